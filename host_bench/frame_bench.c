@@ -0,0 +1,493 @@
+/*
+ * frame_bench.c — Replay pcap captures through the bridge frame functions
+ *
+ * Buduje się na hoście z main/repeater_frame.c, main/repeater_macnat.c
+ * i main/repeater_qos.c (bez ESP-IDF) i podaje ns/ramkę dla każdej funkcji fast path:
+ *
+ *   is_broadcast_for_us        frame_bcast_for_us()
+ *   macnat_learn               frame_macnat_learn() (IPv4 src / ARP sender)
+ *   macnat_rewrite_upstream    frame_macnat_upstream(learn = true)
+ *   macnat_rewrite_downstream  frame_macnat_downstream()
+ *   sniff_dhcp_ack             frame_dhcp_ack_parse() + frame_pick_ap_ip()
+ *                              (tylko ramki UDP 67→68, jak w sta_rx_forward)
+ *   qos_classify               qos_classify() (cache flow, jedna tablica)
+ *   mss_clamp                  frame_mss_clamp() do MSS 1400 (każda ramka, jak bridge_tx)
+ *
+ * Funkcje przepisujące dostają kopię ramki; koszt samej kopii jest
+ * mierzony osobno i odejmowany. Bez argumentów używa syntetycznego
+ * miksu (TCP/UDP, ARP, DHCP ACK, IPv6 + NDP) — liczby z prawdziwych capture'ów
+ * (classic pcap, DLT_EN10MB) są bardziej miarodajne.
+ *
+ *   frame_bench [-r rounds] [-c client_mac] [-i our_ip] file.pcap ...
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "repeater_frame.h"
+#include "repeater_qos.h"
+
+#define FRAME_MAX      1514
+#define CALLS_TARGET   2000000u   /* domyślna liczba wywołań na funkcję */
+
+typedef struct {
+    uint16_t len;
+    uint8_t  data[FRAME_MAX];
+} bench_frame_t;
+
+static bench_frame_t *s_frames;
+static size_t s_count, s_cap;
+
+static macnat_table_t s_table;
+static macnat6_table_t s_table6;
+static qos_table_t s_qos;
+static uint32_t s_qos_calls;       /* zegar klasyfikatora: 1 ms na 64 wywołania */
+static uint8_t s_client_mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+static uint32_t s_our_ip;          /* network order */
+static volatile uint32_t s_sink;   /* żeby kompilator nie wyrzucił pętli */
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static const frame_ctx_t s_ctx = {
+    .macnat     = &s_table,
+    .macnat6    = &s_table6,
+    .client_mac = s_client_mac,
+    .now_us     = now_us,
+};
+
+static void add_frame(const uint8_t *data, uint32_t len)
+{
+    if (len < PKT_ETH_HDR_LEN || len > FRAME_MAX) return;
+    if (s_count == s_cap) {
+        s_cap = s_cap ? s_cap * 2 : 1024;
+        s_frames = realloc(s_frames, s_cap * sizeof(*s_frames));
+        if (!s_frames) { perror("realloc"); exit(1); }
+    }
+    s_frames[s_count].len = len;
+    memcpy(s_frames[s_count].data, data, len);
+    s_count++;
+}
+
+/* ── pcap ─────────────────────────────────────────────────────── */
+
+static uint32_t rd32(const uint8_t *p, bool swap)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return swap ? __builtin_bswap32(v) : v;
+}
+
+static bool load_pcap(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) { perror(path); return false; }
+
+    uint8_t gh[24];
+    if (fread(gh, 1, sizeof(gh), f) != sizeof(gh)) {
+        fprintf(stderr, "%s: short file\n", path);
+        fclose(f);
+        return false;
+    }
+    uint32_t magic;
+    memcpy(&magic, gh, 4);
+    bool swap;
+    if (magic == 0xa1b2c3d4 || magic == 0xa1b23c4d) {
+        swap = false;
+    } else if (magic == 0xd4c3b2a1 || magic == 0x4d3cb2a1) {
+        swap = true;
+    } else {
+        fprintf(stderr, "%s: not a classic pcap file (pcapng? convert with editcap -F pcap)\n", path);
+        fclose(f);
+        return false;
+    }
+    uint32_t linktype = rd32(gh + 20, swap);
+    if (linktype != 1) {
+        fprintf(stderr, "%s: linktype %u, need 1 (Ethernet)\n", path, linktype);
+        fclose(f);
+        return false;
+    }
+
+    static uint8_t buf[65536];
+    size_t before = s_count, skipped = 0;
+    uint8_t rh[16];
+    while (fread(rh, 1, sizeof(rh), f) == sizeof(rh)) {
+        uint32_t incl = rd32(rh + 8, swap);
+        uint32_t orig = rd32(rh + 12, swap);
+        if (incl > sizeof(buf) || fread(buf, 1, incl, f) != incl) break;
+        /* Ucięte przez snaplen — offsety dalej w ramce byłyby poza buforem */
+        if (incl != orig || incl > FRAME_MAX) { skipped++; continue; }
+        add_frame(buf, incl);
+    }
+    fclose(f);
+    printf("%s: %zu frames", path, s_count - before);
+    if (skipped) printf(" (%zu truncated/oversized skipped)", skipped);
+    printf("\n");
+    return true;
+}
+
+/* ── synthetic mix ────────────────────────────────────────────── */
+
+static void put16(uint8_t *p, uint16_t v) { p[0] = v >> 8; p[1] = v; }
+
+static size_t eth_ipv4(uint8_t *f, const uint8_t *dst, const uint8_t *src,
+                       uint8_t proto, uint32_t saddr, uint32_t daddr, uint16_t l4_len)
+{
+    memcpy(f, dst, 6);
+    memcpy(f + 6, src, 6);
+    put16(f + 12, PKT_ETHERTYPE_IPV4);
+    uint8_t *ip = f + PKT_ETH_HDR_LEN;
+    memset(ip, 0, 20);
+    ip[0] = 0x45;
+    put16(ip + 2, 20 + l4_len);
+    ip[8] = 64;
+    ip[9] = proto;
+    memcpy(ip + 12, &saddr, 4);
+    memcpy(ip + 16, &daddr, 4);
+    return PKT_ETH_HDR_LEN + 20 + l4_len;
+}
+
+static size_t eth_ipv6(uint8_t *f, const uint8_t *dst, const uint8_t *src,
+                       uint8_t next, const uint8_t *saddr, const uint8_t *daddr,
+                       uint16_t l4_len)
+{
+    memcpy(f, dst, 6);
+    memcpy(f + 6, src, 6);
+    put16(f + 12, PKT_ETHERTYPE_IPV6);
+    uint8_t *ip = f + PKT_ETH_HDR_LEN;
+    memset(ip, 0, 40);
+    ip[0] = 0x60;
+    put16(ip + 4, l4_len);
+    ip[6] = next;
+    ip[7] = next == PKT_IPPROTO_ICMPV6 ? 255 : 64;
+    memcpy(ip + 8, saddr, 16);
+    memcpy(ip + 24, daddr, 16);
+    return PKT_IPV6_MIN_LEN + l4_len;
+}
+
+static uint32_t ip4(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+{
+    uint8_t v[4] = { a, b, c, d };
+    uint32_t r;
+    memcpy(&r, v, 4);
+    return r;
+}
+
+static void build_synthetic(void)
+{
+    static const uint8_t bcast[6] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+    static const uint8_t router[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0xfe };
+    uint8_t f[FRAME_MAX];
+    uint32_t gw = ip4(192, 168, 1, 1);
+
+    for (int c = 0; c < 6; c++) {
+        uint8_t mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x01, (uint8_t)c };
+        uint32_t cip = ip4(192, 168, 1, (uint8_t)(100 + c));
+
+        for (int n = 0; n < 40; n++) {
+            /* Upstream TCP ACK, downstream TCP data */
+            memset(f, 0, sizeof(f));
+            size_t len = eth_ipv4(f, router, mac, PKT_IPPROTO_TCP, cip, ip4(93, 184, 216, 34), 20);
+            f[PKT_ETH_HDR_LEN + 20 + 12] = 5 << 4;
+            f[PKT_ETH_HDR_LEN + 20 + 13] = PKT_TCP_ACK;
+            add_frame(f, len < 60 ? 60 : len);
+
+            memset(f, 0, sizeof(f));
+            len = eth_ipv4(f, s_client_mac, router, PKT_IPPROTO_TCP, ip4(93, 184, 216, 34), cip, 1480);
+            f[PKT_ETH_HDR_LEN + 20 + 12] = 5 << 4;
+            f[PKT_ETH_HDR_LEN + 20 + 13] = PKT_TCP_ACK;
+            add_frame(f, len);
+        }
+
+        /* SYN klienta z MSS 1460 (cel MSS clamp) */
+        memset(f, 0, sizeof(f));
+        size_t syn_len = eth_ipv4(f, router, mac, PKT_IPPROTO_TCP, cip, ip4(93, 184, 216, 34), 24);
+        uint8_t *tcp = f + PKT_ETH_HDR_LEN + 20;
+        tcp[12] = 6 << 4;
+        tcp[13] = PKT_TCP_SYN;
+        tcp[20] = 2; tcp[21] = 4; put16(tcp + 22, 1460);
+        add_frame(f, syn_len < 60 ? 60 : syn_len);
+
+        /* ARP request klienta o gateway + odpowiedź */
+        memset(f, 0, sizeof(f));
+        memcpy(f, bcast, 6);
+        memcpy(f + 6, mac, 6);
+        put16(f + 12, PKT_ETHERTYPE_ARP);
+        put16(f + 14, 1); put16(f + 16, PKT_ETHERTYPE_IPV4);
+        f[18] = 6; f[19] = 4; put16(f + 20, 1);
+        memcpy(f + 22, mac, 6); memcpy(f + 28, &cip, 4);
+        memcpy(f + 38, &gw, 4);
+        add_frame(f, 60);
+        memcpy(f, s_client_mac, 6);
+        memcpy(f + 6, router, 6);
+        put16(f + 20, 2);
+        memcpy(f + 22, router, 6); memcpy(f + 28, &gw, 4);
+        memcpy(f + 32, s_client_mac, 6); memcpy(f + 38, &cip, 4);
+        add_frame(f, 60);
+
+        /* DHCP ACK dla klienta (broadcast, chaddr = prawdziwy MAC) */
+        memset(f, 0, sizeof(f));
+        size_t len = eth_ipv4(f, bcast, router, PKT_IPPROTO_UDP, gw, ip4(255, 255, 255, 255), 8 + 300);
+        uint8_t *udp = f + PKT_ETH_HDR_LEN + 20;
+        put16(udp, 67); put16(udp + 2, 68); put16(udp + 4, 8 + 300);
+        uint8_t *d = udp + 8;
+        d[0] = 2; d[1] = 1; d[2] = 6;
+        memcpy(d + 16, &cip, 4);
+        memcpy(d + 28, mac, 6);
+        d[236] = 0x63; d[237] = 0x82; d[238] = 0x53; d[239] = 0x63;
+        uint8_t opts[] = { 53, 1, 5, 1, 4, 255, 255, 255, 0, 3, 4, 192, 168, 1, 1,
+                           51, 4, 0, 0, 0x0e, 0x10, 255 };
+        memcpy(d + 240, opts, sizeof(opts));
+        add_frame(f, len);
+
+        /* IPv6: NS klienta o router (z SLLA) + TCP downstream do klienta */
+        uint8_t cip6[16] = { 0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 1,
+                             0, 0, 0, 0, 0, 0, 0x10, (uint8_t)c };
+        static const uint8_t rip6[16] = { 0xfe, 0x80, [15] = 1 };
+        memset(f, 0, sizeof(f));
+        len = eth_ipv6(f, router, mac, PKT_IPPROTO_ICMPV6, cip6, rip6, 32);
+        uint8_t *icmp = f + PKT_IPV6_MIN_LEN;
+        icmp[0] = 135;
+        memcpy(icmp + 8, rip6, 16);
+        icmp[24] = 1; icmp[25] = 1;
+        memcpy(icmp + 26, mac, 6);
+        add_frame(f, len);
+        for (int n = 0; n < 20; n++) {
+            memset(f, 0, sizeof(f));
+            len = eth_ipv6(f, s_client_mac, router, PKT_IPPROTO_TCP, rip6, cip6, 1440);
+            f[PKT_IPV6_MIN_LEN + 12] = 5 << 4;
+            f[PKT_IPV6_MIN_LEN + 13] = PKT_TCP_ACK;
+            add_frame(f, len);
+        }
+    }
+
+    /* mDNS / SSDP — multicast, który filtr broadcastów odrzuca */
+    static const uint8_t mdns[6] = { 0x01, 0x00, 0x5e, 0x00, 0x00, 0xfb };
+    for (int n = 0; n < 20; n++) {
+        memset(f, 0, sizeof(f));
+        size_t len = eth_ipv4(f, mdns, router, PKT_IPPROTO_UDP, gw, ip4(224, 0, 0, 251), 8 + 120);
+        put16(f + 34, 5353); put16(f + 36, 5353);
+        add_frame(f, len);
+    }
+    printf("synthetic: %zu frames (6 clients, TCP/ARP/DHCP/IPv6/mDNS)\n", s_count);
+}
+
+/* ── benchmarks ───────────────────────────────────────────────── */
+
+typedef enum {
+    FN_BCAST, FN_LEARN, FN_UPSTREAM, FN_DOWNSTREAM, FN_DHCP, FN_QOS, FN_MSS, FN_COPY, FN_MAX
+} fn_t;
+
+static const char *const FN_NAME[FN_MAX] = {
+    "is_broadcast_for_us", "macnat_learn", "macnat_rewrite_upstream",
+    "macnat_rewrite_downstream", "sniff_dhcp_ack", "qos_classify", "mss_clamp",
+    "(frame copy)",
+};
+
+/* Does fn apply to this frame (mirrors the guards in the RX fast path)? */
+static bool fn_applies(fn_t fn, const bench_frame_t *fr)
+{
+    uint16_t et = pkt_ethertype(fr->data);
+    switch (fn) {
+    case FN_BCAST:
+        return pkt_is_multicast(fr->data);
+    case FN_LEARN:
+        return (et == PKT_ETHERTYPE_IPV4 && fr->len >= PKT_IPV4_MIN_LEN) ||
+               (et == PKT_ETHERTYPE_ARP && fr->len >= PKT_ARP_LEN);
+    case FN_UPSTREAM:
+        return !pkt_is_multicast(fr->data + 6);
+    case FN_DOWNSTREAM:
+        return !pkt_is_multicast(fr->data);
+    case FN_DHCP:
+        return fr->len >= 286 && pkt_udp4_ports(fr->data, fr->len, 67, 68);
+    default:
+        return true;
+    }
+}
+
+static uint32_t run_one(fn_t fn, const bench_frame_t *fr, uint8_t *work)
+{
+    switch (fn) {
+    case FN_BCAST:
+        return frame_bcast_for_us(fr->data, fr->len, s_our_ip, 0);
+    case FN_LEARN: {
+        uint32_t ip;
+        bool arp = pkt_ethertype(fr->data) == PKT_ETHERTYPE_ARP;
+        memcpy(&ip, fr->data + (arp ? 28 : 26), 4);
+        frame_macnat_learn(&s_ctx, ip, fr->data + 6);
+        return s_table.count;
+    }
+    case FN_UPSTREAM:
+        memcpy(work, fr->data, fr->len);
+        frame_macnat_upstream(&s_ctx, work, fr->len, true);
+        return work[6];
+    case FN_DOWNSTREAM:
+        memcpy(work, fr->data, fr->len);
+        return frame_macnat_downstream(&s_ctx, work, fr->len);
+    case FN_DHCP: {
+        frame_dhcp_ack_t ack;
+        if (!frame_dhcp_ack_parse(fr->data, fr->len, &ack)) return 0;
+        if (ack.chaddr) frame_macnat_learn(&s_ctx, ack.yiaddr, ack.chaddr);
+        return frame_pick_ap_ip(ack.yiaddr, ack.netmask, ack.gateway);
+    }
+    case FN_QOS: {
+        bool unmarked;
+        return qos_classify(&s_qos, fr->data, fr->len, s_qos_calls++ >> 6, &unmarked);
+    }
+    case FN_MSS:
+        memcpy(work, fr->data, fr->len);
+        return frame_mss_clamp(work, fr->len, 1400);
+    case FN_COPY:
+        memcpy(work, fr->data, fr->len);
+        return work[0];
+    default:
+        return 0;
+    }
+}
+
+/* Mean ns per call over rounds passes of the applicable frames. */
+static double bench(fn_t fn, const bench_frame_t **set, size_t n, unsigned rounds)
+{
+    static uint8_t work[FRAME_MAX];
+    uint32_t acc = 0;
+
+    /* Rozgrzewka: cache, tablica MAC-NAT w stanie ustalonym */
+    for (size_t i = 0; i < n; i++) acc += run_one(fn, set[i], work);
+
+    uint64_t t0 = now_ns();
+    for (unsigned r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < n; i++) acc += run_one(fn, set[i], work);
+    }
+    uint64_t t1 = now_ns();
+    s_sink += acc;
+    return (double)(t1 - t0) / ((double)rounds * n);
+}
+
+static bool parse_mac(const char *s, uint8_t *mac)
+{
+    unsigned m[6];
+    if (sscanf(s, "%x:%x:%x:%x:%x:%x", &m[0], &m[1], &m[2], &m[3], &m[4], &m[5]) != 6) {
+        return false;
+    }
+    for (int i = 0; i < 6; i++) mac[i] = m[i];
+    return true;
+}
+
+static bool parse_ip(const char *s, uint32_t *ip)
+{
+    unsigned a, b, c, d;
+    if (sscanf(s, "%u.%u.%u.%u", &a, &b, &c, &d) != 4 || a > 255 || b > 255 ||
+        c > 255 || d > 255) {
+        return false;
+    }
+    *ip = ip4(a, b, c, d);
+    return true;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [-r rounds] [-c client_mac] [-i our_ip] [file.pcap ...]\n"
+            "  -r  passes over the frames per function (default: ~%u calls)\n"
+            "  -c  cloned client MAC (upstream identity), default 02:00:00:00:00:01\n"
+            "  -i  repeater IP for the ARP filter, default 192.168.1.254\n",
+            argv0, CALLS_TARGET);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned rounds = 0;
+    s_our_ip = ip4(192, 168, 1, 254);
+
+    int opt;
+    while ((opt = getopt(argc, argv, "r:c:i:h")) != -1) {
+        switch (opt) {
+        case 'r': rounds = (unsigned)strtoul(optarg, NULL, 0); break;
+        case 'c':
+            if (!parse_mac(optarg, s_client_mac)) { usage(argv[0]); return 2; }
+            break;
+        case 'i':
+            if (!parse_ip(optarg, &s_our_ip)) { usage(argv[0]); return 2; }
+            break;
+        default: usage(argv[0]); return 2;
+        }
+    }
+
+    if (optind < argc) {
+        for (int i = optind; i < argc; i++) {
+            if (!load_pcap(argv[i])) return 1;
+        }
+    } else {
+        build_synthetic();
+    }
+    if (s_count == 0) {
+        fprintf(stderr, "no usable frames\n");
+        return 1;
+    }
+
+    macnat_table_clear(&s_table);
+    macnat6_table_clear(&s_table6);
+    printf("MAC-NAT capacity %d, client MAC %02x:%02x:%02x:%02x:%02x:%02x\n\n",
+           MACNAT_CAPACITY, s_client_mac[0], s_client_mac[1], s_client_mac[2],
+           s_client_mac[3], s_client_mac[4], s_client_mac[5]);
+
+    const bench_frame_t **set = malloc(s_count * sizeof(*set));
+    if (!set) { perror("malloc"); return 1; }
+
+    double copy_ns[2] = { 0, 0 };   /* upstream / downstream frame sets */
+    printf("%-27s %8s %10s %10s\n", "function", "frames", "ns/frame", "raw ns");
+    for (fn_t fn = 0; fn < FN_COPY; fn++) {
+        size_t n = 0;
+        for (size_t i = 0; i < s_count; i++) {
+            if (fn_applies(fn, &s_frames[i])) set[n++] = &s_frames[i];
+        }
+        if (n == 0) {
+            printf("%-27s %8u %10s %10s\n", FN_NAME[fn], 0u, "-", "-");
+            continue;
+        }
+        unsigned r = rounds ? rounds : CALLS_TARGET / n + 1;
+        double raw = bench(fn, set, n, r);
+        double net = raw;
+        if (fn == FN_UPSTREAM || fn == FN_DOWNSTREAM) {
+            double *c = &copy_ns[fn == FN_DOWNSTREAM];
+            *c = bench(FN_COPY, set, n, r);
+            net = raw > *c ? raw - *c : 0;
+        } else if (fn == FN_MSS) {
+            double c = bench(FN_COPY, set, n, r);
+            net = raw > c ? raw - c : 0;
+        }
+        printf("%-27s %8zu %10.1f %10.1f\n", FN_NAME[fn], n, net, raw);
+    }
+    printf("\n%s: %.1f / %.1f ns (subtracted from up/downstream, mss_clamp)\n",
+           FN_NAME[FN_COPY], copy_ns[0], copy_ns[1]);
+    printf("MAC-NAT entries after replay: %u IPv4, %u IPv6\n", s_table.count, s_table6.count);
+
+    /* Rozkład klas po replayu (cache flow w stanie ustalonym) */
+    uint32_t per_ac[QOS_AC_MAX] = { 0 };
+    for (size_t i = 0; i < s_count; i++) {
+        bool unmarked;
+        per_ac[qos_classify(&s_qos, s_frames[i].data, s_frames[i].len,
+                            s_qos_calls++ >> 6, &unmarked)]++;
+    }
+    printf("QoS classes:");
+    for (int a = QOS_AC_MAX - 1; a >= 0; a--) printf(" %s %u", QOS_AC_NAME[a], per_ac[a]);
+    printf("\n");
+
+    free(set);
+    free(s_frames);
+    return 0;
+}
@@ -0,0 +1,7 @@
+/*
+ * sdkconfig.h — Host build stand-in for the ESP-IDF generated header
+ *
+ * repeater_macnat.h czyta z niego CONFIG_REPEATER_MACNAT_CAPACITY;
+ * wartość podaje CMakeLists.txt (-DMACNAT_CAPACITY=N).
+ */
+#pragma once
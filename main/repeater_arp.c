@@ -0,0 +1,126 @@
+/*
+ * repeater_arp.c — Proxy ARP: cache hostów upstream + odpowiedzi z bridge'a
+ */
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "repeater_pkt.h"
+#include "repeater_arp.h"
+
+#ifndef CONFIG_REPEATER_PROXY_ARP_TTL_S
+#define CONFIG_REPEATER_PROXY_ARP_TTL_S  60
+#endif
+
+#define ARP_TTL_MS  ((uint32_t)CONFIG_REPEATER_PROXY_ARP_TTL_S * 1000)
+
+typedef struct {
+    uint32_t ip;                      /* 0 = pusty wpis */
+    uint8_t  mac[6];
+    uint32_t seen_ms;                 /* ostatni ARP od tego hosta */
+} arp_entry_t;
+
+static arp_entry_t       s_cache[ARP_CACHE_SIZE];
+static arp_proxy_stats_t s_stats;
+static portMUX_TYPE      s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static inline uint32_t now_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static inline bool entry_fresh(const arp_entry_t *e, uint32_t now)
+{
+    return e->ip && now - e->seen_ms < ARP_TTL_MS;
+}
+
+bool arp_parse(const uint8_t *frame, uint16_t len, arp_msg_t *out)
+{
+    if (len < PKT_ARP_LEN || pkt_ethertype(frame) != PKT_ETHERTYPE_ARP) return false;
+    /* htype 1 (Ethernet), ptype 0x0800, hlen 6, plen 4 */
+    if (frame[14] != 0 || frame[15] != 1 || frame[16] != 0x08 || frame[17] != 0x00 ||
+        frame[18] != 6 || frame[19] != 4) {
+        return false;
+    }
+    out->op = (uint16_t)(frame[20] << 8 | frame[21]);
+    out->sender_mac = frame + 22;
+    memcpy(&out->sender_ip, frame + 28, 4);
+    memcpy(&out->target_ip, frame + 38, 4);
+    return true;
+}
+
+void arp_build_reply(uint8_t *out, const uint8_t *req, const uint8_t *mac)
+{
+    memcpy(out, req + 6, 6);                  /* eth dst = nadawca requestu */
+    memcpy(out + 6, mac, 6);
+    memcpy(out + 12, req + 12, 10);           /* ethertype + htype..plen + (op) */
+    out[20] = 0;
+    out[21] = ARP_OP_REPLY;
+    memcpy(out + 22, mac, 6);                 /* sha = odpowiadany MAC */
+    memcpy(out + 28, req + 38, 4);            /* spa = pytany IP */
+    memcpy(out + 32, req + 22, 10);           /* tha/tpa = sha/spa requestu */
+}
+
+void arp_proxy_learn(uint32_t ip, const uint8_t *mac)
+{
+    const uint32_t now = now_ms();
+    portENTER_CRITICAL(&s_lock);
+    /* Wpis tego IP, inaczej pusty, inaczej najdawniej widziany */
+    arp_entry_t *slot = NULL, *spare = &s_cache[0];
+    for (int i = 0; i < ARP_CACHE_SIZE; i++) {
+        arp_entry_t *e = &s_cache[i];
+        if (e->ip == ip) { slot = e; break; }
+        if (!spare->ip) continue;
+        if (!e->ip || now - e->seen_ms > now - spare->seen_ms) spare = e;
+    }
+    if (!slot) slot = spare;
+    slot->ip = ip;
+    memcpy(slot->mac, mac, 6);
+    slot->seen_ms = now;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+bool arp_proxy_lookup(uint32_t ip, uint8_t *mac_out)
+{
+    const uint32_t now = now_ms();
+    bool found = false;
+    portENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < ARP_CACHE_SIZE; i++) {
+        if (s_cache[i].ip == ip && entry_fresh(&s_cache[i], now)) {
+            memcpy(mac_out, s_cache[i].mac, 6);
+            found = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return found;
+}
+
+void arp_proxy_clear(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    memset(s_cache, 0, sizeof(s_cache));
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void arp_proxy_count(metrics_path_t path, bool hit)
+{
+    portENTER_CRITICAL(&s_lock);
+    if (hit) {
+        s_stats.hit[path]++;
+    } else {
+        s_stats.miss[path]++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void arp_proxy_get_stats(arp_proxy_stats_t *out)
+{
+    const uint32_t now = now_ms();
+    portENTER_CRITICAL(&s_lock);
+    *out = s_stats;
+    out->cached = 0;
+    for (int i = 0; i < ARP_CACHE_SIZE; i++) {
+        if (entry_fresh(&s_cache[i], now)) out->cached++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,74 @@
+/*
+ * repeater_arp.h — Proxy ARP: cache hostów upstream + odpowiedzi z bridge'a
+ *
+ * Każdy ARP request klienta idzie upstream broadcastem, a każdy broadcast
+ * ARP z upstream jest powtarzany downstream — dwa razy na basic rate.
+ * Z CONFIG_REPEATER_PROXY_ARP bridge odpowiada sam:
+ *   - upstream pyta o znanego klienta (tablica MAC-NAT, klient wciąż
+ *     podłączony) → odpowiedź z MAC widocznym upstream (s_client_mac),
+ *     broadcast nie idzie do AP
+ *   - klient pyta o hosta upstream (brama) z świeżym wpisem w cache →
+ *     odpowiedź od razu na AP, broadcast nie idzie upstream
+ * Cache uczy się z nadawców ARP widzianych po stronie STA (requesty
+ * i reply routera), wpis żyje REPEATER_PROXY_ARP_TTL_S od ostatniego
+ * ARP tego hosta. Odpowiadamy tylko na broadcast — unicastowy request
+ * (odświeżenie wpisu) sprawdza, czy host żyje, więc idzie dalej.
+ *
+ * Wywoływany ze slow path obu kierunków — stan chroniony spinlockiem.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "repeater_metrics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ARP_CACHE_SIZE  8     /* hostów upstream (brama + kilka serwerów LAN) */
+
+#define ARP_OP_REQUEST  1
+#define ARP_OP_REPLY    2
+
+typedef struct {
+    uint16_t op;
+    uint32_t sender_ip;       /* network byte order */
+    uint32_t target_ip;
+    const uint8_t *sender_mac;
+} arp_msg_t;
+
+typedef struct {
+    uint32_t hit[METRICS_PATH_MAX];    /* request obsłużony przez bridge (ścieżka RX) */
+    uint32_t miss[METRICS_PATH_MAX];   /* request przekazany dalej */
+    uint32_t cached;                   /* świeże wpisy w cache */
+} arp_proxy_stats_t;
+
+/* Ethernet + ARP IPv4 over Ethernet; false for anything else. */
+bool arp_parse(const uint8_t *frame, uint16_t len, arp_msg_t *out);
+
+/**
+ * Build the reply to the request in req: "target_ip is at mac", sent
+ * back to the requester's Ethernet/ARP sender address. out holds
+ * PKT_ARP_LEN bytes.
+ */
+void arp_build_reply(uint8_t *out, const uint8_t *req, const uint8_t *mac);
+
+/* Remember (or refresh) an upstream host. */
+void arp_proxy_learn(uint32_t ip, const uint8_t *mac);
+
+/* Fresh cache entry for ip → mac_out. */
+bool arp_proxy_lookup(uint32_t ip, uint8_t *mac_out);
+
+/* Forget the cache (new upstream network). */
+void arp_proxy_clear(void);
+
+/* Count a request received on path as answered (hit) or forwarded. */
+void arp_proxy_count(metrics_path_t path, bool hit);
+
+void arp_proxy_get_stats(arp_proxy_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,357 @@
+/*
+ * repeater_bench.c — On-device throughput benchmark
+ */
+#include "repeater_bench.h"
+
+const char *const BENCH_MODE_NAME[BENCH_MODE_MAX] = {
+    [BENCH_MODE_STA_TX]   = "sta_tx",
+    [BENCH_MODE_AP_TX]    = "ap_tx",
+    [BENCH_MODE_LOOPBACK] = "loopback",
+    [BENCH_MODE_TCP_SINK] = "tcp_sink",
+};
+
+#if CONFIG_REPEATER_BENCH
+
+#include <string.h>
+#include <errno.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_wifi.h"
+#include "esp_private/wifi.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "lwip/sockets.h"
+#include "repeater_pkt.h"
+#include "repeater_mem.h"
+
+#ifndef CONFIG_REPEATER_BENCH_PORT
+#define CONFIG_REPEATER_BENCH_PORT  5001
+#endif
+
+static const char *TAG = "bench";
+
+#define BENCH_TASK_STACK     3072
+#define BENCH_TASK_PRIO      4       /* poniżej status/roaming — nie zagłusza control plane */
+#define BENCH_YIELD_MS       50      /* loopback: vTaskDelay(1) co tyle — idle/WDT */
+#define BENCH_ACCEPT_S       30      /* tcp_sink: czekanie na klienta iperf */
+
+uint8_t s_bench_frame[BENCH_FRAME_MAX];
+
+static bench_result_t s_result;
+static portMUX_TYPE   s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* ── Pomiar ───────────────────────────────────────────────────── */
+
+typedef struct {
+    int64_t  t0_us;
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    configRUN_TIME_COUNTER_TYPE idle0[SOC_CPU_CORES_NUM];
+#endif
+} bench_clock_t;
+
+static void clock_start(bench_clock_t *c)
+{
+    c->t0_us = esp_timer_get_time();
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    for (int i = 0; i < SOC_CPU_CORES_NUM; i++) {
+        c->idle0[i] = ulTaskGetRunTimeCounter(xTaskGetIdleTaskHandleForCore(i));
+    }
+#endif
+}
+
+/* Przelicz liczniki na wynik; final = koniec przebiegu (obciążenie CPU) */
+static void publish(const bench_clock_t *c, uint32_t frames, uint64_t bytes,
+                    uint32_t drops, uint64_t cycles, bool final)
+{
+    int64_t  now = esp_timer_get_time();
+    uint32_t ms  = (uint32_t)((now - c->t0_us) / 1000);
+    int8_t   load[SOC_CPU_CORES_NUM];
+
+    for (int i = 0; i < SOC_CPU_CORES_NUM; i++) {
+        load[i] = -1;
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+        /* Licznik run time = esp_timer (µs) — czas idle vs czas ścienny */
+        if (final && now > c->t0_us) {
+            uint32_t idle = ulTaskGetRunTimeCounter(xTaskGetIdleTaskHandleForCore(i)) - c->idle0[i];
+            int64_t  busy = 100 - (int64_t)idle * 100 / (now - c->t0_us);
+            load[i] = (int8_t)(busy < 0 ? 0 : busy > 100 ? 100 : busy);
+        }
+#endif
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    s_result.elapsed_ms = ms;
+    s_result.frames     = frames;
+    s_result.bytes      = bytes;
+    s_result.drops      = drops;
+    s_result.kbps       = ms ? (uint32_t)(bytes * 8 / ms) : 0;
+    s_result.pps        = ms ? (uint32_t)((uint64_t)frames * 1000 / ms) : 0;
+    s_result.cycles_per_frame = frames ? (uint32_t)(cycles / frames) : 0;
+    if (final) memcpy(s_result.cpu_load, load, sizeof(load));
+    portEXIT_CRITICAL(&s_lock);
+}
+
+/* Czy przebieg jeszcze trwa? */
+static inline bool clock_running(const bench_clock_t *c, uint32_t seconds)
+{
+    return esp_timer_get_time() - c->t0_us < (int64_t)seconds * 1000000;
+}
+
+/* ── Ramki ────────────────────────────────────────────────────── */
+
+static uint16_t ip_checksum(const uint8_t *hdr, int len)
+{
+    uint32_t sum = 0;
+    for (int i = 0; i < len; i += 2) sum += (uint32_t)(hdr[i] << 8 | hdr[i + 1]);
+    while (sum >> 16) sum = (sum & 0xffff) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+/* Surowa ramka L2 z EtherType benchmarku; seq na początku payloadu */
+static void build_raw(uint8_t *f, uint16_t len, const uint8_t dst[6], const uint8_t src[6])
+{
+    memcpy(f, dst, 6);
+    memcpy(f + 6, src, 6);
+    f[12] = BENCH_ETHERTYPE >> 8;
+    f[13] = BENCH_ETHERTYPE & 0xff;
+    for (uint16_t i = PKT_ETH_HDR_LEN; i < len; i++) f[i] = (uint8_t)i;
+}
+
+/* Unicast UDP 198.18.0.x (RFC 2544, zakres benchmarków) — zwykła ramka
+ * danych dla fast path, spoza tablicy MAC-NAT i nie dla naszego MAC */
+static void build_udp(uint8_t *f, uint16_t len, const uint8_t dst[6], const uint8_t src[6],
+                      uint8_t ip_src, uint8_t ip_dst)
+{
+    memset(f, 0, len);
+    memcpy(f, dst, 6);
+    memcpy(f + 6, src, 6);
+    f[12] = PKT_ETHERTYPE_IPV4 >> 8;
+    f[13] = PKT_ETHERTYPE_IPV4 & 0xff;
+
+    uint8_t *ip = f + PKT_ETH_HDR_LEN;
+    uint16_t ip_len = len - PKT_ETH_HDR_LEN;
+    ip[0] = 0x45;
+    ip[2] = ip_len >> 8;
+    ip[3] = ip_len & 0xff;
+    ip[8] = 64;
+    ip[9] = PKT_IPPROTO_UDP;
+    ip[12] = 198; ip[13] = 18; ip[14] = 0; ip[15] = ip_src;
+    ip[16] = 198; ip[17] = 18; ip[18] = 0; ip[19] = ip_dst;
+    uint16_t cs = ip_checksum(ip, 20);
+    ip[10] = cs >> 8;
+    ip[11] = cs & 0xff;
+
+    uint8_t *udp = ip + 20;
+    uint16_t udp_len = ip_len - 20;
+    udp[1] = 9;                       /* discard → discard */
+    udp[3] = 9;
+    udp[4] = udp_len >> 8;
+    udp[5] = udp_len & 0xff;
+}
+
+/* ── Tryby ────────────────────────────────────────────────────── */
+
+static esp_err_t run_raw_tx(const bench_params_t *p)
+{
+    wifi_interface_t ifx = p->mode == BENCH_MODE_STA_TX ? WIFI_IF_STA : WIFI_IF_AP;
+    uint8_t dst[6], src[6];
+
+    if (ifx == WIFI_IF_STA) {
+        wifi_ap_record_t ap;
+        if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK) return ESP_ERR_WIFI_NOT_CONNECT;
+        memcpy(dst, ap.bssid, 6);
+    } else {
+        wifi_sta_list_t sl;
+        if (esp_wifi_ap_get_sta_list(&sl) != ESP_OK || sl.num == 0) return ESP_ERR_NOT_FOUND;
+        memcpy(dst, sl.sta[0].mac, 6);
+    }
+    esp_wifi_get_mac(ifx, src);
+    build_raw(s_bench_frame, p->frame_len, dst, src);
+
+    bench_clock_t c;
+    uint32_t frames = 0, drops = 0, seq = 0;
+    clock_start(&c);
+    while (clock_running(&c, p->seconds)) {
+        memcpy(s_bench_frame + PKT_ETH_HDR_LEN, &seq, sizeof(seq));
+        if (esp_wifi_internal_tx(ifx, s_bench_frame, p->frame_len) == ESP_OK) {
+            frames++;
+            seq++;
+        } else {
+            /* Brak buforów TX — oddaj CPU, driver nadaje w tle */
+            drops++;
+            vTaskDelay(1);
+        }
+        if ((frames & 63) == 0) publish(&c, frames, (uint64_t)frames * p->frame_len, drops, 0, false);
+    }
+    publish(&c, frames, (uint64_t)frames * p->frame_len, drops, 0, true);
+    return ESP_OK;
+}
+
+static esp_err_t run_loopback(const bench_params_t *p)
+{
+    /* Lokalnie administrowane MAC — nigdy nasze ani klienta */
+    static const uint8_t FAKE_HOST[6]   = { 0x02, 0xbe, 0x9c, 0x00, 0x00, 0x01 };
+    static const uint8_t FAKE_CLIENT[6] = { 0x02, 0xbe, 0x9c, 0x00, 0x00, 0x02 };
+
+    bench_clock_t c;
+    uint32_t frames = 0;
+    uint64_t cycles = 0;
+    int64_t  last_yield = esp_timer_get_time();
+    clock_start(&c);
+    while (clock_running(&c, p->seconds)) {
+        /* Na zmianę downstream i upstream; fast path może przepisać ramkę,
+         * więc budowana od nowa (poza pomiarem cykli) */
+        metrics_path_t path = (frames & 1) ? METRICS_PATH_AP_RX : METRICS_PATH_STA_RX;
+        if (path == METRICS_PATH_STA_RX) {
+            build_udp(s_bench_frame, p->frame_len, FAKE_CLIENT, FAKE_HOST, 1, 2);
+        } else {
+            build_udp(s_bench_frame, p->frame_len, FAKE_HOST, FAKE_CLIENT, 2, 1);
+        }
+        cycles += repeater_bench_loopback(path, s_bench_frame, p->frame_len);
+        frames++;
+
+        if ((frames & 255) == 0) {
+            publish(&c, frames, (uint64_t)frames * p->frame_len, 0, cycles, false);
+            if (esp_timer_get_time() - last_yield > BENCH_YIELD_MS * 1000) {
+                vTaskDelay(1);
+                last_yield = esp_timer_get_time();
+            }
+        }
+    }
+    publish(&c, frames, (uint64_t)frames * p->frame_len, 0, cycles, true);
+    return ESP_OK;
+}
+
+static esp_err_t run_tcp_sink(const bench_params_t *p)
+{
+    int ls = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (ls < 0) return ESP_ERR_NO_MEM;
+
+    int one = 1;
+    setsockopt(ls, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(CONFIG_REPEATER_BENCH_PORT),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    struct timeval tv = { .tv_sec = BENCH_ACCEPT_S };
+    if (bind(ls, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(ls, 1) != 0) {
+        close(ls);
+        return ESP_FAIL;
+    }
+    setsockopt(ls, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    ESP_LOGI(TAG, "tcp_sink: waiting for iperf -c <ip> -p %d", CONFIG_REPEATER_BENCH_PORT);
+
+    int s = accept(ls, NULL, NULL);
+    close(ls);
+    if (s < 0) return ESP_ERR_TIMEOUT;
+
+    /* Krótki timeout recv — koniec przebiegu sprawdzany także bez danych */
+    tv.tv_sec = 1;
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    bench_clock_t c;
+    uint32_t segs = 0;
+    uint64_t bytes = 0;
+    clock_start(&c);
+    while (clock_running(&c, p->seconds)) {
+        int n = recv(s, s_bench_frame, sizeof(s_bench_frame), 0);
+        if (n == 0) break;                       /* klient skończył */
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) continue;
+            break;
+        }
+        segs++;
+        bytes += n;
+        if ((segs & 63) == 0) publish(&c, segs, bytes, 0, 0, false);
+    }
+    publish(&c, segs, bytes, 0, 0, true);
+    close(s);
+    return ESP_OK;
+}
+
+static void bench_task(void *pv)
+{
+    bench_params_t p = s_result.params;
+    esp_err_t err;
+    repeater_mem_task_begin(BENCH_TASK_STACK);
+
+    ESP_LOGI(TAG, "Start %s, %d s, %d B", BENCH_MODE_NAME[p.mode], p.seconds, p.frame_len);
+    switch (p.mode) {
+    case BENCH_MODE_STA_TX:
+    case BENCH_MODE_AP_TX:   err = run_raw_tx(&p);   break;
+    case BENCH_MODE_LOOPBACK: err = run_loopback(&p); break;
+    default:                 err = run_tcp_sink(&p); break;
+    }
+
+    bench_result_t r;
+    portENTER_CRITICAL(&s_lock);
+    s_result.err     = err;
+    s_result.running = false;
+    r = s_result;
+    portEXIT_CRITICAL(&s_lock);
+
+    ESP_LOGI(TAG, "Done %s: %s, %lu kbit/s, %lu pps, %lu drops", BENCH_MODE_NAME[p.mode],
+             esp_err_to_name(err), (unsigned long)r.kbps,
+             (unsigned long)r.pps, (unsigned long)r.drops);
+    repeater_mem_task_end();
+    vTaskDelete(NULL);
+}
+
+/* ── API ──────────────────────────────────────────────────────── */
+
+esp_err_t repeater_bench_start(const bench_params_t *p)
+{
+    if (p->mode >= BENCH_MODE_MAX || p->seconds < 1 || p->seconds > BENCH_SECONDS_MAX ||
+        p->frame_len < BENCH_FRAME_MIN || p->frame_len > BENCH_FRAME_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    bool busy = s_result.running;
+    if (!busy) {
+        memset(&s_result, 0, sizeof(s_result));
+        memset(s_result.cpu_load, -1, sizeof(s_result.cpu_load));
+        s_result.params  = *p;
+        s_result.running = true;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (busy) return ESP_ERR_INVALID_STATE;
+
+    /* Przypięty (cykle CPU w loopback liczone na jednym rdzeniu), na
+     * ostatnim rdzeniu — task WiFi domyślnie siedzi na rdzeniu 0 */
+    if (xTaskCreatePinnedToCore(bench_task, "bench", BENCH_TASK_STACK, NULL, BENCH_TASK_PRIO, NULL,
+                                SOC_CPU_CORES_NUM - 1) != pdPASS) {
+        portENTER_CRITICAL(&s_lock);
+        s_result.running = false;
+        s_result.err     = ESP_ERR_NO_MEM;
+        portEXIT_CRITICAL(&s_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void repeater_bench_get(bench_result_t *out)
+{
+    portENTER_CRITICAL(&s_lock);
+    *out = s_result;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+#else /* !CONFIG_REPEATER_BENCH */
+
+#include <string.h>
+
+esp_err_t repeater_bench_start(const bench_params_t *p)
+{
+    (void)p;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void repeater_bench_get(bench_result_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    out->err = ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
@@ -0,0 +1,106 @@
+/*
+ * repeater_bench.h — On-device throughput benchmark (POST/GET /bench)
+ *
+ * Zewnętrzny iperf przez klienta miesza radio klienta, CPU bridge'a i
+ * airtime upstream. Tryby tutaj mierzą każdy kawałek osobno:
+ *
+ *   sta_tx    surowe ramki L2 (EtherType 0x88B5, local experimental)
+ *             STA → upstream BSSID przez esp_wifi_internal_tx
+ *   ap_tx     to samo AP → pierwszy podłączony klient
+ *   loopback  syntetyczne ramki przez fast path on_sta_rx / on_ap_rx
+ *             (sta_rx_forward / ap_rx_forward) bez TX — koszt CPU na
+ *             ramkę; bridge_tx() zatrzymuje się na granicy drivera
+ *   tcp_sink  odbiornik TCP w stylu iperf2 (`iperf -c <IP> -p 5001`)
+ *             — upstream → STA albo klient → AP przez lwIP
+ *
+ * Wynik: Mb/s, ramki/s, odrzucone ramki (driver bez buforów TX), obciążenie
+ * CPU per rdzeń (FreeRTOS run time stats, czas tasku idle) i cykle na
+ * ramkę (loopback). Ramki loopback liczą się w /metrics jak prawdziwe.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "soc/soc_caps.h"
+#include "esp_err.h"
+#include "repeater_metrics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BENCH_ETHERTYPE     0x88B5
+#define BENCH_FRAME_MIN     60
+#define BENCH_FRAME_MAX     1514
+#define BENCH_SECONDS_MAX   30
+
+typedef enum {
+    BENCH_MODE_STA_TX = 0,
+    BENCH_MODE_AP_TX,
+    BENCH_MODE_LOOPBACK,
+    BENCH_MODE_TCP_SINK,
+    BENCH_MODE_MAX,
+} bench_mode_t;
+
+extern const char *const BENCH_MODE_NAME[BENCH_MODE_MAX];
+
+typedef struct {
+    bench_mode_t mode;
+    uint8_t      seconds;        /* 1..BENCH_SECONDS_MAX */
+    uint16_t     frame_len;      /* ramki L2 (bez tcp_sink) */
+} bench_params_t;
+
+typedef struct {
+    bench_params_t params;
+    bool     running;
+    esp_err_t err;               /* ESP_OK albo powód przerwania */
+    uint32_t elapsed_ms;
+    uint32_t frames;             /* wysłane / przetworzone / odebrane segmenty recv() */
+    uint64_t bytes;
+    uint32_t drops;              /* esp_wifi_internal_tx() != ESP_OK */
+    uint32_t kbps;
+    uint32_t pps;
+    int8_t   cpu_load[SOC_CPU_CORES_NUM];  /* %, -1 = brak run time stats */
+    uint32_t cycles_per_frame;   /* loopback: średnio na ramkę (obie ścieżki) */
+} bench_result_t;
+
+#if CONFIG_REPEATER_BENCH
+
+/* Loopback: ramki leżą w jednym statycznym buforze — eb == buffer */
+extern uint8_t s_bench_frame[BENCH_FRAME_MAX];
+
+/* Czy buffer / eb to syntetyczna ramka benchmarku (nie bufor drivera)? */
+static inline bool bench_is_frame(const void *p)
+{
+    return (const uint8_t *)p >= s_bench_frame &&
+           (const uint8_t *)p <  s_bench_frame + sizeof(s_bench_frame);
+}
+
+/**
+ * Push one synthetic frame through the RX fast path of the given
+ * direction (implemented in wifi_repeater_main.c). The frame is not
+ * transmitted and never reaches lwIP; it may be rewritten in place.
+ * Live state is left alone: the frame has its own QoS tables and
+ * metrics slot and is not counted per client. Returns the CPU cycles
+ * spent in the fast path.
+ */
+uint32_t repeater_bench_loopback(metrics_path_t path, void *frame, uint16_t len);
+
+#else
+static inline bool bench_is_frame(const void *p) { (void)p; return false; }
+#endif
+
+/**
+ * Start a run in the background "bench" task. ESP_ERR_INVALID_STATE
+ * when one is already running, ESP_ERR_INVALID_ARG on bad params,
+ * ESP_ERR_NOT_SUPPORTED when built without CONFIG_REPEATER_BENCH.
+ */
+esp_err_t repeater_bench_start(const bench_params_t *p);
+
+/* Last (or running) result. */
+void repeater_bench_get(bench_result_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,172 @@
+/*
+ * repeater_clients.c — Per-client accounting and rate caps
+ */
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "repeater_clients.h"
+
+#define BUCKET_MS      100     /* pojemność koszyka = tyle ms ruchu */
+#define BUCKET_MIN     3028    /* ... ale co najmniej 2 pełne ramki */
+
+typedef struct {
+    uint32_t frames;
+    uint64_t bytes;
+    uint32_t capped;
+    /* Okno bieżącej sekundy → pps / bps poprzedniej */
+    uint32_t win_start_ms;
+    uint32_t win_frames;
+    uint32_t win_bytes;
+    uint32_t pps;
+    uint32_t bps;
+    /* Token bucket (bajty) */
+    int32_t  tokens;
+    uint32_t refill_ms;
+} client_dir_state_t;
+
+typedef struct {
+    bool     used;
+    uint8_t  mac[6];
+    uint32_t joined_ms;
+    client_dir_state_t dir[CLIENT_DIR_MAX];
+} client_t;
+
+static client_t     s_clients[CLIENTS_MAX];
+static uint32_t     s_cap_kbps;
+static uint8_t      s_last_hit[CLIENT_DIR_MAX];   /* zwykle jeden aktywny klient */
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static inline int32_t bucket_size(void)
+{
+    /* kbit/s × 125 = B/s; × BUCKET_MS / 1000 */
+    int32_t b = (int32_t)(s_cap_kbps * 125 / (1000 / BUCKET_MS));
+    return b > BUCKET_MIN ? b : BUCKET_MIN;
+}
+
+/* Indeks mac albo CLIENT_NONE; pod s_lock */
+static uint8_t find(const uint8_t *mac, uint8_t hint)
+{
+    if (hint < CLIENTS_MAX && s_clients[hint].used &&
+        memcmp(s_clients[hint].mac, mac, 6) == 0) {
+        return hint;
+    }
+    for (uint8_t i = 0; i < CLIENTS_MAX; i++) {
+        if (s_clients[i].used && memcmp(s_clients[i].mac, mac, 6) == 0) return i;
+    }
+    return CLIENT_NONE;
+}
+
+/* Zamknij okno sekundowe; okno starsze niż 2 s = klient stał */
+static void window_roll(client_dir_state_t *d, uint32_t now)
+{
+    uint32_t age = now - d->win_start_ms;
+    if (age < 1000) return;
+    d->pps = age < 2000 ? d->win_frames : 0;
+    d->bps = age < 2000 ? d->win_bytes : 0;
+    d->win_start_ms = age < 2000 ? d->win_start_ms + 1000 : now;
+    d->win_frames = 0;
+    d->win_bytes = 0;
+}
+
+void clients_add(const uint8_t *mac, uint32_t now_ms)
+{
+    portENTER_CRITICAL(&s_lock);
+    if (find(mac, CLIENT_NONE) == CLIENT_NONE) {
+        for (int i = 0; i < CLIENTS_MAX; i++) {
+            client_t *c = &s_clients[i];
+            if (c->used) continue;
+            memset(c, 0, sizeof(*c));
+            c->used = true;
+            memcpy(c->mac, mac, 6);
+            c->joined_ms = now_ms;
+            for (int d = 0; d < CLIENT_DIR_MAX; d++) {
+                c->dir[d].win_start_ms = now_ms;
+                c->dir[d].refill_ms = now_ms;
+                c->dir[d].tokens = bucket_size();
+            }
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void clients_remove(const uint8_t *mac)
+{
+    portENTER_CRITICAL(&s_lock);
+    uint8_t i = find(mac, CLIENT_NONE);
+    if (i != CLIENT_NONE) s_clients[i].used = false;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void clients_set_cap(uint32_t kbps)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_cap_kbps = kbps;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+bool clients_account(client_dir_t dir, const uint8_t *mac, uint16_t len,
+                     bool control, uint32_t now_ms)
+{
+    bool pass = true;
+    portENTER_CRITICAL(&s_lock);
+    uint8_t i = find(mac, s_last_hit[dir]);
+    if (i != CLIENT_NONE) {
+        s_last_hit[dir] = i;
+        client_dir_state_t *d = &s_clients[i].dir[dir];
+        if (s_cap_kbps) {
+            /* kbit/s / 8 = B/ms; elapsed ograniczony, żeby nie przepełnić int32 */
+            uint32_t elapsed = now_ms - d->refill_ms;
+            if (elapsed > 1000) elapsed = 1000;
+            int32_t size = bucket_size();
+            d->tokens += (int32_t)(elapsed * s_cap_kbps / 8);
+            if (d->tokens > size) d->tokens = size;
+            d->refill_ms = now_ms;
+            if (d->tokens < len && !control) {
+                pass = false;
+                d->capped++;
+            } else {
+                d->tokens -= len;       /* sterujące mogą zejść poniżej zera */
+            }
+        }
+        if (pass) {
+            window_roll(d, now_ms);
+            d->frames++;
+            d->bytes += len;
+            d->win_frames++;
+            d->win_bytes += len;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return pass;
+}
+
+uint8_t clients_index(const uint8_t *mac)
+{
+    portENTER_CRITICAL(&s_lock);
+    uint8_t i = find(mac, s_last_hit[CLIENT_DIR_DOWN]);
+    portEXIT_CRITICAL(&s_lock);
+    return i;
+}
+
+int clients_get(client_info_t *out, int max, uint32_t now_ms)
+{
+    int n = 0;
+    portENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < CLIENTS_MAX && n < max; i++) {
+        client_t *c = &s_clients[i];
+        if (!c->used) continue;
+        client_info_t *o = &out[n++];
+        memcpy(o->mac, c->mac, 6);
+        o->online_s = (now_ms - c->joined_ms) / 1000;
+        for (int d = 0; d < CLIENT_DIR_MAX; d++) {
+            window_roll(&c->dir[d], now_ms);
+            o->frames[d] = c->dir[d].frames;
+            o->bytes[d]  = c->dir[d].bytes;
+            o->pps[d]    = c->dir[d].pps;
+            o->bps[d]    = c->dir[d].bps;
+            o->capped[d] = c->dir[d].capped;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return n;
+}
@@ -0,0 +1,74 @@
+/*
+ * repeater_clients.h — Per-client accounting and rate caps
+ *
+ * Wpis per stacja na AP (dodawany przy AP_STACONNECTED, usuwany przy
+ * rozłączeniu), kluczem jest prawdziwy MAC klienta: upstream to src
+ * ramki jeszcze przed przepisaniem MAC-NAT, downstream dst już po
+ * przepisaniu (lookup w tablicy MAC-NAT zrobiony). Liczniki ramek
+ * i bajtów w obu kierunkach + tempo z ostatniej pełnej sekundy (pps,
+ * B/s) pod GET /status.
+ *
+ * Limit per klient (client_cap_kbps z konfiguracji, 0 = bez limitu):
+ * token bucket na kierunek, pojemność ~100 ms ruchu (min. 2 ramki).
+ * Ramka ponad limit jest odrzucana — TCP zwalnia sam. Ramki sterujące
+ * (ARP, DHCP, pure ACK) nigdy nie są odrzucane, ale zużywają tokeny.
+ *
+ * Indeks wpisu (0..CLIENTS_MAX-1) jest też kluczem DRR kolejki TX
+ * downstream (repeater_txq.h). Wołany z fast path obu kierunków —
+ * stan chroniony spinlockiem.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CLIENTS_MAX   10      /* = górna granica max_clients w GUI */
+#define CLIENT_NONE   0xFF    /* MAC spoza tablicy (broadcast, lwIP, obcy) */
+
+typedef enum {
+    CLIENT_DIR_UP = 0,        /* klient → upstream (AP RX) */
+    CLIENT_DIR_DOWN,          /* upstream → klient (STA RX) */
+    CLIENT_DIR_MAX,
+} client_dir_t;
+
+typedef struct {
+    uint8_t  mac[6];
+    uint32_t frames[CLIENT_DIR_MAX];
+    uint64_t bytes[CLIENT_DIR_MAX];
+    uint32_t pps[CLIENT_DIR_MAX];       /* ostatnia pełna sekunda */
+    uint32_t bps[CLIENT_DIR_MAX];       /* bajty/s, j.w. */
+    uint32_t capped[CLIENT_DIR_MAX];    /* ramki odrzucone przez limit */
+    uint32_t online_s;                  /* od podłączenia */
+} client_info_t;
+
+/* Start accounting a station that joined the AP (no-op when known). */
+void clients_add(const uint8_t *mac, uint32_t now_ms);
+
+/* Forget a station that left. */
+void clients_remove(const uint8_t *mac);
+
+/* Per-client cap in kbit/s for each direction, 0 = unlimited. */
+void clients_set_cap(uint32_t kbps);
+
+/**
+ * Count a frame of client mac in direction dir. Returns false when the
+ * cap drops it (never for control frames). An unknown MAC is counted
+ * nowhere and never dropped.
+ */
+bool clients_account(client_dir_t dir, const uint8_t *mac, uint16_t len,
+                     bool control, uint32_t now_ms);
+
+/* Index of mac, CLIENT_NONE when unknown. */
+uint8_t clients_index(const uint8_t *mac);
+
+/* Copy up to max connected clients to out; returns how many. */
+int clients_get(client_info_t *out, int max, uint32_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif
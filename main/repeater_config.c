@@ -1,15 +1,78 @@
 /*
  * repeater_config.c — NVS-backed runtime configuration
+ *
+ * Konfiguracja to jeden blob "cfg" (namespace rep_cfg): nagłówek z
+ * wersją, długością i CRC32 + payload o stałym układzie (cfg_blob_t,
+ * niezależny od repeater_config_t). Load = jeden nvs_get_blob, save =
+ * jeden nvs_set_blob + commit, i to tylko gdy payload się zmienił.
+ *
+ * Stan runtime (ostatni upstream, później tablice uczone w locie) jest
+ * w osobnym namespace rep_rt — częste małe zapisy nie przepisują bloba
+ * konfiguracji ani nie zużywają jego stron.
+ *
+ * Wersjonowanie: nowe pola dopisujemy na koniec payloadu — starszy,
+ * krótszy blob wczytuje się, a brakujący ogon bierze wartości domyślne.
+ * CFG_BLOB_VERSION podbijamy tylko przy zmianie znaczenia istniejącego
+ * pola (wtedy migracja w cfg_from_blob). Wersja 0 = stary układ, jeden
+ * klucz NVS na pole — migrowany przy pierwszym starcie.
  */
+#include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include "repeater_config.h"
 #include "nvs_flash.h"
 #include "nvs.h"
 #include "esp_log.h"
+#include "esp_rom_crc.h"
 #include "sdkconfig.h"
 
 static const char *TAG = "rep_cfg";
-#define NVS_NAMESPACE "rep_cfg"
+#define NVS_NAMESPACE     "rep_cfg"
+#define NVS_NAMESPACE_RT  "rep_rt"     /* stan runtime */
+#define CFG_BLOB_KEY      "cfg"
+#define RT_UPSTREAM_KEY   "upstream"
+
+#define BLOB_MAGIC        0x5243       /* "RC" */
+#define CFG_BLOB_VERSION  1
+
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint8_t  version;
+    uint8_t  reserved;
+    uint16_t len;          /* bajty payloadu */
+    uint32_t crc;          /* CRC32 payloadu */
+} blob_hdr_t;
+
+/* Układ payloadu w NVS — tylko dopisywanie na końcu (patrz nagłówek) */
+typedef struct __attribute__((packed)) {
+    char     sta_ssid[REPEATER_SSID_MAX];
+    char     sta_pass[REPEATER_PASS_MAX];
+    char     ap_ssid[REPEATER_SSID_MAX];
+    char     ap_pass[REPEATER_PASS_MAX];
+    uint8_t  tx_power_dbm;
+    uint8_t  max_clients;
+    uint8_t  radio_profile;
+    uint8_t  bridge_mode;
+    uint8_t  upstream_mac[6];
+    uint8_t  ap_authmode;
+    uint8_t  ap_clone_ssid;
+    uint8_t  pseudo_mesh;
+    int8_t   roam_rssi_threshold;
+    uint8_t  roam_hysteresis;
+    uint32_t client_cap_kbps;
+} cfg_blob_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t  bssid[6];
+    uint8_t  channel;
+} rt_upstream_t;
+
+/* Klucze starego układu (wersja 0) — kasowane po migracji */
+static const char *const LEGACY_KEYS[] = {
+    "sta_ssid", "sta_pass", "ap_ssid", "ap_pass", "tx_power", "max_cli", "radio",
+    "authmode", "bridge", "up_mac", "clone_ssid", "pmesh", "roam_rssi", "roam_hyst",
+    "up_bssid", "up_ch",
+};
 
 /* ── helpers ─────────────────────────────────────────────────── */
 
@@ -30,69 +93,264 @@ static void load_u8(nvs_handle_t h, const char *key,
     }
 }
 
-/* ── public API ──────────────────────────────────────────────── */
+/* "aa:bb:cc:dd:ee:ff" z Kconfig; pusty / błędny → zera (MAC fabryczny) */
+static void parse_mac(const char *str, uint8_t *mac)
+{
+    if (!repeater_mac_parse(str, mac)) memset(mac, 0, 6);
+}
 
-esp_err_t repeater_config_load(repeater_config_t *cfg)
+static void config_defaults(repeater_config_t *cfg)
 {
-    nvs_handle_t h;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &h);
-    if (err == ESP_ERR_NVS_NOT_FOUND) {
-        /* No saved config — use Kconfig defaults */
-        ESP_LOGI(TAG, "No NVS config, using menuconfig defaults");
-        strlcpy(cfg->sta_ssid, CONFIG_REPEATER_UPSTREAM_SSID, sizeof(cfg->sta_ssid));
-        strlcpy(cfg->sta_pass, CONFIG_REPEATER_UPSTREAM_PASSWORD, sizeof(cfg->sta_pass));
-        strlcpy(cfg->ap_ssid,  CONFIG_REPEATER_AP_SSID,  sizeof(cfg->ap_ssid));
-        strlcpy(cfg->ap_pass,  CONFIG_REPEATER_AP_PASSWORD, sizeof(cfg->ap_pass));
-        cfg->tx_power_dbm = CONFIG_REPEATER_TX_POWER;
-        cfg->max_clients  = CONFIG_REPEATER_MAX_CLIENTS;
-        cfg->ap_authmode  = CONFIG_REPEATER_AP_AUTHMODE_VAL;
+    memset(cfg, 0, sizeof(*cfg));
+    strlcpy(cfg->sta_ssid, CONFIG_REPEATER_UPSTREAM_SSID, sizeof(cfg->sta_ssid));
+    strlcpy(cfg->sta_pass, CONFIG_REPEATER_UPSTREAM_PASSWORD, sizeof(cfg->sta_pass));
+    strlcpy(cfg->ap_ssid,  CONFIG_REPEATER_AP_SSID,  sizeof(cfg->ap_ssid));
+    strlcpy(cfg->ap_pass,  CONFIG_REPEATER_AP_PASSWORD, sizeof(cfg->ap_pass));
+    cfg->tx_power_dbm = CONFIG_REPEATER_TX_POWER;
+    cfg->max_clients  = CONFIG_REPEATER_MAX_CLIENTS;
+    cfg->radio_profile = CONFIG_REPEATER_RADIO_PROFILE_VAL;
+    cfg->ap_authmode  = CONFIG_REPEATER_AP_AUTHMODE_VAL;
+    cfg->bridge_mode  = CONFIG_REPEATER_BRIDGE_MODE_VAL;
+    parse_mac(CONFIG_REPEATER_UPSTREAM_MAC, cfg->upstream_mac);
 #ifdef CONFIG_REPEATER_AP_CLONE_SSID
-        cfg->ap_clone_ssid = 1;
+    cfg->ap_clone_ssid = 1;
 #else
-        cfg->ap_clone_ssid = 0;
+    cfg->ap_clone_ssid = 0;
 #endif
 #ifdef CONFIG_REPEATER_PSEUDO_MESH
-        cfg->pseudo_mesh = 1;
-        cfg->roam_rssi_threshold = CONFIG_REPEATER_ROAM_RSSI_THRESHOLD;
-        cfg->roam_hysteresis = CONFIG_REPEATER_ROAM_HYSTERESIS;
+    cfg->pseudo_mesh = 1;
+    cfg->roam_rssi_threshold = CONFIG_REPEATER_ROAM_RSSI_THRESHOLD;
+    cfg->roam_hysteresis = CONFIG_REPEATER_ROAM_HYSTERESIS;
 #else
-        cfg->pseudo_mesh = 0;
-        cfg->roam_rssi_threshold = -70;
-        cfg->roam_hysteresis = 8;
+    cfg->pseudo_mesh = 0;
+    cfg->roam_rssi_threshold = -70;
+    cfg->roam_hysteresis = 8;
 #endif
-        return ESP_OK;
+#ifdef CONFIG_REPEATER_CLIENT_CAP_KBPS
+    cfg->client_cap_kbps = CONFIG_REPEATER_CLIENT_CAP_KBPS;
+#endif
+}
+
+static void cfg_to_blob(const repeater_config_t *cfg, cfg_blob_t *b)
+{
+    /* memset: padding stringów zawsze zerowy → porównanie bajtowe działa */
+    memset(b, 0, sizeof(*b));
+    strlcpy(b->sta_ssid, cfg->sta_ssid, sizeof(b->sta_ssid));
+    strlcpy(b->sta_pass, cfg->sta_pass, sizeof(b->sta_pass));
+    strlcpy(b->ap_ssid,  cfg->ap_ssid,  sizeof(b->ap_ssid));
+    strlcpy(b->ap_pass,  cfg->ap_pass,  sizeof(b->ap_pass));
+    b->tx_power_dbm        = cfg->tx_power_dbm;
+    b->max_clients         = cfg->max_clients;
+    b->radio_profile       = cfg->radio_profile;
+    b->bridge_mode         = cfg->bridge_mode;
+    memcpy(b->upstream_mac, cfg->upstream_mac, 6);
+    b->ap_authmode         = cfg->ap_authmode;
+    b->ap_clone_ssid       = cfg->ap_clone_ssid;
+    b->pseudo_mesh         = cfg->pseudo_mesh;
+    b->roam_rssi_threshold = cfg->roam_rssi_threshold;
+    b->roam_hysteresis     = cfg->roam_hysteresis;
+    b->client_cap_kbps     = cfg->client_cap_kbps;
+}
+
+/* Payload o długości len (≤ sizeof) → cfg; cfg ma już wartości domyślne
+ * dla pól spoza starszego, krótszego bloba */
+static void cfg_from_blob(repeater_config_t *cfg, const uint8_t *payload, size_t len)
+{
+    cfg_blob_t b;
+    cfg_to_blob(cfg, &b);
+    memcpy(&b, payload, len);
+    b.sta_ssid[sizeof(b.sta_ssid) - 1] = '\0';
+    b.sta_pass[sizeof(b.sta_pass) - 1] = '\0';
+    b.ap_ssid[sizeof(b.ap_ssid) - 1]   = '\0';
+    b.ap_pass[sizeof(b.ap_pass) - 1]   = '\0';
+
+    strlcpy(cfg->sta_ssid, b.sta_ssid, sizeof(cfg->sta_ssid));
+    strlcpy(cfg->sta_pass, b.sta_pass, sizeof(cfg->sta_pass));
+    strlcpy(cfg->ap_ssid,  b.ap_ssid,  sizeof(cfg->ap_ssid));
+    strlcpy(cfg->ap_pass,  b.ap_pass,  sizeof(cfg->ap_pass));
+    cfg->tx_power_dbm        = b.tx_power_dbm;
+    cfg->max_clients         = b.max_clients;
+    cfg->radio_profile       = b.radio_profile;
+    cfg->bridge_mode         = b.bridge_mode;
+    memcpy(cfg->upstream_mac, b.upstream_mac, 6);
+    cfg->ap_authmode         = b.ap_authmode;
+    cfg->ap_clone_ssid       = b.ap_clone_ssid;
+    cfg->pseudo_mesh         = b.pseudo_mesh;
+    cfg->roam_rssi_threshold = b.roam_rssi_threshold;
+    cfg->roam_hysteresis     = b.roam_hysteresis;
+    cfg->client_cap_kbps     = b.client_cap_kbps;
+}
+
+/* ── Blob: nagłówek + CRC ────────────────────────────────────── */
+
+/*
+ * Jeden odczyt do bufora hdr + max. Blob dłuższy niż max (z nowszego
+ * firmware po downgrade) czytany ponownie w całości — bierzemy prefiks.
+ * Zwraca długość payloadu albo -1 (brak, zły magic/CRC).
+ */
+static int blob_read(nvs_handle_t h, const char *key, uint8_t *payload, size_t max,
+                     uint8_t *version)
+{
+    size_t sz = sizeof(blob_hdr_t) + max;
+    uint8_t *buf = malloc(sz);
+    if (!buf) return -1;
+    esp_err_t err = nvs_get_blob(h, key, buf, &sz);
+    if (err == ESP_ERR_NVS_INVALID_LENGTH) {
+        uint8_t *big = realloc(buf, sz);       /* sz = rozmiar zapisanego bloba */
+        if (!big) {
+            free(buf);
+            return -1;
+        }
+        buf = big;
+        err = nvs_get_blob(h, key, buf, &sz);
     }
-    if (err != ESP_OK) return err;
+    int ret = -1;
+    blob_hdr_t hdr;
+    if (err == ESP_OK && sz >= sizeof(hdr)) {
+        memcpy(&hdr, buf, sizeof(hdr));
+        const uint8_t *p = buf + sizeof(hdr);
+        if (hdr.magic != BLOB_MAGIC || hdr.len != sz - sizeof(hdr)) {
+            ESP_LOGW(TAG, "NVS %s: bad header", key);
+        } else if (esp_rom_crc32_le(0, p, hdr.len) != hdr.crc) {
+            ESP_LOGW(TAG, "NVS %s: CRC mismatch", key);
+        } else {
+            ret = hdr.len < max ? hdr.len : (int)max;
+            memcpy(payload, p, ret);
+            if (version) *version = hdr.version;
+        }
+    }
+    free(buf);
+    return ret;
+}
+
+/* Zapis tylko gdy zawartość się zmieniła (odczyt nie zużywa flasha).
+ * *written = false → identyczny blob już jest w NVS. */
+static esp_err_t blob_write(nvs_handle_t h, const char *key, const void *payload,
+                            size_t len, uint8_t version, bool *written)
+{
+    *written = false;
+    size_t sz = sizeof(blob_hdr_t) + len;
+    uint8_t *buf = malloc(2 * sz);
+    if (!buf) return ESP_ERR_NO_MEM;
+
+    blob_hdr_t hdr = {
+        .magic   = BLOB_MAGIC,
+        .version = version,
+        .len     = (uint16_t)len,
+        .crc     = esp_rom_crc32_le(0, payload, len),
+    };
+    memcpy(buf, &hdr, sizeof(hdr));
+    memcpy(buf + sizeof(hdr), payload, len);
+
+    uint8_t *old = buf + sz;
+    size_t old_sz = sz;
+    esp_err_t err = ESP_OK;
+    if (nvs_get_blob(h, key, old, &old_sz) != ESP_OK || old_sz != sz ||
+        memcmp(old, buf, sz) != 0) {
+        err = nvs_set_blob(h, key, buf, sz);
+        if (err == ESP_OK) err = nvs_commit(h);
+        *written = err == ESP_OK;
+    }
+    free(buf);
+    return err;
+}
+
+/* ── Migracja ze starego układu (klucz per pole) ─────────────── */
+
+static bool legacy_load(nvs_handle_t h, repeater_config_t *cfg)
+{
+    size_t len = 0;
+    if (nvs_get_str(h, "sta_ssid", NULL, &len) != ESP_OK) return false;
 
-    ESP_LOGI(TAG, "Loading config from NVS");
     load_str(h, "sta_ssid", cfg->sta_ssid, sizeof(cfg->sta_ssid), CONFIG_REPEATER_UPSTREAM_SSID);
     load_str(h, "sta_pass", cfg->sta_pass, sizeof(cfg->sta_pass), CONFIG_REPEATER_UPSTREAM_PASSWORD);
     load_str(h, "ap_ssid",  cfg->ap_ssid,  sizeof(cfg->ap_ssid),  CONFIG_REPEATER_AP_SSID);
     load_str(h, "ap_pass",  cfg->ap_pass,  sizeof(cfg->ap_pass),  CONFIG_REPEATER_AP_PASSWORD);
-    load_u8(h, "tx_power", &cfg->tx_power_dbm, CONFIG_REPEATER_TX_POWER);
-    load_u8(h, "max_cli",  &cfg->max_clients,  CONFIG_REPEATER_MAX_CLIENTS);
-    load_u8(h, "authmode", &cfg->ap_authmode,   CONFIG_REPEATER_AP_AUTHMODE_VAL);
-#ifdef CONFIG_REPEATER_AP_CLONE_SSID
-    load_u8(h, "clone_ssid", &cfg->ap_clone_ssid, 1);
-#else
-    load_u8(h, "clone_ssid", &cfg->ap_clone_ssid, 0);
-#endif
-#ifdef CONFIG_REPEATER_PSEUDO_MESH
-    load_u8(h, "pmesh",    &cfg->pseudo_mesh,       1);
-    {
-        uint8_t thr;
-        load_u8(h, "roam_rssi", &thr, (uint8_t)(int8_t)CONFIG_REPEATER_ROAM_RSSI_THRESHOLD);
-        cfg->roam_rssi_threshold = (int8_t)thr;
+    load_u8(h, "tx_power", &cfg->tx_power_dbm,  cfg->tx_power_dbm);
+    load_u8(h, "max_cli",  &cfg->max_clients,   cfg->max_clients);
+    load_u8(h, "radio",    &cfg->radio_profile, cfg->radio_profile);
+    load_u8(h, "authmode", &cfg->ap_authmode,   cfg->ap_authmode);
+    load_u8(h, "bridge",   &cfg->bridge_mode,   cfg->bridge_mode);
+    len = sizeof(cfg->upstream_mac);
+    if (nvs_get_blob(h, "up_mac", cfg->upstream_mac, &len) != ESP_OK ||
+        len != sizeof(cfg->upstream_mac)) {
+        parse_mac(CONFIG_REPEATER_UPSTREAM_MAC, cfg->upstream_mac);
     }
-    load_u8(h, "roam_hyst", &cfg->roam_hysteresis, CONFIG_REPEATER_ROAM_HYSTERESIS);
-#else
-    load_u8(h, "clone_ssid", &cfg->ap_clone_ssid, 0);
-    load_u8(h, "pmesh",      &cfg->pseudo_mesh,   0);
-    cfg->roam_rssi_threshold = -70;
-    cfg->roam_hysteresis = 8;
+    load_u8(h, "clone_ssid", &cfg->ap_clone_ssid, cfg->ap_clone_ssid);
+    load_u8(h, "pmesh",      &cfg->pseudo_mesh,   cfg->pseudo_mesh);
+#ifdef CONFIG_REPEATER_PSEUDO_MESH
+    uint8_t thr;
+    load_u8(h, "roam_rssi", &thr, (uint8_t)cfg->roam_rssi_threshold);
+    cfg->roam_rssi_threshold = (int8_t)thr;
+    load_u8(h, "roam_hyst", &cfg->roam_hysteresis, cfg->roam_hysteresis);
 #endif
+    len = sizeof(cfg->last_bssid);
+    if (nvs_get_blob(h, "up_bssid", cfg->last_bssid, &len) != ESP_OK ||
+        len != sizeof(cfg->last_bssid)) {
+        memset(cfg->last_bssid, 0, sizeof(cfg->last_bssid));
+    }
+    load_u8(h, "up_ch", &cfg->last_channel, 0);
+    return true;
+}
 
+/* Pierwszy start po aktualizacji: stare klucze → blob + rep_rt, potem
+ * skasuj stare klucze. Nieudany zapis zostawia stary układ (następny
+ * start spróbuje ponownie). */
+static void legacy_migrate(nvs_handle_t h, const repeater_config_t *cfg)
+{
+    if (repeater_config_save(cfg) != ESP_OK) {
+        ESP_LOGW(TAG, "Config migration failed, keeping per-key layout");
+        return;
+    }
+    for (int i = 0; i < sizeof(LEGACY_KEYS) / sizeof(LEGACY_KEYS[0]); i++) {
+        nvs_erase_key(h, LEGACY_KEYS[i]);
+    }
+    nvs_commit(h);
+    ESP_LOGI(TAG, "Config migrated to blob v%d", CFG_BLOB_VERSION);
+}
+
+/* ── public API ──────────────────────────────────────────────── */
+
+esp_err_t repeater_config_load(repeater_config_t *cfg)
+{
+    config_defaults(cfg);
+
+    /* Stan runtime — brak = pełny scan przy starcie */
+    rt_upstream_t up;
+    if (repeater_state_load(RT_UPSTREAM_KEY, &up, sizeof(up)) == ESP_OK) {
+        memcpy(cfg->last_bssid, up.bssid, 6);
+        cfg->last_channel = up.channel;
+    }
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &h);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        /* No saved config — use Kconfig defaults */
+        ESP_LOGI(TAG, "No NVS config, using menuconfig defaults");
+        return ESP_OK;
+    }
+    if (err != ESP_OK) return err;
+
+    cfg_blob_t b;
+    uint8_t version = 0;
+    int len = blob_read(h, CFG_BLOB_KEY, (uint8_t *)&b, sizeof(b), &version);
+    if (len >= 0) {
+        cfg_from_blob(cfg, (const uint8_t *)&b, len);
+        nvs_close(h);
+        return ESP_OK;
+    }
+
+    bool legacy = legacy_load(h, cfg);
     nvs_close(h);
+    if (!legacy) {
+        ESP_LOGW(TAG, "No valid config blob, using menuconfig defaults");
+        return ESP_OK;
+    }
+    ESP_LOGI(TAG, "Loaded per-key config, migrating");
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h) == ESP_OK) {
+        legacy_migrate(h, cfg);
+        nvs_close(h);
+    }
     return ESP_OK;
 }
 
@@ -102,32 +360,71 @@ esp_err_t repeater_config_save(const repeater_config_t *cfg)
     esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h);
     if (err != ESP_OK) return err;
 
-    nvs_set_str(h, "sta_ssid", cfg->sta_ssid);
-    nvs_set_str(h, "sta_pass", cfg->sta_pass);
-    nvs_set_str(h, "ap_ssid",  cfg->ap_ssid);
-    nvs_set_str(h, "ap_pass",  cfg->ap_pass);
-    nvs_set_u8(h,  "tx_power", cfg->tx_power_dbm);
-    nvs_set_u8(h,  "max_cli",  cfg->max_clients);
-    nvs_set_u8(h,  "authmode", cfg->ap_authmode);
-    nvs_set_u8(h,  "clone_ssid", cfg->ap_clone_ssid);
-    nvs_set_u8(h,  "pmesh",    cfg->pseudo_mesh);
-    nvs_set_u8(h,  "roam_rssi", (uint8_t)cfg->roam_rssi_threshold);
-    nvs_set_u8(h,  "roam_hyst", cfg->roam_hysteresis);
-
-    err = nvs_commit(h);
+    cfg_blob_t b;
+    cfg_to_blob(cfg, &b);
+    bool written;
+    err = blob_write(h, CFG_BLOB_KEY, &b, sizeof(b), CFG_BLOB_VERSION, &written);
     nvs_close(h);
-    ESP_LOGI(TAG, "Config saved to NVS");
-    return err;
+    if (err != ESP_OK) return err;
+    ESP_LOGI(TAG, "Config %s", written ? "saved to NVS" : "unchanged, NVS not written");
+
+    /* GUI zeruje last_channel przy zmianie SSID — ten sam zapis co w locie */
+    return repeater_config_save_upstream(cfg->last_bssid, cfg->last_channel);
 }
 
-esp_err_t repeater_config_reset(void)
+esp_err_t repeater_config_save_upstream(const uint8_t bssid[6], uint8_t channel)
+{
+    rt_upstream_t up = { .channel = channel };
+    memcpy(up.bssid, bssid, 6);
+    return repeater_state_save(RT_UPSTREAM_KEY, &up, sizeof(up));
+}
+
+esp_err_t repeater_state_load(const char *key, void *data, size_t len)
 {
     nvs_handle_t h;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h);
+    esp_err_t err = nvs_open(NVS_NAMESPACE_RT, NVS_READONLY, &h);
     if (err != ESP_OK) return err;
-    nvs_erase_all(h);
-    nvs_commit(h);
+    uint8_t version;
+    int n = blob_read(h, key, data, len, &version);
+    nvs_close(h);
+    return n == (int)len && version == CFG_BLOB_VERSION ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t repeater_state_save(const char *key, const void *data, size_t len)
+{
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(NVS_NAMESPACE_RT, NVS_READWRITE, &h);
+    if (err != ESP_OK) return err;
+    bool written;
+    err = blob_write(h, key, data, len, CFG_BLOB_VERSION, &written);
     nvs_close(h);
+    return err;
+}
+
+bool repeater_mac_parse(const char *str, uint8_t *mac)
+{
+    unsigned m[6];
+    char end;
+    if (sscanf(str, "%2x:%2x:%2x:%2x:%2x:%2x%c",
+               &m[0], &m[1], &m[2], &m[3], &m[4], &m[5], &end) != 6) {
+        return false;
+    }
+    for (int i = 0; i < 6; i++) mac[i] = (uint8_t)m[i];
+    /* Multicast nie może być adresem STA */
+    return !(mac[0] & 0x01);
+}
+
+esp_err_t repeater_config_reset(void)
+{
+    static const char *const NS[] = { NVS_NAMESPACE, NVS_NAMESPACE_RT };
+    for (int i = 0; i < 2; i++) {
+        nvs_handle_t h;
+        esp_err_t err = nvs_open(NS[i], NVS_READWRITE, &h);
+        if (err != ESP_OK) return err;
+        nvs_erase_all(h);
+        nvs_commit(h);
+        nvs_close(h);
+    }
     ESP_LOGI(TAG, "Config reset to defaults");
     return ESP_OK;
 }
@@ -3,10 +3,14 @@
  *
  * Ładuje ustawienia z NVS; jeśli brak → bierze domyślne z menuconfig.
  * Web GUI zapisuje do NVS, po reboot nowe wartości się wczytują.
+ * Układ w NVS (blob z wersją i CRC, osobny namespace na stan runtime)
+ * opisany w repeater_config.c.
  */
 #pragma once
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include "esp_err.h"
 
 #ifdef __cplusplus
@@ -16,6 +20,10 @@ extern "C" {
 #define REPEATER_SSID_MAX   33   /* 32 chars + NUL */
 #define REPEATER_PASS_MAX   65   /* 64 chars + NUL */
 
+/* repeater_config_t.bridge_mode */
+#define REPEATER_BRIDGE_CLONE   0    /* STA klonuje MAC pierwszego klienta, reszta przez MAC-NAT */
+#define REPEATER_BRIDGE_MACNAT  1    /* stały MAC upstream, wszyscy klienci przez MAC-NAT */
+
 typedef struct {
     /* Upstream (STA) */
     char     sta_ssid[REPEATER_SSID_MAX];
@@ -26,6 +34,10 @@ typedef struct {
     /* Radio */
     uint8_t  tx_power_dbm;        /* 2–20 */
     uint8_t  max_clients;         /* 1–10 */
+    uint8_t  radio_profile;       /* radio_profile_t (repeater_radio.h) */
+    /* Bridge */
+    uint8_t  bridge_mode;         /* REPEATER_BRIDGE_* */
+    uint8_t  upstream_mac[6];     /* MAC STA w trybie MAC-NAT, zera = fabryczny */
     /* Security */
     uint8_t  ap_authmode;         /* wifi_auth_mode_t: 2=WPA,3=WPA2,4=WPA/WPA2,7=WPA2/WPA3,6=WPA3 */
     /* AP cloning */
@@ -34,6 +46,11 @@ typedef struct {
     uint8_t  pseudo_mesh;         /* 0=off, 1=roam to better AP with same SSID */
     int8_t   roam_rssi_threshold; /* dBm, scan when RSSI drops below this */
     uint8_t  roam_hysteresis;     /* dB, new AP must be this much better */
+    /* Multi-client */
+    uint32_t client_cap_kbps;     /* limit per klient i kierunek, 0 = bez limitu */
+    /* Last known good upstream (fast boot) — stan runtime (rep_rt) */
+    uint8_t  last_bssid[6];
+    uint8_t  last_channel;        /* 0 = unknown → full scan at boot */
 } repeater_config_t;
 
 /**
@@ -43,12 +60,32 @@ typedef struct {
 esp_err_t repeater_config_load(repeater_config_t *cfg);
 
 /**
- * Save config to NVS. Returns ESP_OK on success.
+ * Save config to NVS as one blob (skipped when nothing changed), plus
+ * last_bssid / last_channel to the runtime namespace. Returns ESP_OK on
+ * success.
  */
 esp_err_t repeater_config_save(const repeater_config_t *cfg);
 
+/* Save only the last known good upstream (runtime namespace, no-op if unchanged). */
+esp_err_t repeater_config_save_upstream(const uint8_t bssid[6], uint8_t channel);
+
+/**
+ * Runtime state that changes while running (learned tables, last
+ * upstream) — own NVS namespace, same CRC-checked blob format, write
+ * skipped when the stored value is identical. load returns
+ * ESP_ERR_NOT_FOUND for a missing, corrupt or differently sized blob.
+ */
+esp_err_t repeater_state_load(const char *key, void *data, size_t len);
+esp_err_t repeater_state_save(const char *key, const void *data, size_t len);
+
+/**
+ * Parse "aa:bb:cc:dd:ee:ff" (unicast only). mac is left undefined
+ * on failure.
+ */
+bool repeater_mac_parse(const char *str, uint8_t *mac);
+
 /**
- * Reset NVS config back to Kconfig defaults.
+ * Reset NVS config (and runtime state) back to Kconfig defaults.
  */
 esp_err_t repeater_config_reset(void);
 
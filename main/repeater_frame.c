@@ -0,0 +1,368 @@
+/*
+ * repeater_frame.c — Frame rewriting for the bridge fast path (MAC-NAT, DHCP)
+ */
+#include <string.h>
+#include "repeater_frame.h"
+
+/* Zamiana bajtów bez <arpa/inet.h> / lwIP — moduł buduje się też na hoście */
+static inline uint32_t be32(uint32_t v)
+{
+    const uint8_t *b = (const uint8_t *)&v;
+    return ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) |
+           ((uint32_t)b[2] << 8)  | b[3];
+}
+
+static inline uint32_t to_be32(uint32_t h)
+{
+    uint32_t v;
+    uint8_t *b = (uint8_t *)&v;
+    b[0] = h >> 24; b[1] = h >> 16; b[2] = h >> 8; b[3] = h;
+    return v;
+}
+
+void frame_macnat_learn(const frame_ctx_t *ctx, uint32_t ip_n, const uint8_t *mac)
+{
+    /* Ignoruj broadcast/multicast MAC i zerowy IP */
+    if ((mac[0] & 0x01) || ip_n == 0) return;
+
+    /* Hot path: ta sama para IP+MAC (reverse index) — bez timestampu */
+    if (macnat_table_known(ctx->macnat, ip_n, mac)) return;
+
+    int64_t now = ctx->now_us();
+    if (ctx->write_lock) ctx->write_lock();
+    macnat_update_t r = macnat_table_update(ctx->macnat, ip_n, mac, now);
+    if (ctx->write_unlock) ctx->write_unlock();
+    if (r == MACNAT_ADDED && ctx->learned) ctx->learned(ip_n, mac);
+}
+
+/* ── IPv6 / NDP ──────────────────────────────────────────────── */
+
+#define ND_ROUTER_SOL     133
+#define ND_ROUTER_ADV     134
+#define ND_NEIGHBOR_SOL   135
+#define ND_NEIGHBOR_ADV   136
+#define ND_REDIRECT       137
+#define ND_OPT_SLLA       1     /* Source Link-Layer Address */
+#define ND_OPT_TLLA       2     /* Target Link-Layer Address */
+
+/* Ani multicast (ff00::/8), ani nieokreślony (::, DAD) */
+static inline bool ip6_unicast(const uint8_t *ip)
+{
+    static const uint8_t unspecified[16];
+    return ip[0] != 0xff && memcmp(ip, unspecified, 16) != 0;
+}
+
+/* Początek opcji w wiadomości NDP (od nagłówka ICMPv6), 0 = nie NDP */
+static inline uint16_t ndp_opt_offset(uint8_t type)
+{
+    switch (type) {
+    case ND_ROUTER_SOL:   return 8;
+    case ND_ROUTER_ADV:   return 16;
+    case ND_NEIGHBOR_SOL:
+    case ND_NEIGHBOR_ADV: return 24;
+    case ND_REDIRECT:     return 40;
+    default:              return 0;
+    }
+}
+
+/* Długość wiadomości NDP w ramce IPv6, 0 = nie NDP. NDP nie używa
+ * nagłówków rozszerzeń, a hop limit musi być 255 (RFC 4861). */
+static uint16_t ndp_len(const uint8_t *frame, uint16_t len)
+{
+    const uint8_t *ip6 = frame + PKT_ETH_HDR_LEN;
+    if (ip6[6] != PKT_IPPROTO_ICMPV6 || ip6[7] != 255) return 0;
+    uint16_t plen = (uint16_t)(ip6[4] << 8 | ip6[5]);
+    if (plen < 8 || PKT_IPV6_MIN_LEN + plen > len) return 0;
+    uint16_t off = ndp_opt_offset(frame[PKT_IPV6_MIN_LEN]);
+    return off && off <= plen ? plen : 0;
+}
+
+/* Opcje SLLA/TLLA z prawdziwym MAC klienta (eth src, jeszcze przed
+ * przepisaniem) → client_mac, suma ICMPv6 poprawiana przyrostowo */
+static void ndp_rewrite_lla(const frame_ctx_t *ctx, uint8_t *frame, uint16_t len)
+{
+    uint16_t plen = ndp_len(frame, len);
+    if (!plen) return;
+    uint8_t *icmp = frame + PKT_IPV6_MIN_LEN;
+    const uint8_t *real = frame + 6;
+    const uint8_t *nat  = ctx->client_mac;
+
+    for (uint16_t i = ndp_opt_offset(icmp[0]); i + 8 <= plen; ) {
+        uint16_t olen = icmp[i + 1] * 8;
+        if (olen == 0 || i + olen > plen) break;   /* uszkodzona opcja */
+        uint8_t *lla = icmp + i + 2;
+        if ((icmp[i] == ND_OPT_SLLA || icmp[i] == ND_OPT_TLLA) && olen == 8 &&
+            memcmp(lla, real, 6) == 0) {
+            /* Opcje są wyrównane do 8 B — MAC to 3 pełne słowa sumy */
+            for (int w = 0; w < 6; w += 2) {
+                pkt_csum_update16(icmp + 2, (uint16_t)(lla[w] << 8 | lla[w + 1]),
+                                  (uint16_t)(nat[w] << 8 | nat[w + 1]));
+            }
+            memcpy(lla, nat, 6);
+        }
+        i += olen;
+    }
+}
+
+static void macnat6_learn(const frame_ctx_t *ctx, const uint8_t *ip, const uint8_t *mac)
+{
+    if ((mac[0] & 0x01) || !ip6_unicast(ip)) return;
+    if (macnat6_table_known(ctx->macnat6, ip, mac)) return;
+
+    int64_t now = ctx->now_us();
+    if (ctx->write_lock) ctx->write_lock();
+    macnat6_table_update(ctx->macnat6, ip, mac, now);
+    if (ctx->write_unlock) ctx->write_unlock();
+}
+
+/* Upstream IPv6: ucz src (i target NA — adres bronionego przez klienta),
+ * potem przepisz opcje NDP */
+static void macnat6_upstream(const frame_ctx_t *ctx, uint8_t *frame, uint16_t len,
+                             bool learn)
+{
+    const uint8_t *eth_src = frame + 6;
+    if (learn) {
+        macnat6_learn(ctx, frame + 22, eth_src);
+        if (ndp_len(frame, len) && frame[PKT_IPV6_MIN_LEN] == ND_NEIGHBOR_ADV) {
+            macnat6_learn(ctx, frame + PKT_IPV6_MIN_LEN + 8, eth_src);
+        }
+    }
+    ndp_rewrite_lla(ctx, frame, len);
+}
+
+static inline bool macnat6_lookup(const frame_ctx_t *ctx, const uint8_t *ip, uint8_t *mac_out)
+{
+    bool found = macnat6_table_lookup_ip_copy(ctx->macnat6, ip, mac_out);
+    while (!found && ctx->lookup_spin && macnat6_table_busy(ctx->macnat6)) {
+        found = macnat6_table_lookup_ip_copy(ctx->macnat6, ip, mac_out);
+    }
+    return found;
+}
+
+/* IPv4 → real MAC (kopia). Z lookup_spin czekamy na koniec zapisu
+ * drugiego rdzenia zamiast traktować "busy" jak miss. */
+static inline bool macnat_lookup(const frame_ctx_t *ctx, uint32_t ip_n, uint8_t *mac_out)
+{
+    bool found = macnat_table_lookup_ip_copy(ctx->macnat, ip_n, mac_out);
+    while (!found && ctx->lookup_spin && macnat_table_busy(ctx->macnat)) {
+        found = macnat_table_lookup_ip_copy(ctx->macnat, ip_n, mac_out);
+    }
+    return found;
+}
+
+void frame_macnat_upstream(const frame_ctx_t *ctx, uint8_t *frame, uint16_t len,
+                           bool learn)
+{
+    uint8_t *eth_src = frame + 6;
+    uint16_t ethertype = pkt_ethertype(frame);
+
+    if (ethertype == PKT_ETHERTYPE_IPV4 && len >= PKT_IPV4_MIN_LEN) {
+        /* IPv4: src IP at offset 26 */
+        uint32_t src_ip;
+        memcpy(&src_ip, frame + 26, 4);
+        if (learn) frame_macnat_learn(ctx, src_ip, eth_src);
+
+        /* DHCP fix: klient wysyła Discover/Request z chaddr = swój MAC.
+         * Router odpowiada unicast do chaddr → WiFi HW na STA odrzuca
+         * (STA MAC = sklonowany ≠ chaddr). Fix: ustaw BROADCAST flag
+         * w DHCP, żeby router odpowiedział broadcastem. */
+        const uint8_t *ip_hdr = frame + PKT_ETH_HDR_LEN;
+        if (ip_hdr[9] == PKT_IPPROTO_UDP) {
+            uint8_t ihl = pkt_ipv4_ihl(frame);
+            const uint8_t *udp = ip_hdr + ihl;
+            if (PKT_ETH_HDR_LEN + ihl + 8 <= len &&
+                udp[0] == 0 && udp[1] == 68 &&   /* src port 68 (DHCP client) */
+                udp[2] == 0 && udp[3] == 67) {    /* dst port 67 (DHCP server) */
+                uint8_t *dhcp = (uint8_t *)(udp + 8);
+                int dhcp_off = PKT_ETH_HDR_LEN + ihl + 8;
+                if (dhcp_off + 44 <= len) {
+                    /* Set BROADCAST flag (bit 15 of flags field at DHCP offset 10)
+                     * Forces server to respond via broadcast instead of unicast to chaddr */
+                    uint16_t old_flags = (uint16_t)(dhcp[10] << 8 | dhcp[11]);
+                    dhcp[10] |= 0x80;
+                    /* Suma UDP poprawiana przyrostowo (RFC 1624) — część routerów
+                     * i relayów DHCP odrzuca checksum=0 */
+                    pkt_udp_csum_update16((uint8_t *)(udp + 6), old_flags,
+                                          (uint16_t)(dhcp[10] << 8 | dhcp[11]));
+                }
+            }
+        }
+    } else if (ethertype == PKT_ETHERTYPE_ARP && len >= PKT_ARP_LEN) {
+        /* ARP: sender IP at 28, sender MAC at 22 */
+        uint32_t sender_ip;
+        memcpy(&sender_ip, frame + 28, 4);
+        if (learn) frame_macnat_learn(ctx, sender_ip, eth_src);
+        /* Przepisz ARP sender hardware address */
+        memcpy(frame + 22, ctx->client_mac, 6);
+    } else if (ethertype == PKT_ETHERTYPE_IPV6 && ctx->macnat6 && len >= PKT_IPV6_MIN_LEN) {
+        macnat6_upstream(ctx, frame, len, learn);
+    }
+
+    /* Przepisz Ethernet source MAC */
+    memcpy(eth_src, ctx->client_mac, 6);
+}
+
+bool frame_macnat_downstream(const frame_ctx_t *ctx, uint8_t *frame, uint16_t len)
+{
+    uint16_t ethertype = pkt_ethertype(frame);
+    uint8_t real_mac[6];
+    bool found = false;
+
+    /* Lookup przez seqlock — fast path czyta równolegle z bridge taskiem */
+    if (ethertype == PKT_ETHERTYPE_IPV4 && len >= PKT_IPV4_MIN_LEN) {
+        /* IPv4: dst IP at offset 30 */
+        uint32_t dst_ip;
+        memcpy(&dst_ip, frame + 30, 4);
+        found = macnat_lookup(ctx, dst_ip, real_mac);
+    } else if (ethertype == PKT_ETHERTYPE_ARP && len >= PKT_ARP_LEN) {
+        /* ARP: target IP at 38, target MAC at 32 */
+        uint32_t target_ip;
+        memcpy(&target_ip, frame + 38, 4);
+        found = macnat_lookup(ctx, target_ip, real_mac);
+        if (found && memcmp(real_mac, ctx->client_mac, 6) != 0) {
+            /* Przepisz ARP target hardware address */
+            memcpy(frame + 32, real_mac, 6);
+        }
+    } else if (ethertype == PKT_ETHERTYPE_IPV6 && ctx->macnat6 && len >= PKT_IPV6_MIN_LEN) {
+        /* IPv6: dst at offset 38 */
+        found = macnat6_lookup(ctx, frame + 38, real_mac);
+    }
+
+    /* Przepisz Ethernet dst MAC tylko dla dodatkowych klientów */
+    if (found && memcmp(real_mac, ctx->client_mac, 6) != 0) {
+        memcpy(frame, real_mac, 6);
+        return true;
+    }
+    return false;
+}
+
+bool frame_dhcp_ack_parse(const uint8_t *frame, uint16_t len, frame_dhcp_ack_t *out)
+{
+    /* IP header */
+    const uint8_t *ip_hdr = frame + PKT_ETH_HDR_LEN;
+    uint8_t ip_ihl = pkt_ipv4_ihl(frame);
+    const uint8_t *udp_hdr = ip_hdr + ip_ihl;
+
+    /* DHCP message */
+    const uint8_t *dhcp = udp_hdr + 8;
+    int dhcp_len = len - PKT_ETH_HDR_LEN - ip_ihl - 8;
+    if (dhcp_len < 240) return false;
+    if (dhcp[0] != 2) return false;  /* not BOOTREPLY */
+
+    /* Magic cookie 0x63825363 at offset 236 */
+    if (dhcp[236] != 0x63 || dhcp[237] != 0x82 ||
+        dhcp[238] != 0x53 || dhcp[239] != 0x63) return false;
+
+    /* Parse DHCP options — szukamy: type=53 ACK, subnet=1, router=3 */
+    const uint8_t *opt = dhcp + 240;
+    int opt_max = dhcp_len - 240;
+    bool is_ack = false;
+    uint32_t subnet_mask = 0;
+    uint32_t gateway = 0;
+
+    for (int i = 0; i < opt_max; ) {
+        uint8_t type = opt[i];
+        if (type == 255) break;           /* End */
+        if (type == 0) { i++; continue; } /* Pad */
+        if (i + 1 >= opt_max) break;
+        uint8_t olen = opt[i + 1];
+        if (i + 2 + olen > opt_max) break;
+
+        switch (type) {
+        case 53: /* DHCP Message Type */
+            if (olen == 1 && opt[i + 2] == 5) is_ack = true;
+            break;
+        case 1:  /* Subnet Mask */
+            if (olen == 4) memcpy(&subnet_mask, &opt[i + 2], 4);
+            break;
+        case 3:  /* Router */
+            if (olen >= 4) memcpy(&gateway, &opt[i + 2], 4);
+            break;
+        }
+        i += 2 + olen;
+    }
+
+    if (!is_ack) return false;
+
+    /* yiaddr (assigned client IP) at DHCP offset 16 */
+    memcpy(&out->yiaddr, &dhcp[16], 4);
+    if (out->yiaddr == 0 || subnet_mask == 0) return false;
+    out->netmask = subnet_mask;
+    out->gateway = gateway;
+    /* chaddr at DHCP offset 28 */
+    out->chaddr  = dhcp_len >= 34 ? &dhcp[28] : NULL;
+    return true;
+}
+
+uint32_t frame_pick_ap_ip(uint32_t client_ip, uint32_t netmask, uint32_t gateway)
+{
+    /* Najwyższy użyteczny adres w podsieci (broadcast - 1),
+     * omijając IP klienta i gateway */
+    uint32_t h_client = be32(client_ip);
+    uint32_t h_mask   = be32(netmask);
+    uint32_t h_gw     = be32(gateway);
+    uint32_t network  = h_client & h_mask;
+    uint32_t bcast    = network | ~h_mask;
+
+    uint32_t candidate = bcast - 1; /* np. x.x.x.254 dla /24 */
+    for (int tries = 0; tries < 10; tries++) {
+        if (candidate > network && candidate < bcast &&
+            candidate != h_client && candidate != h_gw) {
+            break;
+        }
+        candidate--;
+    }
+    /* Safety: jeśli nie znaleziono, użyj client - 1 */
+    if (candidate <= network || candidate >= bcast) {
+        candidate = h_client - 1;
+        if (candidate <= network) candidate = h_client + 1;
+    }
+    return to_be32(candidate);
+}
+
+bool frame_mss_clamp(uint8_t *frame, uint16_t len, uint16_t mss)
+{
+    uint16_t ethertype = pkt_ethertype(frame);
+    uint16_t l4_off;
+
+    if (ethertype == PKT_ETHERTYPE_IPV4 && len >= PKT_IPV4_MIN_LEN) {
+        const uint8_t *ip_hdr = frame + PKT_ETH_HDR_LEN;
+        /* Fragment o niezerowym offsecie nie ma nagłówka TCP */
+        if (ip_hdr[9] != PKT_IPPROTO_TCP || (ip_hdr[6] & 0x1F) || ip_hdr[7]) return false;
+        l4_off = PKT_ETH_HDR_LEN + pkt_ipv4_ihl(frame);
+    } else if (ethertype == PKT_ETHERTYPE_IPV6 && len >= PKT_IPV6_MIN_LEN) {
+        if (frame[PKT_ETH_HDR_LEN + 6] != PKT_IPPROTO_TCP) return false;
+        l4_off = PKT_IPV6_MIN_LEN;
+        mss -= 20;                            /* nagłówek IPv6 dłuższy o 20 B */
+    } else {
+        return false;
+    }
+    if (l4_off + 20 > len) return false;
+    uint8_t *tcp = frame + l4_off;
+    if (!(tcp[13] & PKT_TCP_SYN)) return false;
+    uint8_t doff = (tcp[12] >> 4) * 4;
+    if (doff < 20 || l4_off + doff > len) return false;
+
+    for (uint8_t i = 20; i < doff; ) {
+        uint8_t kind = tcp[i];
+        if (kind == 0) break;                    /* EOL */
+        if (kind == 1) { i++; continue; }        /* NOP */
+        if (i + 1 >= doff || tcp[i + 1] < 2 || i + tcp[i + 1] > doff) break;
+        if (kind == 2 && tcp[i + 1] == 4) {      /* MSS */
+            uint16_t old_mss = (uint16_t)(tcp[i + 2] << 8 | tcp[i + 3]);
+            if (old_mss <= mss) return false;
+            tcp[i + 2] = mss >> 8;
+            tcp[i + 3] = mss & 0xFF;
+            /* Wartość na nieparzystym offsecie (po NOP) wchodzi do sumy
+             * z zamienionymi bajtami */
+            if (i & 1) {
+                old_mss = (uint16_t)(old_mss << 8 | old_mss >> 8);
+                mss     = (uint16_t)(mss << 8 | mss >> 8);
+            }
+            pkt_csum_update16(tcp + 16, old_mss, mss);
+            return true;
+        }
+        i += tcp[i + 1];
+    }
+    return false;
+}
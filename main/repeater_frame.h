@@ -0,0 +1,105 @@
+/*
+ * repeater_frame.h — Frame rewriting for the bridge fast path (MAC-NAT, DHCP)
+ *
+ * Logika przepisywania ramek wydzielona z wifi_repeater_main.c: filtr
+ * broadcastów dla lwIP, uczenie i przepisywanie MAC-NAT w obu kierunkach,
+ * parsowanie DHCP ACK. Czyste C (bez ESP-IDF) — stan, który w firmware
+ * jest globalny (tablica MAC-NAT, sklonowany MAC, zegar, spinlock),
+ * dostaje się przez frame_ctx_t. Dzięki temu te same pliki buduje
+ * host_bench/ (replay pcap, ns/ramkę na funkcję).
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "repeater_pkt.h"
+#include "repeater_macnat.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    macnat_table_t  *macnat;
+    macnat6_table_t *macnat6;           /* NULL = IPv6 bez MAC-NAT */
+    const uint8_t   *client_mac;         /* sklonowany MAC — jedyny widziany przez router */
+    int64_t (*now_us)(void);            /* znacznik czasu nowych wpisów MAC-NAT */
+    /* Serializacja writerów MAC-NAT; NULL = jeden writer */
+    void    (*write_lock)(void);
+    void    (*write_unlock)(void);
+    /* Nowy wpis MAC-NAT (log); NULL = bez powiadomienia */
+    void    (*learned)(uint32_t ip, const uint8_t *mac);
+    /* Lookup czeka na koniec zapisu zamiast traktować "busy" jak miss —
+     * writer na drugim rdzeniu trzyma spinlock tylko przez chwilę */
+    bool     lookup_spin;
+} frame_ctx_t;
+
+/* Wynik frame_dhcp_ack_parse() — adresy w network byte order */
+typedef struct {
+    uint32_t yiaddr;                    /* IP przydzielony klientowi */
+    uint32_t netmask;
+    uint32_t gateway;                   /* 0 = brak opcji Router */
+    const uint8_t *chaddr;              /* MAC klienta w ramce, NULL = ucięty */
+} frame_dhcp_ack_t;
+
+/**
+ * Broadcast/multicast frame that lwIP must see: an ARP request for one
+ * of our IPs (network order, 0 = unset). Everything else (mDNS, SSDP,
+ * NetBIOS, DHCP for other hosts) is only forwarded at L2.
+ */
+static inline bool frame_bcast_for_us(const uint8_t *frame, uint16_t len,
+                                      uint32_t our_ip1, uint32_t our_ip2)
+{
+    if (len < PKT_ARP_LEN || pkt_ethertype(frame) != PKT_ETHERTYPE_ARP) return false;
+    /* ARP opcode 1 = REQUEST */
+    if (frame[20] != 0 || frame[21] != 1) return false;
+    uint32_t target_ip;
+    memcpy(&target_ip, frame + 38, 4);   /* ARP target protocol address */
+    return target_ip != 0 && (target_ip == our_ip1 || target_ip == our_ip2);
+}
+
+/* Remember ip_n → mac unless it is zero/multicast or already known. */
+void frame_macnat_learn(const frame_ctx_t *ctx, uint32_t ip_n, const uint8_t *mac);
+
+/**
+ * Upstream (AP → STA): replace the source MAC of an additional client
+ * with ctx->client_mac (Ethernet header, ARP sender, NDP link-layer
+ * address options), learning the IP→MAC pair first when learn is set.
+ * DHCP client messages get the BROADCAST flag so the router does not
+ * unicast to a chaddr the STA will never receive.
+ */
+void frame_macnat_upstream(const frame_ctx_t *ctx, uint8_t *frame, uint16_t len,
+                           bool learn);
+
+/**
+ * Downstream (STA → AP): point the destination MAC (and ARP target) of
+ * an IPv4/ARP/IPv6 frame for an additional client back at its real MAC. Returns true
+ * when the frame was rewritten.
+ */
+bool frame_macnat_downstream(const frame_ctx_t *ctx, uint8_t *frame, uint16_t len);
+
+/**
+ * Parse a DHCP ACK (IPv4/UDP 67→68 already checked by the caller).
+ * False for other message types, truncated options, or a zero yiaddr
+ * or netmask.
+ */
+bool frame_dhcp_ack_parse(const uint8_t *frame, uint16_t len, frame_dhcp_ack_t *out);
+
+/**
+ * Management IP for the AP on the client's subnet: the highest usable
+ * address that is neither the client nor the gateway (network order).
+ */
+uint32_t frame_pick_ap_ip(uint32_t client_ip, uint32_t netmask, uint32_t gateway);
+
+/**
+ * TCP MSS clamp: a SYN / SYN-ACK (IPv4, or IPv6 without extension
+ * headers) announcing an MSS above mss gets mss — IPv6 mss - 20, the
+ * same packet size — with the TCP checksum patched incrementally.
+ * Returns true when the frame was changed.
+ */
+bool frame_mss_clamp(uint8_t *frame, uint16_t len, uint16_t mss);
+
+#ifdef __cplusplus
+}
+#endif
@@ -2,10 +2,19 @@
  * repeater_httpd.c — HTTP configuration server
  *
  * Minimalist web GUI for the WiFi 6 repeater.
- * GET  /        → config page (HTML form)
+ * GET  /        → config page (gzipped static HTML, ETag / 304)
+ * GET  /config  → current config as JSON (fills the form)
  * POST /save    → save config to NVS + reboot
  * POST /reset   → reset config to Kconfig defaults + reboot
  * GET  /status  → JSON status (AJAX-friendly)
+ * GET  /metrics → forwarding counters (Prometheus text, ?format=json → JSON)
+ * GET  /radio   → radio profile + current STA link (JSON)
+ * POST /radio   → apply profile=N now without saving (A/B), returns link JSON
+ * POST /bench   → start on-device benchmark (mode, seconds, len)
+ * GET  /bench   → benchmark progress / result (JSON)
+ * GET  /mem     → heap, task stacks, bridge buffers + calibration
+ *                 (?format=sdkconfig → suggested settings as sdkconfig lines)
+ * POST /mem     → start buffer/stack calibration (seconds=N)
  */
 
 #include "sdkconfig.h"
@@ -14,8 +23,20 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include "repeater_httpd.h"
 #include "repeater_config.h"
+#include "repeater_metrics.h"
+#include "repeater_rxbuf.h"
+#include "repeater_mcast.h"
+#include "repeater_arp.h"
+#include "repeater_clients.h"
+#include "repeater_ps.h"
+#include "repeater_roam.h"
+#include "repeater_trace.h"
+#include "repeater_radio.h"
+#include "repeater_bench.h"
+#include "repeater_mem.h"
 #include "esp_http_server.h"
 #include "esp_wifi.h"
 #include "esp_mac.h"
@@ -23,133 +44,19 @@
 #include "esp_system.h"
 #include "esp_netif.h"
 #include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_app_desc.h"
 
 static const char *TAG = "rep_httpd";
+#define HTTPD_STACK_SIZE (4096 + 1024)
 static httpd_handle_t s_server = NULL;
 
 /* ── HTML ────────────────────────────────────────────────────── */
 
-static const char HTML_PAGE[] =
-"<!DOCTYPE html>"
-"<html><head>"
-"<meta charset='utf-8'>"
-"<meta name='viewport' content='width=device-width,initial-scale=1'>"
-"<title>WiFi6 Repeater</title>"
-"<style>"
-"*{box-sizing:border-box;margin:0;padding:0}"
-"body{font-family:system-ui,-apple-system,sans-serif;background:#0f172a;color:#e2e8f0;min-height:100vh;padding:1rem}"
-".c{max-width:480px;margin:0 auto}"
-"h1{text-align:center;font-size:1.4rem;margin-bottom:.5rem;color:#38bdf8}"
-".sub{text-align:center;color:#64748b;font-size:.85rem;margin-bottom:1.5rem}"
-".card{background:#1e293b;border-radius:12px;padding:1.2rem;margin-bottom:1rem;border:1px solid #334155}"
-".card h2{font-size:1rem;color:#38bdf8;margin-bottom:.8rem;padding-bottom:.5rem;border-bottom:1px solid #334155}"
-"label{display:block;font-size:.85rem;color:#94a3b8;margin-bottom:.25rem;margin-top:.6rem}"
-"label:first-child{margin-top:0}"
-"input[type=text],input[type=password],input[type=number]{"
-"width:100%%;padding:.55rem .7rem;border:1px solid #475569;border-radius:8px;"
-"background:#0f172a;color:#e2e8f0;font-size:.95rem;outline:none;transition:border .2s}"
-"input:focus{border-color:#38bdf8}"
-".row{display:flex;gap:.6rem}"
-".row>div{flex:1}"
-".btn{display:block;width:100%%;padding:.7rem;border:none;border-radius:8px;"
-"font-size:1rem;font-weight:600;cursor:pointer;transition:background .2s;margin-top:.5rem}"
-".btn-save{background:#2563eb;color:#fff}.btn-save:hover{background:#1d4ed8}"
-".btn-rst{background:#334155;color:#94a3b8;font-size:.85rem;margin-top:.4rem}"
-".btn-rst:hover{background:#475569;color:#e2e8f0}"
-".st{font-size:.82rem;color:#94a3b8;line-height:1.6}"
-".st b{color:#e2e8f0;font-weight:500}"
-".g{color:#4ade80}.r{color:#f87171}"
-"#msg{text-align:center;padding:.6rem;border-radius:8px;margin-bottom:.8rem;display:none;"
-"background:#164e63;color:#22d3ee;font-size:.9rem}"
-"</style></head><body>"
-"<div class='c'>"
-"<h1>&#128225; WiFi6 Repeater</h1>"
-"<p class='sub'>ESP32-C6 &middot; L2 Bridge &middot; No NAT</p>"
-"<div id='msg'></div>"
-/* Status card (filled by JS) */
-"<div class='card' id='scard'>"
-"<h2>&#128504; Status</h2>"
-"<div class='st' id='status'>Loading...</div>"
-"</div>"
-/* Config form */
-"<form method='POST' action='/save'>"
-"<div class='card'>"
-"<h2>&#128225; Upstream AP (STA)</h2>"
-"<label>SSID</label>"
-"<input name='sta_ssid' type='text' maxlength='32' value='%s' required>"
-"<label>Password</label>"
-"<input name='sta_pass' type='password' maxlength='64' value='%s'>"
-"</div>"
-"<div class='card'>"
-"<h2>&#128246; Repeater AP</h2>"
-"<label>SSID</label>"
-"<input name='ap_ssid' type='text' maxlength='32' value='%s' required>"
-"<label>Password</label>"
-"<input name='ap_pass' type='password' maxlength='64' value='%s'>"
-"<div class='row'><div>"
-"<label>Max clients</label>"
-"<input name='max_cli' type='number' min='1' max='10' value='%d'>"
-"</div><div>"
-"<label>TX Power (dBm)</label>"
-"<input name='tx_pwr' type='number' min='2' max='20' value='%d'>"
-"</div></div>"
-"<label>Security</label>"
-"<select name='authmode' style='width:100%%;padding:.55rem .7rem;border:1px solid #475569;"
-"border-radius:8px;background:#0f172a;color:#e2e8f0;font-size:.95rem'>"
-"<option value='2'%s>WPA-PSK</option>"
-"<option value='3'%s>WPA2-PSK</option>"
-"<option value='4'%s>WPA/WPA2-PSK</option>"
-"<option value='7'%s>WPA2/WPA3-PSK</option>"
-"<option value='6'%s>WPA3-PSK</option>"
-"</select>"
-"</div>"
-/* AP Clone + Roaming card */
-"<div class='card'>"
-"<h2>&#128257; AP Clone &amp; Roaming</h2>"
-"<label style='display:flex;align-items:center;gap:.5rem;margin-top:0;cursor:pointer'>"
-"<input type='checkbox' name='clone_ssid' value='1'%s style='width:1.1rem;height:1.1rem'>"
-"<span>Clone upstream SSID (AP uses same name as router)</span></label>"
-"<label style='display:flex;align-items:center;gap:.5rem;cursor:pointer'>"
-"<input type='checkbox' name='pmesh' value='1'%s id='pm' style='width:1.1rem;height:1.1rem' onchange='toggleMesh()'>"
-"<span>Pseudo-mesh roaming (switch to better AP)</span></label>"
-"<div id='meshcfg' style='display:%s'>"
-"<div class='row'><div>"
-"<label>RSSI threshold (dBm)</label>"
-"<input name='roam_rssi' type='number' min='-90' max='-30' value='%d'>"
-"</div><div>"
-"<label>Hysteresis (dB)</label>"
-"<input name='roam_hyst' type='number' min='3' max='20' value='%d'>"
-"</div></div>"
-"</div>"
-"</div>"
-"<button class='btn btn-save' type='submit'>&#128190; Save &amp; Reboot</button>"
-"</form>"
-"<form method='POST' action='/reset'>"
-"<button class='btn btn-rst' type='submit'>&#8635; Reset to defaults</button>"
-"</form>"
-"</div>"
-/* JS: fetch status */
-"<script>"
-"function toggleMesh(){"
-"document.getElementById('meshcfg').style.display=document.getElementById('pm').checked?'block':'none'}"
-"function fs(){"
-"fetch('/status').then(r=>r.json()).then(d=>{"
-"let h='';"
-"h+='State: <b>'+d.state+'</b><br>';"
-"if(d.upstream)h+='Upstream: <b>'+d.upstream+'</b> RSSI:<b>'+d.rssi+'</b> Ch:<b>'+d.channel+'</b><br>';"
-"else h+='Upstream: <span class=\"r\">not connected</span><br>';"
-"h+='STA MAC: <b>'+d.sta_mac+'</b> '+(d.cloned?'<span class=\"r\">(CLONED)</span>':'')+'<br>';"
-"h+='Clients: <b>'+d.clients+'</b><br>';"
-"h+='Forwarding: '+(d.forwarding?'<span class=\"g\">ON</span>':'OFF')+'<br>';"
-"h+='IP: <b>'+d.ip+'</b><br>';"
-"h+='Uptime: <b>'+d.uptime+'</b>s';"
-"document.getElementById('status').innerHTML=h;"
-"}).catch(()=>{document.getElementById('status').innerHTML='<span class=\"r\">Error</span>'})}"
-"fs();setInterval(fs,5000);"
-"if(location.search.includes('saved')){"
-"let m=document.getElementById('msg');m.textContent='Config saved! Rebooting...';m.style.display='block'}"
-"</script>"
-"</body></html>";
+/* main/www/index.html, skompresowany gzipem przy buildzie (main/CMakeLists.txt)
+ * i wbudowany w obraz — serwowany z flasha bez kopii i bez printf */
+extern const uint8_t INDEX_HTML_GZ_START[] asm("_binary_index_html_gz_start");
+extern const uint8_t INDEX_HTML_GZ_END[]   asm("_binary_index_html_gz_end");
 
 /* ── URL-decode ──────────────────────────────────────────────── */
 
@@ -208,79 +115,164 @@ static bool get_field(const char *body, const char *name,
     return false;
 }
 
-/* ── HTML entity-encode (for safe embedding in value="") ─────── */
+/* ── JSON string escape ──────────────────────────────────────── */
 
-static void html_escape(char *dst, const char *src, size_t dst_sz)
+static void json_escape(char *dst, const char *src, size_t dst_sz)
 {
     size_t di = 0;
-    while (*src && di < dst_sz - 6) {
-        switch (*src) {
-        case '&':  memcpy(dst+di, "&amp;", 5);  di += 5; break;
-        case '<':  memcpy(dst+di, "&lt;", 4);   di += 4; break;
-        case '>':  memcpy(dst+di, "&gt;", 4);   di += 4; break;
-        case '"':  memcpy(dst+di, "&quot;", 6);  di += 6; break;
-        case '\'': memcpy(dst+di, "&#39;", 5);   di += 5; break;
-        default:   dst[di++] = *src; break;
+    while (*src && di < dst_sz - 7) {
+        unsigned char c = (unsigned char)*src++;
+        if (c == '"' || c == '\\') {
+            dst[di++] = '\\';
+            dst[di++] = (char)c;
+        } else if (c < 0x20) {
+            di += snprintf(dst + di, dst_sz - di, "\\u%04x", c);
+        } else {
+            dst[di++] = (char)c;
         }
-        src++;
     }
     dst[di] = '\0';
 }
 
+/* ── Chunked response through a stack buffer ─────────────────── */
+
+/* Drobne kawałki sklejane w jeden chunk; flush, gdy następny się nie
+ * mieści. Bez malloc — koszt odpowiedzi nie zależy od jej długości. */
+typedef struct {
+    httpd_req_t *req;
+    int          n;
+    char         buf[512];
+} resp_stream_t;
+
+static void rs_flush(resp_stream_t *rs)
+{
+    if (rs->n) httpd_resp_send_chunk(rs->req, rs->buf, rs->n);
+    rs->n = 0;
+}
+
+static void rs_printf(resp_stream_t *rs, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static void rs_printf(resp_stream_t *rs, const char *fmt, ...)
+{
+    for (int retry = 0; retry < 2; retry++) {
+        va_list ap;
+        va_start(ap, fmt);
+        int len = vsnprintf(rs->buf + rs->n, sizeof(rs->buf) - rs->n, fmt, ap);
+        va_end(ap);
+        if (len < 0) return;
+        if (rs->n + len < (int)sizeof(rs->buf)) {
+            rs->n += len;
+            return;
+        }
+        if (rs->n == 0) {
+            rs->n = sizeof(rs->buf) - 1;   /* kawałek większy niż bufor — obcięty */
+            return;
+        }
+        rs_flush(rs);   /* częściowy zapis za rs->n nie jest wysyłany */
+    }
+}
+
+static esp_err_t rs_end(resp_stream_t *rs)
+{
+    rs_flush(rs);
+    return httpd_resp_send_chunk(rs->req, NULL, 0);
+}
+
+/* ── Radio profiles (GUI labels) ─────────────────────────────── */
+
+static const char *const RADIO_LABEL[RADIO_PROFILE_MAX] = {
+    [RADIO_PROFILE_AUTO]       = "Auto (SoC default)",
+    [RADIO_PROFILE_THROUGHPUT] = "Max throughput (HT40)",
+    [RADIO_PROFILE_HE20]       = "WiFi 6 HE20 (MCS 0-9)",
+    [RADIO_PROFILE_CONGESTED]  = "Congested 2.4 GHz (HT20)",
+    [RADIO_PROFILE_LONG_RANGE] = "Long range (20 dBm, DCM)",
+};
+
 /* ── GET / ───────────────────────────────────────────────────── */
 
+/* Strona jest częścią obrazu firmware — ETag = SHA-256 ELF-a, więc
+ * przeglądarka po 304 pobiera ją ponownie dopiero po OTA */
+static const char *page_etag(void)
+{
+    static char etag[20];
+    if (!etag[0]) {
+        char sha[17];
+        esp_app_get_elf_sha256(sha, sizeof(sha));
+        snprintf(etag, sizeof(etag), "\"%s\"", sha);
+    }
+    return etag;
+}
+
 static esp_err_t root_get_handler(httpd_req_t *req)
+{
+    const char *etag = page_etag();
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    char inm[24];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", inm, sizeof(inm)) == ESP_OK &&
+        strcmp(inm, etag) == 0) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    httpd_resp_set_type(req, "text/html");
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    return httpd_resp_send(req, (const char *)INDEX_HTML_GZ_START,
+                           INDEX_HTML_GZ_END - INDEX_HTML_GZ_START);
+}
+
+/* ── GET /config ─────────────────────────────────────────────── */
+
+/* Wartości formularza — klucze = nazwy pól formularza (POST /save) */
+static esp_err_t config_get_handler(httpd_req_t *req)
 {
     repeater_config_t cfg;
     repeater_config_load(&cfg);
 
-    /* Escape values for HTML */
-    char e_sta_ssid[128], e_sta_pass[256], e_ap_ssid[128], e_ap_pass[256];
-    html_escape(e_sta_ssid, cfg.sta_ssid, sizeof(e_sta_ssid));
-    html_escape(e_sta_pass, cfg.sta_pass, sizeof(e_sta_pass));
-    html_escape(e_ap_ssid,  cfg.ap_ssid,  sizeof(e_ap_ssid));
-    html_escape(e_ap_pass,  cfg.ap_pass,  sizeof(e_ap_pass));
-
-    /* Build "selected" attributes for authmode dropdown */
-    const char *sel = " selected";
-    const char *sel_wpa   = (cfg.ap_authmode == 2) ? sel : "";
-    const char *sel_wpa2  = (cfg.ap_authmode == 3) ? sel : "";
-    const char *sel_mixed = (cfg.ap_authmode == 4) ? sel : "";
-    const char *sel_w2w3  = (cfg.ap_authmode == 7) ? sel : "";
-    const char *sel_wpa3  = (cfg.ap_authmode == 6) ? sel : "";
-
-    /* Build "checked" for clone + mesh checkboxes */
-    const char *chk = " checked";
-    const char *chk_clone = cfg.ap_clone_ssid ? chk : "";
-    const char *chk_mesh  = cfg.pseudo_mesh   ? chk : "";
-    const char *mesh_disp = cfg.pseudo_mesh   ? "block" : "none";
-
-    /* Render — HTML_PAGE has 18 format specifiers */
-    size_t buf_len = sizeof(HTML_PAGE) + 1024;
-    char *buf = malloc(buf_len);
-    if (!buf) {
-        httpd_resp_send_500(req);
-        return ESP_FAIL;
+    static const uint8_t zero_mac[6];
+    char up_mac[18] = "";
+    if (memcmp(cfg.upstream_mac, zero_mac, 6) != 0) {
+        snprintf(up_mac, sizeof(up_mac), MACSTR, MAC2STR(cfg.upstream_mac));
     }
-    snprintf(buf, buf_len, HTML_PAGE,
-             e_sta_ssid, e_sta_pass,
-             e_ap_ssid, e_ap_pass,
-             cfg.max_clients, cfg.tx_power_dbm,
-             sel_wpa, sel_wpa2, sel_mixed, sel_w2w3, sel_wpa3,
-             chk_clone, chk_mesh, mesh_disp,
-             (int)cfg.roam_rssi_threshold, (int)cfg.roam_hysteresis);
 
-    httpd_resp_set_type(req, "text/html");
-    httpd_resp_send(req, buf, HTTPD_RESP_USE_STRLEN);
-    free(buf);
-    return ESP_OK;
+    resp_stream_t rs = { .req = req };
+    char esc[sizeof(cfg.sta_pass) * 6];
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");   /* hasła */
+    json_escape(esc, cfg.sta_ssid, sizeof(esc));
+    rs_printf(&rs, "{\"sta_ssid\":\"%s\",", esc);
+    json_escape(esc, cfg.sta_pass, sizeof(esc));
+    rs_printf(&rs, "\"sta_pass\":\"%s\",", esc);
+    json_escape(esc, cfg.ap_ssid, sizeof(esc));
+    rs_printf(&rs, "\"ap_ssid\":\"%s\",", esc);
+    json_escape(esc, cfg.ap_pass, sizeof(esc));
+    rs_printf(&rs, "\"ap_pass\":\"%s\",", esc);
+    rs_printf(&rs,
+        "\"max_cli\":%d,\"tx_pwr\":%d,\"authmode\":%d,\"bridge\":%d,\"up_mac\":\"%s\","
+        "\"clone_ssid\":%s,\"pmesh\":%s,\"roam_rssi\":%d,\"roam_hyst\":%d,"
+        "\"cli_cap\":%lu,\"radio\":%d,\"radios\":[",
+        cfg.max_clients, cfg.tx_power_dbm, cfg.ap_authmode, cfg.bridge_mode, up_mac,
+        cfg.ap_clone_ssid ? "true" : "false", cfg.pseudo_mesh ? "true" : "false",
+        (int)cfg.roam_rssi_threshold, (int)cfg.roam_hysteresis,
+        (unsigned long)cfg.client_cap_kbps, cfg.radio_profile);
+    /* Tylko profile wspierane przez ten SoC */
+    bool first = true;
+    for (int p = 0; p < RADIO_PROFILE_MAX; p++) {
+        if (!radio_profile_supported((radio_profile_t)p)) continue;
+        rs_printf(&rs, "%s{\"id\":%d,\"label\":\"%s\"}", first ? "" : ",", p, RADIO_LABEL[p]);
+        first = false;
+    }
+    rs_printf(&rs, "]}");
+    return rs_end(&rs);
 }
 
 /* ── POST /save ──────────────────────────────────────────────── */
 
 static esp_err_t save_post_handler(httpd_req_t *req)
 {
-    char body[512];
+    char body[640];
     int recv = httpd_req_recv(req, body, sizeof(body) - 1);
     if (recv <= 0) {
         httpd_resp_send_500(req);
@@ -292,8 +284,11 @@ static esp_err_t save_post_handler(httpd_req_t *req)
     repeater_config_load(&cfg);
 
     char tmp[128];
-    if (get_field(body, "sta_ssid", tmp, sizeof(tmp)))
+    if (get_field(body, "sta_ssid", tmp, sizeof(tmp))) {
+        /* Inny upstream — zapamiętany BSSID/kanał już nie pasuje */
+        if (strcmp(cfg.sta_ssid, tmp) != 0) cfg.last_channel = 0;
         strlcpy(cfg.sta_ssid, tmp, sizeof(cfg.sta_ssid));
+    }
     if (get_field(body, "sta_pass", tmp, sizeof(tmp)))
         strlcpy(cfg.sta_pass, tmp, sizeof(cfg.sta_pass));
     if (get_field(body, "ap_ssid", tmp, sizeof(tmp)))
@@ -313,6 +308,23 @@ static esp_err_t save_post_handler(httpd_req_t *req)
         if (v == 2 || v == 3 || v == 4 || v == 6 || v == 7)
             cfg.ap_authmode = v;
     }
+    if (get_field(body, "bridge", tmp, sizeof(tmp))) {
+        int v = atoi(tmp);
+        if (v == REPEATER_BRIDGE_CLONE || v == REPEATER_BRIDGE_MACNAT) cfg.bridge_mode = v;
+    }
+    if (get_field(body, "up_mac", tmp, sizeof(tmp))) {
+        /* Pusty = MAC fabryczny; błędny format zostawia poprzedni */
+        if (tmp[0] == '\0') {
+            memset(cfg.upstream_mac, 0, sizeof(cfg.upstream_mac));
+        } else {
+            uint8_t mac[6];
+            if (repeater_mac_parse(tmp, mac)) memcpy(cfg.upstream_mac, mac, 6);
+        }
+    }
+    if (get_field(body, "radio", tmp, sizeof(tmp))) {
+        int v = atoi(tmp);
+        if (radio_profile_supported((radio_profile_t)v)) cfg.radio_profile = (uint8_t)v;
+    }
     /* Checkboxes: present in body only when checked */
     cfg.ap_clone_ssid = get_field(body, "clone_ssid", tmp, sizeof(tmp)) ? 1 : 0;
     cfg.pseudo_mesh   = get_field(body, "pmesh", tmp, sizeof(tmp))      ? 1 : 0;
@@ -324,6 +336,10 @@ static esp_err_t save_post_handler(httpd_req_t *req)
         int v = atoi(tmp);
         if (v >= 3 && v <= 20) cfg.roam_hysteresis = (uint8_t)v;
     }
+    if (get_field(body, "cli_cap", tmp, sizeof(tmp))) {
+        int v = atoi(tmp);
+        if (v >= 0 && v <= 100000) cfg.client_cap_kbps = (uint32_t)v;
+    }
 
     esp_err_t err = repeater_config_save(&cfg);
     if (err != ESP_OK) {
@@ -368,11 +384,24 @@ extern volatile int      s_state;           /* repeater_state_t */
 extern volatile bool     s_sta_connected;
 extern volatile bool     s_forwarding_active;
 extern volatile bool     s_mac_cloned;
-extern esp_netif_t      *s_sta_netif;
+extern uint8_t           s_bridge_mode;     /* REPEATER_BRIDGE_* */
+extern volatile bool     s_clone_grace;
+extern uint32_t          s_clone_grace_saved;
+#if CONFIG_REPEATER_ADAPTIVE_PS
+extern ps_ctrl_t         s_ps;
+#endif
+extern roam_table_t      s_roam;
+extern roam_est_t        s_roam_est;
+extern roam_stats_t      s_roam_stats;
+extern radio_profile_t   s_radio_profile;
+#if CONFIG_REPEATER_WARM_START
+extern volatile uint8_t  s_warm_state;      /* WARM_* (wifi_repeater_main.c) */
+extern uint8_t           s_warm_restored;
+#endif
+esp_err_t radio_ab_apply(radio_profile_t p, radio_link_t *out);
 
 static esp_err_t status_get_handler(httpd_req_t *req)
 {
-    char json[512];
     const char *state_str;
     switch (s_state) {
         case 0:  state_str = "IDLE"; break;
@@ -382,51 +411,703 @@ static esp_err_t status_get_handler(httpd_req_t *req)
         default: state_str = "UNKNOWN"; break;
     }
 
-    /* Upstream info */
-    char upstream[34] = "";
-    int rssi = 0, channel = 0;
-    wifi_ap_record_t ap;
-    if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
-        strlcpy(upstream, (char *)ap.ssid, sizeof(upstream));
-        rssi = ap.rssi;
-        channel = ap.primary;
+    /* Pola drivera ze snapshotu (bez esp_wifi_* per request) */
+    repeater_status_t st;
+    repeater_status_get(&st);
+    char upstream[sizeof(st.upstream) * 6];
+    json_escape(upstream, st.upstream, sizeof(upstream));
+    char ip_str[16] = "none";
+    if (st.ip) {
+        esp_ip4_addr_t ip = { .addr = st.ip };
+        snprintf(ip_str, sizeof(ip_str), IPSTR, IP2STR(&ip));
     }
 
-    /* STA MAC */
-    uint8_t mac[6];
-    esp_wifi_get_mac(WIFI_IF_STA, mac);
-    char mac_str[18];
-    snprintf(mac_str, sizeof(mac_str), "%02X:%02X:%02X:%02X:%02X:%02X",
-             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    resp_stream_t rs = { .req = req };
+    httpd_resp_set_type(req, "application/json");
+    rs_printf(&rs, "{\"state\":\"%s\",\"upstream\":\"%s\",\"rssi\":%d,\"channel\":%d,",
+              state_str, upstream, st.rssi, st.channel);
+    rs_printf(&rs,
+        "\"sta_mac\":\"%02X:%02X:%02X:%02X:%02X:%02X\",\"cloned\":%s,\"bridge\":\"%s\","
+        "\"clients\":%d,\"forwarding\":%s,\"ip\":\"%s\",\"uptime\":%lld,",
+        st.sta_mac[0], st.sta_mac[1], st.sta_mac[2], st.sta_mac[3], st.sta_mac[4], st.sta_mac[5],
+        s_mac_cloned ? "true" : "false",
+        s_bridge_mode == REPEATER_BRIDGE_MACNAT ? "macnat" : "clone", st.clients,
+        s_forwarding_active ? "true" : "false", ip_str,
+        (long long)(esp_timer_get_time() / 1000000));
+    rs_printf(&rs,
+        "\"handover\":{\"count\":%lu,\"fast\":%lu,\"last_ms\":%lu,"
+        "\"disconnect_ms\":%lu,\"set_mac_ms\":%lu,\"connect_ms\":%lu,"
+        "\"grace\":%s,\"grace_saved\":%lu},\"radio\":\"%s\",",
+        (unsigned long)s_handover.count, (unsigned long)s_handover.fast_count,
+        (unsigned long)s_handover.total_ms, (unsigned long)s_handover.disconnect_ms,
+        (unsigned long)s_handover.set_mac_ms, (unsigned long)s_handover.connect_ms,
+        s_clone_grace ? "true" : "false", (unsigned long)s_clone_grace_saved,
+        RADIO_PROFILE[s_radio_profile].name);
 
-    /* Client count */
-    int clients = 0;
-    wifi_sta_list_t sta_list;
-    if (esp_wifi_ap_get_sta_list(&sta_list) == ESP_OK) {
-        clients = sta_list.num;
+    /* Multicast: odrzucone przez limiter per klasa, duplikaty, unicast */
+    mcast_stats_t mc;
+    mcast_get_stats(&mc);
+    uint32_t passed = 0, dup = 0;
+    rs_printf(&rs, "\"mcast\":{\"rate_dropped\":{");
+    for (int c = 0; c < MCAST_CLASS_MAX; c++) {
+        passed += mc.passed[c];
+        dup    += mc.dup_dropped[c];
+        rs_printf(&rs, "%s\"%s\":%lu", c ? "," : "",
+                  MCAST_CLASS_NAME[c], (unsigned long)mc.rate_dropped[c]);
     }
+    rs_printf(&rs, "},\"dup_dropped\":%lu,\"passed\":%lu,\"to_unicast\":%lu},",
+              (unsigned long)dup, (unsigned long)passed, (unsigned long)mc.to_unicast);
 
-    /* IP */
-    char ip_str[16] = "none";
-    esp_netif_ip_info_t ip_info;
-    if (s_sta_netif && esp_netif_get_ip_info(s_sta_netif, &ip_info) == ESP_OK
-        && ip_info.ip.addr != 0) {
-        snprintf(ip_str, sizeof(ip_str), IPSTR, IP2STR(&ip_info.ip));
+    /* Roaming: liczniki, estymator łącza + tabela kandydatów
+     * (seen 0 = tylko podpowiedź z neighbor reportu) */
+    rs_printf(&rs,
+        "\"roam\":{\"roams\":%lu,\"fail\":%lu,\"last_roam_ms\":%lu,\"btm_roams\":%lu,"
+        "\"neighbor_reports\":%lu,\"rrm\":%s,\"btm\":%s,",
+        (unsigned long)s_roam_stats.roams, (unsigned long)s_roam_stats.roam_fail,
+        (unsigned long)s_roam_stats.last_roam_ms, (unsigned long)s_roam_stats.btm_roams,
+        (unsigned long)s_roam_stats.neighbor_reports,
+        s_roam_stats.rrm ? "true" : "false", s_roam_stats.btm ? "true" : "false");
+    rs_printf(&rs,
+        "\"rssi\":%d,\"trend_x10\":%d,\"predicted\":%d,\"rate_kbps\":%lu,"
+        "\"predicted_rate_kbps\":%lu,\"samples\":%lu,\"candidates\":[",
+        roam_est_rssi(&s_roam_est), roam_est_slope_x10(&s_roam_est),
+        roam_est_predict(&s_roam_est, CONFIG_REPEATER_ROAM_PREDICT_S * 1000),
+        (unsigned long)roam_rate_kbps(roam_est_rssi(&s_roam_est)),
+        (unsigned long)roam_rate_kbps(roam_est_predict(&s_roam_est,
+                                                       CONFIG_REPEATER_ROAM_PREDICT_S * 1000)),
+        (unsigned long)s_roam_est.samples);
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    bool first = true;
+    for (int i = 0; i < ROAM_CANDIDATES; i++) {
+        const roam_cand_t *c = &s_roam.cand[i];
+        if (!c->used) continue;
+        rs_printf(&rs,
+            "%s{\"bssid\":\"" MACSTR "\",\"ch\":%d,\"rssi\":%d,\"age_s\":%lu,\"seen\":%lu}",
+            first ? "" : ",", MAC2STR(c->bssid), c->channel, roam_cand_rssi(c),
+            (unsigned long)((now_ms - c->last_seen_ms) / 1000), (unsigned long)c->seen);
+        first = false;
     }
+    rs_printf(&rs, "]}");
 
-    int64_t uptime = esp_timer_get_time() / 1000000;
+    /* Power save: bieżący tryb + łączny czas w każdym (s) */
+#if CONFIG_REPEATER_ADAPTIVE_PS
+    static const char *const PS_NAME[PS_LEVEL_MAX] = { "none", "min_modem", "max_modem" };
+    rs_printf(&rs,
+             ",\"ps\":{\"mode\":\"%s\",\"avg_pps\":%lu,\"switches\":%lu,"
+             "\"none_s\":%llu,\"min_modem_s\":%llu,\"max_modem_s\":%llu}",
+             PS_NAME[s_ps.level], (unsigned long)ps_ctrl_avg_pps(&s_ps),
+             (unsigned long)s_ps.switches,
+             (unsigned long long)(s_ps.time_ms[PS_LEVEL_NONE] / 1000),
+             (unsigned long long)(s_ps.time_ms[PS_LEVEL_MIN_MODEM] / 1000),
+             (unsigned long long)(s_ps.time_ms[PS_LEVEL_MAX_MODEM] / 1000));
+#endif
 
-    snprintf(json, sizeof(json),
-        "{\"state\":\"%s\",\"upstream\":\"%s\",\"rssi\":%d,\"channel\":%d,"
-        "\"sta_mac\":\"%s\",\"cloned\":%s,\"clients\":%d,"
-        "\"forwarding\":%s,\"ip\":\"%s\",\"uptime\":%lld}",
-        state_str, upstream, rssi, channel,
-        mac_str, s_mac_cloned ? "true" : "false", clients,
-        s_forwarding_active ? "true" : "false", ip_str, (long long)uptime);
+    /* Proxy ARP: requesty obsłużone / przekazane dalej per ścieżka RX */
+#if CONFIG_REPEATER_PROXY_ARP
+    arp_proxy_stats_t arp;
+    arp_proxy_get_stats(&arp);
+    rs_printf(&rs,
+              ",\"arp\":{\"upstream_hit\":%lu,\"upstream_miss\":%lu,"
+              "\"client_hit\":%lu,\"client_miss\":%lu,\"cached\":%lu}",
+              (unsigned long)arp.hit[METRICS_PATH_STA_RX],
+              (unsigned long)arp.miss[METRICS_PATH_STA_RX],
+              (unsigned long)arp.hit[METRICS_PATH_AP_RX],
+              (unsigned long)arp.miss[METRICS_PATH_AP_RX],
+              (unsigned long)arp.cached);
+#endif
+
+    /* Klienci: liczniki per MAC, tempo z ostatniej sekundy, odrzucone przez limit */
+#if CONFIG_REPEATER_CLIENT_STATS
+    static const char *const DIR_NAME[CLIENT_DIR_MAX] = { "up", "down" };
+    client_info_t cl[CLIENTS_MAX];
+    /* Ten sam zegar (ticki) co liczniki w fast path */
+    int ncl = clients_get(cl, CLIENTS_MAX, xTaskGetTickCount() * portTICK_PERIOD_MS);
+    rs_printf(&rs, ",\"client_stats\":[");
+    for (int i = 0; i < ncl; i++) {
+        rs_printf(&rs, "%s{\"mac\":\"" MACSTR "\",\"online_s\":%lu", i ? "," : "",
+                  MAC2STR(cl[i].mac), (unsigned long)cl[i].online_s);
+        for (int d = 0; d < CLIENT_DIR_MAX; d++) {
+            rs_printf(&rs,
+                      ",\"%s\":{\"frames\":%lu,\"bytes\":%llu,\"pps\":%lu,"
+                      "\"bps\":%lu,\"capped\":%lu}",
+                      DIR_NAME[d], (unsigned long)cl[i].frames[d],
+                      (unsigned long long)cl[i].bytes[d], (unsigned long)cl[i].pps[d],
+                      (unsigned long)cl[i].bps[d], (unsigned long)cl[i].capped[d]);
+        }
+        rs_printf(&rs, "}");
+    }
+    rs_printf(&rs, "]");
+#endif
+
+    /* Warm start: stan z NVS i czy pierwszy ruch go potwierdził */
+#if CONFIG_REPEATER_WARM_START
+    static const char *const WARM_NAME[] = { "none", "pending", "confirmed", "dropped" };
+    rs_printf(&rs, ",\"warm\":{\"state\":\"%s\",\"restored\":%u}",
+              WARM_NAME[s_warm_state & 3], s_warm_restored);
+#endif
 
+    /* Pamięć: tylko liczniki O(1) — stosy i największy blok pod GET /mem */
+#if CONFIG_REPEATER_MEM_REPORT
+    rs_printf(&rs, ",\"mem\":{\"heap_free\":%lu,\"heap_min\":%lu}",
+              (unsigned long)heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+              (unsigned long)heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL));
+#endif
+    rs_printf(&rs, "}");
+    return rs_end(&rs);
+}
+
+/* ── GET /metrics ────────────────────────────────────────────── */
+
+static const char *const METRICS_PATH_NAME[METRICS_PATH_MAX] = {
+    [METRICS_PATH_STA_RX] = "sta_rx",
+    [METRICS_PATH_AP_RX]  = "ap_rx",
+};
+
+/* Jeden licznik per ścieżka w formacie Prometheus (1 chunk na metrykę) */
+static void metrics_send_counter(httpd_req_t *req, char *buf, size_t buf_sz,
+                                 const char *name, const char *help,
+                                 const uint32_t *v)
+{
+    int n = snprintf(buf, buf_sz,
+                     "# HELP repeater_%s %s\n# TYPE repeater_%s counter\n",
+                     name, help, name);
+    for (int p = 0; p < METRICS_PATH_MAX && n < (int)buf_sz; p++) {
+        n += snprintf(buf + n, buf_sz - n, "repeater_%s{path=\"%s\"} %lu\n",
+                      name, METRICS_PATH_NAME[p], (unsigned long)v[p]);
+    }
+    httpd_resp_send_chunk(req, buf, HTTPD_RESP_USE_STRLEN);
+}
+
+static esp_err_t metrics_send_json(httpd_req_t *req, const repeater_metrics_t *m)
+{
+    char buf[384];
     httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, json, HTTPD_RESP_USE_STRLEN);
-    return ESP_OK;
+    httpd_resp_sendstr_chunk(req, "{");
+    for (int p = 0; p < METRICS_PATH_MAX; p++) {
+        int n = snprintf(buf, sizeof(buf),
+            "%s\"%s\":{\"frames\":%lu,\"bytes\":%llu,\"bcast_dropped\":%lu,"
+            "\"to_lwip\":%lu,\"macnat_rewrites\":%lu,\"tx_fail\":%lu,"
+            "\"deferred\":%lu,\"defer_full\":%lu,"
+            "\"cycles_sum\":%llu,\"cycles_hist\":[",
+            p ? "," : "", METRICS_PATH_NAME[p],
+            (unsigned long)m->rx_frames[p], (unsigned long long)m->rx_bytes[p],
+            (unsigned long)m->bcast_dropped[p], (unsigned long)m->to_lwip[p],
+            (unsigned long)m->macnat_rewrites[p], (unsigned long)m->tx_fail[p],
+            (unsigned long)m->deferred[p], (unsigned long)m->defer_full[p],
+            (unsigned long long)m->cycles_sum[p]);
+        for (int b = 0; b < METRICS_HIST_BUCKETS && n < (int)sizeof(buf); b++) {
+            n += snprintf(buf + n, sizeof(buf) - n, "%s%lu",
+                          b ? "," : "", (unsigned long)m->cycles_hist[p][b]);
+        }
+        httpd_resp_send_chunk(req, buf, HTTPD_RESP_USE_STRLEN);
+        snprintf(buf, sizeof(buf),
+            "],\"txq_queued\":%lu,\"txq_sent\":%lu,\"txq_rejected\":%lu,"
+            "\"txq_evicted\":%lu,\"txq_stale\":%lu,"
+            "\"ack_bypass\":%lu,\"ack_merged\":%lu,"
+            "\"mss_clamped\":%lu,"
+            "\"qos_remarked\":%lu,\"qos_ahead\":%lu,\"qos\":{",
+            (unsigned long)m->txq_queued[p], (unsigned long)m->txq_sent[p],
+            (unsigned long)m->txq_rejected[p], (unsigned long)m->txq_evicted[p],
+            (unsigned long)m->txq_stale[p],
+            (unsigned long)m->ack_bypass[p], (unsigned long)m->ack_merged[p],
+            (unsigned long)m->mss_clamped[p],
+            (unsigned long)m->qos_remarked[p], (unsigned long)m->qos_ahead[p]);
+        httpd_resp_sendstr_chunk(req, buf);
+        n = 0;
+        for (int a = 0; a < QOS_AC_MAX; a++) {
+            n += snprintf(buf + n, sizeof(buf) - n,
+                          "%s\"%s\":{\"frames\":%lu,\"bytes\":%llu}",
+                          a ? "," : "", QOS_AC_NAME[a],
+                          (unsigned long)m->qos_frames[p][a],
+                          (unsigned long long)m->qos_bytes[p][a]);
+        }
+        snprintf(buf + n, sizeof(buf) - n, "}}");
+        httpd_resp_sendstr_chunk(req, buf);
+    }
+    httpd_resp_sendstr_chunk(req, "}");
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+static esp_err_t metrics_get_handler(httpd_req_t *req)
+{
+    /* Snapshot na heapie — ~250 B, nie obciążaj stosu httpd */
+    repeater_metrics_t *m = malloc(sizeof(*m));
+    if (!m) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    repeater_metrics_snapshot(m);
+
+    char query[32], fmt[8] = "";
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        httpd_query_key_value(query, "format", fmt, sizeof(fmt));
+    }
+    if (strcmp(fmt, "json") == 0) {
+        esp_err_t err = metrics_send_json(req, m);
+        free(m);
+        return err;
+    }
+
+    char buf[384];
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+
+    metrics_send_counter(req, buf, sizeof(buf), "rx_frames_total",
+                         "Frames received by the forwarding callback", m->rx_frames);
+    int n = snprintf(buf, sizeof(buf),
+                     "# HELP repeater_rx_bytes_total Bytes received by the forwarding callback\n"
+                     "# TYPE repeater_rx_bytes_total counter\n");
+    for (int p = 0; p < METRICS_PATH_MAX; p++) {
+        n += snprintf(buf + n, sizeof(buf) - n, "repeater_rx_bytes_total{path=\"%s\"} %llu\n",
+                      METRICS_PATH_NAME[p], (unsigned long long)m->rx_bytes[p]);
+    }
+    httpd_resp_send_chunk(req, buf, HTTPD_RESP_USE_STRLEN);
+    metrics_send_counter(req, buf, sizeof(buf), "bcast_dropped_total",
+                         "Broadcast frames kept away from lwIP", m->bcast_dropped);
+    metrics_send_counter(req, buf, sizeof(buf), "to_lwip_total",
+                         "Frames passed to esp_netif_receive", m->to_lwip);
+    metrics_send_counter(req, buf, sizeof(buf), "macnat_rewrites_total",
+                         "MAC-NAT header rewrites", m->macnat_rewrites);
+    metrics_send_counter(req, buf, sizeof(buf), "tx_fail_total",
+                         "esp_wifi_internal_tx failures", m->tx_fail);
+    metrics_send_counter(req, buf, sizeof(buf), "deferred_total",
+                         "Frames handed to the bridge task (slow path)", m->deferred);
+    metrics_send_counter(req, buf, sizeof(buf), "defer_full_total",
+                         "Slow-path frames forwarded inline because the ring was full",
+                         m->defer_full);
+    metrics_send_counter(req, buf, sizeof(buf), "txq_queued_total",
+                         "Frames queued for retry after esp_wifi_internal_tx failed",
+                         m->txq_queued);
+    metrics_send_counter(req, buf, sizeof(buf), "txq_sent_total",
+                         "Queued frames sent on a later retry", m->txq_sent);
+    metrics_send_counter(req, buf, sizeof(buf), "txq_rejected_total",
+                         "Frames dropped because the retry queue was full",
+                         m->txq_rejected);
+    metrics_send_counter(req, buf, sizeof(buf), "txq_evicted_total",
+                         "Queued frames evicted by the overflow policy", m->txq_evicted);
+    metrics_send_counter(req, buf, sizeof(buf), "txq_stale_total",
+                         "Queued frames dropped after REPEATER_TXQ_MAX_AGE_MS",
+                         m->txq_stale);
+    metrics_send_counter(req, buf, sizeof(buf), "ack_bypass_total",
+                         "Pure TCP ACKs sent ahead of queued bulk frames", m->ack_bypass);
+    metrics_send_counter(req, buf, sizeof(buf), "ack_merged_total",
+                         "Queued TCP ACKs replaced by a newer cumulative ACK",
+                         m->ack_merged);
+#if CONFIG_REPEATER_MSS_CLAMP
+    metrics_send_counter(req, buf, sizeof(buf), "mss_clamped_total",
+                         "TCP SYNs with the MSS lowered to REPEATER_MSS_CLAMP_VALUE",
+                         m->mss_clamped);
+#endif
+#if CONFIG_REPEATER_QOS
+    metrics_send_counter(req, buf, sizeof(buf), "qos_remarked_total",
+                         "Unmarked frames given the DSCP of their class", m->qos_remarked);
+    metrics_send_counter(req, buf, sizeof(buf), "qos_ahead_total",
+                         "Voice/video frames queued ahead of bulk", m->qos_ahead);
+    /* Per klasa: etykiety path + ac, chunk na ścieżkę (bufor 384 B) */
+    httpd_resp_sendstr_chunk(req,
+        "# HELP repeater_qos_frames_total Forwarded frames per WMM access category\n"
+        "# TYPE repeater_qos_frames_total counter\n");
+    for (int p = 0; p < METRICS_PATH_MAX; p++) {
+        n = 0;
+        for (int a = 0; a < QOS_AC_MAX; a++) {
+            n += snprintf(buf + n, sizeof(buf) - n,
+                          "repeater_qos_frames_total{path=\"%s\",ac=\"%s\"} %lu\n",
+                          METRICS_PATH_NAME[p], QOS_AC_NAME[a],
+                          (unsigned long)m->qos_frames[p][a]);
+        }
+        httpd_resp_send_chunk(req, buf, n);
+    }
+    httpd_resp_sendstr_chunk(req,
+        "# HELP repeater_qos_bytes_total Forwarded bytes per WMM access category\n"
+        "# TYPE repeater_qos_bytes_total counter\n");
+    for (int p = 0; p < METRICS_PATH_MAX; p++) {
+        n = 0;
+        for (int a = 0; a < QOS_AC_MAX; a++) {
+            n += snprintf(buf + n, sizeof(buf) - n,
+                          "repeater_qos_bytes_total{path=\"%s\",ac=\"%s\"} %llu\n",
+                          METRICS_PATH_NAME[p], QOS_AC_NAME[a],
+                          (unsigned long long)m->qos_bytes[p][a]);
+        }
+        httpd_resp_send_chunk(req, buf, n);
+    }
+#endif
+
+    rxbuf_stats_t rb;
+    rxbuf_get_stats(&rb);
+    snprintf(buf, sizeof(buf),
+             "# HELP repeater_rxbuf_live RX buffers held by the bridge wrapper\n"
+             "# TYPE repeater_rxbuf_live gauge\n"
+             "repeater_rxbuf_live %lu\n"
+             "# HELP repeater_rxbuf_pool_empty_total Wrap attempts with the pool exhausted\n"
+             "# TYPE repeater_rxbuf_pool_empty_total counter\n"
+             "repeater_rxbuf_pool_empty_total %lu\n",
+             (unsigned long)rb.live, (unsigned long)rb.pool_empty);
+    httpd_resp_sendstr_chunk(req, buf);
+#if CONFIG_REPEATER_RXBUF_DEBUG
+    metrics_send_counter(req, buf, sizeof(buf), "tx_copies_total",
+                         "Frame copies made by esp_wifi_internal_tx", m->tx_copies);
+    n = snprintf(buf, sizeof(buf),
+                 "# HELP repeater_tx_copy_bytes_total Bytes copied by esp_wifi_internal_tx\n"
+                 "# TYPE repeater_tx_copy_bytes_total counter\n");
+    for (int p = 0; p < METRICS_PATH_MAX; p++) {
+        n += snprintf(buf + n, sizeof(buf) - n, "repeater_tx_copy_bytes_total{path=\"%s\"} %llu\n",
+                      METRICS_PATH_NAME[p], (unsigned long long)m->tx_copy_bytes[p]);
+    }
+    httpd_resp_send_chunk(req, buf, HTTPD_RESP_USE_STRLEN);
+#endif
+
+#if CONFIG_REPEATER_METRICS_CYCLE_HIST
+    /* Histogram — kubełki w Prometheusie są kumulatywne (le = górna granica) */
+    httpd_resp_sendstr_chunk(req,
+        "# HELP repeater_rx_cycles CPU cycles spent per frame in the RX callback\n"
+        "# TYPE repeater_rx_cycles histogram\n");
+    for (int p = 0; p < METRICS_PATH_MAX; p++) {
+        uint32_t cum = 0;
+        n = 0;
+        for (int b = 0; b < METRICS_HIST_BUCKETS - 1; b++) {
+            cum += m->cycles_hist[p][b];
+            n += snprintf(buf + n, sizeof(buf) - n,
+                          "repeater_rx_cycles_bucket{path=\"%s\",le=\"%lu\"} %lu\n",
+                          METRICS_PATH_NAME[p],
+                          (unsigned long)(1UL << (b + METRICS_HIST_SHIFT + 1)),
+                          (unsigned long)cum);
+            if (n > (int)sizeof(buf) - 80) {
+                httpd_resp_send_chunk(req, buf, n);
+                n = 0;
+            }
+        }
+        cum += m->cycles_hist[p][METRICS_HIST_BUCKETS - 1];
+        n += snprintf(buf + n, sizeof(buf) - n,
+                      "repeater_rx_cycles_bucket{path=\"%s\",le=\"+Inf\"} %lu\n"
+                      "repeater_rx_cycles_sum{path=\"%s\"} %llu\n"
+                      "repeater_rx_cycles_count{path=\"%s\"} %lu\n",
+                      METRICS_PATH_NAME[p], (unsigned long)cum,
+                      METRICS_PATH_NAME[p], (unsigned long long)m->cycles_sum[p],
+                      METRICS_PATH_NAME[p], (unsigned long)cum);
+        httpd_resp_send_chunk(req, buf, n);
+    }
+#endif
+
+    free(m);
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+/* ── GET /trace ──────────────────────────────────────────────── */
+
+#if CONFIG_REPEATER_TRACE
+static esp_err_t trace_get_handler(httpd_req_t *req)
+{
+    int cap = repeater_trace_capacity();
+    trace_entry_t *ev = malloc(cap * sizeof(*ev));
+    if (!ev) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    uint32_t overwritten;
+    int n = repeater_trace_snapshot(ev, cap, &overwritten);
+
+    char query[32], fmt[8] = "";
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        httpd_query_key_value(query, "format", fmt, sizeof(fmt));
+    }
+    bool chrome = strcmp(fmt, "chrome") == 0;
+
+    /* Wpisy sklejane w bufor i wysyłane chunkami po ~kilkanaście zdarzeń */
+    char buf[512];
+    int  len;
+    httpd_resp_set_type(req, "application/json");
+    if (chrome) {
+        /* chrome://tracing / Perfetto: tor (tid) per task, czasy w µs */
+        len = snprintf(buf, sizeof(buf), "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+        for (int t = 0; t < TRACE_TRACK_MAX; t++) {
+            len += snprintf(buf + len, sizeof(buf) - len,
+                "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                "\"args\":{\"name\":\"%s\"}}", t ? "," : "", t, TRACE_TRACK_NAME[t]);
+        }
+    } else {
+        len = snprintf(buf, sizeof(buf),
+            "{\"now_us\":%lld,\"capacity\":%d,\"overwritten\":%lu,\"events\":[",
+            (long long)esp_timer_get_time(), cap, (unsigned long)overwritten);
+    }
+    for (int i = 0; i < n; i++) {
+        const trace_ev_info_t *info = &TRACE_EV_INFO[ev[i].ev];
+        if (len > (int)sizeof(buf) - 160) {
+            httpd_resp_send_chunk(req, buf, len);
+            len = 0;
+        }
+        if (chrome) {
+            len += snprintf(buf + len, sizeof(buf) - len,
+                ",{\"name\":\"%s\",\"ph\":\"%c\",%s\"ts\":%lld,\"pid\":1,\"tid\":%d,"
+                "\"args\":{\"arg\":%lu,\"core\":%d}}",
+                info->name, info->ph, info->ph == 'i' ? "\"s\":\"t\"," : "",
+                (long long)ev[i].ts_us, info->track,
+                (unsigned long)ev[i].arg, ev[i].core);
+        } else {
+            len += snprintf(buf + len, sizeof(buf) - len,
+                "%s{\"t_us\":%lld,\"ev\":\"%s\",\"ph\":\"%c\",\"arg\":%lu,\"core\":%d}",
+                i ? "," : "", (long long)ev[i].ts_us, info->name, info->ph,
+                (unsigned long)ev[i].arg, ev[i].core);
+        }
+    }
+    len += snprintf(buf + len, sizeof(buf) - len, "]}");
+    httpd_resp_send_chunk(req, buf, len);
+    free(ev);
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+#endif
+
+/* ── GET / POST /radio ───────────────────────────────────────── */
+
+/* Profil + łącze STA; przy błędzie {"ok":false,"error":...} */
+static esp_err_t radio_send_json(httpd_req_t *req, esp_err_t err, const radio_link_t *l)
+{
+    char buf[384];
+    int  n;
+    if (err == ESP_OK) {
+        n = snprintf(buf, sizeof(buf),
+            "{\"ok\":true,\"profile\":\"%s\",\"id\":%d,\"phy\":\"%s\",\"bw\":\"%s\","
+            "\"rssi\":%d,\"channel\":%d,\"rate_kbps\":%lu,\"profiles\":[",
+            RADIO_PROFILE[s_radio_profile].name, (int)s_radio_profile,
+            radio_phymode_name(l->phymode), l->bw == WIFI_BW_HT40 ? "HT40" : "HT20",
+            l->rssi, l->channel, (unsigned long)l->rate_kbps);
+    } else {
+        n = snprintf(buf, sizeof(buf),
+            "{\"ok\":false,\"error\":\"%s\",\"profile\":\"%s\",\"id\":%d,\"profiles\":[",
+            esp_err_to_name(err), RADIO_PROFILE[s_radio_profile].name, (int)s_radio_profile);
+    }
+    bool first = true;
+    for (int p = 0; p < RADIO_PROFILE_MAX; p++) {
+        if (!radio_profile_supported((radio_profile_t)p)) continue;
+        n += snprintf(buf + n, sizeof(buf) - n, "%s\"%s\"", first ? "" : ",",
+                      RADIO_PROFILE[p].name);
+        first = false;
+    }
+    snprintf(buf + n, sizeof(buf) - n, "]}");
+
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_send(req, buf, HTTPD_RESP_USE_STRLEN);
+}
+
+static esp_err_t radio_get_handler(httpd_req_t *req)
+{
+    radio_link_t link;
+    esp_err_t err = radio_link_get(&link, RADIO_PROFILE[s_radio_profile].he_mcs9);
+    return radio_send_json(req, err, &link);
+}
+
+/* A/B: profil stosowany od razu, bez zapisu — zapis przez formularz (/save).
+ * Blokuje handler na czas reconnect STA (do ~17 s). */
+static esp_err_t radio_post_handler(httpd_req_t *req)
+{
+    char body[64];
+    int recv = httpd_req_recv(req, body, sizeof(body) - 1);
+    if (recv <= 0) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    body[recv] = '\0';
+
+    char tmp[8];
+    if (!get_field(body, "profile", tmp, sizeof(tmp))) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "profile required");
+        return ESP_FAIL;
+    }
+    radio_link_t link;
+    esp_err_t err = radio_ab_apply((radio_profile_t)atoi(tmp), &link);
+    return radio_send_json(req, err, &link);
+}
+
+/* ── GET / POST /bench ───────────────────────────────────────── */
+
+static esp_err_t bench_get_handler(httpd_req_t *req)
+{
+    bench_result_t r;
+    repeater_bench_get(&r);
+
+    char load[48];
+    int  n = 0;
+    for (int i = 0; i < SOC_CPU_CORES_NUM; i++) {
+        n += snprintf(load + n, sizeof(load) - n, "%s%d", i ? "," : "", r.cpu_load[i]);
+    }
+
+    /* Chip + wersja firmware — wyniki z różnych płytek / buildów porównywalne */
+    const esp_app_desc_t *app = esp_app_get_description();
+    char buf[512];
+    snprintf(buf, sizeof(buf),
+        "{\"mode\":\"%s\",\"running\":%s,\"error\":\"%s\",\"seconds\":%d,\"len\":%d,"
+        "\"elapsed_ms\":%lu,\"frames\":%lu,\"bytes\":%llu,\"drops\":%lu,"
+        "\"kbps\":%lu,\"pps\":%lu,\"cpu_load\":[%s],\"cycles_per_frame\":%lu,"
+        "\"chip\":\"%s\",\"cpu_mhz\":%d,\"firmware\":\"%s\",\"idf\":\"%s\"}",
+        BENCH_MODE_NAME[r.params.mode < BENCH_MODE_MAX ? r.params.mode : 0],
+        r.running ? "true" : "false", esp_err_to_name(r.err),
+        r.params.seconds, r.params.frame_len,
+        (unsigned long)r.elapsed_ms, (unsigned long)r.frames,
+        (unsigned long long)r.bytes, (unsigned long)r.drops,
+        (unsigned long)r.kbps, (unsigned long)r.pps, load,
+        (unsigned long)r.cycles_per_frame,
+        CONFIG_IDF_TARGET, CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ, app->version, app->idf_ver);
+
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_send(req, buf, HTTPD_RESP_USE_STRLEN);
+}
+
+/* mode=sta_tx|ap_tx|loopback|tcp_sink&seconds=N&len=B — start w tle */
+static esp_err_t bench_post_handler(httpd_req_t *req)
+{
+    char body[96];
+    int recv = httpd_req_recv(req, body, sizeof(body) - 1);
+    if (recv <= 0) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    body[recv] = '\0';
+
+    bench_params_t p = { .mode = BENCH_MODE_MAX, .seconds = 10, .frame_len = 1470 };
+    char tmp[16];
+    if (get_field(body, "mode", tmp, sizeof(tmp))) {
+        for (int m = 0; m < BENCH_MODE_MAX; m++) {
+            if (strcmp(tmp, BENCH_MODE_NAME[m]) == 0) p.mode = (bench_mode_t)m;
+        }
+    }
+    if (get_field(body, "seconds", tmp, sizeof(tmp))) p.seconds   = (uint8_t)atoi(tmp);
+    if (get_field(body, "len", tmp, sizeof(tmp)))     p.frame_len = (uint16_t)atoi(tmp);
+
+    esp_err_t err = repeater_bench_start(&p);
+    char buf[64];
+    snprintf(buf, sizeof(buf), "{\"ok\":%s,\"error\":\"%s\"}",
+             err == ESP_OK ? "true" : "false", esp_err_to_name(err));
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_send(req, buf, HTTPD_RESP_USE_STRLEN);
+}
+
+/* ── GET / POST /mem ─────────────────────────────────────────── */
+
+/* Sugestie kalibracji jako fragment sdkconfig (0 = bez zmiany → pomiń) */
+static void mem_send_sdkconfig(httpd_req_t *req, const mem_calib_t *c)
+{
+    char buf[160];
+    httpd_resp_set_type(req, "text/plain");
+    if (!c->done) {
+        httpd_resp_sendstr_chunk(req, c->running ? "# calibration running\n"
+                                                 : "# no calibration yet (POST /mem)\n");
+        httpd_resp_send_chunk(req, NULL, 0);
+        return;
+    }
+    snprintf(buf, sizeof(buf), "# /mem calibration: %s, %u s, heap min %lu B, spare %ld B\n",
+             CONFIG_IDF_TARGET, c->seconds, (unsigned long)c->heap_min, (long)c->spare);
+    httpd_resp_sendstr_chunk(req, buf);
+
+    const mem_suggest_t *g = &c->suggest;
+    const struct { const char *key; uint32_t v; } KV[] = {
+        { "ESP_WIFI_DYNAMIC_RX_BUFFER_NUM", g->dyn_rx },
+        { "ESP_WIFI_DYNAMIC_TX_BUFFER_NUM", g->dyn_tx },
+        { "LWIP_TCP_WND_DEFAULT",           g->tcp_wnd },
+        { "LWIP_TCP_SND_BUF_DEFAULT",       g->tcp_wnd },
+        { "REPEATER_DEFER_RING_SIZE",       g->ring },
+        { "REPEATER_TXQ_DEPTH",             g->txq_depth },
+        { "REPEATER_STACK_MAC_TASK",        g->stack_mac },
+        { "REPEATER_STACK_STATUS_TASK",     g->stack_status },
+        { "REPEATER_STACK_ROAM_TASK",       g->stack_roam },
+        { "REPEATER_STACK_BRIDGE_TASK",     g->stack_bridge },
+    };
+    for (int i = 0; i < sizeof(KV) / sizeof(KV[0]); i++) {
+        if (!KV[i].v) continue;
+        snprintf(buf, sizeof(buf), "CONFIG_%s=%lu\n", KV[i].key, (unsigned long)KV[i].v);
+        httpd_resp_sendstr_chunk(req, buf);
+    }
+    httpd_resp_send_chunk(req, NULL, 0);
+}
+
+static esp_err_t mem_get_handler(httpd_req_t *req)
+{
+    mem_calib_t c;
+    repeater_mem_calibrate_get(&c);
+
+    char query[32], fmt[12] = "";
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        httpd_query_key_value(query, "format", fmt, sizeof(fmt));
+    }
+    if (strcmp(fmt, "sdkconfig") == 0) {
+        mem_send_sdkconfig(req, &c);
+        return ESP_OK;
+    }
+
+    /* Raport na heapie (~300 B) */
+    mem_report_t *r = malloc(sizeof(*r));
+    if (!r) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    repeater_mem_report(r);
+
+    char buf[384];
+    httpd_resp_set_type(req, "application/json");
+    snprintf(buf, sizeof(buf),
+        "{\"chip\":\"%s\",\"heap\":{\"free\":%lu,\"min\":%lu,\"largest\":%lu,\"total\":%lu},"
+        "\"tasks\":[",
+        CONFIG_IDF_TARGET, (unsigned long)r->heap_free, (unsigned long)r->heap_min,
+        (unsigned long)r->heap_largest, (unsigned long)r->heap_total);
+    httpd_resp_sendstr_chunk(req, buf);
+    for (int i = 0; i < r->tasks; i++) {
+        const mem_task_t *t = &r->task[i];
+        snprintf(buf, sizeof(buf),
+                 "%s{\"name\":\"%s\",\"stack\":%lu,\"min_free\":%lu,\"alive\":%s}",
+                 i ? "," : "", t->name, (unsigned long)t->stack,
+                 (unsigned long)t->min_free, t->alive ? "true" : "false");
+        httpd_resp_sendstr_chunk(req, buf);
+    }
+
+    const mem_bridge_t *b = &r->bridge;
+    snprintf(buf, sizeof(buf),
+        "],\"bridge\":{\"ring_peak\":[%lu,%lu],\"txq_peak\":[%lu,%lu],\"rxbuf_peak\":%lu,"
+        "\"tx_fail\":%lu,\"defer_full\":%lu,\"txq_rejected\":%lu,\"pool_empty\":%lu},",
+        (unsigned long)b->ring_peak[0], (unsigned long)b->ring_peak[1],
+        (unsigned long)b->txq_peak[0], (unsigned long)b->txq_peak[1],
+        (unsigned long)b->rxbuf_peak, (unsigned long)b->tx_fail,
+        (unsigned long)b->defer_full, (unsigned long)b->txq_rejected,
+        (unsigned long)b->pool_empty);
+    httpd_resp_sendstr_chunk(req, buf);
+    free(r);
+
+    const mem_suggest_t *g = &c.suggest;
+    snprintf(buf, sizeof(buf),
+        "\"calibration\":{\"running\":%s,\"done\":%s,\"seconds\":%u,\"elapsed_s\":%lu,"
+        "\"heap_min\":%lu,\"spare\":%ld,\"tx_fail\":%lu,",
+        c.running ? "true" : "false", c.done ? "true" : "false", c.seconds,
+        (unsigned long)c.elapsed_s, (unsigned long)c.heap_min, (long)c.spare,
+        (unsigned long)c.window.tx_fail);
+    httpd_resp_sendstr_chunk(req, buf);
+    snprintf(buf, sizeof(buf),
+        "\"suggest\":{\"dyn_rx\":%u,\"dyn_tx\":%u,\"tcp_wnd\":%lu,\"ring\":%u,"
+        "\"txq_depth\":%u,\"stack_mac\":%lu,\"stack_status\":%lu,\"stack_roam\":%lu,"
+        "\"stack_bridge\":%lu}}}",
+        g->dyn_rx, g->dyn_tx, (unsigned long)g->tcp_wnd, g->ring, g->txq_depth,
+        (unsigned long)g->stack_mac, (unsigned long)g->stack_status,
+        (unsigned long)g->stack_roam, (unsigned long)g->stack_bridge);
+    httpd_resp_sendstr_chunk(req, buf);
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+/* seconds=N — kalibracja w tle; w tym czasie puść referencyjne obciążenie */
+static esp_err_t mem_post_handler(httpd_req_t *req)
+{
+    char body[32];
+    int recv = httpd_req_recv(req, body, sizeof(body) - 1);
+    if (recv <= 0) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    body[recv] = '\0';
+
+    char tmp[8];
+    uint16_t seconds = 60;
+    if (get_field(body, "seconds", tmp, sizeof(tmp))) seconds = (uint16_t)atoi(tmp);
+
+    esp_err_t err = repeater_mem_calibrate_start(seconds);
+    char buf[64];
+    snprintf(buf, sizeof(buf), "{\"ok\":%s,\"error\":\"%s\"}",
+             err == ESP_OK ? "true" : "false", esp_err_to_name(err));
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_send(req, buf, HTTPD_RESP_USE_STRLEN);
 }
 
 /* ── Start / Stop ────────────────────────────────────────────── */
@@ -438,21 +1119,33 @@ esp_err_t repeater_httpd_start(void)
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.server_port = CONFIG_REPEATER_HTTPD_PORT;
     config.lru_purge_enable = true;
-    config.max_uri_handlers = 4;
-    /* Keep stack small — we malloc the HTML buffer */
-    config.stack_size = 4096 + 1024;
+    config.max_uri_handlers = 13;
+    /* Odpowiedzi strumieniowane z małego bufora na stosie */
+    config.stack_size = HTTPD_STACK_SIZE;
 
     esp_err_t err = httpd_start(&s_server, &config);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "httpd_start failed: %s", esp_err_to_name(err));
         return err;
     }
+    repeater_mem_task_track("httpd", HTTPD_STACK_SIZE);   /* task httpd w raporcie /mem */
 
     static const httpd_uri_t uris[] = {
         { .uri = "/",       .method = HTTP_GET,  .handler = root_get_handler },
+        { .uri = "/config", .method = HTTP_GET,  .handler = config_get_handler },
         { .uri = "/save",   .method = HTTP_POST, .handler = save_post_handler },
         { .uri = "/reset",  .method = HTTP_POST, .handler = reset_post_handler },
         { .uri = "/status", .method = HTTP_GET,  .handler = status_get_handler },
+        { .uri = "/metrics", .method = HTTP_GET, .handler = metrics_get_handler },
+        { .uri = "/radio",  .method = HTTP_GET,  .handler = radio_get_handler },
+        { .uri = "/radio",  .method = HTTP_POST, .handler = radio_post_handler },
+        { .uri = "/bench",  .method = HTTP_GET,  .handler = bench_get_handler },
+        { .uri = "/bench",  .method = HTTP_POST, .handler = bench_post_handler },
+        { .uri = "/mem",    .method = HTTP_GET,  .handler = mem_get_handler },
+        { .uri = "/mem",    .method = HTTP_POST, .handler = mem_post_handler },
+#if CONFIG_REPEATER_TRACE
+        { .uri = "/trace",  .method = HTTP_GET,  .handler = trace_get_handler },
+#endif
     };
     for (int i = 0; i < sizeof(uris)/sizeof(uris[0]); i++) {
         httpd_register_uri_handler(s_server, &uris[i]);
@@ -3,12 +3,30 @@
  */
 #pragma once
 
+#include <stdint.h>
 #include "esp_err.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/*
+ * Snapshot of the driver-side status fields for GET /status. Event
+ * handlers and the tasks that poll the driver anyway keep it current,
+ * so a /status request never calls into the WiFi driver.
+ */
+typedef struct {
+    char     upstream[33];    /* SSID upstream AP, "" = nie podłączony */
+    int8_t   rssi;            /* ostatni odczyt (status/roaming task) */
+    uint8_t  channel;
+    uint8_t  sta_mac[6];      /* MAC STA przy ostatnim connect */
+    uint8_t  clients;
+    uint32_t ip;              /* STA IPv4 (network order), 0 = brak */
+} repeater_status_t;
+
+/* Copy the status snapshot (implemented in wifi_repeater_main.c). */
+void repeater_status_get(repeater_status_t *out);
+
 /**
  * Start the HTTP config server.
  * Call AFTER WiFi is started and STA has (or can get) an IP.
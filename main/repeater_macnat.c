@@ -0,0 +1,324 @@
+/*
+ * repeater_macnat.c — Hash-indexed IP→MAC table for MAC-NAT
+ */
+#include "repeater_macnat.h"
+
+#define SLOT_MASK (MACNAT_SLOTS - 1)
+
+/* ── index helpers ───────────────────────────────────────────── */
+
+static inline uint32_t home_slot(const macnat_table_t *t, bool by_mac, uint8_t e)
+{
+    return by_mac ? macnat_hash_mac(t->entries[e].real_mac)
+                  : macnat_hash_ip(t->entries[e].ip);
+}
+
+static void index_insert(macnat_table_t *t, bool by_mac, uint8_t e)
+{
+    uint8_t *index = by_mac ? t->mac_index : t->ip_index;
+    uint32_t s = home_slot(t, by_mac, e);
+    while (index[s] != MACNAT_NONE) {
+        s = (s + 1) & SLOT_MASK;
+    }
+    index[s] = e;
+}
+
+/* Slot indeksu wskazujący na wpis e (wpis musi być zaindeksowany) */
+static uint32_t index_slot_of(const macnat_table_t *t, bool by_mac, uint8_t e)
+{
+    const uint8_t *index = by_mac ? t->mac_index : t->ip_index;
+    uint32_t s = home_slot(t, by_mac, e);
+    while (index[s] != e) {
+        s = (s + 1) & SLOT_MASK;
+    }
+    return s;
+}
+
+/* Backward-shift deletion — bez tombstone'ów, więc lookup kończy się
+ * na pierwszym pustym slocie także po wielu usunięciach. */
+static void index_remove(macnat_table_t *t, bool by_mac, uint8_t e)
+{
+    uint8_t *index = by_mac ? t->mac_index : t->ip_index;
+    uint32_t hole = index_slot_of(t, by_mac, e);
+    index[hole] = MACNAT_NONE;
+
+    for (uint32_t j = (hole + 1) & SLOT_MASK; index[j] != MACNAT_NONE;
+         j = (j + 1) & SLOT_MASK) {
+        uint32_t home = home_slot(t, by_mac, index[j]);
+        /* Przesuń, jeśli home NIE leży cyklicznie w (hole, j] */
+        bool stays = (hole <= j) ? (home > hole && home <= j)
+                                 : (home > hole || home <= j);
+        if (!stays) {
+            index[hole] = index[j];
+            index[j] = MACNAT_NONE;
+            hole = j;
+        }
+    }
+}
+
+static void entry_remove(macnat_table_t *t, uint8_t e)
+{
+    uint8_t last = t->count - 1;
+
+    index_remove(t, false, e);
+    index_remove(t, true, e);
+
+    /* Zachowaj gęstość entries[] — ostatni wpis wskakuje na miejsce e */
+    if (e != last) {
+        t->ip_index[index_slot_of(t, false, last)]  = e;
+        t->mac_index[index_slot_of(t, true, last)] = e;
+        t->entries[e] = t->entries[last];
+    }
+    t->count--;
+    memset(&t->entries[last], 0, sizeof(t->entries[last]));
+
+    if (t->last_hit == e) {
+        t->last_hit = MACNAT_NONE;
+    } else if (t->last_hit == last) {
+        t->last_hit = e;
+    }
+}
+
+static uint8_t find_ip(const macnat_table_t *t, uint32_t ip)
+{
+    for (uint32_t s = macnat_hash_ip(ip), n = 0; n < MACNAT_SLOTS;
+         s = (s + 1) & SLOT_MASK, n++) {
+        uint8_t e = t->ip_index[s];
+        if (e == MACNAT_NONE || t->entries[e].ip == ip) return e;
+    }
+    return MACNAT_NONE;
+}
+
+static uint8_t find_mac(const macnat_table_t *t, const uint8_t *mac)
+{
+    const macnat_entry_t *ent = macnat_table_lookup_mac(t, mac);
+    return ent ? (uint8_t)(ent - t->entries) : MACNAT_NONE;
+}
+
+static inline void write_begin(uint32_t *seq)
+{
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void write_end(uint32_t *seq)
+{
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELEASE);
+}
+
+/* ── public API ──────────────────────────────────────────────── */
+
+void macnat_table_clear(macnat_table_t *t)
+{
+    write_begin(&t->seq);
+    memset(t->entries, 0, sizeof(t->entries));
+    memset(t->ip_index, MACNAT_NONE, sizeof(t->ip_index));
+    memset(t->mac_index, MACNAT_NONE, sizeof(t->mac_index));
+    t->count = 0;
+    t->last_hit = MACNAT_NONE;
+    write_end(&t->seq);
+}
+
+static macnat_update_t update_entries(macnat_table_t *t, uint32_t ip,
+                                      const uint8_t *mac, int64_t now)
+{
+    uint8_t by_ip  = find_ip(t, ip);
+    uint8_t by_mac = find_mac(t, mac);
+
+    if (by_ip != MACNAT_NONE && by_ip == by_mac) {
+        return MACNAT_UNCHANGED;
+    }
+
+    if (by_ip != MACNAT_NONE) {
+        /* IP istnieje ale MAC się zmienił. Jeśli nowy MAC miał inny
+         * wpis (stare IP) — usuń go, MAC w tablicy musi być unikalny. */
+        if (by_mac != MACNAT_NONE) {
+            entry_remove(t, by_mac);
+            by_ip = find_ip(t, ip);   /* indeks mógł się przesunąć */
+        }
+        index_remove(t, true, by_ip);
+        memcpy(t->entries[by_ip].real_mac, mac, 6);
+        t->entries[by_ip].last_seen = now;
+        index_insert(t, true, by_ip);
+        return MACNAT_UPDATED;
+    }
+
+    if (by_mac != MACNAT_NONE) {
+        /* Ten sam MAC, nowe IP (DHCP renewal) */
+        index_remove(t, false, by_mac);
+        t->entries[by_mac].ip = ip;
+        t->entries[by_mac].last_seen = now;
+        index_insert(t, false, by_mac);
+        return MACNAT_UPDATED;
+    }
+
+    /* Nowy wpis — przy pełnej tablicy eksmituj najstarszy */
+    if (t->count >= MACNAT_CAPACITY) {
+        uint8_t oldest = 0;
+        for (uint8_t i = 1; i < t->count; i++) {
+            if (t->entries[i].last_seen < t->entries[oldest].last_seen) {
+                oldest = i;
+            }
+        }
+        entry_remove(t, oldest);
+    }
+
+    uint8_t e = t->count++;
+    t->entries[e].ip = ip;
+    memcpy(t->entries[e].real_mac, mac, 6);
+    t->entries[e].last_seen = now;
+    index_insert(t, false, e);
+    index_insert(t, true, e);
+    return MACNAT_ADDED;
+}
+
+macnat_update_t macnat_table_update(macnat_table_t *t, uint32_t ip,
+                                    const uint8_t *mac, int64_t now)
+{
+    /* No-op (najczęstszy przypadek) nie otwiera seqlocka */
+    if (macnat_table_known(t, ip, mac)) return MACNAT_UNCHANGED;
+
+    write_begin(&t->seq);
+    macnat_update_t r = update_entries(t, ip, mac, now);
+    write_end(&t->seq);
+    return r;
+}
+
+int macnat_table_copy(const macnat_table_t *t, macnat_entry_t *out)
+{
+    for (int tries = 0; tries < 4; tries++) {
+        uint32_t s1 = __atomic_load_n(&t->seq, __ATOMIC_ACQUIRE);
+        if (s1 & 1) continue;
+        uint8_t n = t->count;
+        if (n > MACNAT_CAPACITY) continue;   /* rozdarty odczyt */
+        memcpy(out, t->entries, n * sizeof(t->entries[0]));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&t->seq, __ATOMIC_RELAXED) == s1) return n;
+    }
+    return -1;
+}
+
+/* ── IPv6 ────────────────────────────────────────────────────── */
+
+#define SLOT6_MASK (MACNAT6_SLOTS - 1)
+
+static void index6_insert(macnat6_table_t *t, uint8_t e)
+{
+    uint32_t s = macnat_hash_ip6(t->entries[e].ip);
+    while (t->ip_index[s] != MACNAT_NONE) {
+        s = (s + 1) & SLOT6_MASK;
+    }
+    t->ip_index[s] = e;
+}
+
+static uint32_t index6_slot_of(const macnat6_table_t *t, uint8_t e)
+{
+    uint32_t s = macnat_hash_ip6(t->entries[e].ip);
+    while (t->ip_index[s] != e) {
+        s = (s + 1) & SLOT6_MASK;
+    }
+    return s;
+}
+
+/* Backward-shift deletion, jak index_remove() */
+static void index6_remove(macnat6_table_t *t, uint8_t e)
+{
+    uint8_t *index = t->ip_index;
+    uint32_t hole = index6_slot_of(t, e);
+    index[hole] = MACNAT_NONE;
+
+    for (uint32_t j = (hole + 1) & SLOT6_MASK; index[j] != MACNAT_NONE;
+         j = (j + 1) & SLOT6_MASK) {
+        uint32_t home = macnat_hash_ip6(t->entries[index[j]].ip);
+        bool stays = (hole <= j) ? (home > hole && home <= j)
+                                 : (home > hole || home <= j);
+        if (!stays) {
+            index[hole] = index[j];
+            index[j] = MACNAT_NONE;
+            hole = j;
+        }
+    }
+}
+
+static void entry6_remove(macnat6_table_t *t, uint8_t e)
+{
+    uint8_t last = t->count - 1;
+
+    index6_remove(t, e);
+    if (e != last) {
+        t->ip_index[index6_slot_of(t, last)] = e;
+        t->entries[e] = t->entries[last];
+    }
+    t->count--;
+    memset(&t->entries[last], 0, sizeof(t->entries[last]));
+
+    if (t->last_hit == e) {
+        t->last_hit = MACNAT_NONE;
+    } else if (t->last_hit == last) {
+        t->last_hit = e;
+    }
+}
+
+static uint8_t find_ip6(const macnat6_table_t *t, const uint8_t *ip)
+{
+    for (uint32_t s = macnat_hash_ip6(ip), n = 0; n < MACNAT6_SLOTS;
+         s = (s + 1) & SLOT6_MASK, n++) {
+        uint8_t e = t->ip_index[s];
+        if (e == MACNAT_NONE || memcmp(t->entries[e].ip, ip, 16) == 0) return e;
+    }
+    return MACNAT_NONE;
+}
+
+void macnat6_table_clear(macnat6_table_t *t)
+{
+    write_begin(&t->seq);
+    memset(t->entries, 0, sizeof(t->entries));
+    memset(t->ip_index, MACNAT_NONE, sizeof(t->ip_index));
+    t->count = 0;
+    t->last_hit = MACNAT_NONE;
+    write_end(&t->seq);
+}
+
+bool macnat6_table_has_mac(const macnat6_table_t *t, const uint8_t *mac)
+{
+    for (uint8_t i = 0; i < t->count; i++) {
+        if (memcmp(t->entries[i].real_mac, mac, 6) == 0) return true;
+    }
+    return false;
+}
+
+macnat_update_t macnat6_table_update(macnat6_table_t *t, const uint8_t *ip,
+                                     const uint8_t *mac, int64_t now)
+{
+    uint8_t e = find_ip6(t, ip);
+    if (e != MACNAT_NONE && memcmp(t->entries[e].real_mac, mac, 6) == 0) {
+        return MACNAT_UNCHANGED;
+    }
+
+    write_begin(&t->seq);
+    macnat_update_t r;
+    if (e != MACNAT_NONE) {
+        /* Adres przeszedł do innego klienta — klucz bez zmian, indeks też */
+        memcpy(t->entries[e].real_mac, mac, 6);
+        t->entries[e].last_seen = now;
+        r = MACNAT_UPDATED;
+    } else {
+        if (t->count >= MACNAT6_CAPACITY) {
+            uint8_t oldest = 0;
+            for (uint8_t i = 1; i < t->count; i++) {
+                if (t->entries[i].last_seen < t->entries[oldest].last_seen) {
+                    oldest = i;
+                }
+            }
+            entry6_remove(t, oldest);
+        }
+        e = t->count++;
+        memcpy(t->entries[e].ip, ip, 16);
+        memcpy(t->entries[e].real_mac, mac, 6);
+        t->entries[e].last_seen = now;
+        index6_insert(t, e);
+        r = MACNAT_ADDED;
+    }
+    write_end(&t->seq);
+    return r;
+}
@@ -0,0 +1,276 @@
+/*
+ * repeater_macnat.h — Hash-indexed IP→MAC table for MAC-NAT
+ *
+ * Wpisy w gęstej tablicy (entries[]), dwa indeksy open-addressing
+ * (linear probing) wskazują na nie:
+ *   ip_index[]  — IPv4 → wpis (downstream lookup, każda ramka unicast)
+ *   mac_index[] — MAC  → wpis (upstream: "ten klient już znany?")
+ * Przed ip_index stoi jednowpisowy cache "last hit" — ramki jednego
+ * flow idą seriami, więc zwykle wystarcza jedno porównanie.
+ *
+ * Moduł jest czystym C (bez ESP-IDF) — znacznik czasu podaje caller.
+ *
+ * Współbieżność: jeden writer (update/clear), dowolni czytelnicy.
+ * Czytelnik spoza kontekstu writera używa macnat_table_lookup_ip_copy()
+ * — seqlock wykrywa zapis w toku i zwraca MAC spójny z indeksem.
+ *
+ * IPv6 (macnat6_*): osobna tablica sąsiadów IPv6 → MAC o tej samej
+ * budowie (gęste wpisy, indeks open-addressing, last hit, seqlock), ale
+ * bez indeksu po MAC — klient ma naraz kilka adresów IPv6 (link-local,
+ * stały i tymczasowe SLAAC), więc MAC nie jest unikalny.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef CONFIG_REPEATER_MACNAT_CAPACITY
+#define MACNAT_CAPACITY  CONFIG_REPEATER_MACNAT_CAPACITY
+#else
+#define MACNAT_CAPACITY  16
+#endif
+
+/* Indeksy mają ≥ 2× więcej slotów niż wpisów (load factor ≤ 0.5) —
+ * krótkie sekwencje probe'ów nawet przy pełnej tablicy. */
+#define MACNAT_SLOT_BITS  (MACNAT_CAPACITY <= 4  ? 3 : \
+                           MACNAT_CAPACITY <= 8  ? 4 : \
+                           MACNAT_CAPACITY <= 16 ? 5 : \
+                           MACNAT_CAPACITY <= 32 ? 6 : 7)
+#define MACNAT_SLOTS      (1u << MACNAT_SLOT_BITS)
+#define MACNAT_NONE       0xFF   /* pusty slot indeksu / brak cache */
+
+typedef struct {
+    uint32_t ip;          /* network byte order */
+    uint8_t  real_mac[6]; /* prawdziwy MAC klienta */
+    int64_t  last_seen;   /* timestamp ostatniej zmiany (µs) */
+} macnat_entry_t;
+
+typedef struct {
+    macnat_entry_t entries[MACNAT_CAPACITY];
+    uint8_t        ip_index[MACNAT_SLOTS];
+    uint8_t        mac_index[MACNAT_SLOTS];
+    uint8_t        count;
+    uint8_t        last_hit;  /* indeks w entries[] ostatniego trafienia po IP */
+    uint32_t       seq;       /* seqlock: nieparzysty = zapis w toku */
+} macnat_table_t;
+
+typedef enum {
+    MACNAT_UNCHANGED = 0,
+    MACNAT_UPDATED,       /* znany IP lub MAC, zmieniła się druga połowa */
+    MACNAT_ADDED,         /* nowy wpis (ew. po eksmisji najstarszego) */
+} macnat_update_t;
+
+static inline uint32_t macnat_hash_ip(uint32_t ip)
+{
+    /* Fibonacci hashing — ostatni oktet (najbardziej zmienny) miesza się
+     * z resztą niezależnie od byte order */
+    return (ip * 2654435761u) >> (32 - MACNAT_SLOT_BITS);
+}
+
+static inline uint32_t macnat_hash_mac(const uint8_t *mac)
+{
+    uint32_t tail;
+    memcpy(&tail, mac + 2, 4);   /* część NIC-specific (po OUI) */
+    return ((tail ^ ((uint32_t)mac[0] << 8 | mac[1])) * 2654435761u)
+           >> (32 - MACNAT_SLOT_BITS);
+}
+
+void macnat_table_clear(macnat_table_t *t);
+
+/**
+ * IPv4 → real MAC, NULL if unknown. Checks the last-hit cache first.
+ */
+static inline const uint8_t *macnat_table_lookup_ip(macnat_table_t *t, uint32_t ip)
+{
+    uint8_t c = t->last_hit;
+    if (c < t->count && t->entries[c].ip == ip) {
+        return t->entries[c].real_mac;
+    }
+    for (uint32_t s = macnat_hash_ip(ip), n = 0; n < MACNAT_SLOTS;
+         s = (s + 1) & (MACNAT_SLOTS - 1), n++) {
+        uint8_t e = t->ip_index[s];
+        if (e == MACNAT_NONE) return NULL;
+        if (t->entries[e].ip == ip) {
+            t->last_hit = e;
+            return t->entries[e].real_mac;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Lookup safe against a concurrent writer: copies the MAC into mac_out.
+ * Returns false when unknown or when a write kept the table busy for
+ * every retry (caller treats it as a miss).
+ */
+static inline bool macnat_table_lookup_ip_copy(macnat_table_t *t, uint32_t ip,
+                                               uint8_t *mac_out)
+{
+    for (int tries = 0; tries < 4; tries++) {
+        uint32_t s1 = __atomic_load_n(&t->seq, __ATOMIC_ACQUIRE);
+        if (s1 & 1) continue;
+        const uint8_t *mac = macnat_table_lookup_ip(t, ip);
+        if (mac) memcpy(mac_out, mac, 6);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&t->seq, __ATOMIC_RELAXED) == s1) {
+            return mac != NULL;
+        }
+    }
+    return false;
+}
+
+/* Writer in progress? (cheap check for callers that can defer instead) */
+static inline bool macnat_table_busy(const macnat_table_t *t)
+{
+    return __atomic_load_n(&t->seq, __ATOMIC_ACQUIRE) & 1;
+}
+
+/**
+ * Real MAC → entry (reverse index), NULL if unknown.
+ */
+static inline const macnat_entry_t *macnat_table_lookup_mac(const macnat_table_t *t,
+                                                            const uint8_t *mac)
+{
+    for (uint32_t s = macnat_hash_mac(mac), n = 0; n < MACNAT_SLOTS;
+         s = (s + 1) & (MACNAT_SLOTS - 1), n++) {
+        uint8_t e = t->mac_index[s];
+        if (e == MACNAT_NONE) return NULL;
+        if (memcmp(t->entries[e].real_mac, mac, 6) == 0) return &t->entries[e];
+    }
+    return NULL;
+}
+
+/**
+ * Hot-path check: is exactly this IP↔MAC pair already in the table?
+ * Lets the upstream path skip learning (and timestamping) entirely.
+ */
+static inline bool macnat_table_known(const macnat_table_t *t, uint32_t ip,
+                                      const uint8_t *mac)
+{
+    const macnat_entry_t *e = macnat_table_lookup_mac(t, mac);
+    return e && e->ip == ip;
+}
+
+/**
+ * Insert or update an IP↔MAC pair. Same IP with new MAC, or same MAC with
+ * new IP (DHCP renewal), updates the existing entry; otherwise a new entry
+ * is added, evicting the oldest one when the table is full.
+ */
+macnat_update_t macnat_table_update(macnat_table_t *t, uint32_t ip,
+                                    const uint8_t *mac, int64_t now);
+
+/**
+ * Consistent copy of all entries (out holds MACNAT_CAPACITY) for a reader
+ * outside the writer context. Returns the entry count, or -1 when a write
+ * kept the table busy for every retry.
+ */
+int macnat_table_copy(const macnat_table_t *t, macnat_entry_t *out);
+
+/* ── IPv6 ─────────────────────────────────────────────────────── */
+
+#ifdef CONFIG_REPEATER_MACNAT6_CAPACITY
+#define MACNAT6_CAPACITY  CONFIG_REPEATER_MACNAT6_CAPACITY
+#else
+#define MACNAT6_CAPACITY  32
+#endif
+
+#define MACNAT6_SLOT_BITS (MACNAT6_CAPACITY <= 8  ? 4 : \
+                           MACNAT6_CAPACITY <= 16 ? 5 : \
+                           MACNAT6_CAPACITY <= 32 ? 6 : 7)
+#define MACNAT6_SLOTS     (1u << MACNAT6_SLOT_BITS)
+
+typedef struct {
+    uint8_t  ip[16];
+    uint8_t  real_mac[6];
+    int64_t  last_seen;   /* timestamp ostatniej zmiany (µs) */
+} macnat6_entry_t;
+
+typedef struct {
+    macnat6_entry_t entries[MACNAT6_CAPACITY];
+    uint8_t         ip_index[MACNAT6_SLOTS];
+    uint8_t         count;
+    uint8_t         last_hit;
+    uint32_t        seq;      /* seqlock: nieparzysty = zapis w toku */
+} macnat6_table_t;
+
+static inline uint32_t macnat_hash_ip6(const uint8_t *ip)
+{
+    /* Prefiks zwykle wspólny — znaczenie ma XOR interface ID */
+    uint32_t w[4];
+    memcpy(w, ip, 16);
+    return ((w[0] ^ w[1] ^ w[2] ^ w[3]) * 2654435761u) >> (32 - MACNAT6_SLOT_BITS);
+}
+
+void macnat6_table_clear(macnat6_table_t *t);
+
+/**
+ * IPv6 → real MAC, NULL if unknown. Checks the last-hit cache first.
+ */
+static inline const uint8_t *macnat6_table_lookup_ip(macnat6_table_t *t, const uint8_t *ip)
+{
+    uint8_t c = t->last_hit;
+    if (c < t->count && memcmp(t->entries[c].ip, ip, 16) == 0) {
+        return t->entries[c].real_mac;
+    }
+    for (uint32_t s = macnat_hash_ip6(ip), n = 0; n < MACNAT6_SLOTS;
+         s = (s + 1) & (MACNAT6_SLOTS - 1), n++) {
+        uint8_t e = t->ip_index[s];
+        if (e == MACNAT_NONE) return NULL;
+        if (memcmp(t->entries[e].ip, ip, 16) == 0) {
+            t->last_hit = e;
+            return t->entries[e].real_mac;
+        }
+    }
+    return NULL;
+}
+
+/* Seqlock-safe variant of the lookup (see macnat_table_lookup_ip_copy). */
+static inline bool macnat6_table_lookup_ip_copy(macnat6_table_t *t, const uint8_t *ip,
+                                                uint8_t *mac_out)
+{
+    for (int tries = 0; tries < 4; tries++) {
+        uint32_t s1 = __atomic_load_n(&t->seq, __ATOMIC_ACQUIRE);
+        if (s1 & 1) continue;
+        const uint8_t *mac = macnat6_table_lookup_ip(t, ip);
+        if (mac) memcpy(mac_out, mac, 6);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&t->seq, __ATOMIC_RELAXED) == s1) {
+            return mac != NULL;
+        }
+    }
+    return false;
+}
+
+static inline bool macnat6_table_busy(const macnat6_table_t *t)
+{
+    return __atomic_load_n(&t->seq, __ATOMIC_ACQUIRE) & 1;
+}
+
+/* Exactly this IPv6↔MAC pair already in the table? Outside the writer a
+ * racing update can only make it report "unknown" (→ slow path). */
+static inline bool macnat6_table_known(macnat6_table_t *t, const uint8_t *ip,
+                                       const uint8_t *mac)
+{
+    const uint8_t *m = macnat6_table_lookup_ip(t, ip);
+    return m && memcmp(m, mac, 6) == 0;
+}
+
+/* Any address of this MAC in the table? (linear — not for the hot path) */
+bool macnat6_table_has_mac(const macnat6_table_t *t, const uint8_t *mac);
+
+/**
+ * Insert or update an IPv6→MAC pair: a known address moves to the new
+ * MAC, otherwise a new entry is added, evicting the oldest when full.
+ */
+macnat_update_t macnat6_table_update(macnat6_table_t *t, const uint8_t *ip,
+                                     const uint8_t *mac, int64_t now);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,181 @@
+/*
+ * repeater_mcast.c — Multicast/broadcast rate limiter + duplicate suppression
+ */
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "repeater_pkt.h"
+#include "repeater_mcast.h"
+
+#ifndef CONFIG_REPEATER_MCAST_BURST
+#define CONFIG_REPEATER_MCAST_BURST      10
+#endif
+#ifndef CONFIG_REPEATER_MCAST_MDNS_PPS
+#define CONFIG_REPEATER_MCAST_MDNS_PPS   20
+#endif
+#ifndef CONFIG_REPEATER_MCAST_SSDP_PPS
+#define CONFIG_REPEATER_MCAST_SSDP_PPS   10
+#endif
+#ifndef CONFIG_REPEATER_MCAST_IPV6_PPS
+#define CONFIG_REPEATER_MCAST_IPV6_PPS   30
+#endif
+#ifndef CONFIG_REPEATER_MCAST_OTHER_PPS
+#define CONFIG_REPEATER_MCAST_OTHER_PPS  50
+#endif
+#ifndef CONFIG_REPEATER_MCAST_DEDUP_MS
+#define CONFIG_REPEATER_MCAST_DEDUP_MS   100
+#endif
+
+#define DEDUP_SLOTS      32           /* potęga 2 — indeks = hash & (N-1) */
+#define DEDUP_HASH_MAX   64           /* bajtów payloadu wchodzących do hasha */
+#define TOKEN_SCALE      1000         /* tokeny w tysięcznych — refill per ms */
+
+const char *const MCAST_CLASS_NAME[MCAST_CLASS_MAX] = {
+    "arp", "dhcp", "mdns", "ssdp", "ipv6", "other",
+};
+
+/* Ramki/s per klasa, 0 = bez limitu (ARP i DHCP — od nich zależy łączność) */
+static const uint16_t s_rate_pps[MCAST_CLASS_MAX] = {
+    [MCAST_CLASS_ARP]   = 0,
+    [MCAST_CLASS_DHCP]  = 0,
+    [MCAST_CLASS_MDNS]  = CONFIG_REPEATER_MCAST_MDNS_PPS,
+    [MCAST_CLASS_SSDP]  = CONFIG_REPEATER_MCAST_SSDP_PPS,
+    [MCAST_CLASS_IPV6]  = CONFIG_REPEATER_MCAST_IPV6_PPS,
+    [MCAST_CLASS_OTHER] = CONFIG_REPEATER_MCAST_OTHER_PPS,
+};
+
+typedef struct {
+    uint32_t tokens;                  /* × TOKEN_SCALE */
+    uint32_t last_ms;
+} bucket_t;
+
+typedef struct {
+    uint32_t hash;                    /* 0 = pusty slot */
+    uint32_t stamp_ms;
+} dedup_slot_t;
+
+static bucket_t      s_bucket[METRICS_PATH_MAX][MCAST_CLASS_MAX];
+static bool          s_bucket_init;
+static dedup_slot_t  s_dedup[DEDUP_SLOTS];
+static mcast_stats_t s_stats;
+static portMUX_TYPE  s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+mcast_class_t mcast_classify(const uint8_t *frame, uint16_t len)
+{
+    switch (pkt_ethertype(frame)) {
+    case PKT_ETHERTYPE_ARP:
+        return MCAST_CLASS_ARP;
+    case PKT_ETHERTYPE_IPV6:
+        return MCAST_CLASS_IPV6;
+    case PKT_ETHERTYPE_IPV4:
+        if (pkt_udp4_ports(frame, len, 68, 67) || pkt_udp4_ports(frame, len, 67, 68)) {
+            return MCAST_CLASS_DHCP;
+        }
+        if (pkt_udp4_ports(frame, len, 5353, 5353)) return MCAST_CLASS_MDNS;
+        /* SSDP: M-SEARCH/NOTIFY idą na 1900, źródłowy port dowolny */
+        if (len >= PKT_IPV4_MIN_LEN && frame[PKT_ETH_HDR_LEN + 9] == PKT_IPPROTO_UDP) {
+            uint8_t ihl = pkt_ipv4_ihl(frame);
+            if (PKT_ETH_HDR_LEN + ihl + 8 <= len) {
+                const uint8_t *udp = frame + PKT_ETH_HDR_LEN + ihl;
+                if (udp[2] == (1900 >> 8) && udp[3] == (1900 & 0xFF)) return MCAST_CLASS_SSDP;
+            }
+        }
+        return MCAST_CLASS_OTHER;
+    default:
+        return MCAST_CLASS_OTHER;
+    }
+}
+
+#if CONFIG_REPEATER_MCAST_DEDUP_MS > 0
+/* FNV-1a od ethertype (MAC-i pomijamy — MAC-NAT podmienia src) + długość */
+static uint32_t frame_hash(const uint8_t *frame, uint16_t len)
+{
+    uint32_t h = 2166136261u ^ len;
+    uint16_t end = len < 12 + DEDUP_HASH_MAX ? len : 12 + DEDUP_HASH_MAX;
+    for (uint16_t i = 12; i < end; i++) {
+        h = (h ^ frame[i]) * 16777619u;
+    }
+    return h ? h : 1;
+}
+#endif
+
+/* Pobierz token; refill proporcjonalny do czasu od ostatniego wywołania */
+static bool bucket_take(bucket_t *b, uint32_t pps, uint32_t now_ms)
+{
+    const uint32_t cap = CONFIG_REPEATER_MCAST_BURST * TOKEN_SCALE;
+    uint32_t dt = now_ms - b->last_ms;
+    b->last_ms = now_ms;
+    /* dt ograniczone, żeby pps × dt nie przepełnił uint32 */
+    if (dt > 60000) dt = 60000;
+    uint32_t t = b->tokens + pps * dt;
+    b->tokens = t > cap ? cap : t;
+    if (b->tokens < TOKEN_SCALE) return false;
+    b->tokens -= TOKEN_SCALE;
+    return true;
+}
+
+mcast_verdict_t mcast_check(metrics_path_t path, const uint8_t *frame, uint16_t len)
+{
+    const uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    mcast_class_t cls = mcast_classify(frame, len);
+#if CONFIG_REPEATER_MCAST_DEDUP_MS > 0
+    /* ARP i DHCP bez dedup: retry ARP / retransmisja DHCP w oknie to
+     * identyczna ramka, a od nich zależy łączność */
+    const bool dedup = cls != MCAST_CLASS_ARP && cls != MCAST_CLASS_DHCP;
+    uint32_t h = dedup ? frame_hash(frame, len) : 0;
+#endif
+    mcast_verdict_t v = MCAST_PASS;
+
+    portENTER_CRITICAL(&s_lock);
+    if (!s_bucket_init) {
+        for (int p = 0; p < METRICS_PATH_MAX; p++) {
+            for (int c = 0; c < MCAST_CLASS_MAX; c++) {
+                s_bucket[p][c].tokens  = CONFIG_REPEATER_MCAST_BURST * TOKEN_SCALE;
+                s_bucket[p][c].last_ms = now_ms;
+            }
+        }
+        s_bucket_init = true;
+    }
+
+#if CONFIG_REPEATER_MCAST_DEDUP_MS > 0
+    /* Duplikat sprawdzany przed limiterem — echo nie zjada tokenów.
+     * Wspólna tablica obu kierunków: ramka przekazana w górę i odbita
+     * przez upstream AP wraca drugą ścieżką. */
+    if (dedup) {
+        dedup_slot_t *d = &s_dedup[h & (DEDUP_SLOTS - 1)];
+        if (d->hash == h && now_ms - d->stamp_ms < CONFIG_REPEATER_MCAST_DEDUP_MS) {
+            v = MCAST_DROP_DUP;
+        } else {
+            d->hash     = h;
+            d->stamp_ms = now_ms;
+        }
+    }
+#endif
+
+    if (v == MCAST_PASS && s_rate_pps[cls] &&
+        !bucket_take(&s_bucket[path][cls], s_rate_pps[cls], now_ms)) {
+        v = MCAST_DROP_RATE;
+    }
+
+    switch (v) {
+    case MCAST_PASS:      s_stats.passed[cls]++;       break;
+    case MCAST_DROP_RATE: s_stats.rate_dropped[cls]++; break;
+    case MCAST_DROP_DUP:  s_stats.dup_dropped[cls]++;  break;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return v;
+}
+
+void mcast_count_unicast(uint32_t n)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_stats.to_unicast += n;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void mcast_get_stats(mcast_stats_t *out)
+{
+    portENTER_CRITICAL(&s_lock);
+    *out = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
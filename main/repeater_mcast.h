@@ -0,0 +1,68 @@
+/*
+ * repeater_mcast.h — Multicast/broadcast rate limiter + duplicate suppression
+ *
+ * Każda ramka grupowa jest retransmitowana w powietrzu na basic rate
+ * (najwolniejszy MCS) — burza mDNS/SSDP/IPv6-ND zjada airtime obu hopów.
+ * Filtr stoi przed TX w obu kierunkach:
+ *   - token bucket per kierunek × klasa (ethertype / port UDP),
+ *     stawki z menuconfig; ARP i DHCP nigdy nie są limitowane
+ *   - mała tablica hashy ostatnich ramek (direct-mapped): ta sama ramka
+ *     widziana ponownie w oknie REPEATER_MCAST_DEDUP_MS jest odrzucana
+ *     (retransmisje 802.11, odbicia od upstream AP, ta sama ramka od
+ *     kilku klientów); ARP i DHCP z tego też są wyłączone
+ *
+ * Wywoływany z callbacku WiFi i tasków bridge'a — stan chroniony
+ * spinlockiem (tylko ramki grupowe, ułamek ruchu).
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "repeater_metrics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    MCAST_CLASS_ARP = 0,
+    MCAST_CLASS_DHCP,
+    MCAST_CLASS_MDNS,        /* UDP 5353 */
+    MCAST_CLASS_SSDP,        /* UDP 1900 */
+    MCAST_CLASS_IPV6,        /* ND, MLD, mDNS v6 itp. */
+    MCAST_CLASS_OTHER,       /* NetBIOS, LLMNR, IGMP, ... */
+    MCAST_CLASS_MAX,
+} mcast_class_t;
+
+typedef enum {
+    MCAST_PASS = 0,
+    MCAST_DROP_RATE,
+    MCAST_DROP_DUP,
+} mcast_verdict_t;
+
+typedef struct {
+    uint32_t passed[MCAST_CLASS_MAX];
+    uint32_t rate_dropped[MCAST_CLASS_MAX];
+    uint32_t dup_dropped[MCAST_CLASS_MAX];
+    uint32_t to_unicast;     /* ramki zamienione na unicast (jedna na klienta) */
+} mcast_stats_t;
+
+extern const char *const MCAST_CLASS_NAME[MCAST_CLASS_MAX];
+
+mcast_class_t mcast_classify(const uint8_t *frame, uint16_t len);
+
+/**
+ * Decide whether a group-addressed frame received on path may be
+ * forwarded. Updates the token bucket, the duplicate table and counters.
+ */
+mcast_verdict_t mcast_check(metrics_path_t path, const uint8_t *frame, uint16_t len);
+
+/* Count n unicast copies sent instead of one multicast frame. */
+void mcast_count_unicast(uint32_t n);
+
+void mcast_get_stats(mcast_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
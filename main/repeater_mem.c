@@ -0,0 +1,316 @@
+/*
+ * repeater_mem.c — Memory report + buffer/stack calibration
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "repeater_mem.h"
+
+#if CONFIG_REPEATER_MEM_REPORT
+
+static const char *TAG = "mem";
+
+#define MEM_WIFI_BUF_BYTES   1600    /* bufor RX/TX drivera: ramka 1514 B + nagłówki */
+#define MEM_TCP_WND_MIN      5744    /* 4 × MSS 1436 */
+#define MEM_SAMPLE_MS        20
+#define MEM_CAL_TASK_STACK   3072
+
+/* ── Rejestr tasków ───────────────────────────────────────────── */
+
+static mem_task_t   s_task[MEM_TASKS_MAX];
+static TaskHandle_t s_handle[MEM_TASKS_MAX];   /* NULL = task skończył się */
+static uint8_t      s_pin[MEM_TASKS_MAX];      /* raporty próbkujące uchwyt */
+static int          s_tasks;
+/* s_lock chroni tylko tablicę. uxTaskGetStackHighWaterMark() (przejście
+ * po stosie) idzie poza lockiem na przypiętym uchwycie — task kończący
+ * się czeka, aż nikt go nie próbkuje, zanim zgasi wpis i zrobi vTaskDelete */
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static int task_find(const char *name)
+{
+    for (int i = 0; i < s_tasks; i++) {
+        if (strcmp(s_task[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+static void task_add(TaskHandle_t me, uint32_t stack_size)
+{
+    const char *name = pcTaskGetName(me);
+
+    portENTER_CRITICAL(&s_lock);
+    int i = task_find(name);
+    if (i < 0 && s_tasks < MEM_TASKS_MAX) {
+        i = s_tasks++;
+        strlcpy(s_task[i].name, name, sizeof(s_task[i].name));
+        s_task[i].min_free = stack_size;
+    }
+    /* Wpis zajęty przez działającą instancję (np. odrzucony drugi
+     * mac_clone) — nie nadpisuj jej uchwytu */
+    if (i >= 0 && s_handle[i] && s_handle[i] != me) i = -1;
+    if (i >= 0) {
+        s_task[i].stack = stack_size;
+        s_task[i].alive = true;
+        s_handle[i]     = me;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void repeater_mem_task_begin(uint32_t stack_size)
+{
+    task_add(xTaskGetCurrentTaskHandle(), stack_size);
+}
+
+void repeater_mem_task_track(const char *name, uint32_t stack_size)
+{
+    TaskHandle_t h = xTaskGetHandle(name);
+    if (h) task_add(h, stack_size);
+}
+
+void repeater_mem_task_end(void)
+{
+    TaskHandle_t me = xTaskGetCurrentTaskHandle();
+    /* ESP-IDF: stos i high-water mark w bajtach */
+    uint32_t hwm = uxTaskGetStackHighWaterMark(NULL);
+    while (1) {
+        portENTER_CRITICAL(&s_lock);
+        int i = 0;
+        while (i < s_tasks && s_handle[i] != me) i++;
+        bool pinned = i < s_tasks && s_pin[i];
+        if (i < s_tasks && !pinned) {
+            if (hwm < s_task[i].min_free) s_task[i].min_free = hwm;
+            s_handle[i]     = NULL;
+            s_task[i].alive = false;
+        }
+        portEXIT_CRITICAL(&s_lock);
+        if (!pinned) return;
+        vTaskDelay(1);      /* raport właśnie czyta nasz stos */
+    }
+}
+
+void repeater_mem_report(mem_report_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    out->heap_free    = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    out->heap_min     = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+    out->heap_largest = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+    out->heap_total   = heap_caps_get_total_size(MALLOC_CAP_INTERNAL);
+
+    TaskHandle_t h[MEM_TASKS_MAX];
+    uint32_t hwm[MEM_TASKS_MAX];
+    portENTER_CRITICAL(&s_lock);
+    int n = s_tasks;
+    for (int i = 0; i < n; i++) {
+        h[i] = s_handle[i];
+        if (h[i]) s_pin[i]++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    for (int i = 0; i < n; i++) {
+        if (h[i]) hwm[i] = uxTaskGetStackHighWaterMark(h[i]);
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < n; i++) {
+        if (!h[i]) continue;
+        s_pin[i]--;
+        if (hwm[i] < s_task[i].min_free) s_task[i].min_free = hwm[i];
+    }
+    out->tasks = s_tasks;
+    memcpy(out->task, s_task, s_tasks * sizeof(s_task[0]));
+    portEXIT_CRITICAL(&s_lock);
+
+    repeater_mem_bridge_peaks(&out->bridge, false);
+}
+
+/* ── Kalibracja ───────────────────────────────────────────────── */
+
+static mem_calib_t  s_calib;
+static portMUX_TYPE s_calib_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t clamp_u32(int32_t v, int32_t lo, int32_t hi)
+{
+    return (uint32_t)(v < lo ? lo : v > hi ? hi : v);
+}
+
+/* Najgorszy (najbardziej zajęty) stos spośród tasków o tych nazwach,
+ * + zapas max(25%, 512 B), zaokrąglone do 256 B; 0 = task nie działał */
+static uint32_t stack_suggest(const mem_report_t *r, const char *const *names, int n)
+{
+    uint32_t used = 0;
+    bool seen = false;
+    for (int i = 0; i < r->tasks; i++) {
+        for (int k = 0; k < n; k++) {
+            if (strcmp(r->task[i].name, names[k]) != 0) continue;
+            uint32_t u = r->task[i].stack - r->task[i].min_free;
+            if (u > used) used = u;
+            seen = true;
+        }
+    }
+    if (!seen) return 0;
+    uint32_t s = used + (used / 4 > 512 ? used / 4 : 512);
+    s = (s + 255) & ~255u;
+    return s < 2048 ? 2048 : s;
+}
+
+static void suggest(mem_calib_t *c, const mem_report_t *r)
+{
+    const mem_bridge_t *w = &c->window;
+    mem_suggest_t *s = &c->suggest;
+
+    /* Połowa nadwyżki (albo deficytu) heapu na RX, połowa na TX — bufory
+     * dynamiczne to limity, alokowane z heapu dopiero pod ruchem */
+    int32_t step = c->spare >= 0 ? c->spare / (2 * MEM_WIFI_BUF_BYTES)
+                                 : -((-c->spare + 2 * MEM_WIFI_BUF_BYTES - 1) /
+                                     (2 * MEM_WIFI_BUF_BYTES));
+
+    /* TX: driver odmawiał (tx_fail) i jest RAM → więcej; deficyt → mniej */
+    int32_t tx = CONFIG_ESP_WIFI_DYNAMIC_TX_BUFFER_NUM;
+    if (c->spare < 0) {
+        tx += step;
+    } else if (w->tx_fail) {
+        tx += step < tx / 2 ? step : tx / 2;
+    }
+    s->dyn_tx = clamp_u32(tx, 16, 128);
+
+    /* RX: nigdy poniżej tego, co bridge trzymał naraz (+ zapas drivera) */
+    int32_t held = w->ring_peak[0] + w->ring_peak[1] + w->rxbuf_peak;
+    int32_t rx = CONFIG_ESP_WIFI_DYNAMIC_RX_BUFFER_NUM;
+    if (c->spare < 0) rx += step;
+    s->dyn_rx = clamp_u32(rx, held + 8 > 16 ? held + 8 : 16, 256);
+
+    /* lwIP TCP obsługuje tylko GUI / tcp_sink — ruch bridge'a omija stos */
+    s->tcp_wnd = CONFIG_LWIP_TCP_WND_DEFAULT;
+    if (c->spare < 0 && s->tcp_wnd > MEM_TCP_WND_MIN) s->tcp_wnd = MEM_TCP_WND_MIN;
+
+#if CONFIG_REPEATER_DEFERRED_PIPELINE
+    /* Ring trzyma tylko deskryptory — przepełnienie → podwój */
+    s->ring = CONFIG_REPEATER_DEFER_RING_SIZE;
+    if (w->defer_full && s->ring < 128) s->ring *= 2;
+#endif
+#if CONFIG_REPEATER_TXQ
+    /* Każdy wpis kolejki trzyma bufor RX — tylko gdy jest RAM */
+    s->txq_depth = CONFIG_REPEATER_TXQ_DEPTH;
+    if (w->txq_rejected && c->spare > 0 && s->txq_depth < 32) {
+        s->txq_depth = s->txq_depth * 2 > 32 ? 32 : s->txq_depth * 2;
+    }
+#endif
+
+    static const char *const MAC[]    = { "mac_clone", "mac_restore" };
+    static const char *const STATUS[] = { "status" };
+    static const char *const ROAM[]   = { "roaming" };
+    static const char *const BRIDGE[] = { "bridge", "fwd_down", "fwd_up" };
+    s->stack_mac    = stack_suggest(r, MAC, 2);
+    s->stack_status = stack_suggest(r, STATUS, 1);
+    s->stack_roam   = stack_suggest(r, ROAM, 1);
+    s->stack_bridge = stack_suggest(r, BRIDGE, 3);
+}
+
+static void calib_task(void *pv)
+{
+    repeater_mem_task_begin(MEM_CAL_TASK_STACK);
+
+    mem_bridge_t base;
+    repeater_mem_bridge_peaks(&base, true);   /* szczyty od zera */
+    const int64_t t0 = esp_timer_get_time();
+    uint32_t heap_min = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+
+    uint16_t seconds;
+    portENTER_CRITICAL(&s_calib_lock);
+    seconds = s_calib.seconds;
+    portEXIT_CRITICAL(&s_calib_lock);
+
+    int64_t elapsed;
+    do {
+        vTaskDelay(pdMS_TO_TICKS(MEM_SAMPLE_MS));
+        uint32_t f = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+        if (f < heap_min) heap_min = f;
+        elapsed = esp_timer_get_time() - t0;
+        portENTER_CRITICAL(&s_calib_lock);
+        s_calib.elapsed_s = (uint32_t)(elapsed / 1000000);
+        s_calib.heap_min  = heap_min;
+        portEXIT_CRITICAL(&s_calib_lock);
+    } while (elapsed < (int64_t)seconds * 1000000);
+
+    mem_report_t *r = malloc(sizeof(*r));
+    mem_calib_t c = { .seconds = seconds, .elapsed_s = seconds, .heap_min = heap_min };
+    if (r) {
+        repeater_mem_report(r);
+        c.window = r->bridge;
+        c.window.tx_fail      -= base.tx_fail;
+        c.window.defer_full   -= base.defer_full;
+        c.window.txq_rejected -= base.txq_rejected;
+        c.window.pool_empty   -= base.pool_empty;
+        c.spare = (int32_t)heap_min - CONFIG_REPEATER_MEM_RESERVE_KB * 1024;
+        suggest(&c, r);
+        c.done = true;
+        free(r);
+        ESP_LOGI(TAG, "Calibration done: heap min %lu B (spare %ld), tx_fail %lu → "
+                 "dyn RX %u, dyn TX %u", (unsigned long)heap_min, (long)c.spare,
+                 (unsigned long)c.window.tx_fail, c.suggest.dyn_rx, c.suggest.dyn_tx);
+    } else {
+        ESP_LOGE(TAG, "Calibration: no memory for the report");
+    }
+
+    portENTER_CRITICAL(&s_calib_lock);
+    s_calib = c;
+    portEXIT_CRITICAL(&s_calib_lock);
+    repeater_mem_task_end();
+    vTaskDelete(NULL);
+}
+
+esp_err_t repeater_mem_calibrate_start(uint16_t seconds)
+{
+    if (seconds == 0 || seconds > MEM_CALIB_SECONDS_MAX) return ESP_ERR_INVALID_ARG;
+
+    portENTER_CRITICAL(&s_calib_lock);
+    bool busy = s_calib.running;
+    if (!busy) {
+        memset(&s_calib, 0, sizeof(s_calib));
+        s_calib.running = true;
+        s_calib.seconds = seconds;
+    }
+    portEXIT_CRITICAL(&s_calib_lock);
+    if (busy) return ESP_ERR_INVALID_STATE;
+
+    /* Niski priorytet — próbkowanie nie może sztucznie dociążać */
+    if (xTaskCreate(calib_task, "mem_cal", MEM_CAL_TASK_STACK, NULL, 3, NULL) != pdPASS) {
+        portENTER_CRITICAL(&s_calib_lock);
+        s_calib.running = false;
+        portEXIT_CRITICAL(&s_calib_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Calibration started (%u s)", seconds);
+    return ESP_OK;
+}
+
+void repeater_mem_calibrate_get(mem_calib_t *out)
+{
+    portENTER_CRITICAL(&s_calib_lock);
+    *out = s_calib;
+    portEXIT_CRITICAL(&s_calib_lock);
+}
+
+#else /* !CONFIG_REPEATER_MEM_REPORT */
+
+void repeater_mem_report(mem_report_t *out)
+{
+    memset(out, 0, sizeof(*out));
+}
+
+esp_err_t repeater_mem_calibrate_start(uint16_t seconds)
+{
+    (void)seconds;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void repeater_mem_calibrate_get(mem_calib_t *out)
+{
+    memset(out, 0, sizeof(*out));
+}
+
+#endif
@@ -0,0 +1,140 @@
+/*
+ * repeater_mem.h — Memory report + buffer/stack calibration (GET/POST /mem)
+ *
+ * Rozmiary buforów WiFi/lwIP i stosów tasków są w sdkconfig "na oko";
+ * na C3 przy kilkunastu klientach kończy się heap. Tutaj mierzymy:
+ *   - heap wewnętrzny: teraz, minimum od startu, największy wolny blok
+ *   - stosy tasków: każdy task rejestruje się sam przy starcie
+ *     (repeater_mem_task_begin), cudze — httpd, sys_evt — raz po
+ *     utworzeniu (repeater_mem_task_track); śledzone po nazwie. Task
+ *     kończący się zapisuje high-water mark przed vTaskDelete
+ *     (repeater_mem_task_end). Druga instancja
+ *     tasku o tej samej nazwie, gdy pierwsza jeszcze działa, nie jest
+ *     śledzona (wpis trzyma uchwyt pierwszej)
+ *   - bufory bridge'a: szczyty zajętości ringów deferred, kolejek retry
+ *     TX i wrapperów RX (każdy trzyma bufor RX drivera) oraz liczniki
+ *     odmów drivera (brak DYNAMIC_TX_BUFFER)
+ *
+ * Kalibracja: przez N sekund pod referencyjnym obciążeniem task "mem_cal"
+ * próbkuje heap i zbiera szczyty, potem liczy sugerowane ustawienia dla
+ * bieżącego chipu (bufory WiFi, okna TCP lwIP, ring/kolejka, stosy) —
+ * RAM nieużyty pod obciążeniem wraca do buforów tam, gdzie driver
+ * odmawiał, a przy deficycie buforom jest zabierany.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "repeater_metrics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MEM_TASKS_MAX        14
+#define MEM_CALIB_SECONDS_MAX 600
+
+typedef struct {
+    char     name[configMAX_TASK_NAME_LEN];  /* kopia — TCB znika z vTaskDelete */
+    uint32_t stack;           /* rozmiar stosu (B) */
+    uint32_t min_free;        /* high-water mark: najmniej wolnego stosu (B) */
+    bool     alive;           /* task działa (false = skończył się) */
+} mem_task_t;
+
+/* Bufory trzymane przez bridge (implementacja w wifi_repeater_main.c) */
+typedef struct {
+    uint32_t ring_peak[METRICS_PATH_MAX];   /* ramki w ringu deferred */
+    uint32_t txq_peak[METRICS_PATH_MAX];    /* ramki w kolejce retry TX */
+    uint32_t rxbuf_peak;                    /* wrappery RX (kolejka retry) */
+    uint32_t tx_fail;                       /* esp_wifi_internal_tx() != ESP_OK */
+    uint32_t defer_full;                    /* ring pełny */
+    uint32_t txq_rejected;                  /* kolejka retry pełna */
+    uint32_t pool_empty;                    /* brak wolnego wrappera RX */
+} mem_bridge_t;
+
+typedef struct {
+    uint32_t heap_free;       /* wewnętrzny RAM (MALLOC_CAP_INTERNAL), B */
+    uint32_t heap_min;        /* minimum od startu */
+    uint32_t heap_largest;    /* największy wolny blok */
+    uint32_t heap_total;
+    int      tasks;
+    mem_task_t task[MEM_TASKS_MAX];
+    mem_bridge_t bridge;      /* szczyty od startu (albo od startu kalibracji) */
+} mem_report_t;
+
+/* Sugerowane ustawienia po kalibracji (0 = bez zmian / brak danych) */
+typedef struct {
+    uint16_t dyn_rx;          /* CONFIG_ESP_WIFI_DYNAMIC_RX_BUFFER_NUM */
+    uint16_t dyn_tx;          /* CONFIG_ESP_WIFI_DYNAMIC_TX_BUFFER_NUM */
+    uint32_t tcp_wnd;         /* CONFIG_LWIP_TCP_WND_DEFAULT / SND_BUF_DEFAULT */
+    uint16_t ring;            /* CONFIG_REPEATER_DEFER_RING_SIZE */
+    uint16_t txq_depth;       /* CONFIG_REPEATER_TXQ_DEPTH */
+    uint32_t stack_mac;       /* CONFIG_REPEATER_STACK_MAC_TASK */
+    uint32_t stack_status;    /* CONFIG_REPEATER_STACK_STATUS_TASK */
+    uint32_t stack_roam;      /* CONFIG_REPEATER_STACK_ROAM_TASK */
+    uint32_t stack_bridge;    /* CONFIG_REPEATER_STACK_BRIDGE_TASK */
+} mem_suggest_t;
+
+typedef struct {
+    bool     running;
+    bool     done;            /* wynik poniżej ważny */
+    uint16_t seconds;
+    uint32_t elapsed_s;
+    uint32_t heap_min;        /* minimum wolnego heapu w oknie (próbkowane) */
+    int32_t  spare;           /* heap_min - REPEATER_MEM_RESERVE_KB (B) */
+    mem_bridge_t window;      /* szczyty w oknie, liczniki jako przyrosty */
+    mem_suggest_t suggest;
+} mem_calib_t;
+
+/**
+ * Current bridge buffer peaks and counters (implemented in
+ * wifi_repeater_main.c). reset = start the peaks over (calibration).
+ */
+void repeater_mem_bridge_peaks(mem_bridge_t *out, bool reset);
+
+#if CONFIG_REPEATER_MEM_REPORT
+
+/**
+ * Track the calling task under its name (idempotent — a task created
+ * again, e.g. mac_clone, keeps its worst high-water mark). A second
+ * instance started while the first is alive is ignored.
+ */
+void repeater_mem_task_begin(uint32_t stack_size);
+
+/**
+ * Track a task we do not create (httpd, sys_evt) by name; call once
+ * after it is started.
+ */
+void repeater_mem_task_track(const char *name, uint32_t stack_size);
+
+/* Record the final high-water mark; call right before vTaskDelete(NULL). */
+void repeater_mem_task_end(void);
+
+#else
+static inline void repeater_mem_task_begin(uint32_t stack_size) { (void)stack_size; }
+static inline void repeater_mem_task_track(const char *name, uint32_t stack_size)
+{
+    (void)name; (void)stack_size;
+}
+static inline void repeater_mem_task_end(void) { }
+#endif
+
+/* Heap, task stacks and bridge buffers (zeroed without CONFIG_REPEATER_MEM_REPORT). */
+void repeater_mem_report(mem_report_t *out);
+
+/**
+ * Start a calibration run of the given length in the background.
+ * ESP_ERR_INVALID_STATE when one is running, ESP_ERR_INVALID_ARG for
+ * 0 or > MEM_CALIB_SECONDS_MAX, ESP_ERR_NOT_SUPPORTED when disabled.
+ */
+esp_err_t repeater_mem_calibrate_start(uint16_t seconds);
+
+/* Last (or running) calibration. */
+void repeater_mem_calibrate_get(mem_calib_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,87 @@
+/*
+ * repeater_metrics.c — Per-core forwarding counters
+ */
+#include <string.h>
+#include "repeater_metrics.h"
+
+repeater_handover_t s_handover;
+
+#if CONFIG_REPEATER_METRICS
+
+repeater_metrics_t s_metrics[SOC_CPU_CORES_NUM];
+#if CONFIG_REPEATER_BENCH
+repeater_metrics_t *s_metrics_cur[SOC_CPU_CORES_NUM] = {
+    &s_metrics[0],
+#if SOC_CPU_CORES_NUM > 1
+    &s_metrics[1],
+#endif
+};
+repeater_metrics_t s_metrics_bench;   /* tylko loopback benchmarku, nigdzie nie raportowany */
+#endif
+
+void repeater_metrics_snapshot(repeater_metrics_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    for (int c = 0; c < SOC_CPU_CORES_NUM; c++) {
+        const repeater_metrics_t *m = &s_metrics[c];
+        for (int p = 0; p < METRICS_PATH_MAX; p++) {
+            out->rx_frames[p]       += m->rx_frames[p];
+            out->rx_bytes[p]        += m->rx_bytes[p];
+            out->bcast_dropped[p]   += m->bcast_dropped[p];
+            out->to_lwip[p]         += m->to_lwip[p];
+            out->macnat_rewrites[p] += m->macnat_rewrites[p];
+            out->tx_fail[p]         += m->tx_fail[p];
+            out->deferred[p]        += m->deferred[p];
+            out->defer_full[p]      += m->defer_full[p];
+            out->txq_queued[p]      += m->txq_queued[p];
+            out->txq_sent[p]        += m->txq_sent[p];
+            out->txq_rejected[p]    += m->txq_rejected[p];
+            out->txq_evicted[p]     += m->txq_evicted[p];
+            out->txq_stale[p]       += m->txq_stale[p];
+            out->ack_bypass[p]      += m->ack_bypass[p];
+            out->ack_merged[p]      += m->ack_merged[p];
+            out->qos_remarked[p]    += m->qos_remarked[p];
+            out->qos_ahead[p]       += m->qos_ahead[p];
+            out->mss_clamped[p]     += m->mss_clamped[p];
+            out->tx_copies[p]       += m->tx_copies[p];
+            out->tx_copy_bytes[p]   += m->tx_copy_bytes[p];
+            out->cycles_sum[p]      += m->cycles_sum[p];
+            for (int a = 0; a < QOS_AC_MAX; a++) {
+                out->qos_frames[p][a] += m->qos_frames[p][a];
+                out->qos_bytes[p][a]  += m->qos_bytes[p][a];
+            }
+            for (int b = 0; b < METRICS_HIST_BUCKETS; b++) {
+                out->cycles_hist[p][b] += m->cycles_hist[p][b];
+            }
+        }
+    }
+}
+
+uint32_t repeater_metrics_rx_frames(void)
+{
+    uint32_t n = 0;
+    for (int c = 0; c < SOC_CPU_CORES_NUM; c++) {
+        for (int p = 0; p < METRICS_PATH_MAX; p++) {
+            n += s_metrics[c].rx_frames[p];
+        }
+    }
+    return n;
+}
+
+void repeater_metrics_reset(void)
+{
+    memset(s_metrics, 0, sizeof(s_metrics));
+}
+
+#else
+
+void repeater_metrics_snapshot(repeater_metrics_t *out)
+{
+    memset(out, 0, sizeof(*out));
+}
+
+uint32_t repeater_metrics_rx_frames(void) { return 0; }
+
+void repeater_metrics_reset(void) { }
+
+#endif
@@ -0,0 +1,161 @@
+/*
+ * repeater_metrics.h — Per-core forwarding counters + CPU-cycle histograms
+ *
+ * Liczniki inkrementowane w hot-path (on_sta_rx / on_ap_rx). Każdy rdzeń
+ * pisze tylko do własnego slotu → brak atomików i cache line ping-pong
+ * na S3/ESP32. Odczyt (GET /metrics) sumuje sloty — wartości są
+ * "best-effort" (bez blokady), dokładność wystarcza do scrapowania.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "soc/soc_caps.h"
+#include "esp_cpu.h"
+#include "repeater_qos.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Ścieżki forwardingu (= callbacki RX) */
+typedef enum {
+    METRICS_PATH_STA_RX = 0,   /* upstream → klient (on_sta_rx) */
+    METRICS_PATH_AP_RX,        /* klient → upstream (on_ap_rx) */
+    METRICS_PATH_MAX,
+} metrics_path_t;
+
+/* Histogram cykli: kubełek i = [2^(i+SHIFT), 2^(i+SHIFT+1)),
+ * pierwszy łapie wszystko poniżej 2^(SHIFT+1), ostatni — wszystko powyżej. */
+#define METRICS_HIST_SHIFT    8     /* 256 cykli */
+#define METRICS_HIST_BUCKETS  12    /* do 2^20 ≈ 1M cykli (~6 ms @160 MHz) */
+
+typedef struct {
+    uint32_t rx_frames[METRICS_PATH_MAX];      /* ramki wejściowe callbacku */
+    uint64_t rx_bytes[METRICS_PATH_MAX];
+    uint32_t bcast_dropped[METRICS_PATH_MAX];  /* broadcast pominięty przez is_broadcast_for_us */
+    uint32_t to_lwip[METRICS_PATH_MAX];        /* esp_netif_receive() */
+    uint32_t macnat_rewrites[METRICS_PATH_MAX];/* STA_RX = downstream, AP_RX = upstream */
+    uint32_t tx_fail[METRICS_PATH_MAX];        /* esp_wifi_internal_tx() != ESP_OK */
+    uint32_t deferred[METRICS_PATH_MAX];       /* ramki odroczone do bridge tasku */
+    uint32_t defer_full[METRICS_PATH_MAX];     /* ring pełny → fast path bez uczenia */
+    uint32_t txq_queued[METRICS_PATH_MAX];     /* tx odmówił → kolejka retry */
+    uint32_t txq_sent[METRICS_PATH_MAX];       /* wysłane z kolejki przy kolejnej próbie */
+    uint32_t txq_rejected[METRICS_PATH_MAX];   /* kolejka pełna → nowa ramka odrzucona */
+    uint32_t txq_evicted[METRICS_PATH_MAX];    /* kolejka pełna → starsza ramka wyrzucona */
+    uint32_t txq_stale[METRICS_PATH_MAX];      /* za długo w kolejce → odrzucona */
+    uint32_t ack_bypass[METRICS_PATH_MAX];     /* pure ACK wysłany przed kolejką bulk */
+    uint32_t ack_merged[METRICS_PATH_MAX];     /* starszy ACK flow zastąpiony w kolejce */
+    uint32_t qos_frames[METRICS_PATH_MAX][QOS_AC_MAX]; /* ramki wysłane per klasa WMM */
+    uint64_t qos_bytes[METRICS_PATH_MAX][QOS_AC_MAX];
+    uint32_t qos_remarked[METRICS_PATH_MAX];   /* DSCP niezaznaczonej ramki ustawiony z klasy */
+    uint32_t qos_ahead[METRICS_PATH_MAX];      /* ramka VO/VI w kolejce przed bulk */
+    uint32_t mss_clamped[METRICS_PATH_MAX];    /* SYN z MSS obniżonym do REPEATER_MSS_CLAMP_VALUE */
+    uint32_t tx_copies[METRICS_PATH_MAX];      /* kopie drivera w esp_wifi_internal_tx (RXBUF_DEBUG) */
+    uint64_t tx_copy_bytes[METRICS_PATH_MAX];
+    uint32_t cycles_hist[METRICS_PATH_MAX][METRICS_HIST_BUCKETS];
+    uint64_t cycles_sum[METRICS_PATH_MAX];
+} repeater_metrics_t;
+
+#if CONFIG_REPEATER_METRICS
+
+/* Non-static: inline hot-path helpers below write straight into the slot */
+extern repeater_metrics_t s_metrics[SOC_CPU_CORES_NUM];
+
+#if CONFIG_REPEATER_BENCH
+/* Slot rdzenia przez wskaźnik: loopback benchmarku przełącza slot swojego
+ * rdzenia na s_metrics_bench (poza sumą) przy wstrzymanym schedulerze —
+ * żaden inny task tego rdzenia nie liczy w tym czasie */
+extern repeater_metrics_t *s_metrics_cur[SOC_CPU_CORES_NUM];
+extern repeater_metrics_t  s_metrics_bench;
+#endif
+
+static inline repeater_metrics_t *metrics_slot(void)
+{
+#if CONFIG_REPEATER_BENCH
+#if SOC_CPU_CORES_NUM > 1
+    return s_metrics_cur[esp_cpu_get_core_id()];
+#else
+    return s_metrics_cur[0];
+#endif
+#elif SOC_CPU_CORES_NUM > 1
+    return &s_metrics[esp_cpu_get_core_id()];
+#else
+    return &s_metrics[0];
+#endif
+}
+
+#define METRICS_INC(field, path)      (metrics_slot()->field[(path)]++)
+#define METRICS_ADD(field, path, n)   (metrics_slot()->field[(path)] += (n))
+
+static inline uint32_t metrics_cycles_now(void)
+{
+#if CONFIG_REPEATER_METRICS_CYCLE_HIST
+    return esp_cpu_get_cycle_count();
+#else
+    return 0;
+#endif
+}
+
+static inline void metrics_cycles_record(metrics_path_t path, uint32_t start)
+{
+#if CONFIG_REPEATER_METRICS_CYCLE_HIST
+    uint32_t d = esp_cpu_get_cycle_count() - start;
+    /* floor(log2(d)) bez pętli — jedna instrukcja clz */
+    int b = (31 - __builtin_clz(d | 1)) - METRICS_HIST_SHIFT;
+    if (b < 0) b = 0;
+    if (b >= METRICS_HIST_BUCKETS) b = METRICS_HIST_BUCKETS - 1;
+    repeater_metrics_t *m = metrics_slot();
+    m->cycles_hist[path][b]++;
+    m->cycles_sum[path] += d;
+#else
+    (void)path; (void)start;
+#endif
+}
+
+#else /* !CONFIG_REPEATER_METRICS */
+
+#define METRICS_INC(field, path)      ((void)0)
+#define METRICS_ADD(field, path, n)   ((void)0)
+static inline uint32_t metrics_cycles_now(void) { return 0; }
+static inline void metrics_cycles_record(metrics_path_t path, uint32_t start)
+{
+    (void)path; (void)start;
+}
+
+#endif
+
+/* Ostatni handover (MAC clone → bridging), czasy faz w ms.
+ * Piszą go tylko mac_change_task; odczyt w GET /status. */
+typedef struct {
+    uint32_t count;           /* udane handovery od startu */
+    uint32_t fast_count;      /* z tego: fast path (zapisany BSSID/kanał) */
+    bool     fast;            /* ostatni przez fast path? */
+    uint32_t disconnect_ms;   /* forwarding stop + disconnect */
+    uint32_t set_mac_ms;      /* DHCP stop + esp_wifi_set_mac */
+    uint32_t connect_ms;      /* esp_wifi_connect → STA_CONNECTED */
+    uint32_t total_ms;
+} repeater_handover_t;
+
+extern repeater_handover_t s_handover;
+
+/**
+ * Sum all per-core slots into *out (zeroed when metrics are disabled).
+ */
+void repeater_metrics_snapshot(repeater_metrics_t *out);
+
+/**
+ * Frames seen by both RX callbacks, all cores (cheap — no snapshot copy).
+ * Wraps; callers use differences.
+ */
+uint32_t repeater_metrics_rx_frames(void);
+
+/**
+ * Zero all counters (e.g. before a benchmark run).
+ */
+void repeater_metrics_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,167 @@
+/*
+ * repeater_pkt.h — Inline frame parsing helpers (Ethernet II / IPv4 / UDP / TCP)
+ *
+ * Wspólne dla forwardingu i MAC-NAT. Czyste C, bez ESP-IDF. Wszystkie
+ * offsety liczone od początku ramki Ethernet (dst MAC).
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PKT_ETH_HDR_LEN     14
+#define PKT_ETHERTYPE_IPV4  0x0800
+#define PKT_ETHERTYPE_ARP   0x0806
+#define PKT_ETHERTYPE_IPV6  0x86DD
+
+#define PKT_IPPROTO_TCP     6
+#define PKT_IPPROTO_UDP     17
+#define PKT_IPPROTO_ICMPV6  58
+
+#define PKT_ARP_LEN         42   /* Ethernet + ARP IPv4 */
+#define PKT_IPV4_MIN_LEN    34   /* Ethernet + minimalny nagłówek IPv4 */
+#define PKT_IPV6_MIN_LEN    54   /* Ethernet + nagłówek IPv6 */
+
+static inline uint16_t pkt_ethertype(const uint8_t *frame)
+{
+    return ((uint16_t)frame[12] << 8) | frame[13];
+}
+
+static inline bool pkt_is_multicast(const uint8_t *mac)
+{
+    return mac[0] & 0x01;
+}
+
+/* Długość nagłówka IPv4 (IHL × 4) */
+static inline uint8_t pkt_ipv4_ihl(const uint8_t *frame)
+{
+    return (frame[PKT_ETH_HDR_LEN] & 0x0F) * 4;
+}
+
+/**
+ * IPv4/UDP frame with the given source and destination ports?
+ * Ports in host order. Checks that the UDP header fits in len.
+ */
+static inline bool pkt_udp4_ports(const uint8_t *frame, uint16_t len,
+                                  uint16_t sport, uint16_t dport)
+{
+    if (len < PKT_IPV4_MIN_LEN || pkt_ethertype(frame) != PKT_ETHERTYPE_IPV4) return false;
+    const uint8_t *ip_hdr = frame + PKT_ETH_HDR_LEN;
+    if (ip_hdr[9] != PKT_IPPROTO_UDP) return false;
+    uint8_t ihl = pkt_ipv4_ihl(frame);
+    if (PKT_ETH_HDR_LEN + ihl + 8 > len) return false;
+    const uint8_t *udp = ip_hdr + ihl;
+    return udp[0] == (sport >> 8) && udp[1] == (sport & 0xFF) &&
+           udp[2] == (dport >> 8) && udp[3] == (dport & 0xFF);
+}
+
+#define PKT_TCP_FIN  0x01
+#define PKT_TCP_SYN  0x02
+#define PKT_TCP_RST  0x04
+#define PKT_TCP_ACK  0x10
+
+/**
+ * IPv4 TCP segment carrying only an ACK (no payload, no SYN/FIN/RST)?
+ * Length taken from the IPv4 total-length field, not from len (padding).
+ */
+static inline bool pkt_tcp4_pure_ack(const uint8_t *frame, uint16_t len)
+{
+    if (len < PKT_IPV4_MIN_LEN || pkt_ethertype(frame) != PKT_ETHERTYPE_IPV4) return false;
+    const uint8_t *ip_hdr = frame + PKT_ETH_HDR_LEN;
+    if (ip_hdr[9] != PKT_IPPROTO_TCP) return false;
+    uint8_t ihl = pkt_ipv4_ihl(frame);
+    if (PKT_ETH_HDR_LEN + ihl + 20 > len) return false;
+    const uint8_t *tcp = ip_hdr + ihl;
+    uint16_t ip_len = ((uint16_t)ip_hdr[2] << 8) | ip_hdr[3];
+    uint8_t  doff   = (tcp[12] >> 4) * 4;
+    uint8_t  flags  = tcp[13];
+    return ip_len == ihl + doff &&
+           (flags & PKT_TCP_ACK) &&
+           !(flags & (PKT_TCP_SYN | PKT_TCP_FIN | PKT_TCP_RST));
+}
+
+typedef struct {
+    uint32_t saddr, daddr;    /* network byte order */
+    uint16_t sport, dport;    /* network byte order */
+} pkt_flow4_t;
+
+/**
+ * Pure ACK (see pkt_tcp4_pure_ack): fill the flow 4-tuple and the ack
+ * number (host order). *mergeable = no SACK option, i.e. a later
+ * cumulative ACK of the same flow carries everything this one does.
+ */
+static inline bool pkt_tcp4_ack_info(const uint8_t *frame, uint16_t len,
+                                     pkt_flow4_t *flow, uint32_t *ack,
+                                     bool *mergeable)
+{
+    if (!pkt_tcp4_pure_ack(frame, len)) return false;
+    const uint8_t *ip_hdr = frame + PKT_ETH_HDR_LEN;
+    uint8_t ihl = pkt_ipv4_ihl(frame);
+    const uint8_t *tcp = ip_hdr + ihl;
+    uint8_t doff = (tcp[12] >> 4) * 4;
+
+    memcpy(&flow->saddr, ip_hdr + 12, 4);
+    memcpy(&flow->daddr, ip_hdr + 16, 4);
+    memcpy(&flow->sport, tcp, 2);
+    memcpy(&flow->dport, tcp + 2, 2);
+    *ack = ((uint32_t)tcp[8] << 24) | ((uint32_t)tcp[9] << 16) |
+           ((uint32_t)tcp[10] << 8) | tcp[11];
+
+    /* Opcje: szukaj SACK (kind 5). Ucięte opcje → nie łącz. */
+    *mergeable = PKT_ETH_HDR_LEN + ihl + doff <= len;
+    for (unsigned i = 20; *mergeable && i < doff; ) {
+        uint8_t kind = tcp[i];
+        if (kind == 0) break;                    /* EOL */
+        if (kind == 1) { i++; continue; }        /* NOP */
+        if (i + 1 >= doff || tcp[i + 1] < 2) { *mergeable = false; break; }
+        if (kind == 5) *mergeable = false;       /* SACK */
+        i += tcp[i + 1];
+    }
+    return true;
+}
+
+/**
+ * Incremental Internet checksum update (RFC 1624, eqn. 3) for one 16-bit
+ * word of the covered data changing from old_w to new_w. csum points at
+ * the checksum field (network order).
+ */
+static inline void pkt_csum_update16(uint8_t *csum, uint16_t old_w, uint16_t new_w)
+{
+    uint32_t sum = (uint16_t)~(((uint16_t)csum[0] << 8) | csum[1]);
+    sum += (uint16_t)~old_w;
+    sum += new_w;
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    uint16_t hc = ~sum;
+    csum[0] = hc >> 8;
+    csum[1] = hc;
+}
+
+/**
+ * pkt_csum_update16() for a UDP checksum: 0 ("not computed", RFC 768)
+ * stays 0, and a result of 0 is sent as 0xFFFF.
+ */
+static inline void pkt_udp_csum_update16(uint8_t *csum, uint16_t old_w, uint16_t new_w)
+{
+    if (csum[0] == 0 && csum[1] == 0) return;
+    pkt_csum_update16(csum, old_w, new_w);
+    if (csum[0] == 0 && csum[1] == 0) csum[0] = csum[1] = 0xFF;
+}
+
+/* Ramki sterujące, których utrata kosztuje najwięcej (ARP, DHCP, TCP ACK) */
+static inline bool pkt_is_high_priority(const uint8_t *frame, uint16_t len)
+{
+    if (pkt_ethertype(frame) == PKT_ETHERTYPE_ARP) return true;
+    return pkt_udp4_ports(frame, len, 68, 67) ||
+           pkt_udp4_ports(frame, len, 67, 68) ||
+           pkt_tcp4_pure_ack(frame, len);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,75 @@
+/*
+ * repeater_ps.c — Traffic-aware power-save controller
+ */
+#include <string.h>
+#include "repeater_ps.h"
+
+#define SLOTS(c)  ((c)->p.window_s + 1)
+
+void ps_ctrl_init(ps_ctrl_t *c, const ps_params_t *p, ps_level_t level)
+{
+    memset(c, 0, sizeof(*c));
+    c->p = *p;
+    if (c->p.window_s == 0) c->p.window_s = 1;
+    if (c->p.window_s > PS_WINDOW_MAX_S) c->p.window_s = PS_WINDOW_MAX_S;
+    c->level = level;
+}
+
+void ps_ctrl_force(ps_ctrl_t *c, ps_level_t level)
+{
+    if (level != c->level) c->switches++;
+    c->level = level;
+    c->in_level_ms = 0;
+}
+
+uint32_t ps_ctrl_avg_pps(const ps_ctrl_t *c)
+{
+    uint8_t n = c->filled < c->p.window_s ? c->filled : c->p.window_s;
+    if (n == 0) return 0;
+    uint32_t sum = 0;
+    /* Pełne kubełki to n ostatnich przed bieżącym */
+    for (uint8_t i = 1; i <= n; i++) {
+        sum += c->bucket[(c->bucket_idx + SLOTS(c) - i) % SLOTS(c)];
+    }
+    return sum / n;
+}
+
+static ps_level_t target_level(const ps_ctrl_t *c, uint32_t avg)
+{
+    if (avg >= c->p.min_modem_pps) return PS_LEVEL_NONE;
+    if (c->p.max_modem_pps == 0 || avg >= c->p.max_modem_pps) return PS_LEVEL_MIN_MODEM;
+    return PS_LEVEL_MAX_MODEM;
+}
+
+ps_level_t ps_ctrl_update(ps_ctrl_t *c, uint32_t pkts, uint32_t dt_ms)
+{
+    c->time_ms[c->level] += dt_ms;
+    c->in_level_ms += dt_ms;
+
+    /* Okno przesuwne: kubełki 1 s */
+    c->bucket[c->bucket_idx] += pkts;
+    c->bucket_ms += dt_ms;
+    if (c->bucket_ms >= 1000) {
+        c->bucket_ms -= 1000;
+        c->bucket_idx = (c->bucket_idx + 1) % SLOTS(c);
+        c->bucket[c->bucket_idx] = 0;
+        if (c->filled < c->p.window_s) c->filled++;
+    }
+
+    /* Burst: nie czekaj na średnią; hold liczony od ostatniego burstu */
+    if (dt_ms && (uint64_t)pkts * 1000 >= (uint64_t)c->p.wake_pps * dt_ms) {
+        ps_ctrl_force(c, PS_LEVEL_NONE);
+        return c->level;
+    }
+
+    /* Średnia dopiero z pełnego okna (po starcie) */
+    if (c->filled < c->p.window_s) return c->level;
+
+    ps_level_t t = target_level(c, ps_ctrl_avg_pps(c));
+    if (t < c->level) {
+        ps_ctrl_force(c, t);
+    } else if (t > c->level && c->in_level_ms >= c->p.hold_ms) {
+        ps_ctrl_force(c, (ps_level_t)(c->level + 1));
+    }
+    return c->level;
+}
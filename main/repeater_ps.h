@@ -0,0 +1,68 @@
+/*
+ * repeater_ps.h — Traffic-aware power-save controller
+ *
+ * Zamiast sztywnego NONE przy bridgowaniu / MIN_MODEM w idle poziom
+ * power save wynika z ruchu bridge'a (ramki/s z liczników metrics):
+ *   - średnia z okna przesuwnego (kubełki 1 s) wybiera poziom docelowy:
+ *       >= min_modem_pps → NONE, >= max_modem_pps → MIN_MODEM, reszta MAX_MODEM
+ *   - w stronę oszczędzania schodzimy o jeden poziom i dopiero po
+ *     hold_ms w bieżącym poziomie (histereza),
+ *   - w górę od razu; pojedyncza próbka >= wake_pps (burst) to natychmiast NONE.
+ *
+ * Czyste C (bez ESP-IDF) — próbkowanie i esp_wifi_set_ps() robi caller.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PS_WINDOW_MAX_S  60
+
+typedef enum {
+    PS_LEVEL_NONE = 0,        /* WIFI_PS_NONE */
+    PS_LEVEL_MIN_MODEM,       /* WIFI_PS_MIN_MODEM — budzenie co DTIM */
+    PS_LEVEL_MAX_MODEM,       /* WIFI_PS_MAX_MODEM — budzenie co listen_interval */
+    PS_LEVEL_MAX,
+} ps_level_t;
+
+typedef struct {
+    uint32_t wake_pps;        /* próbka >= → NONE od razu */
+    uint32_t min_modem_pps;   /* średnia >= → NONE */
+    uint32_t max_modem_pps;   /* średnia >= → MIN_MODEM, poniżej MAX_MODEM (0 = nigdy MAX) */
+    uint32_t hold_ms;         /* minimalny czas w poziomie przed zejściem niżej */
+    uint8_t  window_s;        /* długość okna średniej, 1..PS_WINDOW_MAX_S */
+} ps_params_t;
+
+typedef struct {
+    ps_params_t p;
+    ps_level_t  level;
+    uint32_t    in_level_ms;          /* czas w bieżącym poziomie */
+    uint32_t    bucket[PS_WINDOW_MAX_S + 1];   /* window_s pełnych + bieżący */
+    uint8_t     bucket_idx;           /* kubełek w trakcie zliczania */
+    uint8_t     filled;               /* pełne kubełki (do window_s) */
+    uint32_t    bucket_ms;
+    uint64_t    time_ms[PS_LEVEL_MAX];/* łączny czas w każdym poziomie */
+    uint32_t    switches;
+} ps_ctrl_t;
+
+void ps_ctrl_init(ps_ctrl_t *c, const ps_params_t *p, ps_level_t level);
+
+/* Force a level (e.g. NONE when bridging starts); restarts the hold time. */
+void ps_ctrl_force(ps_ctrl_t *c, ps_level_t level);
+
+/**
+ * Feed one sample: pkts frames seen during the last dt_ms. Returns the
+ * level to apply (may be unchanged).
+ */
+ps_level_t ps_ctrl_update(ps_ctrl_t *c, uint32_t pkts, uint32_t dt_ms);
+
+/* Average packets/s over the complete buckets of the window. */
+uint32_t ps_ctrl_avg_pps(const ps_ctrl_t *c);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,174 @@
+/*
+ * repeater_qos.c — Flow classifier: WMM access category per forwarded frame
+ */
+#include <string.h>
+#include "repeater_qos.h"
+
+const char *const QOS_AC_NAME[QOS_AC_MAX] = {
+    [QOS_AC_BK] = "bk",
+    [QOS_AC_BE] = "be",
+    [QOS_AC_VI] = "vi",
+    [QOS_AC_VO] = "vo",
+};
+
+/* Znane porty (źródłowy albo docelowy). Port z tablicy przypina klasę —
+ * heurystyka go nie podnosi; DNS/NTP zostają BE jak w RFC 8325
+ * (sterowanie, nie media — inaczej klient sypiący zapytaniami DNS
+ * zająłby kolejkę VO) */
+typedef struct {
+    uint16_t lo, hi;
+    uint8_t  proto;
+    uint8_t  ac;
+} qos_port_range_t;
+
+static const qos_port_range_t QOS_PORTS[] = {
+    {    53,    53, PKT_IPPROTO_UDP, QOS_AC_BE },   /* DNS */
+    {   123,   123, PKT_IPPROTO_UDP, QOS_AC_BE },   /* NTP */
+    {  3478,  3481, PKT_IPPROTO_UDP, QOS_AC_VO },   /* STUN/TURN: WebRTC, Teams, WhatsApp */
+    {  5060,  5061, PKT_IPPROTO_UDP, QOS_AC_VO },   /* SIP */
+    {  8801,  8810, PKT_IPPROTO_UDP, QOS_AC_VI },   /* Zoom media */
+    { 19302, 19309, PKT_IPPROTO_UDP, QOS_AC_VI },   /* Google Meet */
+    { 50000, 50059, PKT_IPPROTO_UDP, QOS_AC_VI },   /* Teams / Skype media */
+    {    22,    22, PKT_IPPROTO_TCP, QOS_AC_VI },   /* SSH */
+};
+
+/* Kanoniczny DSCP klasy przy remarkingu (BE = bez zmian) */
+static const uint8_t QOS_AC_DSCP[QOS_AC_MAX] = {
+    [QOS_AC_BK] = 8,    /* CS1 */
+    [QOS_AC_BE] = 0,
+    [QOS_AC_VI] = 34,   /* AF41 */
+    [QOS_AC_VO] = 46,   /* EF */
+};
+
+qos_ac_t qos_dscp_ac(uint8_t dscp)
+{
+    if (dscp == 46 || dscp == 44 || dscp >= 48) return QOS_AC_VO;   /* EF, VA, CS6/CS7 */
+    if (dscp >= 24) return QOS_AC_VI;                               /* CS3..CS5, AF3x, AF4x */
+    if (dscp == 8 || dscp == 1) return QOS_AC_BK;                   /* CS1, LE */
+    return QOS_AC_BE;                                               /* CS0, AF1x, CS2, AF2x */
+}
+
+#define PORT_KNOWN  0x80   /* port_ac: port z tablicy (także BE) — bez promocji */
+
+static uint8_t port_class(uint8_t proto, uint16_t sport, uint16_t dport)
+{
+    for (unsigned i = 0; i < sizeof(QOS_PORTS) / sizeof(QOS_PORTS[0]); i++) {
+        const qos_port_range_t *r = &QOS_PORTS[i];
+        if (r->proto != proto) continue;
+        if ((sport >= r->lo && sport <= r->hi) || (dport >= r->lo && dport <= r->hi)) {
+            return r->ac | PORT_KNOWN;
+        }
+    }
+    return QOS_AC_BE;
+}
+
+/* Klasa flow na podstawie zamkniętego okna (elapsed_ms ≥ QOS_WINDOW_MS) */
+static uint8_t flow_reclassify(const qos_flow_t *f, uint32_t elapsed_ms)
+{
+    uint32_t kbps = (uint32_t)((uint64_t)f->win_bytes * 8 / elapsed_ms);
+    uint32_t pps  = (uint32_t)f->win_pkts * 1000 / elapsed_ms;
+    uint32_t avg  = f->win_bytes / f->win_pkts;
+    /* Histereza: flow już BK schodzi z BK dopiero poniżej połowy progu */
+    uint32_t bulk_kbps = f->ac == QOS_AC_BK ? QOS_BULK_KBPS / 2 : QOS_BULK_KBPS;
+    bool bulk = avg >= QOS_BULK_MIN_SIZE && kbps >= bulk_kbps;
+
+    /* Znany port: bulk na VO schodzi tylko do VI (TURN niosący wideo),
+     * VI/BE do BK (scp/rsync po SSH nie może wyprzedzać interaktywnych) */
+    if (f->port_ac & PORT_KNOWN) {
+        uint8_t ac = f->port_ac & ~PORT_KNOWN;
+        if (!bulk) return ac;
+        return ac == QOS_AC_VO ? QOS_AC_VI : QOS_AC_BK;
+    }
+    if (bulk) return QOS_AC_BK;
+    if (f->proto == PKT_IPPROTO_UDP && avg <= QOS_VOICE_MAX_SIZE &&
+        pps >= QOS_VOICE_MIN_PPS && kbps <= QOS_VOICE_MAX_KBPS) {
+        return QOS_AC_VO;   /* VoIP, gry */
+    }
+    return QOS_AC_BE;
+}
+
+qos_ac_t qos_classify(qos_table_t *t, const uint8_t *frame, uint16_t len,
+                      uint32_t now_ms, bool *unmarked)
+{
+    *unmarked = false;
+    uint16_t ethertype = pkt_ethertype(frame);
+    if (ethertype == PKT_ETHERTYPE_ARP) return QOS_AC_VO;
+    if (ethertype != PKT_ETHERTYPE_IPV4 || len < PKT_IPV4_MIN_LEN) return QOS_AC_BE;
+
+    const uint8_t *ip_hdr = frame + PKT_ETH_HDR_LEN;
+    uint8_t dscp = ip_hdr[1] >> 2;
+    if (dscp) return qos_dscp_ac(dscp);
+
+    uint8_t proto = ip_hdr[9];
+    if (proto != PKT_IPPROTO_TCP && proto != PKT_IPPROTO_UDP) return QOS_AC_BE;
+
+    /* Porty tylko z pierwszego fragmentu — dalsze fragmenty to osobny flow */
+    uint16_t sport = 0, dport = 0;
+    uint8_t ihl = pkt_ipv4_ihl(frame);
+    bool first_frag = (ip_hdr[6] & 0x1F) == 0 && ip_hdr[7] == 0;
+    if (first_frag && PKT_ETH_HDR_LEN + ihl + 4 <= len) {
+        const uint8_t *l4 = ip_hdr + ihl;
+        sport = ((uint16_t)l4[0] << 8) | l4[1];
+        dport = ((uint16_t)l4[2] << 8) | l4[3];
+    }
+    uint32_t saddr, daddr;
+    memcpy(&saddr, ip_hdr + 12, 4);
+    memcpy(&daddr, ip_hdr + 16, 4);
+
+    uint32_t h = saddr ^ daddr ^ (((uint32_t)sport << 16) | dport) ^ proto;
+    h ^= h >> 16;
+    h *= 0x45d9f3bu;
+    h ^= h >> 16;
+    qos_flow_t *f = &t->flow[h % QOS_FLOWS];
+
+    if (f->proto != proto || f->saddr != saddr || f->daddr != daddr ||
+        f->sport != sport || f->dport != dport) {
+        /* Nowy flow (albo kolizja) — startuje z klasą portu */
+        f->saddr     = saddr;
+        f->daddr     = daddr;
+        f->sport     = sport;
+        f->dport     = dport;
+        f->proto     = proto;
+        f->port_ac   = port_class(proto, sport, dport);
+        f->ac        = f->port_ac & ~PORT_KNOWN;
+        f->win_start = now_ms;
+        f->win_bytes = 0;
+        f->win_pkts  = 0;
+    }
+
+    f->win_bytes += len;
+    f->win_pkts++;
+    uint32_t elapsed = now_ms - f->win_start;
+    if (elapsed >= QOS_WINDOW_MS) {
+        f->ac        = flow_reclassify(f, elapsed);
+        f->win_start = now_ms;
+        f->win_bytes = 0;
+        f->win_pkts  = 0;
+    }
+
+    *unmarked = true;
+    return (qos_ac_t)f->ac;
+}
+
+bool qos_remark(uint8_t *frame, uint16_t len, qos_ac_t ac)
+{
+    if (ac == QOS_AC_BE || len < PKT_IPV4_MIN_LEN ||
+        pkt_ethertype(frame) != PKT_ETHERTYPE_IPV4) {
+        return false;
+    }
+    uint8_t *ip_hdr = frame + PKT_ETH_HDR_LEN;
+    uint8_t tos = (uint8_t)(QOS_AC_DSCP[ac] << 2) | (ip_hdr[1] & 0x03);   /* ECN bez zmian */
+    if (tos == ip_hdr[1]) return false;
+
+    /* Bajt TOS to młodsza połowa pierwszego słowa nagłówka (version/IHL|TOS) */
+    uint16_t old_w = ((uint16_t)ip_hdr[0] << 8) | ip_hdr[1];
+    uint16_t new_w = ((uint16_t)ip_hdr[0] << 8) | tos;
+    ip_hdr[1] = tos;
+    pkt_csum_update16(ip_hdr + 10, old_w, new_w);
+    return true;
+}
+
+void qos_table_clear(qos_table_t *t)
+{
+    memset(t, 0, sizeof(*t));
+}
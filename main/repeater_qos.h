@@ -0,0 +1,99 @@
+/*
+ * repeater_qos.h — Flow classifier: WMM access category per forwarded frame
+ *
+ * Oba hopy dzielą jedno radio i jedną ścieżkę TX — bez klasyfikacji
+ * rozmowa głosowa stoi w tej samej kolejce co pobieranie z tego samego
+ * telefonu. Klasyfikator przypisuje ramce kategorię WMM:
+ *   - DSCP ustawiony przez nadawcę wygrywa (mapowanie jak RFC 8325)
+ *   - ramki niezaznaczone (DSCP 0, większość ruchu domowego): znane
+ *     porty UDP (SIP, STUN/TURN, Zoom, Meet, Teams; DNS/NTP przypięte
+ *     do BE) i heurystyka per flow — małe pakiety UDP w stałym tempie
+ *     → VO, flow o dużych pakietach powyżej REPEATER_QOS_BULK_KBPS → BK
+ *
+ * Stan flow (okno rate) siedzi w małej tablicy direct-mapped indeksowanej
+ * hashem 5-tuple — kolizja po prostu zastępuje wpis. Trafienie to hash,
+ * porównanie klucza i dwa liczniki; przeliczenie klasy raz na okno.
+ *
+ * Czyste C (bez ESP-IDF) — zegar (ms) podaje caller. Jedna tablica na
+ * kierunek; wyścig dwóch writerów na tym samym wpisie kosztuje co
+ * najwyżej jedną źle policzoną ramkę, nie spójność pamięci.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "repeater_pkt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef CONFIG_REPEATER_QOS_FLOWS
+#define QOS_FLOWS        CONFIG_REPEATER_QOS_FLOWS
+#else
+#define QOS_FLOWS        64
+#endif
+
+#ifdef CONFIG_REPEATER_QOS_BULK_KBPS
+#define QOS_BULK_KBPS    CONFIG_REPEATER_QOS_BULK_KBPS
+#else
+#define QOS_BULK_KBPS    4000
+#endif
+
+#define QOS_WINDOW_MS        250   /* okno rate flow — klasa przeliczana raz na okno */
+#define QOS_BULK_MIN_SIZE    1000  /* bulk: średnia ramka ≥ (B) i rate ≥ BULK_KBPS */
+#define QOS_VOICE_MAX_SIZE   300   /* voice: UDP, średnia ramka ≤ (B), */
+#define QOS_VOICE_MIN_PPS    10    /*        stałe tempo ≥ (ramek/s) */
+#define QOS_VOICE_MAX_KBPS   512   /*        i bitrate ≤ (kbit/s) */
+
+/* Kategorie WMM w kolejności priorytetu (nie numeracja 802.11 — BE=0) */
+typedef enum {
+    QOS_AC_BK = 0,            /* background: bulk download/upload */
+    QOS_AC_BE,                /* best effort */
+    QOS_AC_VI,                /* video, interaktywne */
+    QOS_AC_VO,                /* voice, ARP */
+    QOS_AC_MAX,
+} qos_ac_t;
+
+extern const char *const QOS_AC_NAME[QOS_AC_MAX];
+
+typedef struct {
+    uint32_t saddr, daddr;    /* network byte order */
+    uint16_t sport, dport;    /* host order, 0 = brak (fragment IPv4) */
+    uint8_t  proto;           /* 0 = pusty slot */
+    uint8_t  port_ac;         /* klasa z tablicy portów (qos_ac_t) | PORT_KNOWN */
+    uint8_t  ac;              /* bieżąca klasa flow */
+    uint32_t win_start;       /* ms */
+    uint32_t win_bytes;
+    uint16_t win_pkts;
+} qos_flow_t;
+
+typedef struct {
+    qos_flow_t flow[QOS_FLOWS];
+} qos_table_t;
+
+/* WMM AC for a DSCP value (RFC 8325 style). */
+qos_ac_t qos_dscp_ac(uint8_t dscp);
+
+/**
+ * Classify one frame. IPv4 frames with a DSCP set map directly; unmarked
+ * TCP/UDP frames go through the flow cache. *unmarked is set when the
+ * class came from the heuristics (DSCP 0), i.e. the frame may be
+ * re-marked with qos_remark().
+ */
+qos_ac_t qos_classify(qos_table_t *t, const uint8_t *frame, uint16_t len,
+                      uint32_t now_ms, bool *unmarked);
+
+/**
+ * Write the canonical DSCP of ac (EF / AF41 / CS1; BE leaves the frame
+ * alone) into an IPv4 frame, keeping ECN and patching the header
+ * checksum incrementally. Returns true when the frame was changed.
+ */
+bool qos_remark(uint8_t *frame, uint16_t len, qos_ac_t ac);
+
+void qos_table_clear(qos_table_t *t);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,160 @@
+/*
+ * repeater_radio.c — Named radio profiles
+ */
+#include "esp_log.h"
+#include "soc/soc_caps.h"
+#include "repeater_roam.h"
+#include "repeater_radio.h"
+
+static const char *TAG = "radio";
+
+#define PROTO_BGN   (WIFI_PROTOCOL_11B | WIFI_PROTOCOL_11G | WIFI_PROTOCOL_11N)
+#if SOC_WIFI_HE_SUPPORT
+#define PROTO_BGNAX (PROTO_BGN | WIFI_PROTOCOL_11AX)
+#else
+#define PROTO_BGNAX PROTO_BGN
+#endif
+
+#define LONG_RANGE_BA_WIN   6      /* krótsze agregaty — mniej powtórek przy słabym SNR */
+
+const radio_profile_def_t RADIO_PROFILE[RADIO_PROFILE_MAX] = {
+    /* Dotychczasowe zachowanie: HE (C6) wymaga HT20; bez HE (S3) HT40 */
+#if SOC_WIFI_HE_SUPPORT
+    [RADIO_PROFILE_AUTO]       = { "auto",       PROTO_BGNAX, WIFI_BW_HT20, WIFI_BW_HT20,
+                                   0,  true, 0, true,  false },
+#else
+    [RADIO_PROFILE_AUTO]       = { "auto",       PROTO_BGN,   WIFI_BW_HT40, WIFI_BW_HT40,
+                                   0,  true, 0, false, false },
+#endif
+    [RADIO_PROFILE_THROUGHPUT] = { "throughput", PROTO_BGN,   WIFI_BW_HT40, WIFI_BW_HT40,
+                                   0,  true, 0, false, false },
+    [RADIO_PROFILE_HE20]       = { "he20",       PROTO_BGNAX, WIFI_BW_HT20, WIFI_BW_HT20,
+                                   0,  true, 0, true,  false },
+    [RADIO_PROFILE_CONGESTED]  = { "congested",  PROTO_BGNAX, WIFI_BW_HT20, WIFI_BW_HT20,
+                                   0,  true, 0, false, false },
+    [RADIO_PROFILE_LONG_RANGE] = { "long_range", PROTO_BGNAX, WIFI_BW_HT20, WIFI_BW_HT20,
+                                   20, true, LONG_RANGE_BA_WIN, false, true },
+};
+
+bool radio_profile_supported(radio_profile_t p)
+{
+    if (p >= RADIO_PROFILE_MAX) return false;
+#if !SOC_WIFI_HE_SUPPORT
+    if (p == RADIO_PROFILE_HE20) return false;
+#endif
+    return true;
+}
+
+void radio_profile_init_config(radio_profile_t p, wifi_init_config_t *cfg)
+{
+    if (!radio_profile_supported(p)) p = RADIO_PROFILE_AUTO;
+    const radio_profile_def_t *d = &RADIO_PROFILE[p];
+
+    if (!d->ampdu_tx) cfg->ampdu_tx_enable = 0;
+    if (d->ba_win) {
+        if (cfg->tx_ba_win > d->ba_win) cfg->tx_ba_win = d->ba_win;
+        if (cfg->rx_ba_win > d->ba_win) cfg->rx_ba_win = d->ba_win;
+    }
+}
+
+void radio_profile_sta_config(radio_profile_t p, wifi_sta_config_t *sta)
+{
+#if SOC_WIFI_HE_SUPPORT
+    if (!radio_profile_supported(p)) p = RADIO_PROFILE_AUTO;
+    const radio_profile_def_t *d = &RADIO_PROFILE[p];
+
+    sta->he_dcm_set = d->he_dcm;
+    sta->he_dcm_max_constellation_tx = 2;
+    sta->he_dcm_max_constellation_rx = 2;
+    sta->he_mcs9_enabled = d->he_mcs9;
+#else
+    (void)p; (void)sta;
+#endif
+}
+
+esp_err_t radio_profile_apply(radio_profile_t p, uint8_t cfg_tx_power_dbm)
+{
+    if (!radio_profile_supported(p)) return ESP_ERR_NOT_SUPPORTED;
+    const radio_profile_def_t *d = &RADIO_PROFILE[p];
+
+    /* SoftAP bez 11ax — klienci WiFi 6 i tak łączą się jako HT */
+    esp_err_t err = esp_wifi_set_protocol(WIFI_IF_STA, d->protocol);
+    if (err == ESP_OK) {
+        err = esp_wifi_set_protocol(WIFI_IF_AP, d->protocol & ~WIFI_PROTOCOL_11AX);
+    }
+    /* Pasmo po protokole — set_protocol przywraca domyślne bandwidth */
+    if (err == ESP_OK) err = esp_wifi_set_bandwidth(WIFI_IF_STA, (wifi_bandwidth_t)d->bw_sta);
+    if (err == ESP_OK) err = esp_wifi_set_bandwidth(WIFI_IF_AP,  (wifi_bandwidth_t)d->bw_ap);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Profile %s: %s", d->name, esp_err_to_name(err));
+        return err;
+    }
+
+    uint8_t dbm = d->tx_power_dbm ? d->tx_power_dbm : cfg_tx_power_dbm;
+    esp_wifi_set_max_tx_power(dbm * 4);
+
+    ESP_LOGI(TAG, "Profile %s: proto 0x%02x BW %s/%s, %d dBm", d->name, d->protocol,
+             d->bw_sta == WIFI_BW_HT40 ? "HT40" : "HT20",
+             d->bw_ap  == WIFI_BW_HT40 ? "HT40" : "HT20", dbm);
+    return ESP_OK;
+}
+
+uint32_t radio_rate_kbps(wifi_phy_mode_t mode, int rssi, bool he_mcs9)
+{
+    /* HE20 1SS, GI 0.8 µs: MCS9..MCS0 */
+    static const struct { int8_t rssi; uint16_t rate_100k; } he20[] = {
+        { -57, 1147 }, { -59, 1032 }, { -64, 860 }, { -66, 774 },
+        { -70,  688 }, { -74,  516 }, { -77, 344 }, { -79, 258 },
+        { -82,  172 }, { -85,   86 },
+    };
+
+    switch (mode) {
+    case WIFI_PHY_MODE_LR:
+        return rssi >= -100 ? 512 : 0;
+    case WIFI_PHY_MODE_11B:
+        return rssi >= -82 ? 11000 : rssi >= -90 ? 1000 : 0;
+    case WIFI_PHY_MODE_11G:
+        return roam_rate_kbps(rssi) * 54 / 65;
+    case WIFI_PHY_MODE_HT20:
+        return roam_rate_kbps(rssi);
+    case WIFI_PHY_MODE_HT40:
+        /* 2× podnośnych (108 vs 52), ~3 dB gorsza czułość */
+        return roam_rate_kbps(rssi - 3) * 27 / 13;
+    case WIFI_PHY_MODE_HE20:
+        for (unsigned i = he_mcs9 ? 0 : 2; i < sizeof(he20) / sizeof(he20[0]); i++) {
+            if (rssi >= he20[i].rssi) return he20[i].rate_100k * 100u;
+        }
+        return rssi >= -90 ? 1000 : 0;
+    default:
+        return roam_rate_kbps(rssi);
+    }
+}
+
+esp_err_t radio_link_get(radio_link_t *out, bool he_mcs9)
+{
+    wifi_ap_record_t ap;
+    esp_err_t err = esp_wifi_sta_get_ap_info(&ap);
+    if (err != ESP_OK) return err;
+
+    out->rssi    = ap.rssi;
+    out->channel = ap.primary;
+    out->phymode = WIFI_PHY_MODE_HT20;
+    out->bw      = WIFI_BW_HT20;
+    esp_wifi_sta_get_negotiated_phymode(&out->phymode);
+    esp_wifi_get_bandwidth(WIFI_IF_STA, &out->bw);
+    out->rate_kbps = radio_rate_kbps(out->phymode, out->rssi, he_mcs9);
+    return ESP_OK;
+}
+
+const char *radio_phymode_name(wifi_phy_mode_t mode)
+{
+    switch (mode) {
+    case WIFI_PHY_MODE_LR:   return "LR";
+    case WIFI_PHY_MODE_11B:  return "11b";
+    case WIFI_PHY_MODE_11G:  return "11g";
+    case WIFI_PHY_MODE_HT20: return "HT20";
+    case WIFI_PHY_MODE_HT40: return "HT40";
+    case WIFI_PHY_MODE_HE20: return "HE20";
+    default:                 return "?";
+    }
+}
@@ -0,0 +1,85 @@
+/*
+ * repeater_radio.h — Named radio profiles (protocol, bandwidth, power, AMPDU, HE)
+ *
+ * Szerokość kanału i opcje HE zależą od miejsca instalacji (HT40 na
+ * pustym paśmie, HE20 z MCS8-9 przy dobrym SNR, HT20 w zatłoczonym
+ * 2.4 GHz), więc zamiast #if SOC_WIFI_HE_SUPPORT w init_wifi profil
+ * jest wybierany w runtime (repeater_config_t.radio_profile, web GUI).
+ *
+ * Protokół, pasmo, moc i opcje HE STA stosowane są od razu (po
+ * reconnect STA); AMPDU / okno BA trafiają do wifi_init_config_t, więc
+ * działają od następnego startu.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_wifi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    RADIO_PROFILE_AUTO = 0,      /* domyślne dla SoC: HE20 na C6, HT40 na reszcie */
+    RADIO_PROFILE_THROUGHPUT,    /* HT40 b/g/n, pełne AMPDU */
+    RADIO_PROFILE_HE20,          /* 11ax HE20 + MCS8-9 (tylko SoC z HE) */
+    RADIO_PROFILE_CONGESTED,     /* HT20 na obu interfejsach, bez MCS8-9 */
+    RADIO_PROFILE_LONG_RANGE,    /* HT20, pełna moc, DCM, krótsze okno BA */
+    RADIO_PROFILE_MAX,
+} radio_profile_t;
+
+typedef struct {
+    const char *name;            /* GUI / JSON */
+    uint8_t  protocol;           /* WIFI_PROTOCOL_* (oba interfejsy) */
+    uint8_t  bw_sta;             /* wifi_bandwidth_t */
+    uint8_t  bw_ap;
+    uint8_t  tx_power_dbm;       /* 0 = z konfiguracji (tx_power_dbm) */
+    bool     ampdu_tx;
+    uint8_t  ba_win;             /* 0 = z sdkconfig; tylko zmniejsza */
+    bool     he_mcs9;            /* HE-MCS 8-9 (256-QAM) */
+    bool     he_dcm;             /* HE DCM — zasięg kosztem szybkości */
+} radio_profile_def_t;
+
+extern const radio_profile_def_t RADIO_PROFILE[RADIO_PROFILE_MAX];
+
+/* Stan łącza STA po zastosowaniu profilu */
+typedef struct {
+    wifi_phy_mode_t phymode;     /* wynegocjowany z upstream AP */
+    wifi_bandwidth_t bw;
+    int8_t   rssi;
+    uint8_t  channel;
+    uint32_t rate_kbps;          /* szacowana szybkość PHY (patrz radio_rate_kbps) */
+} radio_link_t;
+
+/* Profile usable on this SoC (HE20 needs SOC_WIFI_HE_SUPPORT). */
+bool radio_profile_supported(radio_profile_t p);
+
+/* AMPDU / BA window — call on the init config before esp_wifi_init(). */
+void radio_profile_init_config(radio_profile_t p, wifi_init_config_t *cfg);
+
+/* HE options of the STA config (effective from the next association). */
+void radio_profile_sta_config(radio_profile_t p, wifi_sta_config_t *sta);
+
+/**
+ * Protocol, bandwidth per interface and TX power. Call after
+ * esp_wifi_set_mode(); cfg_tx_power_dbm is used when the profile does
+ * not set its own power.
+ */
+esp_err_t radio_profile_apply(radio_profile_t p, uint8_t cfg_tx_power_dbm);
+
+/* Current STA link (ESP_ERR_WIFI_NOT_CONNECT when not associated). */
+esp_err_t radio_link_get(radio_link_t *out, bool he_mcs9);
+
+/**
+ * Rough 1×1 PHY rate (kbit/s) for the negotiated mode at rssi, from
+ * typical receiver sensitivity per MCS (long GI for HT, 0.8 µs for HE).
+ */
+uint32_t radio_rate_kbps(wifi_phy_mode_t mode, int rssi, bool he_mcs9);
+
+const char *radio_phymode_name(wifi_phy_mode_t mode);
+
+#ifdef __cplusplus
+}
+#endif
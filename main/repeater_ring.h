@@ -0,0 +1,83 @@
+/*
+ * repeater_ring.h — Lock-free single-producer / single-consumer frame ring
+ *
+ * Producent: callback RX drivera WiFi (jeden task — "wifi").
+ * Konsument: bridge task (w trybie dual-core — task forwardingu danego
+ * kierunku). Brak blokad i alokacji — push/pop to kilka
+ * instrukcji + jedna bariera. Ring trzyma tylko deskryptory; bufor RX
+ * (eb) pozostaje własnością ringu aż konsument go zwolni/przekaże dalej.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef CONFIG_REPEATER_DEFER_RING_SIZE
+#define BRIDGE_RING_SIZE  CONFIG_REPEATER_DEFER_RING_SIZE
+#else
+#define BRIDGE_RING_SIZE  32
+#endif
+
+_Static_assert((BRIDGE_RING_SIZE & (BRIDGE_RING_SIZE - 1)) == 0,
+               "REPEATER_DEFER_RING_SIZE must be a power of two");
+
+typedef struct {
+    void    *buffer;
+    void    *eb;
+    uint16_t len;
+} bridge_frame_t;
+
+typedef struct {
+    uint32_t       head;   /* pisze tylko producent */
+    uint32_t       tail;   /* pisze tylko konsument */
+    uint32_t       peak;   /* max zajętość (diagnostyka) */
+    bridge_frame_t slot[BRIDGE_RING_SIZE];
+} bridge_ring_t;
+
+static inline uint32_t bridge_ring_count(const bridge_ring_t *r)
+{
+    return __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) -
+           __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+}
+
+static inline bool bridge_ring_empty(const bridge_ring_t *r)
+{
+    return bridge_ring_count(r) == 0;
+}
+
+/* Producer side. Returns false when full (caller keeps ownership). */
+static inline bool bridge_ring_push(bridge_ring_t *r, void *buffer,
+                                    uint16_t len, void *eb)
+{
+    uint32_t head = r->head;
+    uint32_t used = head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+    if (used >= BRIDGE_RING_SIZE) return false;
+
+    bridge_frame_t *f = &r->slot[head & (BRIDGE_RING_SIZE - 1)];
+    f->buffer = buffer;
+    f->eb     = eb;
+    f->len    = len;
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+    if (used + 1 > r->peak) r->peak = used + 1;
+    return true;
+}
+
+/* Consumer side. Returns false when empty. */
+static inline bool bridge_ring_pop(bridge_ring_t *r, bridge_frame_t *out)
+{
+    uint32_t tail = r->tail;
+    if (tail == __atomic_load_n(&r->head, __ATOMIC_ACQUIRE)) return false;
+
+    *out = r->slot[tail & (BRIDGE_RING_SIZE - 1)];
+    __atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,208 @@
+/*
+ * repeater_roam.c — Pseudo-mesh: candidate BSSID table + incremental scan plan
+ */
+#include <string.h>
+#include "repeater_roam.h"
+
+#define EWMA_SHIFT  2          /* alfa = 1/4 — kilka obserwacji do ustalenia */
+
+/* Estymator (Holt): alfa = 1/4 dla poziomu, beta = 1/8 dla trendu */
+#define EST_ALPHA_DIV   4
+#define EST_BETA_DIV    8
+#define EST_MIN_SAMPLES 8      /* mniej — trend jeszcze szum, prognoza = poziom */
+#define EST_MAX_DT_MS   5000   /* dłuższa przerwa (brak próbek) → start od nowa */
+
+roam_cand_t *roam_table_find(roam_table_t *t, const uint8_t bssid[6])
+{
+    for (int i = 0; i < ROAM_CANDIDATES; i++) {
+        if (t->cand[i].used && memcmp(t->cand[i].bssid, bssid, 6) == 0) {
+            return &t->cand[i];
+        }
+    }
+    return NULL;
+}
+
+roam_cand_t *roam_table_update(roam_table_t *t, const uint8_t bssid[6],
+                               uint8_t channel, int8_t rssi, uint32_t now_ms)
+{
+    roam_cand_t *c = roam_table_find(t, bssid);
+    if (!c) {
+        /* Wolny slot albo najdawniej widziany */
+        c = &t->cand[0];
+        for (int i = 0; i < ROAM_CANDIDATES; i++) {
+            if (!t->cand[i].used) { c = &t->cand[i]; break; }
+            if (now_ms - t->cand[i].last_seen_ms > now_ms - c->last_seen_ms) c = &t->cand[i];
+        }
+        memset(c, 0, sizeof(*c));
+        memcpy(c->bssid, bssid, 6);
+        c->used = true;
+    }
+    /* Pierwsza obserwacja (także po podpowiedzi) ustawia poziom wprost */
+    if (c->seen) {
+        c->rssi_q4 += (rssi * 16 - c->rssi_q4) / (1 << EWMA_SHIFT);
+    } else {
+        c->rssi_q4 = rssi * 16;
+    }
+    c->channel      = channel;
+    c->last_seen_ms = now_ms;
+    c->seen++;
+    return c;
+}
+
+const roam_cand_t *roam_table_best(const roam_table_t *t, uint32_t now_ms,
+                                   uint32_t max_age_ms,
+                                   const uint8_t (*exclude)[6], int n)
+{
+    const roam_cand_t *best = NULL;
+    for (int i = 0; i < ROAM_CANDIDATES; i++) {
+        const roam_cand_t *c = &t->cand[i];
+        if (!c->used || c->seen == 0 || now_ms - c->last_seen_ms > max_age_ms) continue;
+        bool skip = false;
+        for (int k = 0; k < n && !skip; k++) skip = memcmp(c->bssid, exclude[k], 6) == 0;
+        if (skip) continue;
+        if (!best || c->rssi_q4 > best->rssi_q4) best = c;
+    }
+    return best;
+}
+
+void roam_table_hint(roam_table_t *t, const uint8_t bssid[6], uint8_t channel,
+                     uint32_t now_ms, uint32_t max_age_ms)
+{
+    roam_cand_t *c = roam_table_find(t, bssid);
+    if (c) {
+        c->channel = channel;
+        return;
+    }
+    /* Podpowiedź bez pomiaru nie wypiera zmierzonego kandydata: tylko
+     * wolny slot, inna podpowiedź albo wpis nieświeży (najstarszy) */
+    roam_cand_t *slot = NULL;
+    for (int i = 0; i < ROAM_CANDIDATES; i++) {
+        roam_cand_t *e = &t->cand[i];
+        if (!e->used) { slot = e; break; }
+        if (e->seen && now_ms - e->last_seen_ms <= max_age_ms) continue;
+        if (!slot || now_ms - e->last_seen_ms > now_ms - slot->last_seen_ms) slot = e;
+    }
+    if (!slot) return;
+    memset(slot, 0, sizeof(*slot));
+    memcpy(slot->bssid, bssid, 6);
+    slot->used         = true;
+    slot->channel      = channel;
+    slot->rssi_q4      = -127 * 16;
+    slot->last_seen_ms = now_ms;
+}
+
+void roam_table_forget(roam_table_t *t, const uint8_t bssid[6])
+{
+    roam_cand_t *c = roam_table_find(t, bssid);
+    if (c) c->used = false;
+}
+
+/* Czy na kanale ch jest świeży kandydat? */
+static bool channel_known(const roam_table_t *t, uint8_t ch, uint32_t now_ms,
+                          uint32_t max_age_ms)
+{
+    for (int i = 0; i < ROAM_CANDIDATES; i++) {
+        const roam_cand_t *c = &t->cand[i];
+        if (c->used && c->channel == ch && now_ms - c->last_seen_ms <= max_age_ms) return true;
+    }
+    return false;
+}
+
+uint8_t roam_scan_next_channel(roam_scan_t *s, const roam_table_t *t,
+                               uint8_t nchan, uint32_t now_ms, uint32_t max_age_ms)
+{
+    if (nchan == 0 || nchan > ROAM_MAX_CHANNEL) nchan = ROAM_MAX_CHANNEL;
+
+    if (s->slot++ & 1) {
+        /* Sloty nieparzyste: następny znany kanał po ostatnio sondowanym */
+        for (uint8_t k = 1; k <= nchan; k++) {
+            uint8_t ch = (uint8_t)((s->known_rr + k - 1) % nchan + 1);
+            if (channel_known(t, ch, now_ms, max_age_ms)) {
+                s->known_rr = ch;
+                return ch;
+            }
+        }
+    }
+    s->sweep = (uint8_t)(s->sweep % nchan + 1);
+    return s->sweep;
+}
+
+#define EID_NEIGHBOR_REPORT  52
+#define NR_MIN_LEN           13   /* BSSID + BSSID info + op class + kanał + PHY */
+
+int roam_parse_neighbor_report(const uint8_t *buf, uint16_t len,
+                               roam_neighbor_t *out, int max)
+{
+    int n = 0;
+    uint16_t pos = 0;
+    while (n < max && pos + 2 <= len) {
+        uint8_t id = buf[pos], elen = buf[pos + 1];
+        if (pos + 2 + elen > len) break;
+        if (id == EID_NEIGHBOR_REPORT) {
+            if (elen < NR_MIN_LEN) break;
+            const uint8_t *nr = buf + pos + 2;
+            memcpy(out[n].bssid, nr, 6);
+            out[n].bssid_info = (uint32_t)nr[6] | ((uint32_t)nr[7] << 8) |
+                                ((uint32_t)nr[8] << 16) | ((uint32_t)nr[9] << 24);
+            out[n].op_class = nr[10];
+            out[n].channel  = nr[11];
+            out[n].phy_type = nr[12];
+            n++;
+        }
+        pos += 2 + elen;
+    }
+    return n;
+}
+
+void roam_est_update(roam_est_t *e, int8_t rssi, uint32_t now_ms)
+{
+    int32_t x = (int32_t)rssi * 256;
+    uint32_t dt = now_ms - e->last_ms;
+
+    if (e->samples == 0 || dt > EST_MAX_DT_MS) {
+        e->level_q8 = x;
+        e->trend_q8 = 0;
+        e->samples  = 0;
+    } else if (dt > 0) {
+        int32_t pred  = e->level_q8 + e->trend_q8 * (int32_t)dt / 1000;
+        int32_t level = pred + (x - pred) / EST_ALPHA_DIV;
+        int32_t slope = (level - e->level_q8) * 1000 / (int32_t)dt;
+        e->trend_q8 += (slope - e->trend_q8) / EST_BETA_DIV;
+        e->level_q8  = level;
+    }
+    e->last_ms = now_ms;
+    e->samples++;
+}
+
+int roam_est_rssi(const roam_est_t *e)
+{
+    return e->level_q8 / 256;
+}
+
+int roam_est_slope_x10(const roam_est_t *e)
+{
+    return e->trend_q8 * 10 / 256;
+}
+
+int roam_est_predict(const roam_est_t *e, uint32_t horizon_ms)
+{
+    if (e->samples < EST_MIN_SAMPLES) return roam_est_rssi(e);
+    int32_t p = e->level_q8 + e->trend_q8 * (int32_t)(horizon_ms / 100) / 10;
+    if (p > 0) p = 0;
+    if (p < -127 * 256) p = -127 * 256;
+    return p / 256;
+}
+
+uint32_t roam_rate_kbps(int rssi)
+{
+    /* HT20 1SS, long GI: MCS7..MCS0, potem 11b 1 Mb/s */
+    static const struct { int8_t rssi; uint16_t rate_100k; } ladder[] = {
+        { -64, 650 }, { -66, 585 }, { -70, 520 }, { -74, 390 },
+        { -77, 260 }, { -79, 195 }, { -82, 130 }, { -85,  65 },
+        { -90,  10 },
+    };
+    for (unsigned i = 0; i < sizeof(ladder) / sizeof(ladder[0]); i++) {
+        if (rssi >= ladder[i].rssi) return ladder[i].rate_100k * 100u;
+    }
+    return 0;
+}
@@ -0,0 +1,165 @@
+/*
+ * repeater_roam.h — Pseudo-mesh: candidate BSSID table + incremental scan plan
+ *
+ * Zamiast pełnego, blokującego scanu wszystkich kanałów (sekundy bez
+ * bridgowania) roaming_task sonduje JEDEN kanał na slot, między burstami
+ * ruchu. Wyniki trafiają do trwałej tabeli BSSID-ów z tym samym SSID:
+ * wygładzony RSSI (EWMA) + czas ostatniej obserwacji, więc decyzja
+ * o roamingu nie potrzebuje scanu — wystarczy świeży wpis z tabeli.
+ *
+ * Plan kanałów: co drugi slot kanał, na którym już widzieliśmy
+ * kandydata (round-robin), pozostałe sloty przemiatają wszystkie kanały
+ * po kolei — znane kanały są odświeżane najczęściej, nowe AP i tak
+ * zostaną znalezione.
+ *
+ * Estymator łącza (roam_est_t): RSSI obecnego AP próbkowany gęsto
+ * (co REPEATER_ROAM_SAMPLE_MS), wygładzany podwójnym wygładzaniem
+ * wykładniczym (Holt: poziom + trend w dB/s). Prognoza RSSI za kilka
+ * sekund i przybliżona szybkość PHY (roam_rate_kbps) pozwalają zebrać
+ * kandydatów i przełączyć się, ZANIM łącze się załamie.
+ *
+ * 802.11k: neighbor report od upstream AP (roam_parse_neighbor_report)
+ * wpisuje do tabeli "podpowiedzi" — BSSID + kanał bez pomiaru RSSI.
+ * Ich kanały są sondowane jako znane, a kandydatem do roamingu wpis
+ * staje się dopiero po pierwszej obserwacji w scanie.
+ *
+ * Czyste C (bez ESP-IDF) — scan i roam robi caller.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ROAM_CANDIDATES   8
+#define ROAM_MAX_CHANNEL  14
+
+typedef struct {
+    uint8_t  bssid[6];
+    uint8_t  channel;
+    bool     used;
+    int16_t  rssi_q4;         /* EWMA RSSI × 16 (dBm) */
+    uint32_t last_seen_ms;
+    uint32_t seen;            /* liczba obserwacji (0 = tylko podpowiedź 802.11k) */
+} roam_cand_t;
+
+typedef struct {
+    roam_cand_t cand[ROAM_CANDIDATES];
+} roam_table_t;
+
+typedef struct {
+    uint8_t  sweep;           /* ostatni kanał przemiatania (0 = start) */
+    uint8_t  known_rr;        /* ostatni znany kanał (round-robin) */
+    uint32_t slot;
+} roam_scan_t;
+
+static inline int roam_cand_rssi(const roam_cand_t *c)
+{
+    return c->rssi_q4 / 16;
+}
+
+/**
+ * Record one observation. A new BSSID replaces a free or the oldest
+ * entry. Returns the entry.
+ */
+roam_cand_t *roam_table_update(roam_table_t *t, const uint8_t bssid[6],
+                               uint8_t channel, int8_t rssi, uint32_t now_ms);
+
+roam_cand_t *roam_table_find(roam_table_t *t, const uint8_t bssid[6]);
+
+/**
+ * Strongest entry seen within max_age_ms, skipping the BSSIDs in
+ * exclude (n entries, e.g. the current upstream and our own AP).
+ */
+const roam_cand_t *roam_table_best(const roam_table_t *t, uint32_t now_ms,
+                                   uint32_t max_age_ms,
+                                   const uint8_t (*exclude)[6], int n);
+
+/**
+ * Add a BSSID/channel hint without an RSSI measurement (802.11k
+ * neighbor report). An existing entry only gets the channel updated.
+ * A hint takes a free slot or replaces another hint or an entry not
+ * seen within max_age_ms, never a fresh measured candidate.
+ */
+void roam_table_hint(roam_table_t *t, const uint8_t bssid[6], uint8_t channel,
+                     uint32_t now_ms, uint32_t max_age_ms);
+
+/* Forget a BSSID (e.g. after a failed roam to it). */
+void roam_table_forget(roam_table_t *t, const uint8_t bssid[6]);
+
+/**
+ * Channel to probe in the next slot, 1..nchan. Channels holding an
+ * entry fresher than max_age_ms get every other slot.
+ */
+uint8_t roam_scan_next_channel(roam_scan_t *s, const roam_table_t *t,
+                               uint8_t nchan, uint32_t now_ms, uint32_t max_age_ms);
+
+/* Pole elementu Neighbor Report (IEEE 802.11-2016 9.4.2.37) */
+typedef struct {
+    uint8_t  bssid[6];
+    uint32_t bssid_info;
+    uint8_t  op_class;
+    uint8_t  channel;
+    uint8_t  phy_type;
+} roam_neighbor_t;
+
+/**
+ * Parse a Neighbor Report response body (a sequence of element ID 52).
+ * Returns the number of entries stored in out (at most max); stops at
+ * the first malformed element.
+ */
+int roam_parse_neighbor_report(const uint8_t *buf, uint16_t len,
+                               roam_neighbor_t *out, int max);
+
+/* Liczniki / stan roamingu dla GET /status */
+typedef struct {
+    uint32_t roams;           /* udane przełączenia */
+    uint32_t roam_fail;
+    uint32_t last_roam_ms;    /* przerwa w łączności ostatniego roamingu */
+    uint32_t neighbor_reports;/* odebrane odpowiedzi 802.11k */
+    uint32_t btm_roams;       /* roaming zlecony przez AP (802.11v BTM) */
+    bool     rrm;             /* obecne połączenie wspiera 802.11k */
+    bool     btm;             /* obecne połączenie wspiera 802.11v BTM */
+} roam_stats_t;
+
+typedef struct {
+    int32_t  level_q8;        /* wygładzony RSSI × 256 (dBm) */
+    int32_t  trend_q8;        /* trend × 256 (dB/s) */
+    uint32_t last_ms;
+    uint32_t samples;
+} roam_est_t;
+
+static inline void roam_est_reset(roam_est_t *e)
+{
+    e->level_q8 = e->trend_q8 = 0;
+    e->last_ms = 0;
+    e->samples = 0;
+}
+
+/* One RSSI sample of the current AP. */
+void roam_est_update(roam_est_t *e, int8_t rssi, uint32_t now_ms);
+
+/* Smoothed RSSI (dBm). */
+int roam_est_rssi(const roam_est_t *e);
+
+/* Trend in tenths of dB per second (negative = getting worse). */
+int roam_est_slope_x10(const roam_est_t *e);
+
+/**
+ * RSSI expected horizon_ms from now (level + trend). Without enough
+ * samples for a stable trend this is the smoothed RSSI.
+ */
+int roam_est_predict(const roam_est_t *e, uint32_t horizon_ms);
+
+/**
+ * Rough PHY rate (kbit/s) reachable at rssi: 1×1 HT20 MCS ladder with
+ * typical receiver sensitivity, 0 below the lowest usable level.
+ */
+uint32_t roam_rate_kbps(int rssi);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,97 @@
+/*
+ * repeater_rxbuf.c — RX buffer ownership + pooled wrapper
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_private/wifi.h"
+#include "repeater_rxbuf.h"
+
+static const char *TAG = "rxbuf";
+
+#define POOL_WORDS  ((RXBUF_POOL_SIZE + 31) / 32)
+
+static rxbuf_t       s_pool[RXBUF_POOL_SIZE];
+static uint32_t      s_used[POOL_WORDS];   /* bit = wrapper zajęty (0 = wolny po starcie) */
+static rxbuf_stats_t s_stats;
+/* Wrap/release wołają callback WiFi i taski bridge'a */
+static portMUX_TYPE  s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+rxbuf_t *rxbuf_wrap(void *buffer, uint16_t len, void *eb, esp_netif_t *sink)
+{
+    rxbuf_t *rb = NULL;
+
+    portENTER_CRITICAL(&s_lock);
+    for (int w = 0; w < POOL_WORDS && !rb; w++) {
+        if (s_used[w] == UINT32_MAX) continue;
+        int i = w * 32 + __builtin_ctz(~s_used[w]);
+        if (i >= RXBUF_POOL_SIZE) break;
+        s_used[w] |= 1u << (i % 32);
+        rb = &s_pool[i];
+    }
+    if (rb) {
+        s_stats.wrapped++;
+        if (++s_stats.live > s_stats.live_peak) s_stats.live_peak = s_stats.live;
+    } else {
+        s_stats.pool_empty++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (rb) {
+        rb->buffer = buffer;
+        rb->eb     = eb;
+        rb->sink   = sink;
+        rb->len    = len;
+        rb->held   = true;
+    }
+    return rb;
+}
+
+void rxbuf_release(rxbuf_t *rb)
+{
+#if CONFIG_REPEATER_RXBUF_DEBUG
+    portENTER_CRITICAL(&s_lock);
+    bool held = rb->held;
+    rb->held = false;
+    portEXIT_CRITICAL(&s_lock);
+    if (!held) {
+        ESP_LOGE(TAG, "double release of buffer %p (eb %p)", rb, rb->eb);
+        abort();
+    }
+#endif
+
+    /* Kopia pól przed zwrotem do puli — wrapper zaraz może dostać inny bufor */
+    rxbuf_t f = *rb;
+#if CONFIG_REPEATER_RXBUF_DEBUG
+    memset(rb, 0, sizeof(*rb));
+#endif
+
+    portENTER_CRITICAL(&s_lock);
+    int i = rb - s_pool;
+    s_used[i / 32] &= ~(1u << (i % 32));
+    s_stats.live--;
+    if (f.sink) s_stats.to_stack++;
+    else        s_stats.freed++;
+    portEXIT_CRITICAL(&s_lock);
+
+    if (f.sink) {
+        esp_netif_receive(f.sink, f.buffer, f.len, f.eb);
+    } else {
+        esp_wifi_internal_free_rx_buffer(f.eb);
+    }
+}
+
+void rxbuf_get_stats(rxbuf_stats_t *out)
+{
+    portENTER_CRITICAL(&s_lock);
+    *out = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void rxbuf_reset_peak(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_stats.live_peak = s_stats.live;
+    portEXIT_CRITICAL(&s_lock);
+}
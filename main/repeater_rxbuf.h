@@ -0,0 +1,78 @@
+/*
+ * repeater_rxbuf.h — RX buffer ownership + pooled wrapper
+ *
+ * Bufor RX od drivera (eb) ma w każdej chwili dokładnie jednego
+ * właściciela, który kończy jego życie DOKŁADNIE jednym z wywołań:
+ *   esp_wifi_internal_free_rx_buffer(eb)   — koniec
+ *   esp_netif_receive(netif, buf, len, eb) — lwIP przejmuje i sam zwolni
+ *   bridge_ring_push()                     — przejmuje bridge task
+ *   rxbuf_wrap()                           — przejmuje wrapper (poniżej)
+ * Po przekazaniu caller nie dotyka już ani buffer, ani eb.
+ *
+ * esp_wifi_internal_tx() bufora NIE przejmuje — driver kopiuje ramkę do
+ * DYNAMIC_TX_BUFFER i wraca. Ta kopia jest jedyną na ścieżce bridge'a,
+ * więc jedna odebrana ramka może pójść do TX (także kilka razy, np. po
+ * podmianie dst MAC) i do lwIP bez żadnego memcpy — pod warunkiem, że
+ * lwIP dostaje ją OSTATNI (po esp_netif_receive bufor może zniknąć).
+ *
+ * Wrapper trzyma ramkę, która musi przeżyć callback (kolejka retry TX).
+ * Jeden właściciel wystarcza: wpis kolejki to jedyny użytkownik TX,
+ * a fan-out (TX + lwIP) dzieje się synchronicznie w callbacku, więc
+ * refcount nie miałby czego liczyć. rxbuf_release() oddaje ramkę do
+ * "sink" (esp_netif_receive) albo zwalnia eb. Wrappery pochodzą z małej
+ * statycznej puli — bez malloc w hot path.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "esp_netif.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Na ścieżkę: pełna kolejka retry + nowa ramka przed eviction + ramka
+ * zdjęta przez drain (wraca przez push_front) */
+#ifdef CONFIG_REPEATER_TXQ_DEPTH
+#define RXBUF_POOL_SIZE  (2 * (CONFIG_REPEATER_TXQ_DEPTH + 2))
+#else
+#define RXBUF_POOL_SIZE  1     /* bez kolejki retry nikt nie owija */
+#endif
+
+typedef struct rxbuf {
+    void        *buffer;
+    void        *eb;
+    esp_netif_t *sink;    /* po release: esp_netif_receive(), NULL = free */
+    uint16_t     len;
+    bool         held;
+} rxbuf_t;
+
+typedef struct {
+    uint32_t wrapped;     /* rxbuf_wrap() udane */
+    uint32_t pool_empty;  /* rxbuf_wrap() bez wolnego wrappera */
+    uint32_t to_stack;    /* release → esp_netif_receive */
+    uint32_t freed;       /* release → free */
+    uint32_t live;        /* wrappery w użyciu */
+    uint32_t live_peak;
+} rxbuf_stats_t;
+
+/**
+ * Take ownership of eb. sink = netif that gets the frame once the TX
+ * user is done, or NULL to free it. Returns NULL when the pool is
+ * empty (ownership stays with the caller).
+ */
+rxbuf_t *rxbuf_wrap(void *buffer, uint16_t len, void *eb, esp_netif_t *sink);
+
+/* Done with the frame: deliver to sink or free eb, return the wrapper. */
+void rxbuf_release(rxbuf_t *rb);
+
+void rxbuf_get_stats(rxbuf_stats_t *out);
+
+/* Restart live_peak from the current use (GET/POST /mem calibration). */
+void rxbuf_reset_peak(void);
+
+#ifdef __cplusplus
+}
+#endif
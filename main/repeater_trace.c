@@ -0,0 +1,128 @@
+/*
+ * repeater_trace.c — Boot / handover event trace
+ */
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
+#include "repeater_trace.h"
+
+#ifndef CONFIG_REPEATER_TRACE_ENTRIES
+#define CONFIG_REPEATER_TRACE_ENTRIES  128
+#endif
+
+#define TRACE_BOOT_ENTRIES  32    /* nienadpisywany początek: power-on → pierwszy klient */
+
+const trace_ev_info_t TRACE_EV_INFO[TRACE_EV_MAX] = {
+    [TRACE_BOOT]               = { "boot",              'i', TRACE_TRACK_EVENTS },
+    [TRACE_NVS_READY]          = { "nvs_ready",         'i', TRACE_TRACK_EVENTS },
+    [TRACE_CONFIG_LOADED]      = { "config_loaded",     'i', TRACE_TRACK_EVENTS },
+    [TRACE_WIFI_INIT_BEGIN]    = { "init_wifi",         'B', TRACE_TRACK_EVENTS },
+    [TRACE_WIFI_INIT_END]      = { "init_wifi",         'E', TRACE_TRACK_EVENTS },
+    [TRACE_WIFI_STARTED]       = { "wifi_started",      'i', TRACE_TRACK_EVENTS },
+    [TRACE_HTTPD_STARTED]      = { "httpd_started",     'i', TRACE_TRACK_EVENTS },
+    [TRACE_STA_START]          = { "sta_start",         'i', TRACE_TRACK_EVENTS },
+    [TRACE_STA_CONNECTED]      = { "sta_connected",     'i', TRACE_TRACK_EVENTS },
+    [TRACE_STA_DISCONNECTED]   = { "sta_disconnected",  'i', TRACE_TRACK_EVENTS },
+    [TRACE_STA_GOT_IP]         = { "sta_got_ip",        'i', TRACE_TRACK_EVENTS },
+    [TRACE_AP_START]           = { "ap_start",          'i', TRACE_TRACK_EVENTS },
+    [TRACE_AP_STACONNECTED]    = { "client_joined",     'i', TRACE_TRACK_EVENTS },
+    [TRACE_AP_STADISCONNECTED] = { "client_left",       'i', TRACE_TRACK_EVENTS },
+    [TRACE_BSS_TRANSITION]     = { "bss_transition",    'i', TRACE_TRACK_EVENTS },
+    [TRACE_FWD_START]          = { "forwarding_start",  'i', TRACE_TRACK_EVENTS },
+    [TRACE_FWD_STOP]           = { "forwarding_stop",   'i', TRACE_TRACK_EVENTS },
+    [TRACE_FIRST_FRAME]        = { "first_frame",       'i', TRACE_TRACK_EVENTS },
+    [TRACE_MAC_CLONE_BEGIN]    = { "mac_clone",         'B', TRACE_TRACK_MAC },
+    [TRACE_MAC_STA_DOWN]       = { "sta_down",          'i', TRACE_TRACK_MAC },
+    [TRACE_MAC_SET]            = { "set_mac",           'i', TRACE_TRACK_MAC },
+    [TRACE_MAC_CONNECT]        = { "connect",           'i', TRACE_TRACK_MAC },
+    [TRACE_MAC_CLONE_END]      = { "mac_clone",         'E', TRACE_TRACK_MAC },
+    [TRACE_MAC_RESTORE_BEGIN]  = { "mac_restore",       'B', TRACE_TRACK_MAC },
+    [TRACE_MAC_RESTORE_END]    = { "mac_restore",       'E', TRACE_TRACK_MAC },
+    [TRACE_CLONE_GRACE_BEGIN]  = { "clone_grace",       'B', TRACE_TRACK_MAC },
+    [TRACE_CLONE_GRACE_END]    = { "clone_grace",       'E', TRACE_TRACK_MAC },
+    [TRACE_ROAM_PROBE_BEGIN]   = { "probe",             'B', TRACE_TRACK_ROAM },
+    [TRACE_ROAM_PROBE_END]     = { "probe",             'E', TRACE_TRACK_ROAM },
+    [TRACE_ROAM_SWITCH_BEGIN]  = { "roam",              'B', TRACE_TRACK_ROAM },
+    [TRACE_ROAM_SWITCH_END]    = { "roam",              'E', TRACE_TRACK_ROAM },
+    [TRACE_ROAM_NEIGHBORS]     = { "neighbor_report",   'i', TRACE_TRACK_ROAM },
+};
+
+const char *const TRACE_TRACK_NAME[TRACE_TRACK_MAX] = {
+    "events", "mac_change_task", "roaming_task",
+};
+
+#if CONFIG_REPEATER_TRACE
+
+#if CONFIG_REPEATER_TRACE_ENTRIES > TRACE_BOOT_ENTRIES
+#define BOOT_N  TRACE_BOOT_ENTRIES
+#else
+#define BOOT_N  (CONFIG_REPEATER_TRACE_ENTRIES / 2)
+#endif
+#define RING_N  (CONFIG_REPEATER_TRACE_ENTRIES - BOOT_N)
+
+static trace_entry_t s_trace[CONFIG_REPEATER_TRACE_ENTRIES];
+static uint32_t s_total;          /* wszystkie zapisane od startu */
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+volatile bool s_trace_first_armed;
+
+void repeater_trace_record(trace_ev_t ev, uint32_t arg)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_lock);
+    uint32_t n = s_total++;
+    trace_entry_t *e = n < BOOT_N ? &s_trace[n]
+                                  : &s_trace[BOOT_N + (n - BOOT_N) % RING_N];
+    e->ts_us = now;
+    e->arg   = arg;
+    e->ev    = (uint16_t)ev;
+    e->core  = (uint8_t)esp_cpu_get_core_id();
+    portEXIT_CRITICAL(&s_lock);
+
+    if (ev == TRACE_FWD_START) s_trace_first_armed = true;
+}
+
+int repeater_trace_snapshot(trace_entry_t *out, int max, uint32_t *overwritten)
+{
+    int k = 0;
+    portENTER_CRITICAL(&s_lock);
+    uint32_t total = s_total;
+    uint32_t boot  = total < BOOT_N ? total : BOOT_N;
+    for (uint32_t i = 0; i < boot && k < max; i++) {
+        out[k++] = s_trace[i];
+    }
+    if (total > BOOT_N) {
+        uint32_t in_ring = total - BOOT_N;
+        uint32_t first   = in_ring > RING_N ? in_ring - RING_N : 0;
+        for (uint32_t i = first; i < in_ring && k < max; i++) {
+            out[k++] = s_trace[BOOT_N + i % RING_N];
+        }
+        if (overwritten) *overwritten = first;
+    } else if (overwritten) {
+        *overwritten = 0;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return k;
+}
+
+int repeater_trace_capacity(void)
+{
+    return CONFIG_REPEATER_TRACE_ENTRIES;
+}
+
+#else /* !CONFIG_REPEATER_TRACE */
+
+int repeater_trace_snapshot(trace_entry_t *out, int max, uint32_t *overwritten)
+{
+    (void)out; (void)max;
+    if (overwritten) *overwritten = 0;
+    return 0;
+}
+
+int repeater_trace_capacity(void)
+{
+    return 0;
+}
+
+#endif
@@ -0,0 +1,122 @@
+/*
+ * repeater_trace.h — Boot / handover event trace (GET /trace)
+ *
+ * Ring stałego rozmiaru z wpisami (czas µs od startu, zdarzenie, arg).
+ * Kamienie milowe app_main/init_wifi, eventy WiFi/IP, kroki
+ * mac_change_task i scany/przełączenia roaming_task — zamiast odtwarzać
+ * czasy z logów widać dokładnie, gdzie idą sekundy między power-on,
+ * STA connected, dołączeniem klienta i pierwszą zbridgowaną ramką.
+ *
+ * Pierwsze TRACE_BOOT_ENTRIES wpisów nie są nadpisywane (start
+ * urządzenia zostaje w buforze), reszta to ring — nowe nadpisują
+ * najstarsze. Zdarzenia *_BEGIN / *_END są parami (span w Chrome trace).
+ *
+ * Zapis pod spinlockiem — wołane z tasków i callbacków WiFi, nie z ISR.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    /* Start */
+    TRACE_BOOT = 0,           /* app_main */
+    TRACE_NVS_READY,
+    TRACE_CONFIG_LOADED,
+    TRACE_WIFI_INIT_BEGIN,
+    TRACE_WIFI_INIT_END,
+    TRACE_WIFI_STARTED,       /* esp_wifi_start() wrócił */
+    TRACE_HTTPD_STARTED,
+    /* Eventy WiFi / IP */
+    TRACE_STA_START,
+    TRACE_STA_CONNECTED,      /* arg = kanał */
+    TRACE_STA_DISCONNECTED,   /* arg = reason */
+    TRACE_STA_GOT_IP,         /* arg = IPv4 (network order) */
+    TRACE_AP_START,
+    TRACE_AP_STACONNECTED,    /* arg = AID */
+    TRACE_AP_STADISCONNECTED, /* arg = AID */
+    TRACE_BSS_TRANSITION,     /* arg = kanał nowego AP */
+    /* Forwarding */
+    TRACE_FWD_START,
+    TRACE_FWD_STOP,
+    TRACE_FIRST_FRAME,        /* pierwsza ramka po FWD_START, arg = ścieżka */
+    /* mac_change_task */
+    TRACE_MAC_CLONE_BEGIN,
+    TRACE_MAC_STA_DOWN,       /* disconnect potwierdzony */
+    TRACE_MAC_SET,            /* arg = esp_err_t esp_wifi_set_mac */
+    TRACE_MAC_CONNECT,        /* arg = 1 fast path, 0 scan */
+    TRACE_MAC_CLONE_END,      /* arg = 1 bridge aktywny */
+    TRACE_MAC_RESTORE_BEGIN,
+    TRACE_MAC_RESTORE_END,    /* arg = 1 połączony */
+    TRACE_CLONE_GRACE_BEGIN,  /* sklonowany klient odszedł, arg = pozostali klienci */
+    TRACE_CLONE_GRACE_END,    /* arg = powód (GRACE_END_* w wifi_repeater_main.c) */
+    /* roaming_task */
+    TRACE_ROAM_PROBE_BEGIN,   /* arg = kanał */
+    TRACE_ROAM_PROBE_END,     /* arg = liczba AP */
+    TRACE_ROAM_SWITCH_BEGIN,  /* arg = kanał kandydata */
+    TRACE_ROAM_SWITCH_END,    /* arg = 1 sukces */
+    TRACE_ROAM_NEIGHBORS,     /* arg = wpisy neighbor reportu */
+    TRACE_EV_MAX,
+} trace_ev_t;
+
+typedef struct {
+    int64_t  ts_us;           /* esp_timer_get_time() */
+    uint32_t arg;
+    uint16_t ev;              /* trace_ev_t */
+    uint8_t  core;
+} trace_entry_t;
+
+/* Nazwa, faza Chrome trace ('i', 'B', 'E') i tor (tid) zdarzenia */
+typedef struct {
+    const char *name;
+    char        ph;
+    uint8_t     track;
+} trace_ev_info_t;
+
+enum { TRACE_TRACK_EVENTS = 0, TRACE_TRACK_MAC, TRACE_TRACK_ROAM, TRACE_TRACK_MAX };
+
+extern const trace_ev_info_t TRACE_EV_INFO[TRACE_EV_MAX];
+extern const char *const TRACE_TRACK_NAME[TRACE_TRACK_MAX];
+
+#if CONFIG_REPEATER_TRACE
+
+void repeater_trace_record(trace_ev_t ev, uint32_t arg);
+
+#define TRACE_EV(ev, arg)   repeater_trace_record((ev), (uint32_t)(arg))
+
+/* Uzbrajane przez TRACE_FWD_START; hot path sprawdza tylko flagę */
+extern volatile bool s_trace_first_armed;
+
+static inline void repeater_trace_first_frame(uint32_t path)
+{
+    if (__builtin_expect(s_trace_first_armed, 0)) {
+        s_trace_first_armed = false;
+        repeater_trace_record(TRACE_FIRST_FRAME, path);
+    }
+}
+
+#else /* !CONFIG_REPEATER_TRACE */
+
+#define TRACE_EV(ev, arg)   ((void)0)
+static inline void repeater_trace_first_frame(uint32_t path) { (void)path; }
+
+#endif
+
+/**
+ * Copy up to max entries in chronological order (boot entries first,
+ * then the ring from oldest). *overwritten gets the number of ring
+ * entries lost since boot. Returns the number copied (0 when disabled).
+ */
+int repeater_trace_snapshot(trace_entry_t *out, int max, uint32_t *overwritten);
+
+/* Capacity of the buffer (0 when disabled). */
+int repeater_trace_capacity(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,185 @@
+/*
+ * repeater_txq.c — Per-direction TX retry queue (backpressure)
+ */
+#include <string.h>
+#include "repeater_txq.h"
+
+static inline uint8_t slot_of(const txq_t *q, uint8_t i)
+{
+    return (q->head + i) % TXQ_DEPTH;
+}
+
+/* Usuń i-ty (od głowy) wpis, zachowując kolejność pozostałych */
+static void remove_at(txq_t *q, uint8_t i, txq_entry_t *out)
+{
+    *out = q->slot[slot_of(q, i)];
+    for (; i + 1 < q->count; i++) {
+        q->slot[slot_of(q, i)] = q->slot[slot_of(q, i + 1)];
+    }
+    q->count--;
+}
+
+/* Wstaw e na pozycję pos (od głowy), przesuwając dalsze wpisy */
+static void insert_at(txq_t *q, uint8_t pos, const txq_entry_t *e)
+{
+    for (uint8_t i = q->count; i > pos; i--) {
+        q->slot[slot_of(q, i)] = q->slot[slot_of(q, i - 1)];
+    }
+    q->slot[slot_of(q, pos)] = *e;
+    if (++q->count > q->peak) q->peak = q->count;
+}
+
+/* Pierwszy wpis TXQ_PRIO_BULK (count, gdy brak) */
+static uint8_t first_bulk(const txq_t *q)
+{
+    uint8_t i = 0;
+    while (i < q->count && q->slot[slot_of(q, i)].prio != TXQ_PRIO_BULK) i++;
+    return i;
+}
+
+/* Liczba ramek bulk klucza i pozycja najnowszej z nich */
+static uint8_t bulk_backlog(const txq_t *q, uint8_t client, uint8_t *newest)
+{
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < q->count; i++) {
+        const txq_entry_t *e = &q->slot[slot_of(q, i)];
+        if (e->prio == TXQ_PRIO_BULK && e->client == client) {
+            n++;
+            *newest = i;
+        }
+    }
+    return n;
+}
+
+/* DRR: klient z najdłuższą kolejką bulk oddaje najnowszą ramkę, jeśli
+ * ma ich więcej niż klient e. false = brak takiego (decyduje polityka). */
+static bool drr_evict_longest(txq_t *q, const txq_entry_t *e, txq_entry_t *victim)
+{
+    uint8_t pos = 0, own_pos;
+    uint8_t own = bulk_backlog(q, e->client, &own_pos);
+    uint8_t longest = own;
+    for (uint8_t k = 0; k < TXQ_DRR_KEYS; k++) {
+        uint8_t p;
+        uint8_t n = k == e->client ? 0 : bulk_backlog(q, k, &p);
+        if (n > longest) {
+            longest = n;
+            pos = p;
+        }
+    }
+    if (longest == own) return false;
+    remove_at(q, pos, victim);
+    return true;
+}
+
+/* Pełna kolejka → zrób miejsce wg polityki (albo odrzuć e) */
+static txq_result_t make_room(txq_t *q, const txq_entry_t *e, txq_policy_t policy,
+                              txq_entry_t *victim)
+{
+    if (q->count < TXQ_DEPTH) return TXQ_QUEUED;
+    if (q->drr && e->prio == TXQ_PRIO_BULK && drr_evict_longest(q, e, victim)) {
+        return TXQ_EVICTED_BULK;
+    }
+
+    switch (policy) {
+    case TXQ_POLICY_DROP_OLDEST:
+        remove_at(q, 0, victim);
+        return TXQ_EVICTED_OLDEST;
+    case TXQ_POLICY_PRIORITY: {
+        if (e->prio == TXQ_PRIO_BULK) return TXQ_REJECTED;
+        uint8_t i = first_bulk(q);
+        if (i < q->count) {
+            remove_at(q, i, victim);
+            return TXQ_EVICTED_BULK;
+        }
+        /* Same ramki HIGH — świeższy ACK jest cenniejszy od starego */
+        remove_at(q, 0, victim);
+        return TXQ_EVICTED_OLDEST;
+    }
+    case TXQ_POLICY_TAIL_DROP:
+    default:
+        return TXQ_REJECTED;
+    }
+}
+
+txq_result_t txq_push(txq_t *q, const txq_entry_t *e, txq_policy_t policy,
+                      txq_entry_t *victim)
+{
+    txq_result_t r = make_room(q, e, policy, victim);
+    if (r != TXQ_REJECTED) insert_at(q, q->count, e);
+    return r;
+}
+
+txq_result_t txq_push_ahead(txq_t *q, const txq_entry_t *e, txq_policy_t policy,
+                            txq_entry_t *victim)
+{
+    txq_result_t r = make_room(q, e, policy, victim);
+    if (r != TXQ_REJECTED) insert_at(q, first_bulk(q), e);
+    return r;
+}
+
+bool txq_merge_ack(txq_t *q, const txq_entry_t *e, txq_entry_t *victim)
+{
+    for (uint8_t i = 0; i < q->count; i++) {
+        txq_entry_t *old = &q->slot[slot_of(q, i)];
+        /* Tylko ściśle nowszy ACK — duplikaty (ten sam numer) sygnalizują
+         * stratę nadawcy (fast retransmit) i muszą dojść wszystkie */
+        if (old->merge_ack &&
+            memcmp(&old->flow, &e->flow, sizeof(e->flow)) == 0 &&
+            (int32_t)(e->ack - old->ack) > 0) {
+            *victim = *old;
+            *old = *e;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool txq_push_front(txq_t *q, const txq_entry_t *e)
+{
+    if (q->count >= TXQ_DEPTH) return false;
+    /* Nieudana próba — zwróć deficyt pobrany przez txq_pop */
+    if (q->drr && e->prio == TXQ_PRIO_BULK) q->deficit[e->client] += e->len;
+    q->head = (q->head + TXQ_DEPTH - 1) % TXQ_DEPTH;
+    q->slot[q->head] = *e;
+    if (++q->count > q->peak) q->peak = q->count;
+    return true;
+}
+
+/* Następny wpis wg DRR: HIGH od razu, bulk po deficycie klucza */
+static void pop_drr(txq_t *q, txq_entry_t *out)
+{
+    uint8_t i = 0;
+    while (i < q->count && q->slot[slot_of(q, i)].prio == TXQ_PRIO_BULK) i++;
+    if (i < q->count) {
+        remove_at(q, i, out);
+        return;
+    }
+    /* Same bulk — pętla kończy się, bo kolejka nie jest pusta */
+    for (;;) {
+        uint8_t cur = q->drr_cur;
+        for (i = 0; i < q->count && q->slot[slot_of(q, i)].client != cur; i++) {
+        }
+        if (i == q->count) {
+            q->deficit[cur] = 0;          /* bez ramek kredyt nie rośnie */
+        } else if (q->deficit[cur] >= q->slot[slot_of(q, i)].len) {
+            q->deficit[cur] -= q->slot[slot_of(q, i)].len;
+            remove_at(q, i, out);
+            return;
+        }
+        q->drr_cur = (cur + 1) % TXQ_DRR_KEYS;
+        q->deficit[q->drr_cur] += TXQ_DRR_QUANTUM;
+    }
+}
+
+bool txq_pop(txq_t *q, txq_entry_t *out)
+{
+    if (q->count == 0) return false;
+    if (q->drr) {
+        pop_drr(q, out);
+        return true;
+    }
+    *out = q->slot[q->head];
+    q->head = (q->head + 1) % TXQ_DEPTH;
+    q->count--;
+    return true;
+}
@@ -0,0 +1,120 @@
+/*
+ * repeater_txq.h — Per-direction TX retry queue (backpressure)
+ *
+ * Gdy esp_wifi_internal_tx() odmawia (brak DYNAMIC_TX_BUFFER), ramka
+ * zamiast przepaść trafia tutaj i czeka na kolejną próbę (następne RX
+ * tej ścieżki albo sygnał TX-done). Kolejka trzyma bufor RX (eb), więc
+ * jest krótka — przepełnienie rozstrzyga polityka:
+ *   TAIL_DROP   — nowa ramka odrzucona
+ *   DROP_OLDEST — najstarsza ramka eksmitowana
+ *   PRIORITY    — ramki TXQ_PRIO_HIGH (TCP pure ACK, ARP, DHCP) eksmitują
+ *                 najstarszą ramkę TXQ_PRIO_BULK; bulk przy pełnej
+ *                 kolejce jest odrzucany
+ *
+ * Pure ACK-i mogą wejść przed bulk (txq_push_ahead) i zastąpić starszy,
+ * wciąż czekający ACK tego samego flow (txq_merge_ack) — ACK kumulatywny
+ * niesie wszystko, co niósł poprzedni.
+ *
+ * Z drr = true kolejka jest sprawiedliwa między klientami (klucz
+ * txq_entry_t.client): ramki HIGH wychodzą pierwsze, bulk w deficit
+ * round-robin (kwant TXQ_DRR_QUANTUM bajtów na wizytę), a przy pełnej
+ * kolejce miejsce oddaje klient z najdłuższą kolejką bulk (jego
+ * najnowsza ramka) — jeden ciężki odbiorca nie wypycha pozostałych.
+ *
+ * Czyste C (bez ESP-IDF) — synchronizację i zwalnianie ramek (rxbuf)
+ * robi caller.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "repeater_pkt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef CONFIG_REPEATER_TXQ_DEPTH
+#define TXQ_DEPTH  CONFIG_REPEATER_TXQ_DEPTH
+#else
+#define TXQ_DEPTH  8
+#endif
+
+#define TXQ_DRR_KEYS      16      /* klucze klientów; ostatni = ruch bez klienta */
+#define TXQ_NO_CLIENT     (TXQ_DRR_KEYS - 1)
+#define TXQ_DRR_QUANTUM   1536    /* ≥ największej ramki: wizyta = min. 1 ramka */
+
+typedef enum {
+    TXQ_POLICY_TAIL_DROP = 0,
+    TXQ_POLICY_DROP_OLDEST,
+    TXQ_POLICY_PRIORITY,
+} txq_policy_t;
+
+typedef enum {
+    TXQ_PRIO_BULK = 0,
+    TXQ_PRIO_HIGH,            /* TCP pure ACK, ARP, DHCP */
+} txq_prio_t;
+
+struct rxbuf;                 /* repeater_rxbuf.h */
+
+typedef struct {
+    struct rxbuf *rb;         /* ramka (właściciel bufora RX) */
+    uint32_t stamp;           /* tick kolejkowania (limit wieku) */
+    uint8_t  prio;            /* txq_prio_t */
+    uint8_t  client;          /* klucz DRR (< TXQ_DRR_KEYS) */
+    uint16_t len;             /* długość ramki (deficyt DRR) */
+    bool     merge_ack;       /* pure ACK bez SACK — flow/ack poniżej ważne */
+    uint32_t ack;             /* numer ACK (host order) */
+    pkt_flow4_t flow;
+} txq_entry_t;
+
+typedef struct {
+    txq_entry_t slot[TXQ_DEPTH];
+    uint8_t     head;
+    uint8_t     count;
+    uint8_t     peak;         /* max zajętość (diagnostyka, /mem) */
+    bool        drr;          /* sprawiedliwie między klientami (patrz wyżej) */
+    uint8_t     drr_cur;      /* klucz obsługiwany w tej rundzie */
+    int32_t     deficit[TXQ_DRR_KEYS];
+} txq_t;
+
+typedef enum {
+    TXQ_QUEUED = 0,           /* przyjęta, nic nie wypadło */
+    TXQ_REJECTED,             /* nowa ramka odrzucona (caller zwalnia ją) */
+    TXQ_EVICTED_OLDEST,       /* przyjęta, *victim = najstarsza ramka */
+    TXQ_EVICTED_BULK,         /* przyjęta, *victim = najstarsza ramka bulk */
+} txq_result_t;
+
+static inline bool txq_empty(const txq_t *q)
+{
+    return __atomic_load_n(&q->count, __ATOMIC_RELAXED) == 0;
+}
+
+/**
+ * Append e. When full, applies the policy; an evicted entry is copied
+ * to *victim and the caller must release its frame.
+ */
+txq_result_t txq_push(txq_t *q, const txq_entry_t *e, txq_policy_t policy,
+                      txq_entry_t *victim);
+
+/* Like txq_push, but insert ahead of the first TXQ_PRIO_BULK entry. */
+txq_result_t txq_push_ahead(txq_t *q, const txq_entry_t *e, txq_policy_t policy,
+                            txq_entry_t *victim);
+
+/**
+ * Replace a queued merge_ack entry of the same flow with an older ack
+ * number by e (in place, keeping its position). The replaced entry is
+ * copied to *victim. Returns false when there is nothing to merge with.
+ */
+bool txq_merge_ack(txq_t *q, const txq_entry_t *e, txq_entry_t *victim);
+
+/* Put e back at the head (retry failed). Returns false when full. */
+bool txq_push_front(txq_t *q, const txq_entry_t *e);
+
+/* Take the head entry (drr: the next entry in DRR order). Returns false when empty. */
+bool txq_pop(txq_t *q, txq_entry_t *out);
+
+#ifdef __cplusplus
+}
+#endif
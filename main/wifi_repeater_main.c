@@ -29,7 +29,14 @@
  *
  * Ograniczenie: w trybie MAC cloning obsługujemy jednego klienta
  * (bo STA może mieć tylko jeden MAC). Dla wielu klientów potrzebny
- * byłby WDS/4-addr mode, którego ESP32 nie wspiera.
+ * byłby WDS/4-addr mode, którego ESP32 nie wspiera — dodatkowi klienci
+ * idą przez MAC-NAT (patrz sekcja MAC-NAT).
+ *
+ * Tryb MAC-NAT (bridge_mode = REPEATER_BRIDGE_MACNAT):
+ *   STA zostaje przy stałym MAC (fabrycznym albo skonfigurowanym) i
+ *   własnym DHCP, a WSZYSCY klienci idą przez MAC-NAT. Wejście i
+ *   wyjście klienta tylko włącza / wyłącza forwarding — bez zmiany
+ *   MAC i reconnectu STA, więc pozostali klienci nie tracą łącza.
  */
 
 #include <stdio.h>
@@ -47,10 +54,32 @@
 #include "esp_netif.h"
 #include "esp_timer.h"
 #include "nvs_flash.h"
+#include "esp_rom_crc.h"
 #include "sdkconfig.h"
 #include "lwip/inet.h"
 #include "repeater_config.h"
 #include "repeater_httpd.h"
+#include "repeater_metrics.h"
+#include "repeater_macnat.h"
+#include "repeater_pkt.h"
+#include "repeater_frame.h"
+#include "repeater_ring.h"
+#include "repeater_txq.h"
+#include "repeater_rxbuf.h"
+#include "repeater_mcast.h"
+#include "repeater_arp.h"
+#include "repeater_clients.h"
+#include "repeater_qos.h"
+#include "repeater_ps.h"
+#include "repeater_roam.h"
+#include "repeater_trace.h"
+#include "repeater_radio.h"
+#include "repeater_bench.h"
+#include "repeater_mem.h"
+#if CONFIG_REPEATER_ROAM_ASSISTED
+#include "esp_rrm.h"
+#include "esp_wnm.h"
+#endif
 
 static const char *TAG = "wifi6_rep";
 
@@ -59,13 +88,20 @@ static const char *TAG = "wifi6_rep";
 #define STA_DISCONNECTED_BIT BIT1
 static EventGroupHandle_t s_wifi_event_group;
 
+#define RADIO_AB_SETTLE_MS  1500   /* po reconnect, przed pomiarem łącza (A/B) */
+
 /* ── MAC adresy ─────────────────────────────────────────────── */
 static uint8_t s_original_sta_mac[6];   /* oryginalny MAC STA (fabryczny) */
 static uint8_t s_ap_mac[6];             /* MAC naszego AP */
-static uint8_t s_client_mac[6];         /* MAC aktualnie podłączonego klienta */
+static uint8_t s_client_mac[6];         /* MAC widziany przez router: sklonowany klient / stały MAC (MAC-NAT) */
 static uint8_t s_upstream_bssid[6];      /* BSSID upstream AP do którego się łączymy */
 static uint8_t s_upstream_channel;       /* kanał upstream AP */
 static bool    s_bssid_locked = false;   /* czy mamy zapisany BSSID */
+roam_stats_t   s_roam_stats;             /* roaming / 802.11k/v — GET /status */
+radio_profile_t s_radio_profile = RADIO_PROFILE_AUTO; /* aktywny profil — GET /radio */
+#if CONFIG_REPEATER_FAST_BOOT
+static bool    s_boot_direct = false;    /* trwa connect do upstream zapamiętanego w NVS */
+#endif
 
 /* ── Stan ───────────────────────────────────────────────────── */
 typedef enum {
@@ -85,6 +121,10 @@ static volatile bool s_suppress_auto_reconnect = false;  /* blokuj auto-reconnec
 esp_netif_t *s_sta_netif = NULL;
 static esp_netif_t *s_ap_netif = NULL;
 static int s_client_count = 0;           /* ile klientów podłączonych do AP */
+uint8_t    s_bridge_mode = REPEATER_BRIDGE_CLONE;  /* REPEATER_BRIDGE_* — GET /status */
+/* Od ilu klientów ramki idą przez MAC-NAT: clone → od drugiego
+ * (pierwszy ma sklonowany MAC), MAC-NAT → od pierwszego */
+static int s_macnat_min_clients = 2;
 static bool s_ap_ip_from_sniff = false;  /* AP IP ustawione z DHCP sniffera */
 
 /* Cached IPs for fast hot-path comparison (network byte order).
@@ -107,22 +147,47 @@ static uint32_t s_sta_ip_cache = 0;  /* nasz STA IP (link-local dummy lub DHCP)
 static inline bool is_broadcast_for_us(const uint8_t *frame, uint16_t len,
                                         uint32_t our_ip1, uint32_t our_ip2)
 {
-    /* EtherType at offset 12-13 */
-    uint16_t ethertype = ((uint16_t)frame[12] << 8) | frame[13];
-
-    /* ARP (0x0806) — pass only REQUEST (opcode 1) targeting our IP */
-    if (ethertype == 0x0806 && len >= 42) {
-        uint16_t opcode = ((uint16_t)frame[20] << 8) | frame[21];
-        if (opcode == 1) {  /* ARP REQUEST */
-            uint32_t target_ip;
-            memcpy(&target_ip, frame + 38, 4);  /* ARP target protocol address */
-            if (target_ip == our_ip1 && our_ip1 != 0) return true;
-            if (target_ip == our_ip2 && our_ip2 != 0) return true;
-        }
-    }
-    return false;
+    return frame_bcast_for_us(frame, len, our_ip1, our_ip2);
 }
 
+/* Tablica MAC-NAT (IP→MAC dodatkowych klientów), patrz sekcja MAC-NAT */
+static macnat_table_t s_macnat;
+#if CONFIG_REPEATER_MACNAT_IPV6
+static macnat6_table_t s_macnat6;   /* IPv6 → MAC, ten sam writer co s_macnat */
+#endif
+/* Writerzy MAC-NAT (ścieżka RX: DHCP sniff / upstream, dwa taski przy
+ * dual-core; macnat_clear() z tasku MAC/warm startu) serializowani
+ * spinlockiem w każdej konfiguracji — czytelnicy dalej przez seqlock */
+static portMUX_TYPE s_macnat_lock = portMUX_INITIALIZER_UNLOCKED;
+#define MACNAT_WRITE_LOCK()    portENTER_CRITICAL(&s_macnat_lock)
+#define MACNAT_WRITE_UNLOCK()  portEXIT_CRITICAL(&s_macnat_lock)
+
+#if CONFIG_REPEATER_WARM_START
+/* Warm start (sekcja "Warm start"): stan MAC-NAT/podsieci z NVS czeka na
+ * potwierdzenie pierwszym adresem z ruchu. Non-static: GET /status. */
+enum { WARM_NONE, WARM_PENDING, WARM_CONFIRMED, WARM_DROPPED };
+volatile uint8_t s_warm_state = WARM_NONE;
+uint8_t          s_warm_restored = 0;   /* wpisów MAC-NAT przywróconych przy boocie */
+static void warm_validate(uint32_t ip, const char *what);
+
+/* Slow path: ARP sender IP (klient albo upstream) sprawdza podsieć */
+static void warm_apply_ap_ip(void);
+
+static inline void warm_check_arp(const uint8_t *frame, uint16_t len)
+{
+    if (s_warm_state != WARM_PENDING) return;
+    if (pkt_ethertype(frame) != PKT_ETHERTYPE_ARP || len < PKT_ARP_LEN) return;
+    uint32_t sender_ip;
+    memcpy(&sender_ip, frame + 28, 4);
+    if (sender_ip) warm_validate(sender_ip, "ARP");   /* 0 = ARP probe */
+}
+#else
+static inline void warm_check_arp(const uint8_t *frame, uint16_t len)
+{
+    (void)frame; (void)len;
+}
+#endif
+
 /* Runtime config loaded from NVS (or menuconfig defaults) */
 static repeater_config_t s_cfg;
 
@@ -133,13 +198,485 @@ static SemaphoreHandle_t s_mac_task_mutex;   /* zapobiega równoległym zmianom
 static void ap_mirror_sta_ip(const esp_netif_ip_info_t *sta_ip);
 static void ap_restore_management_ip(void);
 static void sniff_dhcp_ack_and_set_ap_ip(const uint8_t *data, uint16_t len);
-static void macnat_rewrite_upstream(uint8_t *frame, uint16_t len);
+static void macnat_rewrite_upstream(uint8_t *frame, uint16_t len, bool learn);
 static void ap_clone_upstream_ssid(const uint8_t *ssid, uint8_t ssid_len);
 static void roaming_task(void *pv);
-static void macnat_rewrite_downstream(uint8_t *frame, uint16_t len);
+#if CONFIG_REPEATER_ROAM_ASSISTED
+static void roam_on_neighbor_report(const wifi_event_neighbor_report_t *ev);
+#endif
+static bool macnat_rewrite_downstream(uint8_t *frame, uint16_t len);
 static void macnat_learn(uint32_t ip_n, const uint8_t *mac);
 static void request_mac_clone(const uint8_t *client_mac);
 
+/* ══════════════════════════════════════════════════════════════
+ *  TX backpressure
+ *
+ *  esp_wifi_internal_tx() kopiuje ramkę do DYNAMIC_TX_BUFFER; gdy ich
+ *  zabraknie, zwraca błąd i ramka przepada — TCP reaguje na to mocnym
+ *  back-offem. Z CONFIG_REPEATER_TXQ odrzucona ramka czeka w krótkiej
+ *  kolejce per ścieżka
+ *  (repeater_txq.c) i jest ponawiana przy kolejnym RX tej ścieżki albo
+ *  po sygnale TX-done (bridge task). Ramki nie wyprzedzają kolejki;
+ *  zbyt stare (REPEATER_TXQ_MAX_AGE_MS) są odrzucane — spóźniona ramka
+ *  szkodzi grom/VoIP bardziej niż brakująca.
+ * ══════════════════════════════════════════════════════════════ */
+
+/* Ścieżka RX → interfejs, którym ramka wychodzi */
+static inline wifi_interface_t bridge_tx_if(metrics_path_t path)
+{
+    return path == METRICS_PATH_STA_RX ? WIFI_IF_AP : WIFI_IF_STA;
+}
+
+/* Koniec życia ramki bez wrappera (repeater_rxbuf.h): do lwIP albo free */
+static inline void rx_release(void *buffer, uint16_t len, void *eb, esp_netif_t *sink)
+{
+    if (bench_is_frame(eb)) return;   /* ramka loopback benchmarku — nie od drivera */
+    if (sink) {
+        esp_netif_receive(sink, buffer, len, eb);
+    } else {
+        esp_wifi_internal_free_rx_buffer(eb);
+    }
+}
+
+/* esp_wifi_internal_tx() kopiuje ramkę (jedyna kopia na ścieżce bridge'a)
+ * i nie przejmuje bufora — po powrocie buffer/eb wciąż należą do nas */
+static inline bool wifi_tx(metrics_path_t path, void *buffer, uint16_t len)
+{
+    if (esp_wifi_internal_tx(bridge_tx_if(path), buffer, len) != ESP_OK) {
+        METRICS_INC(tx_fail, path);
+        return false;
+    }
+#if CONFIG_REPEATER_RXBUF_DEBUG
+    METRICS_INC(tx_copies, path);
+    METRICS_ADD(tx_copy_bytes, path, len);
+#endif
+    return true;
+}
+
+/* ── MSS clamp: SYN/SYN-ACK obu kierunków ─────────────────── */
+static inline void bridge_mss_clamp(metrics_path_t path, uint8_t *frame, uint16_t len)
+{
+#if CONFIG_REPEATER_MSS_CLAMP
+    if (frame_mss_clamp(frame, len, CONFIG_REPEATER_MSS_CLAMP_VALUE)) {
+        METRICS_INC(mss_clamped, path);
+    }
+#else
+    (void)path; (void)frame; (void)len;
+#endif
+}
+
+/* ── Klienci: liczniki per MAC + limit (repeater_clients.c) ──
+ *  Upstream liczony po src przed przepisaniem MAC-NAT, downstream po
+ *  dst po przepisaniu. control = ramka nigdy nie odrzucana przez limit
+ *  (sterująca albo do GUI). */
+#if CONFIG_REPEATER_CLIENT_STATS
+static inline bool client_account(client_dir_t dir, const uint8_t *mac,
+                                  const uint8_t *frame, uint16_t len, bool control)
+{
+    if (bench_is_frame(frame)) return true;   /* loopback benchmarku — nie klient */
+    uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    return clients_account(dir, mac, len, control || pkt_is_high_priority(frame, len),
+                           now_ms);
+}
+#else
+static inline bool client_account(client_dir_t dir, const uint8_t *mac,
+                                  const uint8_t *frame, uint16_t len, bool control)
+{
+    (void)dir; (void)mac; (void)frame; (void)len; (void)control;
+    return true;
+}
+#endif /* CONFIG_REPEATER_CLIENT_STATS */
+
+/* ── QoS: klasa WMM per ramka ─────────────────────────────────
+ *  Driver wybiera kategorię WMM z IP precedence, więc klasa
+ *  niezaznaczonego flow trafia do ramki jako DSCP
+ *  (CONFIG_REPEATER_QOS_REMARK) — tylko na hopie do klientów AP;
+ *  ramki w stronę routera/ISP wychodzą z DSCP nadawcy. Ramki VO/VI
+ *  czekające na bufor TX stają w kolejce retry przed bulk (oba
+ *  kierunki). */
+#if CONFIG_REPEATER_QOS
+static qos_table_t s_qos[METRICS_PATH_MAX];   /* indeks = ścieżka RX */
+#if CONFIG_REPEATER_BENCH
+static qos_table_t s_qos_bench[METRICS_PATH_MAX];   /* loopback — tylko bench task */
+#endif
+
+static inline qos_ac_t bridge_qos(metrics_path_t path, uint8_t *frame, uint16_t len)
+{
+    bool unmarked;
+    /* Tick × okres zamiast pdTICKS_TO_MS() — bez dzielenia 64-bit per ramka */
+    uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+#if CONFIG_REPEATER_BENCH
+    qos_table_t *t = bench_is_frame(frame) ? &s_qos_bench[path] : &s_qos[path];
+#else
+    qos_table_t *t = &s_qos[path];
+#endif
+    qos_ac_t ac = qos_classify(t, frame, len, now_ms, &unmarked);
+#if CONFIG_REPEATER_QOS_REMARK
+    if (unmarked && path == METRICS_PATH_STA_RX && qos_remark(frame, len, ac)) {
+        METRICS_INC(qos_remarked, path);
+    }
+#endif
+#if CONFIG_REPEATER_METRICS
+    repeater_metrics_t *m = metrics_slot();
+    m->qos_frames[path][ac]++;
+    m->qos_bytes[path][ac] += len;
+#endif
+    return ac;
+}
+#else
+static inline qos_ac_t bridge_qos(metrics_path_t path, uint8_t *frame, uint16_t len)
+{
+    (void)path; (void)frame; (void)len;
+    return QOS_AC_BE;
+}
+#endif /* CONFIG_REPEATER_QOS */
+
+#if CONFIG_REPEATER_TXQ
+#if CONFIG_REPEATER_TXQ_POLICY_TAIL_DROP
+#define TXQ_POLICY  TXQ_POLICY_TAIL_DROP
+#elif CONFIG_REPEATER_TXQ_POLICY_DROP_OLDEST
+#define TXQ_POLICY  TXQ_POLICY_DROP_OLDEST
+#else
+#define TXQ_POLICY  TXQ_POLICY_PRIORITY
+#endif
+#define TXQ_MAX_AGE_TICKS  pdMS_TO_TICKS(CONFIG_REPEATER_TXQ_MAX_AGE_MS)
+
+#if CONFIG_REPEATER_CLIENT_DRR
+/* Downstream sprawiedliwie między klientami (klucz = indeks w repeater_clients) */
+_Static_assert(CLIENTS_MAX < TXQ_NO_CLIENT, "client index must fit a DRR key");
+static txq_t        s_txq[METRICS_PATH_MAX] = { [METRICS_PATH_STA_RX] = { .drr = true } };
+#else
+static txq_t        s_txq[METRICS_PATH_MAX];    /* indeks = ścieżka RX */
+#endif
+/* Kolejkę ruszają callback WiFi i bridge task(i) — krótkie sekcje,
+ * samo esp_wifi_internal_tx() zawsze poza lockiem */
+static portMUX_TYPE s_txq_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Przejmij ramkę do kolejki retry. Zawsze konsumuje eb: odrzucona
+ * ramka od razu idzie do sink/free (rxbuf_release). VO/VI (ac) staje
+ * przed bulk — jak pure ACK. */
+static void txq_enqueue(metrics_path_t path, void *buffer, uint16_t len,
+                        void *eb, esp_netif_t *sink, qos_ac_t ac)
+{
+    const bool realtime = ac >= QOS_AC_VI;
+    txq_entry_t e = {
+        .stamp  = xTaskGetTickCount(),
+        .client = TXQ_NO_CLIENT,
+        .len    = len,
+        .prio   = (TXQ_POLICY == TXQ_POLICY_PRIORITY &&
+                   (realtime || pkt_is_high_priority(buffer, len))) ? TXQ_PRIO_HIGH
+                                                                   : TXQ_PRIO_BULK,
+    };
+    txq_entry_t victim;
+#if CONFIG_REPEATER_ACK_PRIO
+    /* Pure ACK upstream: przed bulk, ew. w miejsce starszego ACK flow */
+    bool is_ack = path == METRICS_PATH_AP_RX &&
+                  pkt_tcp4_ack_info(buffer, len, &e.flow, &e.ack, &e.merge_ack);
+    if (is_ack) e.prio = TXQ_PRIO_HIGH;
+#else
+    const bool is_ack = false;
+#endif
+
+#if CONFIG_REPEATER_CLIENT_DRR
+    if (path == METRICS_PATH_STA_RX && !(((const uint8_t *)buffer)[0] & 0x01)) {
+        uint8_t idx = clients_index(buffer);
+        if (idx != CLIENT_NONE) e.client = idx;
+    }
+#endif
+
+    e.rb = rxbuf_wrap(buffer, len, eb, sink);
+    if (!e.rb) {
+        METRICS_INC(txq_rejected, path);
+        rx_release(buffer, len, eb, sink);
+        return;
+    }
+
+    bool merged = false;
+    portENTER_CRITICAL(&s_txq_lock);
+#if CONFIG_REPEATER_ACK_COALESCE
+    merged = e.merge_ack && txq_merge_ack(&s_txq[path], &e, &victim);
+#endif
+    txq_result_t r = merged ? TXQ_QUEUED
+                   : (is_ack || realtime) ? txq_push_ahead(&s_txq[path], &e, TXQ_POLICY, &victim)
+                                          : txq_push(&s_txq[path], &e, TXQ_POLICY, &victim);
+    portEXIT_CRITICAL(&s_txq_lock);
+
+    if (merged) {
+        METRICS_INC(ack_merged, path);
+        rxbuf_release(victim.rb);
+        return;
+    }
+    if (r == TXQ_REJECTED) {
+        METRICS_INC(txq_rejected, path);
+        rxbuf_release(e.rb);
+        return;
+    }
+    if (r != TXQ_QUEUED) {
+        METRICS_INC(txq_evicted, path);
+        rxbuf_release(victim.rb);
+    }
+    if (realtime && !is_ack) METRICS_INC(qos_ahead, path);
+    METRICS_INC(txq_queued, path);
+}
+
+/* Ponów kolejkę od głowy. Zwraca true, gdy kolejka jest pusta. */
+static bool txq_drain(metrics_path_t path)
+{
+    const uint32_t now = xTaskGetTickCount();
+    txq_entry_t e;
+
+    while (1) {
+        portENTER_CRITICAL(&s_txq_lock);
+        bool got = txq_pop(&s_txq[path], &e);
+        portEXIT_CRITICAL(&s_txq_lock);
+        if (!got) return true;
+
+        if (now - e.stamp > TXQ_MAX_AGE_TICKS) {
+            METRICS_INC(txq_stale, path);
+            rxbuf_release(e.rb);
+            continue;
+        }
+        if (!wifi_tx(path, e.rb->buffer, e.rb->len)) {
+            portENTER_CRITICAL(&s_txq_lock);
+            bool back = txq_push_front(&s_txq[path], &e);
+            portEXIT_CRITICAL(&s_txq_lock);
+            if (!back) {
+                /* Równoległy enqueue zapełnił kolejkę w międzyczasie */
+                METRICS_INC(txq_evicted, path);
+                rxbuf_release(e.rb);
+            }
+            return false;
+        }
+        METRICS_INC(txq_sent, path);
+        rxbuf_release(e.rb);
+    }
+}
+
+static void txq_flush(metrics_path_t path)
+{
+    txq_entry_t e;
+    while (1) {
+        portENTER_CRITICAL(&s_txq_lock);
+        bool got = txq_pop(&s_txq[path], &e);
+        portEXIT_CRITICAL(&s_txq_lock);
+        if (!got) return;
+        rxbuf_release(e.rb);
+    }
+}
+#endif /* CONFIG_REPEATER_TXQ */
+
+/* Ponów zaległe ramki ścieżki (no-op bez kolejki albo gdy pusta) */
+static inline void txq_service(metrics_path_t path)
+{
+#if CONFIG_REPEATER_TXQ
+    if (!txq_empty(&s_txq[path])) txq_drain(path);
+#else
+    (void)path;
+#endif
+}
+
+/**
+ * Wspólny punkt TX obu ścieżek. ZAWSZE przejmuje eb: po wysłaniu (albo
+ * porzuceniu) ramka idzie do sink (esp_netif_receive — lwIP dostaje ją
+ * ostatni, po TX) albo jest zwalniana, gdy sink == NULL. Przy odmowie
+ * drivera czeka w kolejce retry, także gdy ma trafić do lwIP.
+ */
+static inline void bridge_tx(metrics_path_t path, void *buffer, uint16_t len,
+                             void *eb, esp_netif_t *sink)
+{
+    bridge_mss_clamp(path, buffer, len);
+    qos_ac_t ac = bridge_qos(path, buffer, len);
+    (void)ac;   /* bez CONFIG_REPEATER_TXQ tylko liczniki / DSCP */
+    /* Loopback benchmarku kończy się na granicy drivera (bez TX i kolejki) */
+    if (bench_is_frame(buffer)) return;
+#if CONFIG_REPEATER_TXQ
+    if (!txq_empty(&s_txq[path])) {
+#if CONFIG_REPEATER_ACK_PRIO
+        /* Pure ACK upstream nie czeka za bulk — dostaje pierwszy wolny
+         * bufor TX (kolejka ruszy przy następnej ramce / TX-done) */
+        if (path == METRICS_PATH_AP_RX && pkt_tcp4_pure_ack(buffer, len)) {
+            if (wifi_tx(path, buffer, len)) {
+                METRICS_INC(ack_bypass, path);
+                rx_release(buffer, len, eb, sink);
+            } else {
+                txq_enqueue(path, buffer, len, eb, sink, ac);
+            }
+            return;
+        }
+#endif
+        if (!txq_drain(path)) {
+            /* Driver wciąż pełny — ustaw się za kolejką zamiast ją wyprzedzać */
+            txq_enqueue(path, buffer, len, eb, sink, ac);
+            return;
+        }
+    }
+    if (!wifi_tx(path, buffer, len)) {
+        txq_enqueue(path, buffer, len, eb, sink, ac);
+        return;
+    }
+#else
+    wifi_tx(path, buffer, len);
+#endif
+    rx_release(buffer, len, eb, sink);
+}
+
+/* ── Multicast: limiter + konwersja na unicast ─────────────── */
+
+/* Czy ramkę grupową wolno przekazać dalej (limiter / duplikaty)? */
+static inline bool mcast_forward_ok(metrics_path_t path, const uint8_t *frame, uint16_t len)
+{
+#if CONFIG_REPEATER_MCAST_LIMIT
+    return mcast_check(path, frame, len) == MCAST_PASS;
+#else
+    (void)path; (void)frame; (void)len;
+    return true;
+#endif
+}
+
+#if CONFIG_REPEATER_MCAST_TO_UNICAST_MAX > 0
+#define MCAST_UCAST_MAX  CONFIG_REPEATER_MCAST_TO_UNICAST_MAX
+
+/* Kopia listy klientów AP dla hot path (esp_wifi_ap_get_sta_list() jest
+ * za drogie per ramka). s_ap_sta_num = -1: klientów więcej niż limit. */
+static uint8_t      s_ap_sta_mac[MCAST_UCAST_MAX][6];
+static int          s_ap_sta_num;
+static portMUX_TYPE s_ap_sta_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Z event handlera; leaving = odchodzący klient (jeszcze na liście) */
+static void ap_sta_cache_update(const wifi_sta_list_t *sl, const uint8_t *leaving)
+{
+    uint8_t macs[MCAST_UCAST_MAX][6];
+    int n = 0;
+    for (int i = 0; i < sl->num; i++) {
+        if (leaving && memcmp(sl->sta[i].mac, leaving, 6) == 0) continue;
+        if (n == MCAST_UCAST_MAX) { n = -1; break; }
+        memcpy(macs[n++], sl->sta[i].mac, 6);
+    }
+    portENTER_CRITICAL(&s_ap_sta_lock);
+    if (n > 0) memcpy(s_ap_sta_mac, macs, n * 6);
+    s_ap_sta_num = n;
+    portEXIT_CRITICAL(&s_ap_sta_lock);
+}
+
+/**
+ * Send a group frame from upstream to every client as unicast: the dst
+ * MAC is rewritten in place before each esp_wifi_internal_tx() (the
+ * driver copies), then restored for lwIP. Returns false when there are
+ * no clients or more than the limit — send plain multicast instead.
+ */
+static bool mcast_to_unicast(uint8_t *frame, uint16_t len)
+{
+    uint8_t macs[MCAST_UCAST_MAX][6];
+    portENTER_CRITICAL(&s_ap_sta_lock);
+    int n = s_ap_sta_num;
+    if (n > 0) memcpy(macs, s_ap_sta_mac, n * 6);
+    portEXIT_CRITICAL(&s_ap_sta_lock);
+    if (n <= 0) return false;
+
+    uint8_t group[6];
+    uint32_t sent = 0;
+    memcpy(group, frame, 6);
+    for (int i = 0; i < n; i++) {
+        memcpy(frame, macs[i], 6);
+        if (wifi_tx(METRICS_PATH_STA_RX, frame, len)) sent++;
+    }
+    memcpy(frame, group, 6);
+    mcast_count_unicast(sent);
+    return true;
+}
+#else
+static inline void ap_sta_cache_update(const wifi_sta_list_t *sl, const uint8_t *leaving)
+{
+    (void)sl; (void)leaving;
+}
+#endif /* CONFIG_REPEATER_MCAST_TO_UNICAST_MAX */
+
+/* ── Proxy ARP (repeater_arp.c) ─────────────────────────────── */
+
+#if CONFIG_REPEATER_PROXY_ARP
+/* Broadcast request, na który bridge może odpowiedzieć: nie probe
+ * (sender 0), nie gratuitous, nie o nasz IP (to odpowiada lwIP) */
+static inline bool proxy_arp_candidate(const uint8_t *frame, const arp_msg_t *m)
+{
+    return m->op == ARP_OP_REQUEST && pkt_is_multicast(frame) &&
+           m->sender_ip && m->sender_ip != m->target_ip &&
+           m->target_ip != s_sta_ip_cache && m->target_ip != s_ap_ip_cache;
+}
+
+/**
+ * STA RX (slow path): learn the upstream sender; answer a request for a
+ * client known to MAC-NAT and still associated with the MAC upstream
+ * sees. true = answered, the request is not repeated on the AP.
+ */
+static bool proxy_arp_upstream(const uint8_t *frame, uint16_t len)
+{
+    arp_msg_t m;
+    if (!arp_parse(frame, len, &m)) return false;
+
+    /* Echo naszych/klientów ramek od upstream AP ma sender = s_client_mac */
+    if (m.sender_ip && memcmp(m.sender_mac, s_client_mac, 6) != 0 &&
+        memcmp(m.sender_mac, s_original_sta_mac, 6) != 0) {
+        arp_proxy_learn(m.sender_ip, m.sender_mac);
+    }
+    if (!proxy_arp_candidate(frame, &m)) return false;
+
+    uint8_t mac[6];
+    uint16_t aid = 0;
+    bool hit = s_client_count > 0 &&
+               macnat_table_lookup_ip_copy(&s_macnat, m.target_ip, mac) &&
+               esp_wifi_ap_get_sta_aid(mac, &aid) == ESP_OK && aid != 0;
+    if (hit) {
+        uint8_t reply[PKT_ARP_LEN];
+        arp_build_reply(reply, frame, s_client_mac);
+        hit = esp_wifi_internal_tx(WIFI_IF_STA, reply, sizeof(reply)) == ESP_OK;
+    }
+    arp_proxy_count(METRICS_PATH_STA_RX, hit);
+    return hit;
+}
+
+/**
+ * AP RX (slow path): answer a client's request for an upstream host with
+ * a fresh cache entry. true = answered, the request does not go upstream.
+ */
+static bool proxy_arp_downstream(const uint8_t *frame, uint16_t len)
+{
+    arp_msg_t m;
+    if (!s_sta_connected || !arp_parse(frame, len, &m) ||
+        !proxy_arp_candidate(frame, &m)) {
+        return false;
+    }
+
+    uint8_t mac[6];
+    bool hit = arp_proxy_lookup(m.target_ip, mac);
+    if (hit) {
+        uint8_t reply[PKT_ARP_LEN];
+        arp_build_reply(reply, frame, mac);
+        hit = esp_wifi_internal_tx(WIFI_IF_AP, reply, sizeof(reply)) == ESP_OK;
+    }
+    arp_proxy_count(METRICS_PATH_AP_RX, hit);
+    if (hit) {
+        /* Request nie przejdzie przez macnat_rewrite_upstream — ucz tutaj */
+        const uint8_t *src = frame + 6;
+        if (s_client_count >= s_macnat_min_clients && memcmp(src, s_client_mac, 6) != 0) {
+            macnat_learn(m.sender_ip, src);
+        }
+    }
+    return hit;
+}
+#else
+static inline bool proxy_arp_upstream(const uint8_t *frame, uint16_t len)
+{
+    (void)frame; (void)len;
+    return false;
+}
+
+static inline bool proxy_arp_downstream(const uint8_t *frame, uint16_t len)
+{
+    (void)frame; (void)len;
+    return false;
+}
+#endif
+
 /* ══════════════════════════════════════════════════════════════
  *  L2 Packet Forwarding
  *
@@ -152,9 +689,13 @@ static void request_mac_clone(const uint8_t *client_mac);
  *
  *  W trybie idle (STA z własnym MAC):
  *    - Normalna praca, forwarding wyłączony
+ *
+ *  slow = true: wolno uczyć MAC-NAT i sniffować DHCP (bridge task albo
+ *  build bez CONFIG_REPEATER_DEFERRED_PIPELINE). slow = false: tylko
+ *  forward + przepisanie nagłówków (fast path w callbacku drivera).
  * ══════════════════════════════════════════════════════════════ */
 
-static esp_err_t on_sta_rx(void *buffer, uint16_t len, void *eb)
+static inline esp_err_t sta_rx_forward(void *buffer, uint16_t len, void *eb, bool slow)
 {
     if (!buffer || len < 14) {
         esp_wifi_internal_free_rx_buffer(eb);
@@ -162,58 +703,88 @@ static esp_err_t on_sta_rx(void *buffer, uint16_t len, void *eb)
     }
 
     uint8_t *dst = (uint8_t *)buffer;
+    METRICS_INC(rx_frames, METRICS_PATH_STA_RX);
+    METRICS_ADD(rx_bytes, METRICS_PATH_STA_RX, len);
 
     /* Sniff DHCP ACK — only if UDP port 67→68 (skip 99.9% packets with inline check) */
-    if (len >= 286 && dst[12] == 0x08 && dst[13] == 0x00) {
-        const uint8_t *ip_hdr = dst + 14;
-        if (ip_hdr[9] == 17) {  /* UDP */
-            uint8_t ihl = (ip_hdr[0] & 0x0F) * 4;
-            const uint8_t *udp = ip_hdr + ihl;
-            if (14 + ihl + 8 <= len && udp[0] == 0 && udp[1] == 67 && udp[2] == 0 && udp[3] == 68) {
-                sniff_dhcp_ack_and_set_ap_ip(dst, len);
-            }
-        }
+    if (slow && len >= 286 && pkt_udp4_ports(dst, len, 67, 68)) {
+        sniff_dhcp_ack_and_set_ap_ip(dst, len);
+    }
+    if (slow) warm_check_arp(dst, len);
+    if (slow && proxy_arp_upstream(dst, len)) {
+        rx_release(buffer, len, eb, NULL);
+        return ESP_OK;
     }
 
     /* MAC-NAT downstream: przepisz dst MAC dla dodatkowych klientów
      * Skip jeśli jest tylko 1 klient (primary) — nic do przepisywania */
-    if (s_client_count > 1 && !(dst[0] & 0x01)) {
-        macnat_rewrite_downstream((uint8_t *)buffer, len);
+    bool rewritten = false;
+    if (s_client_count >= s_macnat_min_clients && !(dst[0] & 0x01)) {
+        rewritten = macnat_rewrite_downstream((uint8_t *)buffer, len);
+    }
+    if (s_bridge_mode == REPEATER_BRIDGE_MACNAT && !rewritten &&
+        memcmp(dst, s_client_mac, 6) == 0) {
+        /* MAC-NAT: unicast do MAC STA bez wpisu w tablicy jest dla nas
+         * (GUI, DHCP STA) — klienci i tak by go odrzucili, bez TX do AP */
+        METRICS_INC(to_lwip, METRICS_PATH_STA_RX);
+        rx_release(buffer, len, eb, s_sta_netif);
+        return ESP_OK;
     }
-
-    /* Forward WSZYSTKO do klienta na AP */
-    esp_wifi_internal_tx(WIFI_IF_AP, buffer, len);
 
     /* Broadcast/multicast: podaj do lwIP TYLKO jeśli to ARP request o nasz IP.
      * Inne broadcasty (mDNS, SSDP, NetBIOS, IGMP) — tylko forward, skip lwIP.
-     * Oszczędność: ~10-20k cykli CPU na każdym pominiętym pakiecie. */
-    if (dst[0] & 0x01) {
+     * Oszczędność: ~10-20k cykli CPU na każdym pominiętym pakiecie.
+     * Unicast do NASZEGO MAC (STA) — też do stosu lwIP
+     * (HTTP config GUI, ping, itp. z upstream sieci). */
+    bool mcast = dst[0] & 0x01;
+    bool to_stack;
+    if (mcast) {
 #if CONFIG_REPEATER_BROADCAST_FILTER
-        if (is_broadcast_for_us(dst, len, s_sta_ip_cache, s_ap_ip_cache)) {
-            esp_netif_receive(s_sta_netif, buffer, len, eb);
+        to_stack = is_broadcast_for_us(dst, len, s_sta_ip_cache, s_ap_ip_cache) ||
+                   /* MAC-NAT: STA ma własny DHCP — broadcast Offer/ACK też dla lwIP */
+                   (s_bridge_mode == REPEATER_BRIDGE_MACNAT && pkt_udp4_ports(dst, len, 67, 68));
+#else
+        to_stack = true;
+#endif
+    } else {
+        to_stack = memcmp(dst, s_original_sta_mac, 6) == 0 ||
+                   memcmp(dst, s_client_mac, 6) == 0;
+    }
+
+    if (to_stack) {
+        METRICS_INC(to_lwip, METRICS_PATH_STA_RX);
+    } else if (mcast) {
+        METRICS_INC(bcast_dropped, METRICS_PATH_STA_RX);
+    }
+
+    esp_netif_t *sink = to_stack ? s_sta_netif : NULL;
+    if (mcast) {
+        /* Ponad limit / duplikat: bez TX, lwIP dostaje ją i tak, jeśli dla nas */
+        if (!mcast_forward_ok(METRICS_PATH_STA_RX, dst, len)) {
+            rx_release(buffer, len, eb, sink);
+            return ESP_OK;
+        }
+#if CONFIG_REPEATER_MCAST_TO_UNICAST_MAX > 0
+        if (mcast_to_unicast(dst, len)) {
+            rx_release(buffer, len, eb, sink);
             return ESP_OK;
         }
-        esp_wifi_internal_free_rx_buffer(eb);
-#else
-        esp_netif_receive(s_sta_netif, buffer, len, eb);
 #endif
-        return ESP_OK;
     }
 
-    /* Unicast do NASZEGO MAC (STA) — podaj do stosu lwIP
-     * (HTTP config GUI, ping, itp. z upstream sieci) */
-    if (memcmp(dst, s_original_sta_mac, 6) == 0 ||
-        memcmp(dst, s_client_mac, 6) == 0) {
-        esp_netif_receive(s_sta_netif, buffer, len, eb);
+    /* Liczniki / limit klienta — dst już jest prawdziwym MAC */
+    if (!mcast && !client_account(CLIENT_DIR_DOWN, dst, dst, len, false)) {
+        rx_release(buffer, len, eb, sink);
         return ESP_OK;
     }
 
-    /* Unicast do klienta: tylko forward */
-    esp_wifi_internal_free_rx_buffer(eb);
+    /* Forward WSZYSTKO do klienta na AP; ten sam bufor (bez kopii) trafia
+     * potem do lwIP albo jest zwalniany — patrz bridge_tx() */
+    bridge_tx(METRICS_PATH_STA_RX, buffer, len, eb, sink);
     return ESP_OK;
 }
 
-static esp_err_t on_ap_rx(void *buffer, uint16_t len, void *eb)
+static inline esp_err_t ap_rx_forward(void *buffer, uint16_t len, void *eb, bool slow)
 {
     if (!buffer || len < 14) {
         esp_wifi_internal_free_rx_buffer(eb);
@@ -222,55 +793,488 @@ static esp_err_t on_ap_rx(void *buffer, uint16_t len, void *eb)
 
     uint8_t *dst = (uint8_t *)buffer;
     uint8_t *src = (uint8_t *)buffer + 6;
+    METRICS_INC(rx_frames, METRICS_PATH_AP_RX);
+    METRICS_ADD(rx_bytes, METRICS_PATH_AP_RX, len);
+    if (slow) warm_check_arp(dst, len);
+    if (slow && proxy_arp_downstream(dst, len)) {
+        rx_release(buffer, len, eb, NULL);
+        return ESP_OK;
+    }
+    /* Liczniki / limit klienta — src jeszcze nieprzepisany; GUI bez limitu */
+    if (!client_account(CLIENT_DIR_UP, src, dst, len, memcmp(dst, s_ap_mac, 6) == 0)) {
+        rx_release(buffer, len, eb, NULL);
+        return ESP_OK;
+    }
 
     /* MAC-NAT upstream: przepisz src MAC non-primary klientów
      * Skip jeśli jest tylko 1 klient */
-    if (s_client_count > 1 && !(src[0] & 0x01) &&
+    if (s_client_count >= s_macnat_min_clients && !(src[0] & 0x01) &&
         memcmp(src, s_client_mac, 6) != 0) {
-        macnat_rewrite_upstream((uint8_t *)buffer, len);
+        macnat_rewrite_upstream((uint8_t *)buffer, len, slow);
     }
 
     /* Broadcast/multicast — forward upstream + podaj do lwIP TYLKO jeśli dla nas */
     if (dst[0] & 0x01) {
-        if (s_sta_connected) {
-            esp_wifi_internal_tx(WIFI_IF_STA, buffer, len);
-        }
 #if CONFIG_REPEATER_BROADCAST_FILTER
-        if (is_broadcast_for_us(dst, len, s_ap_ip_cache, s_sta_ip_cache)) {
-            esp_netif_receive(s_ap_netif, buffer, len, eb);
-            return ESP_OK;
-        }
-        esp_wifi_internal_free_rx_buffer(eb);
+        bool to_stack = is_broadcast_for_us(dst, len, s_ap_ip_cache, s_sta_ip_cache);
 #else
-        esp_netif_receive(s_ap_netif, buffer, len, eb);
+        bool to_stack = true;
 #endif
+        esp_netif_t *sink = NULL;
+        if (to_stack) {
+            METRICS_INC(to_lwip, METRICS_PATH_AP_RX);
+            sink = s_ap_netif;
+        } else {
+            METRICS_INC(bcast_dropped, METRICS_PATH_AP_RX);
+        }
+        if (s_sta_connected && mcast_forward_ok(METRICS_PATH_AP_RX, dst, len)) {
+            bridge_tx(METRICS_PATH_AP_RX, buffer, len, eb, sink);
+        } else {
+            rx_release(buffer, len, eb, sink);
+        }
         return ESP_OK;
     }
 
     /* Unicast do NASZEGO MAC (AP) — podaj do stosu lwIP
      * (HTTP config GUI pod 192.168.4.1, ARP, itp.) */
     if (memcmp(dst, s_ap_mac, 6) == 0) {
+        METRICS_INC(to_lwip, METRICS_PATH_AP_RX);
         esp_netif_receive(s_ap_netif, buffer, len, eb);
         return ESP_OK;
     }
 
     /* Unicast do upstream — forward przez STA */
     if (s_sta_connected) {
-        esp_wifi_internal_tx(WIFI_IF_STA, buffer, len);
+        bridge_tx(METRICS_PATH_AP_RX, buffer, len, eb, NULL);
+    } else {
+        rx_release(buffer, len, eb, NULL);
     }
-
-    esp_wifi_internal_free_rx_buffer(eb);
     return ESP_OK;
 }
 
+#if CONFIG_REPEATER_BENCH
+/* Loopback benchmarku (repeater_bench.c): fast path jak w callbacku
+ * drivera, bez ringu — bench task nie jest producentem SPSC. Liczniki
+ * idą do osobnego slotu: scheduler wstrzymany, więc task WiFi tego
+ * rdzenia nie wpadnie w środek z przełączonym slotem (tablice QoS
+ * i liczniki klientów omija bench_is_frame) */
+uint32_t repeater_bench_loopback(metrics_path_t path, void *frame, uint16_t len)
+{
+    vTaskSuspendAll();
+#if CONFIG_REPEATER_METRICS
+    const int core = SOC_CPU_CORES_NUM > 1 ? esp_cpu_get_core_id() : 0;
+    s_metrics_cur[core] = &s_metrics_bench;
+#endif
+    uint32_t t0 = esp_cpu_get_cycle_count();
+    if (path == METRICS_PATH_STA_RX) {
+        sta_rx_forward(frame, len, frame, false);
+    } else {
+        ap_rx_forward(frame, len, frame, false);
+    }
+    uint32_t cycles = esp_cpu_get_cycle_count() - t0;
+#if CONFIG_REPEATER_METRICS
+    s_metrics_cur[core] = &s_metrics[core];
+#endif
+    xTaskResumeAll();
+    return cycles;
+}
+#endif
+
+#if CONFIG_REPEATER_DEFERRED_PIPELINE
+/* ══════════════════════════════════════════════════════════════
+ *  Deferred pipeline — slow path poza callbackiem drivera
+ *
+ *  Callback RX działa w tasku WiFi; każdy cykl tutaj to cykl zabrany
+ *  driverowi (boleśnie widać to na single-core C3/C6). Szybki
+ *  klasyfikator forwarduje zwykły unicast od razu, a "ciekawe" ramki
+ *  (DHCP, ARP, ramki wymagające uczenia MAC-NAT) wrzuca na lock-free
+ *  ring SPSC, który opróżnia bridge_task. Dzięki temu cały control
+ *  plane (parsowanie opcji DHCP, esp_netif_set_ip_info/dhcps_stop,
+ *  macnat_learn) działa w bridge tasku, a bridge task jest jedynym
+ *  writerem tablicy MAC-NAT na ścieżce RX (czyszczenie z zewnątrz:
+ *  bridge_quiesce() + MACNAT_WRITE_LOCK).
+ *
+ *  Kolejność: gdy ring danej ścieżki nie jest pusty, KAŻDA ramka tej
+ *  ścieżki idzie za kolejką — fast path nie wyprzedza odroczonych ramek.
+ *  Pełny ring → ramka idzie fast path (bez uczenia/sniffu), callback
+ *  nigdy nie czeka.
+ *
+ *  CONFIG_REPEATER_DUAL_CORE_BRIDGE (ESP32 / ESP32-S3): zamiast jednego
+ *  bridge tasku są dwa taski forwardingu przypięte do rdzeni, po jednym
+ *  na kierunek. Callback wrzuca na ring KAŻDĄ ramkę, a task danego
+ *  kierunku robi całą ścieżkę (fast + slow) — downstream i upstream
+ *  liczą się równolegle zamiast na jednym rdzeniu z taskiem WiFi.
+ * ══════════════════════════════════════════════════════════════ */
+
+static bridge_ring_t s_defer_ring[METRICS_PATH_MAX];   /* indeks = ścieżka RX */
+#if CONFIG_REPEATER_DUAL_CORE_BRIDGE
+static TaskHandle_t  s_fwd_task_handle[METRICS_PATH_MAX];
+#else
+static TaskHandle_t  s_bridge_task_handle = NULL;
+#endif
+/* Przebiegi tasku ścieżki z pustym ringiem (bridge_quiesce) */
+static volatile uint32_t s_bridge_pass[METRICS_PATH_MAX];
+
+static inline bool sta_rx_wants_slow_path(const uint8_t *frame, uint16_t len)
+{
+    if (pkt_ethertype(frame) == PKT_ETHERTYPE_ARP) return true;
+    if (len >= 286 && pkt_udp4_ports(frame, len, 67, 68)) return true;   /* DHCP → klient */
+    /* Bridge task właśnie zmienia tablicę MAC-NAT — nie czytaj jej tutaj */
+    if (s_client_count < s_macnat_min_clients || pkt_is_multicast(frame)) return false;
+#if CONFIG_REPEATER_MACNAT_IPV6
+    if (pkt_ethertype(frame) == PKT_ETHERTYPE_IPV6) return macnat6_table_busy(&s_macnat6);
+#endif
+    return macnat_table_busy(&s_macnat);
+}
+
+static inline bool ap_rx_wants_slow_path(const uint8_t *frame, uint16_t len)
+{
+    uint16_t ethertype = pkt_ethertype(frame);
+    if (ethertype == PKT_ETHERTYPE_ARP) return true;
+    const uint8_t *src = frame + 6;
+#if CONFIG_REPEATER_MACNAT_IPV6
+    if (ethertype == PKT_ETHERTYPE_IPV6 && len > PKT_IPV6_MIN_LEN) {
+        /* Non-primary: nieznany adres źródłowy albo NA (uczenie targetu) */
+        if (s_client_count < s_macnat_min_clients || pkt_is_multicast(src) ||
+            memcmp(src, s_client_mac, 6) == 0) {
+            return false;
+        }
+        const uint8_t *ip6 = frame + PKT_ETH_HDR_LEN;
+        return (ip6[6] == PKT_IPPROTO_ICMPV6 && frame[PKT_IPV6_MIN_LEN] == 136) ||
+               !macnat6_table_known(&s_macnat6, ip6 + 8, src);
+    }
+#endif
+    if (ethertype != PKT_ETHERTYPE_IPV4 || len < PKT_IPV4_MIN_LEN) return false;
+    if (pkt_udp4_ports(frame, len, 68, 67)) return true;                 /* DHCP → serwer */
+
+    /* Non-primary klient, którego pary IP↔MAC nie ma jeszcze w tablicy */
+    if (s_client_count >= s_macnat_min_clients && !pkt_is_multicast(src) &&
+        memcmp(src, s_client_mac, 6) != 0) {
+        uint32_t src_ip;
+        memcpy(&src_ip, frame + 26, 4);
+        return !macnat_table_known(&s_macnat, src_ip, src);
+    }
+    return false;
+}
+
+/* Obudź task obsługujący ścieżkę */
+static inline void bridge_kick(metrics_path_t path)
+{
+#if CONFIG_REPEATER_DUAL_CORE_BRIDGE
+    xTaskNotifyGive(s_fwd_task_handle[path]);
+#else
+    (void)path;
+    xTaskNotifyGive(s_bridge_task_handle);
+#endif
+}
+
+static inline bool bridge_defer(metrics_path_t path, void *buffer, uint16_t len, void *eb)
+{
+    if (!bridge_ring_push(&s_defer_ring[path], buffer, len, eb)) {
+        METRICS_INC(defer_full, path);
+        return false;
+    }
+    METRICS_INC(deferred, path);
+    bridge_kick(path);
+    return true;
+}
+
+/* Czy callback ma odłożyć ramkę na ring (zamiast forwardować w miejscu)? */
+static inline bool sta_rx_should_defer(const uint8_t *frame, uint16_t len)
+{
+#if CONFIG_REPEATER_DUAL_CORE_BRIDGE
+    return true;
+#else
+    return !bridge_ring_empty(&s_defer_ring[METRICS_PATH_STA_RX]) ||
+           sta_rx_wants_slow_path(frame, len);
+#endif
+}
+
+static inline bool ap_rx_should_defer(const uint8_t *frame, uint16_t len)
+{
+#if CONFIG_REPEATER_DUAL_CORE_BRIDGE
+    return true;
+#else
+    return !bridge_ring_empty(&s_defer_ring[METRICS_PATH_AP_RX]) ||
+           ap_rx_wants_slow_path(frame, len);
+#endif
+}
+
+#if CONFIG_REPEATER_DUAL_CORE_BRIDGE
+/* Task forwardingu jednego kierunku (pv = metrics_path_t) */
+static void fwd_task(void *pv)
+{
+    const metrics_path_t path = (metrics_path_t)(intptr_t)pv;
+    repeater_mem_task_begin(CONFIG_REPEATER_STACK_BRIDGE_TASK);
+    bridge_ring_t *ring = &s_defer_ring[path];
+    bridge_frame_t f;
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        txq_service(path);
+
+        while (bridge_ring_pop(ring, &f)) {
+            if (!s_forwarding_active) {
+                esp_wifi_internal_free_rx_buffer(f.eb);
+            } else if (path == METRICS_PATH_STA_RX) {
+                sta_rx_forward(f.buffer, f.len, f.eb, true);
+            } else {
+                ap_rx_forward(f.buffer, f.len, f.eb, true);
+            }
+        }
+        s_bridge_pass[path]++;
+    }
+}
+
+static void bridge_pipeline_start(void)
+{
+    xTaskCreatePinnedToCore(fwd_task, "fwd_down", CONFIG_REPEATER_STACK_BRIDGE_TASK,
+                            (void *)(intptr_t)METRICS_PATH_STA_RX,
+                            CONFIG_REPEATER_FWD_DOWNSTREAM_PRIO,
+                            &s_fwd_task_handle[METRICS_PATH_STA_RX],
+                            CONFIG_REPEATER_FWD_DOWNSTREAM_CORE);
+    xTaskCreatePinnedToCore(fwd_task, "fwd_up", CONFIG_REPEATER_STACK_BRIDGE_TASK,
+                            (void *)(intptr_t)METRICS_PATH_AP_RX,
+                            CONFIG_REPEATER_FWD_UPSTREAM_PRIO,
+                            &s_fwd_task_handle[METRICS_PATH_AP_RX],
+                            CONFIG_REPEATER_FWD_UPSTREAM_CORE);
+    ESP_LOGI(TAG, "Dual-core bridge: downstream on core %d, upstream on core %d",
+             CONFIG_REPEATER_FWD_DOWNSTREAM_CORE, CONFIG_REPEATER_FWD_UPSTREAM_CORE);
+}
+#else
+/* Jeden bridge task opróżnia oba ringi (slow path obu kierunków) */
+static void bridge_task(void *pv)
+{
+    bridge_frame_t f;
+    repeater_mem_task_begin(CONFIG_REPEATER_STACK_BRIDGE_TASK);
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        txq_service(METRICS_PATH_STA_RX);
+        txq_service(METRICS_PATH_AP_RX);
+
+        bool more;
+        do {
+            more = false;
+            if (bridge_ring_pop(&s_defer_ring[METRICS_PATH_STA_RX], &f)) {
+                more = true;
+                if (s_forwarding_active) sta_rx_forward(f.buffer, f.len, f.eb, true);
+                else esp_wifi_internal_free_rx_buffer(f.eb);
+            }
+            if (bridge_ring_pop(&s_defer_ring[METRICS_PATH_AP_RX], &f)) {
+                more = true;
+                if (s_forwarding_active) ap_rx_forward(f.buffer, f.len, f.eb, true);
+                else esp_wifi_internal_free_rx_buffer(f.eb);
+            }
+        } while (more);
+        s_bridge_pass[METRICS_PATH_STA_RX]++;
+        s_bridge_pass[METRICS_PATH_AP_RX]++;
+    }
+}
+
+static void bridge_pipeline_start(void)
+{
+    xTaskCreate(bridge_task, "bridge", CONFIG_REPEATER_STACK_BRIDGE_TASK, NULL,
+                CONFIG_REPEATER_BRIDGE_TASK_PRIO, &s_bridge_task_handle);
+}
+#endif /* CONFIG_REPEATER_DUAL_CORE_BRIDGE */
+
+/* Po forwarding_stop(): poczekaj, aż task(i) ścieżek opróżnią ringi
+ * (!s_forwarding_active → ramki tylko zwalniane) i dokończą ramkę
+ * zdjętą przed zatrzymaniem — potem nikt z RX nie pisze do MAC-NAT.
+ * Nie wołać z tasku ścieżki. */
+static void bridge_quiesce(void)
+{
+    for (int p = 0; p < METRICS_PATH_MAX; p++) {
+        uint32_t pass = s_bridge_pass[p];
+        bridge_kick((metrics_path_t)p);
+        for (int i = 0; i < 20 && s_bridge_pass[p] == pass; i++) {
+            vTaskDelay(pdMS_TO_TICKS(5));
+        }
+    }
+}
+
+#if CONFIG_REPEATER_TXQ
+/* TX-done (task WiFi): zwolnił się bufor TX — jeśli coś czeka w kolejce
+ * retry, niech ponowi to task ścieżki (nie nadajemy z wnętrza callbacku) */
+static void on_tx_done(uint8_t ifidx, uint8_t *data, uint16_t *data_len, bool txStatus)
+{
+    metrics_path_t path = (ifidx == WIFI_IF_AP) ? METRICS_PATH_STA_RX : METRICS_PATH_AP_RX;
+    if (!txq_empty(&s_txq[path])) bridge_kick(path);
+}
+#endif
+#else
+static inline void bridge_quiesce(void) { }
+#endif /* CONFIG_REPEATER_DEFERRED_PIPELINE */
+
+/* Szczyty buforów trzymanych przez bridge (repeater_mem.c). Reset przy
+ * starcie kalibracji — peak ringu to wyścig z producentem, ale zgubiona
+ * aktualizacja zaniża szczyt o jedną ramkę, nie więcej. */
+void repeater_mem_bridge_peaks(mem_bridge_t *out, bool reset)
+{
+    memset(out, 0, sizeof(*out));
+    for (int p = 0; p < METRICS_PATH_MAX; p++) {
+#if CONFIG_REPEATER_DEFERRED_PIPELINE
+        out->ring_peak[p] = s_defer_ring[p].peak;
+        if (reset) s_defer_ring[p].peak = 0;
+#endif
+#if CONFIG_REPEATER_TXQ
+        portENTER_CRITICAL(&s_txq_lock);
+        out->txq_peak[p] = s_txq[p].peak;
+        if (reset) s_txq[p].peak = 0;
+        portEXIT_CRITICAL(&s_txq_lock);
+#endif
+    }
+
+    rxbuf_stats_t rs;
+    rxbuf_get_stats(&rs);
+    out->rxbuf_peak = rs.live_peak;
+    out->pool_empty = rs.pool_empty;
+    if (reset) rxbuf_reset_peak();
+
+    repeater_metrics_t *m = malloc(sizeof(*m));
+    if (!m) return;
+    repeater_metrics_snapshot(m);
+    for (int p = 0; p < METRICS_PATH_MAX; p++) {
+        out->tx_fail      += m->tx_fail[p];
+        out->defer_full   += m->defer_full[p];
+        out->txq_rejected += m->txq_rejected[p];
+    }
+    free(m);
+}
+
+/* Callbacki RX rejestrowane w driverze — cienkie wrappery mierzące
+ * czas (cykle CPU) całej ścieżki w kontekście drivera. */
+static esp_err_t on_sta_rx(void *buffer, uint16_t len, void *eb)
+{
+    uint32_t t0 = metrics_cycles_now();
+    esp_err_t ret;
+    repeater_trace_first_frame(METRICS_PATH_STA_RX);
+#if CONFIG_REPEATER_DEFERRED_PIPELINE
+    if (buffer && len >= 14 && sta_rx_should_defer(buffer, len) &&
+        bridge_defer(METRICS_PATH_STA_RX, buffer, len, eb)) {
+        ret = ESP_OK;
+    } else {
+        ret = sta_rx_forward(buffer, len, eb, false);
+    }
+#else
+    ret = sta_rx_forward(buffer, len, eb, true);
+#endif
+    metrics_cycles_record(METRICS_PATH_STA_RX, t0);
+    return ret;
+}
+
+static esp_err_t on_ap_rx(void *buffer, uint16_t len, void *eb)
+{
+    uint32_t t0 = metrics_cycles_now();
+    esp_err_t ret;
+    repeater_trace_first_frame(METRICS_PATH_AP_RX);
+#if CONFIG_REPEATER_DEFERRED_PIPELINE
+    if (buffer && len >= 14 && ap_rx_should_defer(buffer, len) &&
+        bridge_defer(METRICS_PATH_AP_RX, buffer, len, eb)) {
+        ret = ESP_OK;
+    } else {
+        ret = ap_rx_forward(buffer, len, eb, false);
+    }
+#else
+    ret = ap_rx_forward(buffer, len, eb, true);
+#endif
+    metrics_cycles_record(METRICS_PATH_AP_RX, t0);
+    return ret;
+}
+
+/* ── Power save ───────────────────────────────────────────────
+ *  Tylko ps_task woła esp_wifi_set_ps() — forwarding_start/stop
+ *  wymuszają poziom przez notyfikację, więc decyzja kontrolera nie
+ *  może nadpisać świeżo wymuszonego trybu. */
+
+static const wifi_ps_type_t PS_MODE[PS_LEVEL_MAX] = {
+    [PS_LEVEL_NONE]      = WIFI_PS_NONE,
+    [PS_LEVEL_MIN_MODEM] = WIFI_PS_MIN_MODEM,
+    [PS_LEVEL_MAX_MODEM] = WIFI_PS_MAX_MODEM,
+};
+
+#if CONFIG_REPEATER_ADAPTIVE_PS
+#define PS_SAMPLE_MS      250
+#define PS_FORCE_FLAG     0x100     /* notyfikacja = PS_FORCE_FLAG | poziom */
+#define PS_TASK_STACK     2560
+
+/* Non-static: GET /status czyta czasy w poziomach (odczyt bez locka) */
+ps_ctrl_t s_ps;
+static TaskHandle_t s_ps_task;
+
+static void ps_task(void *pv)
+{
+    repeater_mem_task_begin(PS_TASK_STACK);
+    uint32_t last_frames = repeater_metrics_rx_frames();
+    int64_t  last_us     = esp_timer_get_time();
+    ps_level_t applied   = s_ps.level;
+    esp_wifi_set_ps(PS_MODE[applied]);
+
+    while (1) {
+        uint32_t req = 0;
+        bool forced = xTaskNotifyWait(0, UINT32_MAX, &req, pdMS_TO_TICKS(PS_SAMPLE_MS)) &&
+                      (req & PS_FORCE_FLAG);
+
+        int64_t  now_us = esp_timer_get_time();
+        uint32_t frames = repeater_metrics_rx_frames();
+        /* repeater_metrics_reset() cofa licznik — traktuj jak nową bazę */
+        uint32_t pkts = frames - last_frames;
+        if ((int32_t)pkts < 0) pkts = frames;
+        ps_level_t level = ps_ctrl_update(&s_ps, pkts, (uint32_t)((now_us - last_us) / 1000));
+        last_frames = frames;
+        last_us     = now_us;
+
+        if (forced) {
+            ps_ctrl_force(&s_ps, (ps_level_t)(req & 0xFF));
+            level = s_ps.level;
+        }
+        if (level != applied) {
+            ESP_LOGI(TAG, "Power save: %d -> %d (avg %lu pkt/s)", applied, level,
+                     (unsigned long)ps_ctrl_avg_pps(&s_ps));
+            esp_wifi_set_ps(PS_MODE[level]);
+            applied = level;
+        }
+    }
+}
+
+static void ps_start(void)
+{
+    const ps_params_t p = {
+        .wake_pps      = CONFIG_REPEATER_PS_WAKE_PPS,
+        .min_modem_pps = CONFIG_REPEATER_PS_MIN_MODEM_PPS,
+        .max_modem_pps = CONFIG_REPEATER_PS_MAX_MODEM_PPS,
+        .hold_ms       = CONFIG_REPEATER_PS_HOLD_S * 1000,
+        .window_s      = CONFIG_REPEATER_PS_WINDOW_S,
+    };
+    ps_ctrl_init(&s_ps, &p, PS_LEVEL_MIN_MODEM);
+    xTaskCreate(ps_task, "ps", PS_TASK_STACK, NULL, 6, &s_ps_task);
+}
+#endif /* CONFIG_REPEATER_ADAPTIVE_PS */
+
+/* Wymuś poziom (start/stop bridgowania); dalej decyduje kontroler */
+static void ps_force(ps_level_t level)
+{
+#if CONFIG_REPEATER_ADAPTIVE_PS
+    if (s_ps_task) {
+        xTaskNotify(s_ps_task, PS_FORCE_FLAG | level, eSetValueWithOverwrite);
+        return;
+    }
+#endif
+    esp_wifi_set_ps(PS_MODE[level]);
+}
+
 static void forwarding_start(void)
 {
     if (s_forwarding_active) return;
     ESP_LOGI(TAG, ">>> Forwarding START");
-    /* Wyłącz power save — minimalna latencja podczas bridgowania */
-    esp_wifi_set_ps(WIFI_PS_NONE);
+    TRACE_EV(TRACE_FWD_START, 0);
+    /* Start bridgowania bez power save — klient zwykle zaraz nadaje
+     * (DHCP, ARP); potem poziom dobiera kontroler z ruchu */
+    ps_force(PS_LEVEL_NONE);
     esp_wifi_internal_reg_rxcb(WIFI_IF_STA, on_sta_rx);
     esp_wifi_internal_reg_rxcb(WIFI_IF_AP, on_ap_rx);
+#if CONFIG_REPEATER_DEFERRED_PIPELINE && CONFIG_REPEATER_TXQ
+    esp_wifi_set_tx_done_cb(on_tx_done);
+#endif
     s_forwarding_active = true;
 }
 
@@ -278,11 +1282,17 @@ static void forwarding_stop(void)
 {
     if (!s_forwarding_active) return;
     ESP_LOGI(TAG, "<<< Forwarding STOP");
+    TRACE_EV(TRACE_FWD_STOP, 0);
     esp_wifi_internal_reg_rxcb(WIFI_IF_STA, NULL);
     esp_wifi_internal_reg_rxcb(WIFI_IF_AP, NULL);
     s_forwarding_active = false;
+#if CONFIG_REPEATER_TXQ
+    /* Kolejka trzyma bufory RX — oddaj je driverowi */
+    txq_flush(METRICS_PATH_STA_RX);
+    txq_flush(METRICS_PATH_AP_RX);
+#endif
     /* Przywróć modem sleep w trybie idle */
-    esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
+    ps_force(PS_LEVEL_MIN_MODEM);
 }
 
 /* ══════════════════════════════════════════════════════════════
@@ -290,6 +1300,8 @@ static void forwarding_stop(void)
  *
  *  STA ma MAC sklonowany pod jednego klienta (primary). Dodatkowi
  *  klienci nie byliby widziani przez router (802.11 TA != ich MAC).
+ *  W trybie MAC-NAT (REPEATER_BRIDGE_MACNAT) STA ma stały MAC i nie
+ *  ma klienta primary — wszyscy klienci są "dodatkowi".
  *
  *  Rozwiązanie:
  *   Upstream (AP→STA): przepisz src MAC dodatkowych klientów na
@@ -298,157 +1310,77 @@ static void forwarding_stop(void)
  *                         przepisz dst MAC na prawdziwy MAC klienta.
  *
  *  Tablica IP→MAC uczona z pakietów klientów (IPv4 src, ARP sender)
- *  i z DHCP ACK (yiaddr→chaddr).
+ *  i z DHCP ACK (yiaddr→chaddr). Implementacja w repeater_macnat.c:
+ *  hash po IPv4 + cache "last hit" (downstream) i reverse index po MAC
+ *  (upstream), pojemność z CONFIG_REPEATER_MACNAT_CAPACITY.
  * ══════════════════════════════════════════════════════════════ */
 
-#define MACNAT_MAX 8
-
-typedef struct {
-    uint32_t ip;          /* network byte order */
-    uint8_t  real_mac[6]; /* prawdziwy MAC klienta */
-    int64_t  last_seen;   /* esp_timer_get_time() timestamp */
-    bool     used;
-} macnat_entry_t;
-
-static macnat_entry_t s_macnat[MACNAT_MAX];
-
-static void macnat_learn(uint32_t ip_n, const uint8_t *mac)
+static void macnat_learned(uint32_t ip_n, const uint8_t *mac)
 {
-    /* Ignoruj broadcast/multicast MAC i zerowy IP */
-    if ((mac[0] & 0x01) || ip_n == 0) return;
-
-    int free_idx = -1;
-    int oldest_idx = 0;
-
-    for (int i = 0; i < MACNAT_MAX; i++) {
-        if (s_macnat[i].used) {
-            /* Hot path: istniejący wpis, ten sam IP+MAC — nic nie rób */
-            if (s_macnat[i].ip == ip_n) {
-                if (memcmp(s_macnat[i].real_mac, mac, 6) == 0) return;
-                /* IP istnieje ale MAC się zmienił */
-                memcpy(s_macnat[i].real_mac, mac, 6);
-                s_macnat[i].last_seen = esp_timer_get_time();
-                return;
-            }
-            if (memcmp(s_macnat[i].real_mac, mac, 6) == 0) {
-                /* Ten sam MAC, nowe IP (DHCP renewal) */
-                s_macnat[i].ip = ip_n;
-                s_macnat[i].last_seen = esp_timer_get_time();
-                return;
-            }
-            if (s_macnat[i].last_seen < s_macnat[oldest_idx].last_seen) {
-                oldest_idx = i;
-            }
-        } else if (free_idx == -1) {
-            free_idx = i;
-        }
-    }
-
-    /* Nowy wpis */
-    int idx = (free_idx >= 0) ? free_idx : oldest_idx;
-    s_macnat[idx].ip = ip_n;
-    memcpy(s_macnat[idx].real_mac, mac, 6);
-    s_macnat[idx].last_seen = esp_timer_get_time();
-    s_macnat[idx].used = true;
     ESP_LOGI(TAG, "MAC-NAT learned: " IPSTR " -> " MACSTR,
              IP2STR((esp_ip4_addr_t *)&ip_n), MAC2STR(mac));
 }
 
-static const uint8_t *macnat_lookup_by_ip(uint32_t ip_n)
+static void macnat_write_lock(void)   { MACNAT_WRITE_LOCK(); }
+static void macnat_write_unlock(void) { MACNAT_WRITE_UNLOCK(); }
+
+/* Globalny stan dla repeater_frame.c (s_client_mac zmienia się w miejscu) */
+static const frame_ctx_t s_frame_ctx = {
+    .macnat       = &s_macnat,
+#if CONFIG_REPEATER_MACNAT_IPV6
+    .macnat6      = &s_macnat6,
+#endif
+    .client_mac   = s_client_mac,
+    .now_us       = esp_timer_get_time,
+    .write_lock   = macnat_write_lock,
+    .write_unlock = macnat_write_unlock,
+#if CONFIG_REPEATER_DUAL_CORE_BRIDGE
+    .lookup_spin  = true,
+#endif
+    .learned      = macnat_learned,
+};
+
+static void macnat_learn(uint32_t ip_n, const uint8_t *mac)
 {
-    for (int i = 0; i < MACNAT_MAX; i++) {
-        if (s_macnat[i].used && s_macnat[i].ip == ip_n) {
-            return s_macnat[i].real_mac;
-        }
-    }
-    return NULL;
+    frame_macnat_learn(&s_frame_ctx, ip_n, mac);
 }
 
 static void macnat_clear(void)
 {
-    memset(s_macnat, 0, sizeof(s_macnat));
+    MACNAT_WRITE_LOCK();
+    macnat_table_clear(&s_macnat);
+#if CONFIG_REPEATER_MACNAT_IPV6
+    macnat6_table_clear(&s_macnat6);
+#endif
+    MACNAT_WRITE_UNLOCK();
 }
 
 /* Upstream: przepisz src MAC dodatkowego klienta na sklonowany MAC.
  * Router widzi jeden MAC, a my zapamiętujemy IP→MAC do powrotu. */
-static void macnat_rewrite_upstream(uint8_t *frame, uint16_t len)
+static void macnat_rewrite_upstream(uint8_t *frame, uint16_t len, bool learn)
 {
-    uint8_t *eth_src = frame + 6;
-    uint16_t ethertype = (frame[12] << 8) | frame[13];
-
-    if (ethertype == 0x0800 && len >= 34) {
-        /* IPv4: src IP at offset 26 */
-        uint32_t src_ip;
-        memcpy(&src_ip, frame + 26, 4);
-        macnat_learn(src_ip, eth_src);
-
-        /* DHCP fix: klient wysyła Discover/Request z chaddr = swój MAC.
-         * Router odpowiada unicast do chaddr → WiFi HW na STA odrzuca
-         * (STA MAC = sklonowany ≠ chaddr). Fix: ustaw BROADCAST flag
-         * w DHCP, żeby router odpowiedział broadcastem. */
-        const uint8_t *ip_hdr = frame + 14;
-        if (ip_hdr[9] == 17) {  /* UDP */
-            uint8_t ihl = (ip_hdr[0] & 0x0F) * 4;
-            const uint8_t *udp = ip_hdr + ihl;
-            if (14 + ihl + 8 <= len &&
-                udp[0] == 0 && udp[1] == 68 &&   /* src port 68 (DHCP client) */
-                udp[2] == 0 && udp[3] == 67) {    /* dst port 67 (DHCP server) */
-                uint8_t *dhcp = (uint8_t *)(udp + 8);
-                int dhcp_off = 14 + ihl + 8;
-                if (dhcp_off + 44 <= len) {
-                    /* Set BROADCAST flag (bit 15 of flags field at DHCP offset 10)
-                     * Forces server to respond via broadcast instead of unicast to chaddr */
-                    dhcp[10] |= 0x80;
-                    /* Zero UDP checksum — modifying payload invalidates it.
-                     * UDP/IPv4 allows checksum=0 meaning "not computed" (RFC 768). */
-                    uint8_t *udp_csum = (uint8_t *)(udp + 6);
-                    udp_csum[0] = 0;
-                    udp_csum[1] = 0;
-                    ESP_LOGD(TAG, "MAC-NAT: set BROADCAST flag in DHCP from " MACSTR,
-                             MAC2STR(eth_src));
-                }
-            }
-        }
-    } else if (ethertype == 0x0806 && len >= 42) {
-        /* ARP: sender IP at 28, sender MAC at 22 */
-        uint32_t sender_ip;
-        memcpy(&sender_ip, frame + 28, 4);
-        macnat_learn(sender_ip, eth_src);
-        /* Przepisz ARP sender hardware address */
-        memcpy(frame + 22, s_client_mac, 6);
-    }
-
-    /* Przepisz Ethernet source MAC */
-    memcpy(eth_src, s_client_mac, 6);
+    frame_macnat_upstream(&s_frame_ctx, frame, len, learn);
+    METRICS_INC(macnat_rewrites, METRICS_PATH_AP_RX);
 }
 
 /* Downstream: przepisz dst MAC ze sklonowanego na prawdziwy MAC klienta.
  * Router wysyła do sklonowanego MAC — my podmieniamy na docelowy. */
-static void macnat_rewrite_downstream(uint8_t *frame, uint16_t len)
-{
-    uint16_t ethertype = (frame[12] << 8) | frame[13];
-    const uint8_t *real_mac = NULL;
-
-    if (ethertype == 0x0800 && len >= 34) {
-        /* IPv4: dst IP at offset 30 */
-        uint32_t dst_ip;
-        memcpy(&dst_ip, frame + 30, 4);
-        real_mac = macnat_lookup_by_ip(dst_ip);
-    } else if (ethertype == 0x0806 && len >= 42) {
-        /* ARP: target IP at 38, target MAC at 32 */
-        uint32_t target_ip;
-        memcpy(&target_ip, frame + 38, 4);
-        real_mac = macnat_lookup_by_ip(target_ip);
-        if (real_mac && memcmp(real_mac, s_client_mac, 6) != 0) {
-            /* Przepisz ARP target hardware address */
-            memcpy(frame + 32, real_mac, 6);
-        }
-    }
+static bool macnat_rewrite_downstream(uint8_t *frame, uint16_t len)
+{
+    if (!frame_macnat_downstream(&s_frame_ctx, frame, len)) return false;
+    METRICS_INC(macnat_rewrites, METRICS_PATH_STA_RX);
+    return true;
+}
 
-    /* Przepisz Ethernet dst MAC tylko dla dodatkowych klientów */
-    if (real_mac && memcmp(real_mac, s_client_mac, 6) != 0) {
-        memcpy(frame, real_mac, 6);
-    }
+/* Tryb MAC-NAT: wejście / wyjście klienta zmienia tylko stan — bez
+ * zmiany MAC i bez reconnectu STA. Forwarding działa przez cały czas
+ * połączenia STA: lwIP STA dostaje ramki przez nasz callback (netif
+ * rejestruje własny tylko przy STA_CONNECTED), więc wyłączenie go przy
+ * zerze klientów odcięłoby GUI i DHCP STA. */
+static void macnat_bridge_update(void)
+{
+    if (s_sta_connected) forwarding_start();
+    s_state = (s_sta_connected && s_client_count > 0) ? STATE_BRIDGING : STATE_IDLE;
 }
 
 /* ══════════════════════════════════════════════════════════════
@@ -464,14 +1396,68 @@ typedef struct {
     bool    clone;     /* true = clone client MAC, false = restore original */
 } mac_task_params_t;
 
+/* Rozłącz STA i poczekaj, aż handler WIFI_EVENT_STA_DISCONNECTED skończy
+ * (bit ustawiany na końcu handlera) — potem można zmieniać MAC/config
+ * bez stałych opóźnień. Gdy STA już jest rozłączone, bit jest ustawiony
+ * i czekanie kończy się od razu. */
+static void sta_disconnect_wait(void)
+{
+    esp_wifi_disconnect();
+    xEventGroupWaitBits(s_wifi_event_group, STA_DISCONNECTED_BIT,
+                        pdTRUE, pdFALSE, pdMS_TO_TICKS(5000));
+}
+
+/* Przypnij STA do zapamiętanego BSSID/kanału (lock) albo przywróć pełny
+ * scan. esp_wifi_set_config() tylko gdy coś się zmienia — SSID i hasło
+ * zostają nietknięte, więc driver zachowuje policzony PMK (PBKDF2 dla
+ * WPA2-PSK) i nie liczy go od nowa przy reconnect. */
+static void sta_lock_bssid(bool lock)
+{
+    wifi_config_t cfg;
+    esp_wifi_get_config(WIFI_IF_STA, &cfg);
+    uint8_t channel = lock ? s_upstream_channel : 0;
+    if (cfg.sta.bssid_set == lock && cfg.sta.channel == channel &&
+        (!lock || memcmp(cfg.sta.bssid, s_upstream_bssid, 6) == 0)) {
+        return;
+    }
+    if (lock) memcpy(cfg.sta.bssid, s_upstream_bssid, 6);
+    cfg.sta.bssid_set = lock;
+    cfg.sta.channel = channel;
+    esp_wifi_set_config(WIFI_IF_STA, &cfg);
+}
+
+/* Czas fazy handoveru w ms; *t przesuwany na koniec fazy */
+static uint32_t handover_phase_ms(int64_t *t)
+{
+    int64_t now = esp_timer_get_time();
+    uint32_t ms = (uint32_t)((now - *t) / 1000);
+    *t = now;
+    return ms;
+}
+
+static void handover_record(const repeater_handover_t *ho)
+{
+    uint32_t count = s_handover.count + 1;
+    uint32_t fast_count = s_handover.fast_count + (ho->fast ? 1 : 0);
+    s_handover = *ho;
+    s_handover.count = count;
+    s_handover.fast_count = fast_count;
+    ESP_LOGI(TAG, "  Handover %lu ms (%s): disconnect %lu, set MAC %lu, connect %lu",
+             (unsigned long)ho->total_ms, ho->fast ? "fast" : "scan",
+             (unsigned long)ho->disconnect_ms, (unsigned long)ho->set_mac_ms,
+             (unsigned long)ho->connect_ms);
+}
+
 static void mac_change_task(void *pvParams)
 {
     mac_task_params_t *params = (mac_task_params_t *)pvParams;
+    repeater_mem_task_begin(CONFIG_REPEATER_STACK_MAC_TASK);
 
     /* Zablokuj równoległe zmiany */
     if (xSemaphoreTake(s_mac_task_mutex, pdMS_TO_TICKS(5000)) != pdTRUE) {
         ESP_LOGW(TAG, "MAC change already in progress, skipping");
         free(params);
+        repeater_mem_task_end();
         vTaskDelete(NULL);
         return;
     }
@@ -480,6 +1466,10 @@ static void mac_change_task(void *pvParams)
         /* ── Clone client MAC ─────────────────── */
         s_state = STATE_MAC_CHANGING;
         ESP_LOGI(TAG, "=== MAC CLONE: " MACSTR " ===", MAC2STR(params->mac));
+        TRACE_EV(TRACE_MAC_CLONE_BEGIN, 0);
+        int64_t t_start = esp_timer_get_time();
+        int64_t t = t_start;
+        repeater_handover_t ho = { 0 };
 
         /* 1. Stop forwarding */
         forwarding_stop();
@@ -487,14 +1477,11 @@ static void mac_change_task(void *pvParams)
         /* 2. Suppress auto-reconnect in event handler */
         s_suppress_auto_reconnect = true;
 
-        /* 3. Disconnect STA */
+        /* 3–4. Disconnect STA i czekaj aż handler disconnectu skończy */
         ESP_LOGI(TAG, "  Disconnecting STA...");
-        esp_wifi_disconnect();
-
-        /* 4. Czekaj na disconnect */
-        xEventGroupWaitBits(s_wifi_event_group, STA_DISCONNECTED_BIT,
-                            pdTRUE, pdFALSE, pdMS_TO_TICKS(5000));
-        vTaskDelay(pdMS_TO_TICKS(100));
+        sta_disconnect_wait();
+        ho.disconnect_ms = handover_phase_ms(&t);
+        TRACE_EV(TRACE_MAC_STA_DOWN, 0);
 
         /* 5. Wyłącz DHCP client na STA
          *    (żeby nie kolidował z DHCP klienta — oba mają ten sam MAC) */
@@ -512,14 +1499,17 @@ static void mac_change_task(void *pvParams)
 
         /* 6. Zmień MAC na STA */
         esp_err_t err = esp_wifi_set_mac(WIFI_IF_STA, params->mac);
+        TRACE_EV(TRACE_MAC_SET, err);
         if (err != ESP_OK) {
             ESP_LOGE(TAG, "  esp_wifi_set_mac failed: %s", esp_err_to_name(err));
             /* Fallback: przywróć oryginał i reconnect */
             esp_wifi_set_mac(WIFI_IF_STA, s_original_sta_mac);
             s_suppress_auto_reconnect = false;
             esp_wifi_connect();
+            TRACE_EV(TRACE_MAC_CLONE_END, 0);
             xSemaphoreGive(s_mac_task_mutex);
             free(params);
+            repeater_mem_task_end();
             vTaskDelete(NULL);
             return;
         }
@@ -530,47 +1520,72 @@ static void mac_change_task(void *pvParams)
         ESP_LOGI(TAG, "  STA MAC now: " MACSTR, MAC2STR(verify_mac));
 
         s_mac_cloned = true;
+        ho.set_mac_ms = handover_phase_ms(&t);
 
         /* 7. Reconnect z nowym MAC — użyj zapisanego BSSID żeby nie skakać po kanałach */
         ESP_LOGI(TAG, "  Reconnecting with cloned MAC...");
+        EventBits_t bits = 0;
+#if CONFIG_REPEATER_FAST_HANDOVER
+        /* Fast path: znany BSSID + kanał → driver sonduje tylko jeden
+         * kanał. Auto-reconnect zostaje wyłączony, więc porażka
+         * (DISCONNECTED) wraca od razu zamiast po timeoucie. */
+        if (s_bssid_locked) {
+            ESP_LOGI(TAG, "  Fast reconnect: " MACSTR " ch %d",
+                     MAC2STR(s_upstream_bssid), s_upstream_channel);
+            sta_lock_bssid(true);
+            xEventGroupClearBits(s_wifi_event_group, STA_DISCONNECTED_BIT);
+            TRACE_EV(TRACE_MAC_CONNECT, 1);
+            esp_wifi_connect();
+            bits = xEventGroupWaitBits(s_wifi_event_group,
+                                       STA_CONNECTED_BIT | STA_DISCONNECTED_BIT,
+                                       pdFALSE, pdFALSE,
+                                       pdMS_TO_TICKS(CONFIG_REPEATER_FAST_HANDOVER_TIMEOUT_MS));
+            if (bits & STA_CONNECTED_BIT) {
+                ho.fast = true;
+            } else {
+                ESP_LOGW(TAG, "  Fast reconnect to " MACSTR " failed, full scan...",
+                         MAC2STR(s_upstream_bssid));
+                sta_disconnect_wait();
+                sta_lock_bssid(false);
+            }
+        }
+#else
         if (s_bssid_locked) {
-            wifi_config_t current_cfg;
-            esp_wifi_get_config(WIFI_IF_STA, &current_cfg);
-            memcpy(current_cfg.sta.bssid, s_upstream_bssid, 6);
-            current_cfg.sta.bssid_set = true;
-            current_cfg.sta.channel = s_upstream_channel;
-            esp_wifi_set_config(WIFI_IF_STA, &current_cfg);
+            sta_lock_bssid(true);
             ESP_LOGI(TAG, "  BSSID locked to: " MACSTR " ch %d",
                      MAC2STR(s_upstream_bssid), s_upstream_channel);
         }
-        vTaskDelay(pdMS_TO_TICKS(200));
+#endif
         s_suppress_auto_reconnect = false;
-        esp_wifi_connect();
+        if (!(bits & STA_CONNECTED_BIT)) {
+            TRACE_EV(TRACE_MAC_CONNECT, 0);
+            esp_wifi_connect();
+
+            /* 8. Czekaj na połączenie */
+            bits = xEventGroupWaitBits(s_wifi_event_group, STA_CONNECTED_BIT,
+                                       pdFALSE, pdFALSE, pdMS_TO_TICKS(15000));
+        }
+        ho.connect_ms = handover_phase_ms(&t);
+        TRACE_EV(TRACE_MAC_CLONE_END, (bits & STA_CONNECTED_BIT) ? 1 : 0);
 
-        /* 8. Czekaj na połączenie */
-        EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group, STA_CONNECTED_BIT,
-                                                pdFALSE, pdFALSE, pdMS_TO_TICKS(15000));
         if (bits & STA_CONNECTED_BIT) {
             ESP_LOGI(TAG, "=== BRIDGE ACTIVE ===");
             s_state = STATE_BRIDGING;
+#if CONFIG_REPEATER_WARM_START
+            warm_apply_ap_ip();
+#endif
             /* Forwarding jest uruchamiany w STA_CONNECTED handlerze */
+            ho.total_ms = (uint32_t)((esp_timer_get_time() - t_start) / 1000);
+            handover_record(&ho);
         } else {
             ESP_LOGE(TAG, "  Reconnect timeout! Restoring original MAC...");
             s_suppress_auto_reconnect = true;
-            esp_wifi_disconnect();
-            vTaskDelay(pdMS_TO_TICKS(200));
+            sta_disconnect_wait();
             esp_wifi_set_mac(WIFI_IF_STA, s_original_sta_mac);
             s_mac_cloned = false;
             esp_netif_dhcpc_start(s_sta_netif);
             /* Odblokuj BSSID — pozwól na pełny scan przy fallback */
-            {
-                wifi_config_t current_cfg;
-                esp_wifi_get_config(WIFI_IF_STA, &current_cfg);
-                current_cfg.sta.bssid_set = false;
-                current_cfg.sta.channel = 0;
-                esp_wifi_set_config(WIFI_IF_STA, &current_cfg);
-            }
-            vTaskDelay(pdMS_TO_TICKS(200));
+            sta_lock_bssid(false);
             s_suppress_auto_reconnect = false;
             esp_wifi_connect();
             s_state = STATE_IDLE;
@@ -580,6 +1595,7 @@ static void mac_change_task(void *pvParams)
         /* ── Restore original MAC ─────────────── */
         s_state = STATE_MAC_RESTORING;
         ESP_LOGI(TAG, "=== MAC RESTORE ===");
+        TRACE_EV(TRACE_MAC_RESTORE_BEGIN, 0);
 
         /* 1. Stop forwarding */
         forwarding_stop();
@@ -589,11 +1605,7 @@ static void mac_change_task(void *pvParams)
 
         /* 3. Disconnect */
         ESP_LOGI(TAG, "  Disconnecting STA...");
-        esp_wifi_disconnect();
-
-        xEventGroupWaitBits(s_wifi_event_group, STA_DISCONNECTED_BIT,
-                            pdTRUE, pdFALSE, pdMS_TO_TICKS(5000));
-        vTaskDelay(pdMS_TO_TICKS(100));
+        sta_disconnect_wait();
 
         /* 4. Przywróć oryginalny MAC */
         esp_wifi_set_mac(WIFI_IF_STA, s_original_sta_mac);
@@ -607,8 +1619,13 @@ static void mac_change_task(void *pvParams)
         esp_netif_dhcpc_start(s_sta_netif);
         ESP_LOGI(TAG, "  DHCP client re-enabled");
 
-        /* 5a. Wyczyść tablicę MAC-NAT (nowa sesja bridgingu = nowe mapowania) */
+        /* 5a. Wyczyść tablicę MAC-NAT (nowa sesja bridgingu = nowe mapowania);
+         *     najpierw niech bridge skończy ramki sprzed forwarding_stop */
+        bridge_quiesce();
         macnat_clear();
+#if CONFIG_REPEATER_PROXY_ARP
+        arp_proxy_clear();
+#endif
         s_ap_ip_from_sniff = false;
         s_ap_ip_cache = 0;  /* clear until next DHCP sniff */
 
@@ -618,20 +1635,14 @@ static void mac_change_task(void *pvParams)
         ap_restore_management_ip();
 
         /* 6. Reconnect — odblokuj BSSID, pozwól na pełny scan */
-        {
-            wifi_config_t current_cfg;
-            esp_wifi_get_config(WIFI_IF_STA, &current_cfg);
-            current_cfg.sta.bssid_set = false;
-            current_cfg.sta.channel = 0;
-            esp_wifi_set_config(WIFI_IF_STA, &current_cfg);
-        }
+        sta_lock_bssid(false);
         ESP_LOGI(TAG, "  Reconnecting with original MAC...");
-        vTaskDelay(pdMS_TO_TICKS(200));
         s_suppress_auto_reconnect = false;
         esp_wifi_connect();
 
         EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group, STA_CONNECTED_BIT,
                                                 pdFALSE, pdFALSE, pdMS_TO_TICKS(15000));
+        TRACE_EV(TRACE_MAC_RESTORE_END, (bits & STA_CONNECTED_BIT) ? 1 : 0);
         if (bits & STA_CONNECTED_BIT) {
             ESP_LOGI(TAG, "=== IDLE MODE (own IP) ===");
         } else {
@@ -648,11 +1659,13 @@ static void mac_change_task(void *pvParams)
                          "auto-cloning for " MACSTR, MAC2STR(pending.sta[0].mac));
                 memcpy(s_client_mac, pending.sta[0].mac, 6);
                 s_client_count = pending.num;
+                ap_sta_cache_update(&pending, NULL);
                 /* Release mutex BEFORE requesting clone (new task needs it) */
                 xSemaphoreGive(s_mac_task_mutex);
                 s_mac_task_handle = NULL;
                 free(params);
                 request_mac_clone(s_client_mac);
+                repeater_mem_task_end();
                 vTaskDelete(NULL);
                 return;  /* unreachable, but clear intent */
             }
@@ -662,6 +1675,7 @@ static void mac_change_task(void *pvParams)
     xSemaphoreGive(s_mac_task_mutex);
     s_mac_task_handle = NULL;
     free(params);
+    repeater_mem_task_end();
     vTaskDelete(NULL);
 }
 
@@ -671,7 +1685,8 @@ static void request_mac_clone(const uint8_t *client_mac)
     if (!params) return;
     memcpy(params->mac, client_mac, 6);
     params->clone = true;
-    xTaskCreate(mac_change_task, "mac_clone", 4096, params, 10, &s_mac_task_handle);
+    xTaskCreate(mac_change_task, "mac_clone", CONFIG_REPEATER_STACK_MAC_TASK, params, 10,
+                &s_mac_task_handle);
 }
 
 static void request_mac_restore(void)
@@ -680,20 +1695,226 @@ static void request_mac_restore(void)
     if (!params) return;
     memcpy(params->mac, s_original_sta_mac, 6);
     params->clone = false;
-    xTaskCreate(mac_change_task, "mac_restore", 4096, params, 10, &s_mac_task_handle);
+    xTaskCreate(mac_change_task, "mac_restore", CONFIG_REPEATER_STACK_MAC_TASK, params, 10,
+                &s_mac_task_handle);
+}
+
+/* ══════════════════════════════════════════════════════════════
+ *  Grace period po wyjściu sklonowanego klienta
+ *
+ *  Re-clone pod innego klienta to reconnect STA — wszyscy tracą łącze
+ *  na kilka sekund. Zamiast tego STA zostaje przy MAC odchodzącego
+ *  (router nadal widzi "jego" asocjację), a pozostali klienci idą
+ *  przez MAC-NAT (s_macnat_min_clients = 1). Koniec grace:
+ *    - klient wrócił → znów primary, bez żadnego reconnectu,
+ *    - upłynęło CONFIG_REPEATER_CLONE_GRACE_S i ruch bridge'a ucichł
+ *      (liczniki forwardingu) → re-clone w oknie ciszy,
+ *    - MAC-NAT nie obsłuży klienta (brak wpisu IP→MAC dłużej niż
+ *      CONFIG_REPEATER_CLONE_UNSERVED_MS albo pełna tablica) → re-clone
+ *      od razu, pod tego klienta,
+ *    - odszedł ostatni klient → restore MAC jak dotąd.
+ * ══════════════════════════════════════════════════════════════ */
+
+enum {
+    GRACE_END_RETURNED = 0,   /* sklonowany klient wrócił */
+    GRACE_END_IDLE,           /* grace minęło, re-clone w oknie ciszy */
+    GRACE_END_UNSERVED,       /* MAC-NAT nie obsłuży klienta → re-clone */
+    GRACE_END_LAST_LEFT,      /* brak klientów → restore */
+};
+
+#define CLONE_GRACE_POLL_MS  500
+#define CLONE_GRACE_TASK_STACK 3072
+/* Bez CONFIG_REPEATER_METRICS nie ma licznika ruchu — bez wymogu ciszy */
+#ifndef CONFIG_REPEATER_CLONE_IDLE_PPS
+#define CONFIG_REPEATER_CLONE_IDLE_PPS        0
+#define CONFIG_REPEATER_CLONE_IDLE_WINDOW_MS  CLONE_GRACE_POLL_MS
+#endif
+
+/* Non-static: GET /status */
+volatile bool s_clone_grace = false;     /* sklonowany klient odszedł, STA nadal z jego MAC */
+uint32_t      s_clone_grace_saved = 0;   /* powroty w trakcie grace (re-clone uniknięty) */
+static portMUX_TYPE s_clone_grace_lock = portMUX_INITIALIZER_UNLOCKED;
+
+#if CONFIG_REPEATER_CLONE_GRACE_S > 0
+/* Pierwszy klient (poza leaving) bez wpisu w MAC-NAT (IPv4 ani IPv6), -1 = wszyscy znani */
+static int macnat_unserved_client(const wifi_sta_list_t *sl, const uint8_t *leaving)
+{
+    for (int i = 0; i < sl->num; i++) {
+        if (leaving && memcmp(sl->sta[i].mac, leaving, 6) == 0) continue;
+        if (macnat_table_lookup_mac(&s_macnat, sl->sta[i].mac)) continue;
+#if CONFIG_REPEATER_MACNAT_IPV6
+        if (macnat6_table_has_mac(&s_macnat6, sl->sta[i].mac)) continue;   /* tylko IPv6 */
+#endif
+        return i;
+    }
+    return -1;
+}
+#endif
+
+/* Zakończ grace; true tylko dla wołającego, który faktycznie je zakończył
+ * (event handler i clone_grace_task mogą się ścigać) */
+static bool clone_grace_end(uint32_t reason)
+{
+    portENTER_CRITICAL(&s_clone_grace_lock);
+    bool was = s_clone_grace;
+    s_clone_grace = false;
+    portEXIT_CRITICAL(&s_clone_grace_lock);
+    if (!was) return false;
+
+    s_macnat_min_clients = 2;
+    TRACE_EV(TRACE_CLONE_GRACE_END, reason);
+    return true;
+}
+
+/* Re-clone pod klienta (jak dotąd, ale po grace) */
+static void clone_grace_reclone(const uint8_t *mac)
+{
+    ESP_LOGI(TAG, "Re-cloning for " MACSTR, MAC2STR(mac));
+    memcpy(s_client_mac, mac, 6);
+    request_mac_clone(mac);
+}
+
+#if CONFIG_REPEATER_CLONE_GRACE_S > 0
+static void clone_grace_task(void *pv)
+{
+    repeater_mem_task_begin(CLONE_GRACE_TASK_STACK);
+    const int64_t start_us = esp_timer_get_time();
+    uint32_t last_frames = repeater_metrics_rx_frames();
+    uint32_t quiet_ms = 0, unserved_ms = 0;
+
+    while (s_clone_grace) {
+        vTaskDelay(pdMS_TO_TICKS(CLONE_GRACE_POLL_MS));
+
+        uint32_t frames = repeater_metrics_rx_frames();
+        uint32_t pps = (frames - last_frames) * 1000 / CLONE_GRACE_POLL_MS;
+        last_frames = frames;
+#if CONFIG_REPEATER_CLONE_IDLE_PPS > 0
+        quiet_ms = pps < CONFIG_REPEATER_CLONE_IDLE_PPS ? quiet_ms + CLONE_GRACE_POLL_MS : 0;
+#else
+        quiet_ms += CLONE_GRACE_POLL_MS;
+#endif
+
+        wifi_sta_list_t sl;
+        if (esp_wifi_ap_get_sta_list(&sl) != ESP_OK || sl.num == 0) continue;
+
+        /* Pełna tablica = eksmisje, wpis pozostałego klienta może zniknąć */
+        int target = macnat_unserved_client(&sl, NULL);
+        unserved_ms = target >= 0 ? unserved_ms + CLONE_GRACE_POLL_MS : 0;
+        if (unserved_ms >= CONFIG_REPEATER_CLONE_UNSERVED_MS ||
+            s_macnat.count >= MACNAT_CAPACITY) {
+            if (clone_grace_end(GRACE_END_UNSERVED)) {
+                ESP_LOGW(TAG, "Clone grace: MAC-NAT cannot serve all clients");
+                clone_grace_reclone(sl.sta[target >= 0 ? target : 0].mac);
+            }
+            break;
+        }
+
+        bool expired = esp_timer_get_time() - start_us >=
+                       (int64_t)CONFIG_REPEATER_CLONE_GRACE_S * 1000000;
+        if (expired && quiet_ms >= CONFIG_REPEATER_CLONE_IDLE_WINDOW_MS) {
+            if (clone_grace_end(GRACE_END_IDLE)) {
+                ESP_LOGI(TAG, "Clone grace expired, traffic idle (%lu pkt/s)",
+                         (unsigned long)pps);
+                clone_grace_reclone(sl.sta[0].mac);
+            }
+            break;
+        }
+    }
+    repeater_mem_task_end();
+    vTaskDelete(NULL);
+}
+#endif
+
+/* Sklonowany klient odszedł, a inni zostali. Grace zamiast
+ * re-clone, jeśli MAC-NAT zna już wszystkich pozostałych. */
+static void clone_client_left(const uint8_t *leaving)
+{
+    wifi_sta_list_t sl;
+    if (esp_wifi_ap_get_sta_list(&sl) != ESP_OK) return;
+    int first = -1;
+    for (int i = 0; i < sl.num && first < 0; i++) {
+        if (memcmp(sl.sta[i].mac, leaving, 6) != 0) first = i;
+    }
+    if (first < 0) return;
+
+#if CONFIG_REPEATER_CLONE_GRACE_S > 0
+    if (s_clone_grace) return;   /* duplikat eventu leave — grace już trwa */
+    int unserved = macnat_unserved_client(&sl, leaving);
+    if (unserved < 0 && s_macnat.count < MACNAT_CAPACITY) {
+        portENTER_CRITICAL(&s_clone_grace_lock);
+        bool start = s_mac_task_handle == NULL && !s_clone_grace;
+        if (start) s_clone_grace = true;
+        portEXIT_CRITICAL(&s_clone_grace_lock);
+        if (start) {
+            s_macnat_min_clients = 1;
+            TRACE_EV(TRACE_CLONE_GRACE_BEGIN, s_client_count);
+            ESP_LOGI(TAG, "Cloned client left, keeping its MAC for up to %d s; "
+                     "%d client(s) on MAC-NAT", CONFIG_REPEATER_CLONE_GRACE_S, s_client_count);
+            if (xTaskCreate(clone_grace_task, "clone_grace", CLONE_GRACE_TASK_STACK, NULL, 5,
+                            NULL) == pdPASS) {
+                return;
+            }
+            clone_grace_end(GRACE_END_UNSERVED);
+        }
+    } else if (unserved >= 0) {
+        first = unserved;   /* klient, którego MAC-NAT nie zna — niech on będzie primary */
+    }
+#endif
+    ESP_LOGI(TAG, "Cloned client left, but %d other clients remain. "
+             "Re-cloning...", s_client_count);
+    clone_grace_reclone(sl.sta[first].mac);
 }
 
 /* ══════════════════════════════════════════════════════════════
  *  WiFi event handlers
  * ══════════════════════════════════════════════════════════════ */
 
+/* Snapshot dla GET /status (repeater_httpd.h): odświeżany tutaj i w
+ * taskach, które i tak pytają driver (status, roaming) — handler HTTP
+ * tylko kopiuje. Pola wieloelementowe pod lockiem, pojedyncze słowa
+ * (rssi, clients, ip) zapisywane wprost. */
+static repeater_status_t s_status;
+static portMUX_TYPE      s_status_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void repeater_status_get(repeater_status_t *out)
+{
+    portENTER_CRITICAL(&s_status_lock);
+    *out = s_status;
+    portEXIT_CRITICAL(&s_status_lock);
+}
+
+static void status_snapshot_sta(const wifi_event_sta_connected_t *ev)
+{
+    uint8_t mac[6];
+    esp_wifi_get_mac(WIFI_IF_STA, mac);
+    wifi_ap_record_t ap;
+    int8_t rssi = esp_wifi_sta_get_ap_info(&ap) == ESP_OK ? ap.rssi : 0;
+
+    portENTER_CRITICAL(&s_status_lock);
+    memcpy(s_status.sta_mac, mac, 6);
+    if (ev) {
+        uint8_t n = ev->ssid_len < 32 ? ev->ssid_len : 32;
+        memcpy(s_status.upstream, ev->ssid, n);
+        s_status.upstream[n] = '\0';
+        s_status.channel = ev->channel;
+        s_status.rssi    = rssi;
+    } else {
+        s_status.upstream[0] = '\0';
+        s_status.channel = 0;
+        s_status.rssi    = 0;
+    }
+    portEXIT_CRITICAL(&s_status_lock);
+}
+
 static void wifi_event_handler(void *arg, esp_event_base_t base,
                                int32_t id, void *data)
 {
     switch (id) {
 
     case WIFI_EVENT_STA_START:
+        TRACE_EV(TRACE_STA_START, 0);
         ESP_LOGI(TAG, "STA started");
+        status_snapshot_sta(NULL);
         /* Nie łącz jeśli mac_change_task sam zarządza połączeniem */
         if (!s_suppress_auto_reconnect) {
             ESP_LOGI(TAG, "  Auto-connecting...");
@@ -701,13 +1922,25 @@ static void wifi_event_handler(void *arg, esp_event_base_t base,
         }
         break;
 
+    case WIFI_EVENT_AP_START:
+        TRACE_EV(TRACE_AP_START, 0);
+        break;
+
     case WIFI_EVENT_STA_CONNECTED: {
         wifi_event_sta_connected_t *ev = (wifi_event_sta_connected_t *)data;
+        TRACE_EV(TRACE_STA_CONNECTED, ev->channel);
         ESP_LOGI(TAG, ">> Connected to: %.*s (ch %d, BSSID " MACSTR ")",
                  ev->ssid_len, ev->ssid, ev->channel, MAC2STR(ev->bssid));
         s_sta_connected = true;
         xEventGroupSetBits(s_wifi_event_group, STA_CONNECTED_BIT);
         xEventGroupClearBits(s_wifi_event_group, STA_DISCONNECTED_BIT);
+#if CONFIG_REPEATER_FAST_BOOT
+        if (s_boot_direct) {
+            s_boot_direct = false;
+            ESP_LOGI(TAG, "  Direct boot connect: upstream up %lld ms after boot",
+                     (long long)(esp_timer_get_time() / 1000));
+        }
+#endif
 
         /* Zapamiętaj BSSID i kanał upstream AP żeby przy reconnect nie skakać po kanałach */
         if (!s_bssid_locked) {
@@ -717,28 +1950,71 @@ static void wifi_event_handler(void *arg, esp_event_base_t base,
             ESP_LOGI(TAG, "  BSSID locked: " MACSTR " ch %d",
                      MAC2STR(s_upstream_bssid), s_upstream_channel);
         }
+#if CONFIG_REPEATER_ROAM_ASSISTED
+        else if (memcmp(s_upstream_bssid, ev->bssid, 6) != 0) {
+            /* Reasocjacja zlecona przez upstream AP (802.11v BTM) — roam_to
+             * ustawia s_upstream_bssid przed connect, więc tu trafia tylko
+             * przejście wykonane przez supplicanta. Lock idzie za nim —
+             * także w configu drivera, inaczej następny reconnect (auto
+             * albo fast path) wróci do AP, od którego nas odesłano. */
+            memcpy(s_upstream_bssid, ev->bssid, 6);
+            s_upstream_channel = ev->channel;
+            wifi_config_t cfg;
+            if (esp_wifi_get_config(WIFI_IF_STA, &cfg) == ESP_OK && cfg.sta.bssid_set) {
+                sta_lock_bssid(true);
+            }
+            s_roam_stats.btm_roams++;
+            TRACE_EV(TRACE_BSS_TRANSITION, ev->channel);
+            ESP_LOGW(TAG, "  BSS transition: BSSID locked to " MACSTR " ch %d",
+                     MAC2STR(s_upstream_bssid), s_upstream_channel);
+        }
+#endif
 
         /* Klonuj SSID upstream do AP (jeśli włączone) */
         ap_clone_upstream_ssid(ev->ssid, ev->ssid_len);
+        status_snapshot_sta(ev);
 
         /* Jeśli jesteśmy w trybie bridging (MAC cloned), włącz forwarding */
         if (s_mac_cloned) {
             forwarding_start();
+        } else if (s_bridge_mode == REPEATER_BRIDGE_MACNAT) {
+            macnat_bridge_update();
         }
         break;
     }
 
     case WIFI_EVENT_STA_DISCONNECTED: {
         wifi_event_sta_disconnected_t *ev = (wifi_event_sta_disconnected_t *)data;
+        TRACE_EV(TRACE_STA_DISCONNECTED, ev->reason);
         ESP_LOGW(TAG, "<< Disconnected (reason %d)", ev->reason);
         s_sta_connected = false;
-        xEventGroupSetBits(s_wifi_event_group, STA_DISCONNECTED_BIT);
         xEventGroupClearBits(s_wifi_event_group, STA_CONNECTED_BIT);
+        status_snapshot_sta(NULL);
 
         forwarding_stop();
+        if (s_bridge_mode == REPEATER_BRIDGE_MACNAT) {
+            s_state = STATE_IDLE;
+        }
 
-        /* Auto-reconnect, ale NIE gdy mac_change_task sam zarządza połączeniem */
-        if (!s_suppress_auto_reconnect) {
+#if CONFIG_REPEATER_FAST_BOOT
+        if (s_boot_direct) {
+            /* Zapamiętany upstream nie odpowiada (inny kanał, wyłączony
+             * AP) — odblokuj BSSID, auto-reconnect zrobi pełny scan */
+            ESP_LOGW(TAG, "  Direct boot connect to " MACSTR " ch %d failed, full scan",
+                     MAC2STR(s_upstream_bssid), s_upstream_channel);
+            s_boot_direct = false;
+            s_bssid_locked = false;
+            sta_lock_bssid(false);
+        }
+#endif
+
+        /* Auto-reconnect, ale NIE gdy mac_change_task sam zarządza połączeniem
+         * ani gdy driver właśnie reasocjuje do innego AP (roaming/BTM) */
+        bool reconnect = !s_suppress_auto_reconnect && ev->reason != WIFI_REASON_ROAMING;
+        /* Bit na końcu: mac_change_task czeka na niego zamiast na stały
+         * vTaskDelay — handler już zdecydował o auto-reconnect */
+        xEventGroupSetBits(s_wifi_event_group, STA_DISCONNECTED_BIT);
+        if (reconnect) {
             vTaskDelay(pdMS_TO_TICKS(1000));
             ESP_LOGI(TAG, "Auto-reconnecting...");
             esp_wifi_connect();
@@ -746,19 +2022,47 @@ static void wifi_event_handler(void *arg, esp_event_base_t base,
         break;
     }
 
+#if CONFIG_REPEATER_ROAM_ASSISTED
+    case WIFI_EVENT_STA_NEIGHBOR_REP:
+        roam_on_neighbor_report((const wifi_event_neighbor_report_t *)data);
+        break;
+#endif
+
     case WIFI_EVENT_AP_STACONNECTED: {
         wifi_event_ap_staconnected_t *ev = (wifi_event_ap_staconnected_t *)data;
+        TRACE_EV(TRACE_AP_STACONNECTED, ev->aid);
         /* Use actual sta_list for reliable count (manual tracking desyncs
          * from duplicate leave events caused by SA Query timeouts) */
         {
             wifi_sta_list_t sl;
-            s_client_count = (esp_wifi_ap_get_sta_list(&sl) == ESP_OK) ? sl.num : s_client_count + 1;
+            if (esp_wifi_ap_get_sta_list(&sl) == ESP_OK) {
+                s_client_count = sl.num;
+                ap_sta_cache_update(&sl, NULL);
+            } else {
+                s_client_count++;
+            }
         }
+        s_status.clients = s_client_count;
+#if CONFIG_REPEATER_CLIENT_STATS
+        clients_add(ev->mac, xTaskGetTickCount() * portTICK_PERIOD_MS);
+#endif
         ESP_LOGI(TAG, "-> Client joined: " MACSTR " (AID=%d, total=%d)",
                  MAC2STR(ev->mac), ev->aid, s_client_count);
 
-        /* Jeśli jesteśmy w trybie IDLE (brak klona) → klonuj MAC klienta */
-        if (s_state == STATE_IDLE && !s_mac_cloned) {
+        if (s_bridge_mode == REPEATER_BRIDGE_MACNAT) {
+            /* Stały MAC upstream — klient od razu przez MAC-NAT */
+            ESP_LOGI(TAG, "MAC-NAT: client " MACSTR " via " MACSTR,
+                     MAC2STR(ev->mac), MAC2STR(s_client_mac));
+            macnat_bridge_update();
+        } else if (s_clone_grace && memcmp(ev->mac, s_client_mac, 6) == 0) {
+            /* Sklonowany klient wrócił w trakcie grace — STA nadal ma jego MAC */
+            if (clone_grace_end(GRACE_END_RETURNED)) {
+                s_clone_grace_saved++;
+                ESP_LOGI(TAG, "Cloned client " MACSTR " back, no re-clone needed",
+                         MAC2STR(ev->mac));
+            }
+        } else if (s_state == STATE_IDLE && !s_mac_cloned) {
+            /* Tryb IDLE (brak klona) → klonuj MAC klienta */
             memcpy(s_client_mac, ev->mac, 6);
             request_mac_clone(ev->mac);
         } else if (s_mac_cloned) {
@@ -774,6 +2078,7 @@ static void wifi_event_handler(void *arg, esp_event_base_t base,
 
     case WIFI_EVENT_AP_STADISCONNECTED: {
         wifi_event_ap_stadisconnected_t *ev = (wifi_event_ap_stadisconnected_t *)data;
+        TRACE_EV(TRACE_AP_STADISCONNECTED, ev->aid);
         /* Use actual sta_list for reliable count (exclude leaving client) */
         {
             wifi_sta_list_t sl;
@@ -783,15 +2088,23 @@ static void wifi_event_handler(void *arg, esp_event_base_t base,
                     if (memcmp(sl.sta[i].mac, ev->mac, 6) != 0) cnt++;
                 }
                 s_client_count = cnt;
+                ap_sta_cache_update(&sl, ev->mac);
             } else if (s_client_count > 0) {
                 s_client_count--;
             }
         }
+        s_status.clients = s_client_count;
+#if CONFIG_REPEATER_CLIENT_STATS
+        clients_remove(ev->mac);
+#endif
         ESP_LOGI(TAG, "<- Client left: " MACSTR " (AID=%d, total=%d)",
                  MAC2STR(ev->mac), ev->aid, s_client_count);
 
-        /* Jeśli odszedł ten klient, dla którego klonowaliśmy MAC → przywróć */
-        if (s_mac_cloned && memcmp(ev->mac, s_client_mac, 6) == 0) {
+        if (s_bridge_mode == REPEATER_BRIDGE_MACNAT) {
+            /* Wpisy MAC-NAT odchodzącego klienta wygasną (eksmisja najstarszego) */
+            macnat_bridge_update();
+        } else if (s_mac_cloned && memcmp(ev->mac, s_client_mac, 6) == 0) {
+            /* Odszedł klient, dla którego klonowaliśmy MAC → przywróć */
             /* Sprawdź ile klientów zostało (odfiltruj odchodzącego — race condition) */
             wifi_sta_list_t sta_list;
             int remaining = 0;
@@ -805,20 +2118,16 @@ static void wifi_event_handler(void *arg, esp_event_base_t base,
 
             if (remaining == 0) {
                 ESP_LOGI(TAG, "Last client left, restoring MAC...");
+                clone_grace_end(GRACE_END_LAST_LEFT);
                 request_mac_restore();
             } else {
-                /* Są jeszcze inni klienci, ale MAC jest sklonowany
-                 * pod starego klienta. Sklonuj pod pierwszego dostępnego. */
-                ESP_LOGI(TAG, "Cloned client left, but %d other clients remain. "
-                         "Re-cloning for first available...", remaining);
-                for (int i = 0; i < sta_list.num; i++) {
-                    if (memcmp(sta_list.sta[i].mac, ev->mac, 6) != 0) {
-                        memcpy(s_client_mac, sta_list.sta[i].mac, 6);
-                        request_mac_clone(sta_list.sta[i].mac);
-                        break;
-                    }
-                }
+                clone_client_left(ev->mac);
             }
+        } else if (s_clone_grace && s_client_count == 0 &&
+                   clone_grace_end(GRACE_END_LAST_LEFT)) {
+            /* W trakcie grace odszedł ostatni z pozostałych klientów */
+            ESP_LOGI(TAG, "Last client left during clone grace, restoring MAC...");
+            request_mac_restore();
         }
         break;
     }
@@ -839,97 +2148,33 @@ static void wifi_event_handler(void *arg, esp_event_base_t base,
 static void sniff_dhcp_ack_and_set_ap_ip(const uint8_t *data, uint16_t len)
 {
     /* Caller already verified: IPv4, UDP, src:67 dst:68, len >= 286 */
+    frame_dhcp_ack_t ack;
+    if (!frame_dhcp_ack_parse(data, len, &ack)) return;
 
-    /* IP header */
-    const uint8_t *ip_hdr = data + 14;
-    uint8_t ip_ihl = (ip_hdr[0] & 0x0F) * 4;
-    const uint8_t *udp_hdr = ip_hdr + ip_ihl;
-
-    /* DHCP message */
-    const uint8_t *dhcp = udp_hdr + 8;
-    int dhcp_len = len - 14 - ip_ihl - 8;
-    if (dhcp_len < 240) return;
-    if (dhcp[0] != 2) return;  /* not BOOTREPLY */
-
-    /* Magic cookie 0x63825363 at offset 236 */
-    if (dhcp[236] != 0x63 || dhcp[237] != 0x82 ||
-        dhcp[238] != 0x53 || dhcp[239] != 0x63) return;
-
-    /* Parse DHCP options — szukamy: type=53 ACK, subnet=1, router=3 */
-    const uint8_t *opt = dhcp + 240;
-    int opt_max = dhcp_len - 240;
-    bool is_ack = false;
-    uint32_t subnet_mask = 0;
-    uint32_t gateway = 0;
-
-    for (int i = 0; i < opt_max; ) {
-        uint8_t type = opt[i];
-        if (type == 255) break;           /* End */
-        if (type == 0) { i++; continue; } /* Pad */
-        if (i + 1 >= opt_max) break;
-        uint8_t olen = opt[i + 1];
-        if (i + 2 + olen > opt_max) break;
-
-        switch (type) {
-        case 53: /* DHCP Message Type */
-            if (olen == 1 && opt[i + 2] == 5) is_ack = true;
-            break;
-        case 1:  /* Subnet Mask */
-            if (olen == 4) memcpy(&subnet_mask, &opt[i + 2], 4);
-            break;
-        case 3:  /* Router */
-            if (olen >= 4) memcpy(&gateway, &opt[i + 2], 4);
-            break;
-        }
-        i += 2 + olen;
-    }
-
-    if (!is_ack) return;
-
-    /* yiaddr (assigned client IP) at DHCP offset 16 */
-    uint32_t client_ip_n;   /* network byte order */
-    memcpy(&client_ip_n, &dhcp[16], 4);
-    if (client_ip_n == 0 || subnet_mask == 0) return;
+#if CONFIG_REPEATER_WARM_START
+    /* Przed uczeniem — odrzucenie stanu z NVS czyści tablicę */
+    if (s_warm_state == WARM_PENDING) warm_validate(ack.yiaddr, "DHCP ACK");
+#endif
 
-    /* Learn IP→MAC from DHCP chaddr (offset 28 in DHCP payload) */
-    if (dhcp_len >= 34) {
-        macnat_learn(client_ip_n, &dhcp[28]);
+    /* Learn IP→MAC from DHCP chaddr */
+    if (ack.chaddr) {
+        macnat_learn(ack.yiaddr, ack.chaddr);
     }
 
-    /* AP IP already set from previous DHCP ACK — skip expensive recalculation */
-    if (s_ap_ip_from_sniff) return;
+    /* AP IP already set from previous DHCP ACK — skip expensive recalculation.
+     * MAC-NAT: STA ma własny DHCP, AP mirroruje STA IP (ap_mirror_sta_ip). */
+    if (s_ap_ip_from_sniff || s_bridge_mode == REPEATER_BRIDGE_MACNAT) return;
 
     ESP_LOGI(TAG, "DHCP ACK sniffed: client=" IPSTR " mask=" IPSTR " gw=" IPSTR,
-             IP2STR((esp_ip4_addr_t *)&client_ip_n),
-             IP2STR((esp_ip4_addr_t *)&subnet_mask),
-             IP2STR((esp_ip4_addr_t *)&gateway));
-
-    /* Wybierz IP dla AP: najwyższy użyteczny adres w podsieci
-     * (broadcast - 1), omijając IP klienta i gateway */
-    uint32_t h_client = ntohl(client_ip_n);
-    uint32_t h_mask   = ntohl(subnet_mask);
-    uint32_t h_gw     = ntohl(gateway);
-    uint32_t network  = h_client & h_mask;
-    uint32_t bcast    = network | ~h_mask;
-
-    uint32_t candidate = bcast - 1; /* np. x.x.x.254 dla /24 */
-    for (int tries = 0; tries < 10; tries++) {
-        if (candidate > network && candidate < bcast &&
-            candidate != h_client && candidate != h_gw) {
-            break;
-        }
-        candidate--;
-    }
-    /* Safety: jeśli nie znaleziono, użyj client - 1 */
-    if (candidate <= network || candidate >= bcast) {
-        candidate = h_client - 1;
-        if (candidate <= network) candidate = h_client + 1;
-    }
+             IP2STR((esp_ip4_addr_t *)&ack.yiaddr),
+             IP2STR((esp_ip4_addr_t *)&ack.netmask),
+             IP2STR((esp_ip4_addr_t *)&ack.gateway));
 
+    /* Wybierz IP dla AP: najwyższy użyteczny adres w podsieci */
     esp_netif_ip_info_t ap_ip = {
-        .ip      = { .addr = htonl(candidate) },
-        .netmask = { .addr = subnet_mask },
-        .gw      = { .addr = gateway },
+        .ip      = { .addr = frame_pick_ap_ip(ack.yiaddr, ack.netmask, ack.gateway) },
+        .netmask = { .addr = ack.netmask },
+        .gw      = { .addr = ack.gateway },
     };
 
     esp_netif_dhcps_stop(s_ap_netif);
@@ -987,25 +2232,252 @@ static void ap_restore_management_ip(void)
     ESP_LOGI(TAG, "AP IP restored to 192.168.4.1 (setup mode, DHCP ON)");
 }
 
+#if CONFIG_REPEATER_WARM_START
+/* ══════════════════════════════════════════════════════════════
+ *  Warm start — MAC-NAT i podsieć AP po restarcie
+ *
+ *  Po restarcie / brownoucie tablica IP→MAC jest pusta, a AP czeka na
+ *  DHCP ACK klienta (czasem do następnego odnowienia dzierżawy), zanim
+ *  dostanie IP w jego podsieci. Klienci zwykle zostają przy starych
+ *  adresach, więc zapisujemy (rzadko, tylko po zmianie) tablicę,
+ *  podsieć/bramę i IP AP w NVS (rep_rt) i odtwarzamy je przy boocie:
+ *   - tablica: od razu, zanim ruszy WiFi,
+ *   - IP AP (tryb clone, z DHCP sniffera): gdy bridge jest aktywny.
+ *  Stan jest warunkowy do pierwszego adresu z ruchu (DHCP ACK, ARP):
+ *  adres spoza przywróconej podsieci = sieć się zmieniła → wyczyść
+ *  tablicę, AP czeka na świeży DHCP ACK. Niezgodne wpisy w zgodnej
+ *  podsieci naprawia zwykłe uczenie (macnat_table_update nadpisuje).
+ * ══════════════════════════════════════════════════════════════ */
+
+#define WARM_KEY            "warm"
+#define WARM_AP_FROM_SNIFF  0x01   /* IP AP z DHCP sniffera (clone) */
+
+typedef struct __attribute__((packed)) {
+    uint32_t ssid_crc;        /* upstream SSID, dla którego zebrano stan */
+    uint8_t  bridge_mode;     /* REPEATER_BRIDGE_* */
+    uint8_t  flags;           /* WARM_AP_* */
+    uint8_t  count;
+    uint8_t  reserved;
+    uint32_t ap_ip;           /* network byte order, 0 = podsieć nieznana */
+    uint32_t netmask;
+    uint32_t gw;
+    struct __attribute__((packed)) {
+        uint32_t ip;
+        uint8_t  mac[6];
+    } entry[MACNAT_CAPACITY];
+} warm_snapshot_t;
+
+static warm_snapshot_t     s_warm_saved;       /* ostatnio zapisany / wczytany */
+static int64_t             s_warm_saved_at;    /* 0 = jeszcze nie zapisywano */
+static uint32_t            s_warm_net, s_warm_mask;
+static esp_netif_ip_info_t s_warm_ap_ip;       /* .ip = 0: nic do ustawienia */
+
+static uint32_t warm_ssid_crc(void)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)s_cfg.sta_ssid, strlen(s_cfg.sta_ssid));
+}
+
+/* Boot: przed esp_wifi_start(), tablica jeszcze bez czytelników */
+static void warm_restore(void)
+{
+    warm_snapshot_t w;
+    if (repeater_state_load(WARM_KEY, &w, sizeof(w)) != ESP_OK) return;
+    s_warm_saved = w;   /* ten sam stan nie jest zapisywany ponownie */
+
+    if (w.ssid_crc != warm_ssid_crc() || w.bridge_mode != s_bridge_mode ||
+        w.count > MACNAT_CAPACITY) {
+        ESP_LOGI(TAG, "Warm start: snapshot is for another upstream or mode, ignored");
+        return;
+    }
+    /* Maska 0 pasuje do każdego adresu — takiego stanu nie da się
+     * potwierdzić (starszy zapis bez podsieci) */
+    if (w.netmask == 0) {
+        ESP_LOGI(TAG, "Warm start: snapshot without a subnet, ignored");
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    MACNAT_WRITE_LOCK();
+    for (int i = 0; i < w.count; i++) {
+        macnat_table_update(&s_macnat, w.entry[i].ip, w.entry[i].mac, now);
+    }
+    MACNAT_WRITE_UNLOCK();
+
+    s_warm_mask = w.netmask;
+    s_warm_net  = w.ap_ip & w.netmask;
+    if ((w.flags & WARM_AP_FROM_SNIFF) && w.ap_ip) {
+        s_warm_ap_ip.ip.addr      = w.ap_ip;
+        s_warm_ap_ip.netmask.addr = w.netmask;
+        s_warm_ap_ip.gw.addr      = w.gw;
+    }
+    s_warm_restored = w.count;
+    s_warm_state    = WARM_PENDING;
+    ESP_LOGI(TAG, "Warm start: %d MAC-NAT entries, AP " IPSTR "/" IPSTR " (pending)",
+             w.count, IP2STR((esp_ip4_addr_t *)&w.ap_ip),
+             IP2STR((esp_ip4_addr_t *)&w.netmask));
+}
+
+/* Bridge aktywny (clone): zapamiętane IP AP zamiast czekać na DHCP ACK */
+static void warm_apply_ap_ip(void)
+{
+    if (!s_warm_ap_ip.ip.addr || s_warm_state != WARM_PENDING || s_ap_ip_from_sniff) return;
+
+    esp_netif_dhcps_stop(s_ap_netif);
+    esp_netif_set_ip_info(s_ap_netif, &s_warm_ap_ip);
+    s_ap_ip_from_sniff = true;
+    s_ap_ip_cache = s_warm_ap_ip.ip.addr;
+    ESP_LOGI(TAG, "AP IP restored to " IPSTR " (warm start)", IP2STR(&s_warm_ap_ip.ip));
+    s_warm_ap_ip.ip.addr = 0;
+}
+
+/* Slow path / GOT_IP: pierwszy adres z ruchu rozstrzyga o przywróconym stanie */
+static void warm_validate(uint32_t ip, const char *what)
+{
+    if ((ip & s_warm_mask) == s_warm_net) {
+        s_warm_state = WARM_CONFIRMED;
+        ESP_LOGI(TAG, "Warm start confirmed by %s " IPSTR,
+                 what, IP2STR((esp_ip4_addr_t *)&ip));
+        return;
+    }
+    s_warm_state = WARM_DROPPED;
+    ESP_LOGW(TAG, "Warm start: %s " IPSTR " outside the restored subnet, dropped",
+             what, IP2STR((esp_ip4_addr_t *)&ip));
+    macnat_clear();
+    s_warm_ap_ip.ip.addr = 0;
+    /* IP AP mogło być już z NVS — następny DHCP ACK ustawi je od nowa */
+    if (s_bridge_mode != REPEATER_BRIDGE_MACNAT) s_ap_ip_from_sniff = false;
+}
+
+/* Status task: zapis po zmianie, najwyżej co REPEATER_WARM_SAVE_S */
+static void warm_save(void)
+{
+    static macnat_entry_t copy[MACNAT_CAPACITY];   /* tylko status task */
+
+    /* Niepotwierdzony stan z NVS nie nadpisuje tego, co już tam jest */
+    if (s_warm_state == WARM_PENDING) return;
+    int64_t now = esp_timer_get_time();
+    if (s_warm_saved_at && now - s_warm_saved_at < (int64_t)CONFIG_REPEATER_WARM_SAVE_S * 1000000) {
+        return;
+    }
+    int n = macnat_table_copy(&s_macnat, copy);
+    if (n < 0) return;
+
+    warm_snapshot_t w = {
+        .ssid_crc    = warm_ssid_crc(),
+        .bridge_mode = s_bridge_mode,
+        .count       = (uint8_t)n,
+    };
+    for (int i = 0; i < n; i++) {
+        w.entry[i].ip = copy[i].ip;
+        memcpy(w.entry[i].mac, copy[i].real_mac, 6);
+    }
+    /* Podsieć: z DHCP sniffera (clone) albo lustro STA IP (MAC-NAT) */
+    bool subnet = s_bridge_mode == REPEATER_BRIDGE_MACNAT
+                      ? s_sta_ip_cache && s_ap_ip_cache == s_sta_ip_cache
+                      : s_ap_ip_from_sniff;
+    esp_netif_ip_info_t ap;
+    if (subnet && esp_netif_get_ip_info(s_ap_netif, &ap) == ESP_OK) {
+        w.flags   = s_bridge_mode == REPEATER_BRIDGE_MACNAT ? 0 : WARM_AP_FROM_SNIFF;
+        w.ap_ip   = ap.ip.addr;
+        w.netmask = ap.netmask.addr;
+        w.gw      = ap.gw.addr;
+    }
+
+    /* Bez podsieci nie ma czym potwierdzić stanu po boocie (warm_restore
+     * go odrzuci); pusty stan nie kasuje ostatniego dobrego */
+    if (w.netmask == 0 || (w.count == 0 && w.ap_ip == 0)) return;
+    if (memcmp(&w, &s_warm_saved, sizeof(w)) == 0) return;
+    if (repeater_state_save(WARM_KEY, &w, sizeof(w)) == ESP_OK) {
+        s_warm_saved    = w;
+        s_warm_saved_at = now;
+        ESP_LOGI(TAG, "Warm start snapshot saved (%d MAC-NAT entries)", n);
+    }
+}
+#endif
+
 static void ip_event_handler(void *arg, esp_event_base_t base,
                              int32_t id, void *data)
 {
     if (id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t *ev = (ip_event_got_ip_t *)data;
+        TRACE_EV(TRACE_STA_GOT_IP, ev->ip_info.ip.addr);
         ESP_LOGI(TAG, "=== Got IP: " IPSTR " gw: " IPSTR " ===",
                  IP2STR(&ev->ip_info.ip), IP2STR(&ev->ip_info.gw));
         s_sta_ip_cache = ev->ip_info.ip.addr;  /* cache for hot-path filter */
+        s_status.ip    = ev->ip_info.ip.addr;
         xEventGroupSetBits(s_wifi_event_group, STA_CONNECTED_BIT);
+#if CONFIG_REPEATER_WARM_START
+        /* Dummy 169.254.x przy klonowaniu (DHCP STA wyłączony) nic nie mówi */
+        if (s_warm_state == WARM_PENDING &&
+            (ev->ip_info.ip.addr & ESP_IP4TOADDR(255, 255, 0, 0)) != ESP_IP4TOADDR(169, 254, 0, 0)) {
+            warm_validate(ev->ip_info.ip.addr, "STA address");
+        }
+#endif
 
         /* Przełącz AP na podsieć upstream — GUI dostępne pod STA IP */
         ap_mirror_sta_ip(&ev->ip_info);
     } else if (id == IP_EVENT_STA_LOST_IP) {
         ESP_LOGW(TAG, "STA lost IP, restoring AP management subnet");
         s_sta_ip_cache = 0;
+        s_status.ip    = 0;
         ap_restore_management_ip();
     }
 }
 
+/* ══════════════════════════════════════════════════════════════
+ *  Profil radia — szybki test A/B z web GUI
+ * ══════════════════════════════════════════════════════════════ */
+
+/* Zastosuj profil bez zapisu do NVS: rozłącz STA, ustaw protokół/pasmo/
+ * moc i opcje HE, połącz ponownie i zmierz łącze. AMPDU / okno BA
+ * zostają z bootu (wifi_init_config_t). Bridge wraca sam — forwarding
+ * startuje w handlerze STA_CONNECTED. */
+esp_err_t radio_ab_apply(radio_profile_t p, radio_link_t *out)
+{
+    if (!radio_profile_supported(p)) return ESP_ERR_NOT_SUPPORTED;
+    if (xSemaphoreTake(s_mac_task_mutex, pdMS_TO_TICKS(5000)) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    ESP_LOGI(TAG, "Radio A/B: %s -> %s",
+             RADIO_PROFILE[s_radio_profile].name, RADIO_PROFILE[p].name);
+    s_suppress_auto_reconnect = true;
+    sta_disconnect_wait();
+
+    esp_err_t err = radio_profile_apply(p, s_cfg.tx_power_dbm);
+    if (err == ESP_OK) {
+        wifi_config_t sta_cfg;
+        esp_wifi_get_config(WIFI_IF_STA, &sta_cfg);
+        radio_profile_sta_config(p, &sta_cfg.sta);
+        esp_wifi_set_config(WIFI_IF_STA, &sta_cfg);
+        s_radio_profile = p;
+    }
+
+    xEventGroupClearBits(s_wifi_event_group, STA_CONNECTED_BIT);
+    s_suppress_auto_reconnect = false;
+    esp_wifi_connect();
+    EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group, STA_CONNECTED_BIT,
+                                           pdFALSE, pdFALSE, pdMS_TO_TICKS(10000));
+    if (err == ESP_OK) {
+        if (bits & STA_CONNECTED_BIT) {
+            /* RSSI z kilku beaconów po asocjacji */
+            vTaskDelay(pdMS_TO_TICKS(RADIO_AB_SETTLE_MS));
+            err = radio_link_get(out, RADIO_PROFILE[p].he_mcs9);
+        } else {
+            err = ESP_ERR_WIFI_NOT_CONNECT;
+        }
+    }
+    xSemaphoreGive(s_mac_task_mutex);
+
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Radio A/B: %s link %s RSSI %d ~%lu kbit/s", RADIO_PROFILE[p].name,
+                 radio_phymode_name(out->phymode), out->rssi, (unsigned long)out->rate_kbps);
+    } else {
+        ESP_LOGW(TAG, "Radio A/B: %s failed: %s", RADIO_PROFILE[p].name, esp_err_to_name(err));
+    }
+    return err;
+}
+
 /* ══════════════════════════════════════════════════════════════
  *  WiFi info + status
  * ══════════════════════════════════════════════════════════════ */
@@ -1018,21 +2490,48 @@ static void print_wifi_info(void)
     ESP_LOGI(TAG, "  HE (High Efficiency): CAPABLE");
     ESP_LOGI(TAG, "  OFDMA / BSS Coloring: CAPABLE");
     ESP_LOGI(TAG, "  MCS 0-9:              YES");
-    ESP_LOGI(TAG, "  BW: HT20 (required for HE)");
     ESP_LOGI(TAG, "  (WiFi6 active only if upstream AP supports it)");
 #else
     ESP_LOGI(TAG, "=== WiFi 5 (802.11n) Repeater ===");
-    ESP_LOGI(TAG, "  BW: HT40 (2.4 GHz)");
 #endif
+    ESP_LOGI(TAG, "  Radio profile: %s", RADIO_PROFILE[s_radio_profile].name);
     ESP_LOGI(TAG, "  Compat: WiFi 4/5");
     ESP_LOGI(TAG, "  Security: WPA2/WPA3");
     ESP_LOGI(TAG, "===================================");
 }
 
+#if CONFIG_REPEATER_FAST_BOOT
+/* Upstream połączony od co najmniej jednego cyklu status_task = "dobry";
+ * zapis do NVS tylko przy zmianie (flash) i tylko do namespace runtime —
+ * blob konfiguracji (i to, co GUI w międzyczasie zapisało) bez zmian. */
+static void upstream_remember(void)
+{
+    if (!s_sta_connected || !s_bssid_locked) return;
+    if (s_cfg.last_channel == s_upstream_channel &&
+        memcmp(s_cfg.last_bssid, s_upstream_bssid, 6) == 0) {
+        return;
+    }
+    memcpy(s_cfg.last_bssid, s_upstream_bssid, 6);
+    s_cfg.last_channel = s_upstream_channel;
+
+    if (repeater_config_save_upstream(s_cfg.last_bssid, s_cfg.last_channel) == ESP_OK) {
+        ESP_LOGI(TAG, "Upstream " MACSTR " ch %d saved for fast boot",
+                 MAC2STR(s_cfg.last_bssid), s_cfg.last_channel);
+    }
+}
+#endif
+
 static void status_task(void *pv)
 {
+    repeater_mem_task_begin(CONFIG_REPEATER_STACK_STATUS_TASK);
     while (1) {
         vTaskDelay(pdMS_TO_TICKS(30000));
+#if CONFIG_REPEATER_FAST_BOOT
+        upstream_remember();
+#endif
+#if CONFIG_REPEATER_WARM_START
+        warm_save();
+#endif
 
         const char *state_str;
         switch (s_state) {
@@ -1047,6 +2546,7 @@ static void status_task(void *pv)
 
         wifi_ap_record_t ap;
         if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+            s_status.rssi = ap.rssi;
             ESP_LOGI(TAG, "  Up: %s RSSI:%d Ch:%d", ap.ssid, ap.rssi, ap.primary);
 #if SOC_WIFI_HE_SUPPORT
             ESP_LOGI(TAG, "  PHY: %s",
@@ -1064,7 +2564,8 @@ static void status_task(void *pv)
         esp_wifi_get_mac(WIFI_IF_STA, current_mac);
         ESP_LOGI(TAG, "  STA MAC: " MACSTR " %s",
                  MAC2STR(current_mac),
-                 s_mac_cloned ? "(CLONED)" : "(original)");
+                 s_mac_cloned ? "(CLONED)" :
+                 s_bridge_mode == REPEATER_BRIDGE_MACNAT ? "(MAC-NAT)" : "(original)");
 
         wifi_sta_list_t sta_list;
         if (esp_wifi_ap_get_sta_list(&sta_list) == ESP_OK) {
@@ -1105,20 +2606,231 @@ static void ap_clone_upstream_ssid(const uint8_t *ssid, uint8_t ssid_len)
 }
 
 /* ══════════════════════════════════════════════════════════════
- *  Pseudo-mesh roaming — scan for better AP with same SSID
+ *  Pseudo-mesh roaming — przełącz na lepszy AP z tym samym SSID
  *
- *  Monitoruje RSSI upstream AP. Jeśli spadnie poniżej progu,
- *  skanuje w poszukiwaniu innego AP z tym samym SSID ale
- *  innym BSSID (pomijając własny AP). Przełącza się na najlepszy.
+ *  Co slot (REPEATER_ROAM_SCAN_SLOT_MS) sprawdza RSSI upstream AP.
+ *  Gdy wygładzony RSSI zbliża się do progu, sonduje w tle po JEDNYM
+ *  kanale (krótki dwell, w przerwach ruchu) i zbiera kandydatów z tym
+ *  samym SSID do tabeli (repeater_roam.c). Poniżej progu roam do
+ *  najlepszego świeżego kandydata — bez pełnego scanu.
  * ══════════════════════════════════════════════════════════════ */
 
+#ifndef CONFIG_REPEATER_ROAM_SCAN_SLOT_MS
+#define CONFIG_REPEATER_ROAM_SCAN_SLOT_MS     1500
+#endif
+#ifndef CONFIG_REPEATER_ROAM_SCAN_DWELL_MS
+#define CONFIG_REPEATER_ROAM_SCAN_DWELL_MS    40
+#endif
+#ifndef CONFIG_REPEATER_ROAM_SCAN_MARGIN_DB
+#define CONFIG_REPEATER_ROAM_SCAN_MARGIN_DB   10
+#endif
+#ifndef CONFIG_REPEATER_ROAM_SCAN_IDLE_PPS
+#define CONFIG_REPEATER_ROAM_SCAN_IDLE_PPS    200
+#endif
+#ifndef CONFIG_REPEATER_ROAM_CAND_MAX_AGE_S
+#define CONFIG_REPEATER_ROAM_CAND_MAX_AGE_S   60
+#endif
+#ifndef CONFIG_REPEATER_ROAM_SAMPLE_MS
+#define CONFIG_REPEATER_ROAM_SAMPLE_MS        250
+#endif
+#ifndef CONFIG_REPEATER_ROAM_PREDICT_S
+#define CONFIG_REPEATER_ROAM_PREDICT_S        5
+#endif
+#ifndef CONFIG_REPEATER_ROAM_RATE_MARGIN_PCT
+#define CONFIG_REPEATER_ROAM_RATE_MARGIN_PCT  30
+#endif
+
+#define ROAM_SCAN_RECORDS   6       /* AP z jednego kanału — reszta odrzucona */
+#define ROAM_SCAN_MAX_SKIP  8       /* po tylu slotach z ruchem sonduj i tak */
+#define ROAM_MAX_AGE_MS     (CONFIG_REPEATER_ROAM_CAND_MAX_AGE_S * 1000)
+
+#define ROAM_SAMPLES_PER_SLOT \
+    (CONFIG_REPEATER_ROAM_SCAN_SLOT_MS > CONFIG_REPEATER_ROAM_SAMPLE_MS ? \
+     CONFIG_REPEATER_ROAM_SCAN_SLOT_MS / CONFIG_REPEATER_ROAM_SAMPLE_MS : 1)
+
+/* Non-static: GET /status pokazuje estymator i kandydatów (odczyt bez locka) */
+roam_table_t s_roam;
+roam_est_t   s_roam_est;
+
+static inline uint32_t roam_now_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+/* Sonduj jeden kanał i dopisz AP z tym SSID do tabeli. Blokuje tylko
+ * roaming_task; radio jest poza kanałem domowym przez ~dwell ms. */
+static void roam_probe_channel(const uint8_t *ssid, uint8_t channel)
+{
+    wifi_scan_config_t scan_cfg = {
+        .ssid = (uint8_t *)ssid,
+        .channel = channel,
+        .show_hidden = false,
+        .scan_type = WIFI_SCAN_TYPE_ACTIVE,
+        .scan_time.active.min = CONFIG_REPEATER_ROAM_SCAN_DWELL_MS / 2,
+        .scan_time.active.max = CONFIG_REPEATER_ROAM_SCAN_DWELL_MS,
+    };
+    TRACE_EV(TRACE_ROAM_PROBE_BEGIN, channel);
+    if (esp_wifi_scan_start(&scan_cfg, true) != ESP_OK) {
+        TRACE_EV(TRACE_ROAM_PROBE_END, 0);
+        return;
+    }
+
+    /* Bufor na stosie zamiast malloc; get_ap_records zwalnia też
+     * rekordy, które się nie zmieściły */
+    wifi_ap_record_t rec[ROAM_SCAN_RECORDS];
+    uint16_t n = ROAM_SCAN_RECORDS;
+    if (esp_wifi_scan_get_ap_records(&n, rec) != ESP_OK) n = 0;
+    TRACE_EV(TRACE_ROAM_PROBE_END, n);
+
+    uint32_t now = roam_now_ms();
+    for (int i = 0; i < n; i++) {
+        if (memcmp(rec[i].bssid, s_ap_mac, 6) == 0) continue;   /* własny AP */
+        roam_table_update(&s_roam, rec[i].bssid, rec[i].primary, rec[i].rssi, now);
+    }
+}
+
+/* Czy ruch bridge'a pozwala teraz zejść z kanału? */
+static bool roam_scan_slot_free(uint32_t *last_frames, int *skipped)
+{
+    uint32_t frames = repeater_metrics_rx_frames();
+    uint32_t pps = (frames - *last_frames) * 1000 / CONFIG_REPEATER_ROAM_SCAN_SLOT_MS;
+    *last_frames = frames;
+    if (CONFIG_REPEATER_ROAM_SCAN_IDLE_PPS == 0 || pps < CONFIG_REPEATER_ROAM_SCAN_IDLE_PPS ||
+        ++*skipped >= ROAM_SCAN_MAX_SKIP) {
+        *skipped = 0;
+        return true;
+    }
+    return false;
+}
+
+#if CONFIG_REPEATER_ROAM_ASSISTED
+/* 802.11k: odpowiedź przychodzi w event loopie, roaming_task scala ją
+ * z tabelą w swoim slocie (tabela ma jednego pisarza) */
+#define ROAM_NR_MAX          ROAM_CANDIDATES
+#define ROAM_NR_INTERVAL_MS  30000   /* nie częściej pytaj upstream AP o sąsiadów */
+
+static roam_neighbor_t s_roam_nr[ROAM_NR_MAX];
+static int s_roam_nr_num;
+static portMUX_TYPE s_roam_nr_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void roam_on_neighbor_report(const wifi_event_neighbor_report_t *ev)
+{
+    /* report[0] to dialog token, dalej elementy Neighbor Report */
+    if (ev->report_len < 1) return;
+    roam_neighbor_t nr[ROAM_NR_MAX];
+    int n = roam_parse_neighbor_report(ev->report + 1, ev->report_len - 1, nr, ROAM_NR_MAX);
+
+    portENTER_CRITICAL(&s_roam_nr_lock);
+    memcpy(s_roam_nr, nr, n * sizeof(nr[0]));
+    s_roam_nr_num = n;
+    portEXIT_CRITICAL(&s_roam_nr_lock);
+
+    s_roam_stats.neighbor_reports++;
+    TRACE_EV(TRACE_ROAM_NEIGHBORS, n);
+    ESP_LOGI(TAG, "ROAM: neighbor report with %d entries", n);
+}
+
+/* Sąsiedzi z raportu → podpowiedzi w tabeli (kanały sondowane jako znane) */
+static void roam_merge_neighbors(uint32_t now)
+{
+    roam_neighbor_t nr[ROAM_NR_MAX];
+    portENTER_CRITICAL(&s_roam_nr_lock);
+    int n = s_roam_nr_num;
+    memcpy(nr, s_roam_nr, n * sizeof(nr[0]));
+    s_roam_nr_num = 0;
+    portEXIT_CRITICAL(&s_roam_nr_lock);
+
+    for (int i = 0; i < n; i++) {
+        /* STA pracuje w 2.4 GHz — sąsiedzi 5/6 GHz nic nie dają */
+        if (nr[i].channel == 0 || nr[i].channel > ROAM_MAX_CHANNEL) continue;
+        if (memcmp(nr[i].bssid, s_ap_mac, 6) == 0) continue;
+        ESP_LOGD(TAG, "ROAM: neighbor " MACSTR " ch%d", MAC2STR(nr[i].bssid), nr[i].channel);
+        roam_table_hint(&s_roam, nr[i].bssid, nr[i].channel, now, ROAM_MAX_AGE_MS);
+    }
+}
+#endif
+
+/* Przełącz STA na kandydata. false = nie udało się połączyć */
+static bool roam_to(const uint8_t bssid[6], uint8_t channel)
+{
+    /* Zaktualizuj BSSID i kanał */
+    memcpy(s_upstream_bssid, bssid, 6);
+    s_upstream_channel = channel;
+
+    /* Ustaw STA config z nowym BSSID */
+    wifi_config_t sta_cfg;
+    esp_wifi_get_config(WIFI_IF_STA, &sta_cfg);
+    memcpy(sta_cfg.sta.bssid, s_upstream_bssid, 6);
+    sta_cfg.sta.bssid_set = true;
+    sta_cfg.sta.channel = s_upstream_channel;
+    esp_wifi_set_config(WIFI_IF_STA, &sta_cfg);
+
+    int64_t t0 = esp_timer_get_time();
+    bool reassoc = false;
+#if CONFIG_REPEATER_ROAM_ASSISTED
+    /* Reasocjacja bez disconnect: connect przy aktywnym połączeniu
+     * przełącza driver na nowy BSSID (z FT, jeśli oba AP są w tej samej
+     * mobility domain). Stary AP zgłasza DISCONNECTED z
+     * WIFI_REASON_ROAMING — handler nie robi wtedy auto-reconnect. */
+    xEventGroupClearBits(s_wifi_event_group, STA_CONNECTED_BIT);
+    reassoc = esp_wifi_connect() == ESP_OK;
+#endif
+    if (!reassoc) {
+        /* Rozłącz i połącz z nowym AP */
+        s_suppress_auto_reconnect = true;
+        esp_wifi_disconnect();
+        vTaskDelay(pdMS_TO_TICKS(200));
+        s_suppress_auto_reconnect = false;
+        esp_wifi_connect();
+    }
+
+    /* Czekaj na połączenie */
+    EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group, STA_CONNECTED_BIT,
+                                            pdFALSE, pdFALSE, pdMS_TO_TICKS(10000));
+    if (bits & STA_CONNECTED_BIT) {
+        s_roam_stats.roams++;
+        s_roam_stats.last_roam_ms = (uint32_t)((esp_timer_get_time() - t0) / 1000);
+        ESP_LOGW(TAG, "ROAM: successfully roamed to " MACSTR " in %lu ms%s",
+                 MAC2STR(s_upstream_bssid), (unsigned long)s_roam_stats.last_roam_ms,
+                 reassoc ? " (reassociation)" : "");
+        return true;
+    }
+
+    s_roam_stats.roam_fail++;
+    ESP_LOGE(TAG, "ROAM: failed to connect, unlocking BSSID for auto-reconnect");
+    /* Odblokuj BSSID */
+    esp_wifi_get_config(WIFI_IF_STA, &sta_cfg);
+    sta_cfg.sta.bssid_set = false;
+    sta_cfg.sta.channel = 0;
+    esp_wifi_set_config(WIFI_IF_STA, &sta_cfg);
+    s_bssid_locked = false;
+    esp_wifi_connect();
+    return false;
+}
+
 static void roaming_task(void *pv)
 {
+    repeater_mem_task_begin(CONFIG_REPEATER_STACK_ROAM_TASK);
     ESP_LOGI(TAG, "Pseudo-mesh roaming started (threshold=%d dBm, hysteresis=%d dB)",
              (int)s_cfg.roam_rssi_threshold, (int)s_cfg.roam_hysteresis);
 
+    roam_scan_t scan = { 0 };
+    uint32_t last_frames = repeater_metrics_rx_frames();
+    int skipped = 0;
+    int sample = 0;
+    uint8_t est_bssid[6] = { 0 };
+#if CONFIG_REPEATER_ROAM_ASSISTED
+    uint32_t nr_req_ms = 0;
+    bool nr_req = false;     /* czy już pytaliśmy obecny AP */
+#endif
+    uint8_t nchan = 13;
+    wifi_country_t country;
+    if (esp_wifi_get_country(&country) == ESP_OK && country.nchan > 0) {
+        nchan = country.schan + country.nchan - 1;
+    }
+
     while (1) {
-        vTaskDelay(pdMS_TO_TICKS(10000));  /* sprawdzaj co 10s */
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_REPEATER_ROAM_SAMPLE_MS));
 
         /* Roaming tylko gdy STA jest podłączony i nie trwa zmiana MAC */
         if (!s_sta_connected || s_state == STATE_MAC_CHANGING ||
@@ -1130,123 +2842,103 @@ static void roaming_task(void *pv)
         if (esp_wifi_sta_get_ap_info(&current_ap) != ESP_OK) {
             continue;
         }
-
-        /* RSSI powyżej progu — nie szukaj lepszego */
-        if (current_ap.rssi >= s_cfg.roam_rssi_threshold) {
+        s_status.rssi = current_ap.rssi;
+
+        /* Gęste próbkowanie RSSI → estymator (poziom + trend);
+         * nowy AP (roam, reconnect) = estymator od zera */
+        uint32_t now = roam_now_ms();
+        if (memcmp(est_bssid, current_ap.bssid, 6) != 0) {
+            memcpy(est_bssid, current_ap.bssid, 6);
+            roam_est_reset(&s_roam_est);
+#if CONFIG_REPEATER_ROAM_ASSISTED
+            s_roam_stats.rrm = esp_rrm_is_rrm_supported_connection();
+            s_roam_stats.btm = esp_wnm_is_btm_supported_connection();
+            nr_req = false;
+#endif
+        }
+        roam_est_update(&s_roam_est, current_ap.rssi, now);
+        if (++sample < ROAM_SAMPLES_PER_SLOT) {
             continue;
         }
+        sample = 0;
 
-        ESP_LOGW(TAG, "ROAM: RSSI=%d < threshold=%d, scanning for better AP...",
-                 current_ap.rssi, (int)s_cfg.roam_rssi_threshold);
+        /* Obecny AP też w tabeli — plan kanałów i /status */
+        roam_table_update(&s_roam, current_ap.bssid, current_ap.primary, current_ap.rssi, now);
 
-        /* Scan pasywny (nie rozłącza STA) */
-        wifi_scan_config_t scan_cfg = {
-            .ssid = current_ap.ssid,   /* szukaj tego samego SSID */
-            .show_hidden = false,
-            .scan_type = WIFI_SCAN_TYPE_ACTIVE,
-            .scan_time.active.min = 100,
-            .scan_time.active.max = 300,
-        };
+        /* Decyzje wg prognozy za REPEATER_ROAM_PREDICT_S (gorszej z
+         * bieżącej i przewidywanej) — spadający link łapiemy wcześniej */
+        int cur_rssi  = roam_est_rssi(&s_roam_est);
+        int pred_rssi = roam_est_predict(&s_roam_est, CONFIG_REPEATER_ROAM_PREDICT_S * 1000);
+        int link_rssi = pred_rssi < cur_rssi ? pred_rssi : cur_rssi;
 
-        /* esp_wifi_scan_start z block=true może trwać kilka sekund */
-        esp_err_t err = esp_wifi_scan_start(&scan_cfg, true);
-        if (err != ESP_OK) {
-            ESP_LOGW(TAG, "ROAM: scan failed: %s", esp_err_to_name(err));
-            continue;
-        }
+#if CONFIG_REPEATER_ROAM_ASSISTED
+        roam_merge_neighbors(now);
+#endif
 
-        uint16_t ap_count = 0;
-        esp_wifi_scan_get_ap_num(&ap_count);
-        if (ap_count == 0) {
-            esp_wifi_scan_get_ap_records(&ap_count, NULL);  /* free scan memory */
-            ESP_LOGI(TAG, "ROAM: no APs found with SSID '%s'", current_ap.ssid);
-            continue;
+        /* Zbieraj kandydatów, zanim będzie źle */
+#if CONFIG_REPEATER_ROAM_ASSISTED
+        /* Neighbor report: kandydaci od upstream AP bez sondowania kanałów */
+        if (link_rssi < s_cfg.roam_rssi_threshold + CONFIG_REPEATER_ROAM_SCAN_MARGIN_DB &&
+            s_roam_stats.rrm && (!nr_req || now - nr_req_ms >= ROAM_NR_INTERVAL_MS)) {
+            if (esp_rrm_send_neighbor_report_request() == 0) {
+                nr_req = true;
+                nr_req_ms = now;
+            }
         }
-
-        wifi_ap_record_t *ap_list = malloc(sizeof(wifi_ap_record_t) * ap_count);
-        if (!ap_list) {
-            esp_wifi_scan_get_ap_records(&ap_count, NULL);
-            continue;
+#endif
+        if (link_rssi < s_cfg.roam_rssi_threshold + CONFIG_REPEATER_ROAM_SCAN_MARGIN_DB &&
+            roam_scan_slot_free(&last_frames, &skipped)) {
+            roam_probe_channel(current_ap.ssid,
+                               roam_scan_next_channel(&scan, &s_roam, nchan, now, ROAM_MAX_AGE_MS));
         }
-        esp_wifi_scan_get_ap_records(&ap_count, ap_list);
-
-        /* Znajdź najlepszy AP (pomijając siebie i obecny) */
-        int best_idx = -1;
-        int best_rssi = -127;
 
-        for (int i = 0; i < ap_count; i++) {
-            /* Pomiń własny AP (BSSID = s_ap_mac) */
-            if (memcmp(ap_list[i].bssid, s_ap_mac, 6) == 0) {
-                ESP_LOGI(TAG, "ROAM: skip self " MACSTR, MAC2STR(ap_list[i].bssid));
-                continue;
-            }
-            /* Pomiń obecny AP */
-            if (memcmp(ap_list[i].bssid, s_upstream_bssid, 6) == 0) {
-                continue;
-            }
-            /* Pomiń AP z gorszym sygnałem */
-            if (ap_list[i].rssi > best_rssi) {
-                best_rssi = ap_list[i].rssi;
-                best_idx = i;
-            }
+        /* Prognoza powyżej progu — nie szukaj lepszego */
+        if (link_rssi >= s_cfg.roam_rssi_threshold) {
+            continue;
         }
 
-        if (best_idx < 0) {
-            ESP_LOGI(TAG, "ROAM: no better AP found");
-            free(ap_list);
+        /* Najlepszy świeży kandydat (pomijając siebie i obecny) */
+        uint8_t exclude[2][6];
+        memcpy(exclude[0], current_ap.bssid, 6);
+        memcpy(exclude[1], s_ap_mac, 6);
+        const roam_cand_t *best = roam_table_best(&s_roam, roam_now_ms(), ROAM_MAX_AGE_MS,
+                                                  exclude, 2);
+        if (!best) {
+            ESP_LOGD(TAG, "ROAM: RSSI=%d (predicted %d) < threshold=%d, no candidate yet",
+                     cur_rssi, pred_rssi, (int)s_cfg.roam_rssi_threshold);
             continue;
         }
 
-        /* Nowy AP musi być lepszy o hysteresis od obecnego */
-        if (best_rssi < current_ap.rssi + s_cfg.roam_hysteresis) {
-            ESP_LOGI(TAG, "ROAM: best candidate " MACSTR " RSSI=%d, "
-                     "not enough improvement (need +%d dB over %d)",
-                     MAC2STR(ap_list[best_idx].bssid), best_rssi,
-                     (int)s_cfg.roam_hysteresis, current_ap.rssi);
-            free(ap_list);
+        /* Kandydat musi dawać wyraźnie wyższą szybkość niż prognoza
+         * obecnego łącza, a histereza w dB chroni przed ping-pongiem */
+        int best_rssi      = roam_cand_rssi(best);
+        uint32_t best_rate = roam_rate_kbps(best_rssi);
+        uint32_t link_rate = roam_rate_kbps(link_rssi);
+        if ((uint64_t)best_rate * 100 < (uint64_t)link_rate * (100 + CONFIG_REPEATER_ROAM_RATE_MARGIN_PCT) ||
+            best_rssi < link_rssi + s_cfg.roam_hysteresis) {
+            ESP_LOGD(TAG, "ROAM: best candidate " MACSTR " RSSI=%d (%lu kb/s), "
+                     "not enough over %d dBm (%lu kb/s)",
+                     MAC2STR(best->bssid), best_rssi, (unsigned long)best_rate,
+                     link_rssi, (unsigned long)link_rate);
             continue;
         }
 
         /* ── Roam! ──────────────────────────── */
-        ESP_LOGW(TAG, "ROAM: switching to " MACSTR " RSSI=%d (from " MACSTR " RSSI=%d)",
-                 MAC2STR(ap_list[best_idx].bssid), best_rssi,
-                 MAC2STR(s_upstream_bssid), current_ap.rssi);
-
-        /* Zaktualizuj BSSID i kanał */
-        memcpy(s_upstream_bssid, ap_list[best_idx].bssid, 6);
-        s_upstream_channel = ap_list[best_idx].primary;
-
-        /* Ustaw STA config z nowym BSSID */
-        wifi_config_t sta_cfg;
-        esp_wifi_get_config(WIFI_IF_STA, &sta_cfg);
-        memcpy(sta_cfg.sta.bssid, s_upstream_bssid, 6);
-        sta_cfg.sta.bssid_set = true;
-        sta_cfg.sta.channel = s_upstream_channel;
-        esp_wifi_set_config(WIFI_IF_STA, &sta_cfg);
-
-        free(ap_list);
-
-        /* Rozłącz i połącz z nowym AP */
-        s_suppress_auto_reconnect = true;
-        esp_wifi_disconnect();
-        vTaskDelay(pdMS_TO_TICKS(200));
-        s_suppress_auto_reconnect = false;
-        esp_wifi_connect();
-
-        /* Czekaj na połączenie */
-        EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group, STA_CONNECTED_BIT,
-                                                pdFALSE, pdFALSE, pdMS_TO_TICKS(10000));
-        if (bits & STA_CONNECTED_BIT) {
-            ESP_LOGW(TAG, "ROAM: successfully roamed to " MACSTR, MAC2STR(s_upstream_bssid));
-        } else {
-            ESP_LOGE(TAG, "ROAM: failed to connect, unlocking BSSID for auto-reconnect");
-            /* Odblokuj BSSID */
-            esp_wifi_get_config(WIFI_IF_STA, &sta_cfg);
-            sta_cfg.sta.bssid_set = false;
-            sta_cfg.sta.channel = 0;
-            esp_wifi_set_config(WIFI_IF_STA, &sta_cfg);
-            s_bssid_locked = false;
-            esp_wifi_connect();
+        ESP_LOGW(TAG, "ROAM: switching to " MACSTR " ch%d RSSI=%d ~%lu kb/s (from " MACSTR
+                 " RSSI=%d, trend %+d dB/10s, predicted %d ~%lu kb/s)",
+                 MAC2STR(best->bssid), best->channel, best_rssi, (unsigned long)best_rate,
+                 MAC2STR(current_ap.bssid), cur_rssi,
+                 roam_est_slope_x10(&s_roam_est),
+                 pred_rssi, (unsigned long)link_rate);
+
+        uint8_t bssid[6];
+        memcpy(bssid, best->bssid, 6);
+        TRACE_EV(TRACE_ROAM_SWITCH_BEGIN, best->channel);
+        bool ok = roam_to(bssid, best->channel);
+        TRACE_EV(TRACE_ROAM_SWITCH_END, ok);
+        if (!ok) {
+            /* Nie wracaj do niego, dopóki scan nie zobaczy go ponownie */
+            roam_table_forget(&s_roam, bssid);
         }
 
         /* Daj trochę czasu na stabilizację przed kolejnym sprawdzeniem */
@@ -1260,6 +2952,7 @@ static void roaming_task(void *pv)
 
 static void init_wifi(void)
 {
+    TRACE_EV(TRACE_WIFI_INIT_BEGIN, 0);
     s_sta_netif = esp_netif_create_default_wifi_sta();
     s_ap_netif  = esp_netif_create_default_wifi_ap();
     assert(s_sta_netif && s_ap_netif);
@@ -1272,6 +2965,7 @@ static void init_wifi(void)
      * dzięki temu zbridgowany klient osiąga GUI bez zmiany IP. */
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+    radio_profile_init_config(s_radio_profile, &cfg);
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
 
     /* Zachowaj oryginalny MAC */
@@ -1283,6 +2977,22 @@ static void init_wifi(void)
     ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_APSTA));
 
+    if (s_bridge_mode == REPEATER_BRIDGE_MACNAT) {
+        /* Stały MAC upstream przez cały czas pracy — fabryczny albo z konfiguracji */
+        static const uint8_t zero_mac[6];
+        memcpy(s_client_mac, s_original_sta_mac, 6);
+        if (memcmp(s_cfg.upstream_mac, zero_mac, 6) != 0) {
+            esp_err_t err = esp_wifi_set_mac(WIFI_IF_STA, s_cfg.upstream_mac);
+            if (err == ESP_OK) {
+                memcpy(s_client_mac, s_cfg.upstream_mac, 6);
+            } else {
+                ESP_LOGW(TAG, "Upstream MAC " MACSTR ": %s, using factory MAC",
+                         MAC2STR(s_cfg.upstream_mac), esp_err_to_name(err));
+            }
+        }
+        ESP_LOGI(TAG, "Bridge mode MAC-NAT, upstream MAC " MACSTR, MAC2STR(s_client_mac));
+    }
+
     /* STA config — from NVS runtime config */
     wifi_config_t sta_cfg = {
         .sta = {
@@ -1290,22 +3000,43 @@ static void init_wifi(void)
             .sort_method = WIFI_CONNECT_AP_BY_SIGNAL,
             .threshold.authmode = WIFI_AUTH_OPEN,
             .sae_pwe_h2e = WPA3_SAE_PWE_BOTH,
-#if SOC_WIFI_HE_SUPPORT
-            .he_dcm_set = 0,
-            .he_dcm_max_constellation_tx = 2,
-            .he_dcm_max_constellation_rx = 2,
-            .he_mcs9_enabled = 1,
+#if CONFIG_REPEATER_ADAPTIVE_PS
+            .listen_interval = CONFIG_REPEATER_PS_LISTEN_INTERVAL,
+#endif
+#if CONFIG_REPEATER_ROAM_ASSISTED
+            /* 802.11k/v/r — patrz roaming_task / roam_to */
+            .rm_enabled = 1,
+            .btm_enabled = 1,
+            .ft_enabled = 1,
 #endif
         },
     };
+    radio_profile_sta_config(s_radio_profile, &sta_cfg.sta);
     strlcpy((char *)sta_cfg.sta.ssid,     s_cfg.sta_ssid, sizeof(sta_cfg.sta.ssid));
     strlcpy((char *)sta_cfg.sta.password,  s_cfg.sta_pass, sizeof(sta_cfg.sta.password));
+#if CONFIG_REPEATER_FAST_BOOT
+    /* Ostatni dobry upstream z NVS: BSSID + kanał → driver sonduje jeden
+     * kanał zamiast wszystkich. Porażka → STA_DISCONNECTED odblokowuje. */
+    if (s_cfg.last_channel >= 1 && s_cfg.last_channel <= 14) {
+        memcpy(s_upstream_bssid, s_cfg.last_bssid, 6);
+        s_upstream_channel = s_cfg.last_channel;
+        s_bssid_locked = true;
+        s_boot_direct  = true;
+        memcpy(sta_cfg.sta.bssid, s_upstream_bssid, 6);
+        sta_cfg.sta.bssid_set = true;
+        sta_cfg.sta.channel   = s_upstream_channel;
+        ESP_LOGI(TAG, "Direct boot connect: " MACSTR " ch %d",
+                 MAC2STR(s_upstream_bssid), s_upstream_channel);
+    }
+#endif
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &sta_cfg));
 
     /* AP config — from NVS runtime config */
+    /* AP od razu na kanale upstream (jeśli znany) — w APSTA AP i tak
+     * przechodzi na kanał STA, a zmiana kanału rozłącza klientów */
     wifi_config_t ap_cfg = {
         .ap = {
-            .channel = 0,
+            .channel = s_upstream_channel,
             .authmode = (wifi_auth_mode_t)s_cfg.ap_authmode,
             .pmf_cfg = { .required = false, .capable = true },
             .sae_pwe_h2e = WPA3_SAE_PWE_BOTH,
@@ -1321,21 +3052,15 @@ static void init_wifi(void)
     ESP_LOGI(TAG, "AP authmode: %d", ap_cfg.ap.authmode);
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_AP, &ap_cfg));
 
-    /* Bandwidth: HE (C6) wymaga HT20; bez HE (S3) HT40 daje lepszy throughput */
-#if SOC_WIFI_HE_SUPPORT
-    esp_wifi_set_bandwidth(WIFI_IF_STA, WIFI_BW_HT20);
-    esp_wifi_set_bandwidth(WIFI_IF_AP,  WIFI_BW_HT20);
-#else
-    esp_wifi_set_bandwidth(WIFI_IF_STA, WIFI_BW_HT40);
-    esp_wifi_set_bandwidth(WIFI_IF_AP,  WIFI_BW_HT40);
-#endif
-    esp_wifi_set_max_tx_power(s_cfg.tx_power_dbm * 4);
+    /* Protokoły, pasmo STA/AP i moc z profilu radia */
+    radio_profile_apply(s_radio_profile, s_cfg.tx_power_dbm);
 
     /* Event handlers */
     ESP_ERROR_CHECK(esp_event_handler_instance_register(
         WIFI_EVENT, ESP_EVENT_ANY_ID, wifi_event_handler, NULL, NULL));
     ESP_ERROR_CHECK(esp_event_handler_instance_register(
         IP_EVENT, ESP_EVENT_ANY_ID, ip_event_handler, NULL, NULL));
+    TRACE_EV(TRACE_WIFI_INIT_END, 0);
 }
 
 /* ══════════════════════════════════════════════════════════════
@@ -1353,9 +3078,11 @@ void app_main(void)
 #endif
     ESP_LOGI(TAG, "  L2 Bridge - MAC Cloning + MAC-NAT");
     ESP_LOGI(TAG, "========================================");
+    TRACE_EV(TRACE_BOOT, 0);
 
     s_wifi_event_group = xEventGroupCreate();
     s_mac_task_mutex = xSemaphoreCreateMutex();
+    macnat_clear();
 
     /* NVS */
     esp_err_t ret = nvs_flash_init();
@@ -1363,23 +3090,51 @@ void app_main(void)
         ESP_ERROR_CHECK(nvs_flash_erase());
         ESP_ERROR_CHECK(nvs_flash_init());
     }
+    TRACE_EV(TRACE_NVS_READY, 0);
 
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
+    /* Handlery eventów działają w tasku domyślnej pętli */
+    repeater_mem_task_track("sys_evt", CONFIG_ESP_SYSTEM_EVENT_TASK_STACK_SIZE);
 
     /* Load runtime config from NVS (falls back to menuconfig defaults) */
     repeater_config_load(&s_cfg);
+    if (radio_profile_supported((radio_profile_t)s_cfg.radio_profile)) {
+        s_radio_profile = (radio_profile_t)s_cfg.radio_profile;
+    }
+    if (s_cfg.bridge_mode == REPEATER_BRIDGE_MACNAT) {
+        s_bridge_mode = REPEATER_BRIDGE_MACNAT;
+        s_macnat_min_clients = 1;
+    }
+#if CONFIG_REPEATER_CLIENT_STATS
+    clients_set_cap(s_cfg.client_cap_kbps);
+#endif
+    TRACE_EV(TRACE_CONFIG_LOADED, 0);
+#if CONFIG_REPEATER_WARM_START
+    warm_restore();
+#endif
+
+#if CONFIG_REPEATER_DEFERRED_PIPELINE
+    /* Bridge task musi istnieć zanim forwarding_start() zarejestruje callbacki */
+    bridge_pipeline_start();
+#endif
 
     print_wifi_info();
     init_wifi();
 
     ESP_ERROR_CHECK(esp_wifi_start());
+    TRACE_EV(TRACE_WIFI_STARTED, 0);
+#if CONFIG_REPEATER_ADAPTIVE_PS
+    ps_start();
+#endif
     ESP_LOGI(TAG, "APSTA started");
     ESP_LOGI(TAG, "  Upstream: %s", s_cfg.sta_ssid);
     ESP_LOGI(TAG, "  Repeater: %s", s_cfg.ap_ssid);
     ESP_LOGI(TAG, "  TX Power: %d dBm, Max clients: %d",
              s_cfg.tx_power_dbm, s_cfg.max_clients);
     ESP_LOGI(TAG, "  AP Clone SSID: %s", s_cfg.ap_clone_ssid ? "ON" : "OFF");
+    ESP_LOGI(TAG, "  Bridge mode: %s",
+             s_bridge_mode == REPEATER_BRIDGE_MACNAT ? "MAC-NAT (all clients)" : "clone");
     ESP_LOGI(TAG, "  Pseudo-mesh: %s%s",
              s_cfg.pseudo_mesh ? "ON" : "OFF",
              s_cfg.pseudo_mesh ? "" : "");
@@ -1387,17 +3142,23 @@ void app_main(void)
         ESP_LOGI(TAG, "    RSSI threshold: %d dBm, Hysteresis: %d dB",
                  (int)s_cfg.roam_rssi_threshold, (int)s_cfg.roam_hysteresis);
     }
+#if CONFIG_REPEATER_CLIENT_STATS
+    if (s_cfg.client_cap_kbps) {
+        ESP_LOGI(TAG, "  Per-client cap: %lu kbit/s", (unsigned long)s_cfg.client_cap_kbps);
+    }
+#endif
     ESP_LOGI(TAG, "  Config GUI: http://192.168.4.1 (before upstream connect)");
     ESP_LOGI(TAG, "              After upstream connect: same IP as STA");
 
     /* Start HTTP config server (if enabled in menuconfig) */
     repeater_httpd_start();
+    TRACE_EV(TRACE_HTTPD_STARTED, 0);
 
-    xTaskCreate(status_task, "status", 4096, NULL, 5, NULL);
+    xTaskCreate(status_task, "status", CONFIG_REPEATER_STACK_STATUS_TASK, NULL, 5, NULL);
 
     /* Start roaming task if pseudo-mesh enabled */
     if (s_cfg.pseudo_mesh) {
-        xTaskCreate(roaming_task, "roaming", 4096, NULL, 5, NULL);
+        xTaskCreate(roaming_task, "roaming", CONFIG_REPEATER_STACK_ROAM_TASK, NULL, 5, NULL);
     }
 
     ESP_LOGI(TAG, "Waiting for connections...");